@@ -43,6 +43,20 @@ def aam_code(word):
     else:
         return 0
 
+# JH added: ReLU flag for ALU ops, e.g. MAD_RELU(AAM0) / ADD_RELU(AAM0)
+def relu_code(word):
+    if "RELU" in word:
+        return 1 << 12
+    else:
+        return 0
+
+# MAD bias operand, always SRF_A[idx] -> bits 18..16
+def src2_code(word):
+    if "SRF_A" not in word:
+        raise ValueError("MAD bias must be SRF_A[idx]: " + word)
+    tmp = int(re.sub(r'[^0-9]', '', word))
+    return (tmp & 0b111) << 16
+
 def src_code(word, loc):
     shifter = 25 - loc * 3
     idx_shifter = 8 - loc * 4
@@ -78,12 +92,15 @@ def convert_to_ukernel(words):
     ukernel_code = 1 << 32 # later gone
     ukernel_code = ukernel_code | op_code(words[0])
     ukernel_code = ukernel_code | aam_code(words[0])
+    ukernel_code = ukernel_code | relu_code(words[0])
     if len(words) >= 2:
         ukernel_code = ukernel_code | src_code(words[1], 0)
     if len(words) >= 3:
         ukernel_code = ukernel_code | src_code(words[2], 1)
     if len(words) >= 4:
         ukernel_code = ukernel_code | src_code(words[3], 2)
+    if len(words) >= 5:
+        ukernel_code = ukernel_code | src2_code(words[4])
     ukernel_code = ukernel_code - (1 << 32) # later gone
     ukernel_code = str(bin(ukernel_code))
     ukernel_code = '0b'+'0'*(34-len(ukernel_code))+ukernel_code[2:]
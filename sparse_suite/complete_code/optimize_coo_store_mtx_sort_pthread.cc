@@ -8,6 +8,7 @@
 #include <stdexcept>
 #include <map>
 #include <pthread.h>
+#include "../mtx_reader.h"
 
 #define N_THREAD 16
 #define debug 1
@@ -24,40 +25,20 @@ struct COOMatrix {
 
 // Function to read Matrix Market (MTX) file
 COOMatrix readMTXFile(const std::string& file_path) {
+    MTXEntries entries = readMTXEntries(file_path); // mtx_reader.h
     COOMatrix matrix;
-    std::ifstream file(file_path);
-    if (!file.is_open()) {
-        throw std::runtime_error("Unable to open file: " + file_path);
-    }
-
-    std::string line;
-    bool is_comment = true;
-
-    // Read header and metadata
-    while (is_comment && std::getline(file, line)) {
-        if (line[0] != '%') {
-            is_comment = false;
-            std::istringstream iss(line);
-            iss >> matrix.n_rows >> matrix.n_cols >> matrix.nnz;
-        }
-    }
-
+    matrix.n_rows = entries.header.n_rows;
+    matrix.n_cols = entries.header.n_cols;
+    matrix.nnz = entries.rows.size();
     matrix.row_indices.reserve(matrix.nnz);
     matrix.col_indices.reserve(matrix.nnz);
     matrix.values.reserve(matrix.nnz);
-
-    // Read COO data
-    uint32_t row, col;
-    float value;
-    while (std::getline(file, line)) {
-        std::istringstream iss(line);
-        iss >> row >> col >> value;
-        matrix.row_indices.push_back(row - 1); // Convert to zero-based indexing
-        matrix.col_indices.push_back(col - 1); // Convert to zero-based indexing
-        matrix.values.push_back(static_cast<uint16_t>(value));
+    for (size_t i = 0; i < matrix.nnz; i++) {
+        matrix.row_indices.push_back(entries.rows[i] - 1); // Convert to zero-based indexing
+        matrix.col_indices.push_back(entries.cols[i] - 1); // Convert to zero-based indexing
+        matrix.values.push_back(static_cast<uint16_t>(entries.values[i]));
     }
 
-    file.close();
     std::cout << "Matrix loaded: " << matrix.n_rows << "x" << matrix.n_cols << " with " << matrix.nnz << " non-zero elements." << std::endl;
     return matrix;
 }
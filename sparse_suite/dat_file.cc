@@ -0,0 +1,146 @@
+#include "dat_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+struct Mapping {
+    void* data;
+    size_t size;
+    ~Mapping() { munmap(data, size); }
+};
+
+bool truncated(const std::string& filename) {
+    std::cerr << filename << ": truncated .dat file" << std::endl;
+    return false;
+}
+
+// v2: header and offset table checked against the file size
+bool openV2(const std::string& filename, int fd, size_t file_size,
+            size_t record_size, DatImage* image) {
+    void* p = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+        std::cerr << "Failed to map file for loading: " << filename << std::endl;
+        return false;
+    }
+    auto mapping = std::make_shared<Mapping>();
+    mapping->data = p;
+    mapping->size = file_size;
+
+    const DatHeader* h = static_cast<const DatHeader*>(p);
+    if (h->version != DAT_VERSION || h->record_size != record_size) {
+        std::cerr << filename << ": .dat version " << h->version << " / record size "
+                  << h->record_size << ", expected " << DAT_VERSION << " / "
+                  << record_size << std::endl;
+        return false;
+    }
+    uint64_t table_end = sizeof(DatHeader) + sizeof(uint64_t) * ((uint64_t)h->n_part + 1);
+    if (table_end > file_size || h->data_offset < table_end ||
+        h->data_offset > file_size ||
+        h->total > (file_size - h->data_offset) / record_size)
+        return truncated(filename);
+    const uint64_t* offsets = reinterpret_cast<const uint64_t*>(h + 1);
+    image->offsets.assign(offsets, offsets + h->n_part + 1);
+    for (uint32_t i = 0; i < h->n_part; i++) {
+        if (image->offsets[i] > image->offsets[i + 1])
+            return truncated(filename);
+    }
+    if (image->offsets[0] != 0 || image->offsets[h->n_part] != h->total)
+        return truncated(filename);
+    image->records = static_cast<const char*>(p) + h->data_offset;
+    image->owner = mapping;
+    return true;
+}
+
+// v1: counts interleaved with the records, read into one buffer
+bool openV1(const std::string& filename, int fd, size_t file_size,
+            size_t record_size, DatImage* image) {
+    FILE* f = fdopen(dup(fd), "rb");
+    if (!f)
+        return false;
+    auto buffer = std::make_shared<std::vector<char>>();
+    // records <= file size, reserve once so the parts do not move
+    buffer->reserve(file_size);
+    uint32_t n_part = 0;
+    bool ok = fread(&n_part, sizeof(uint32_t), 1, f) == 1;
+    image->offsets.assign(1, 0);
+    for (uint32_t i = 0; ok && i < n_part; i++) {
+        uint32_t count;
+        ok = fread(&count, sizeof(uint32_t), 1, f) == 1 &&
+             (uint64_t)count * record_size <= file_size - buffer->size();
+        if (!ok)
+            break;
+        size_t at = buffer->size();
+        buffer->resize(at + (size_t)count * record_size);
+        ok = fread(buffer->data() + at, record_size, count, f) == count;
+        image->offsets.push_back(image->offsets.back() + count);
+    }
+    fclose(f);
+    if (!ok)
+        return truncated(filename);
+    image->records = buffer->data();
+    image->owner = buffer;
+    return true;
+}
+
+}  // namespace
+
+bool openDatFile(const std::string& filename, size_t record_size, DatImage* image) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Failed to open file for loading: " << filename << std::endl;
+        return false;
+    }
+    struct stat st;
+    uint32_t magic = 0;
+    bool ok = fstat(fd, &st) == 0 && pread(fd, &magic, sizeof(magic), 0) == sizeof(magic);
+    if (!ok) {
+        close(fd);
+        return truncated(filename);
+    }
+    if (magic == DAT_MAGIC && (size_t)st.st_size >= sizeof(DatHeader))
+        ok = openV2(filename, fd, st.st_size, record_size, image);
+    else
+        ok = openV1(filename, fd, st.st_size, record_size, image);
+    close(fd);
+    return ok;
+}
+
+bool writeDatFile(const std::string& filename, size_t record_size,
+                  const std::vector<const void*>& parts,
+                  const std::vector<uint64_t>& counts) {
+    FILE* f = fopen(filename.c_str(), "wb");
+    if (!f) {
+        std::cerr << "Failed to open file for saving: " << filename << std::endl;
+        return false;
+    }
+    DatHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = DAT_MAGIC;
+    h.version = DAT_VERSION;
+    h.record_size = record_size;
+    h.n_part = parts.size();
+    std::vector<uint64_t> offsets(1, 0);
+    for (uint64_t count : counts)
+        offsets.push_back(offsets.back() + count);
+    h.total = offsets.back();
+    uint64_t table_end = sizeof(h) + sizeof(uint64_t) * offsets.size();
+    h.data_offset = (table_end + DAT_ALIGN - 1) / DAT_ALIGN * DAT_ALIGN;
+
+    std::vector<char> padding(h.data_offset - table_end, 0);
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+              fwrite(offsets.data(), sizeof(uint64_t), offsets.size(), f) == offsets.size() &&
+              fwrite(padding.data(), 1, padding.size(), f) == padding.size();
+    for (size_t i = 0; ok && i < parts.size(); i++)
+        ok = fwrite(parts[i], record_size, counts[i], f) == counts[i];
+    ok = (fclose(f) == 0) && ok;
+    if (!ok)
+        std::cerr << "Failed to write file: " << filename << std::endl;
+    return ok;
+}
@@ -0,0 +1,126 @@
+#ifndef DAT_FILE_H
+#define DAT_FILE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+// .dat files of the sparse_suite generators (DRAF rows, sparse_row_format
+// blocks), one partition per DRAF_BG / BG tile
+//  v1: uint32_t n_part, then per partition uint32_t count + count records
+//  v2: DatHeader, uint64_t offset[n_part + 1] (first record of every
+//      partition, offset[n_part] = total), zero padding up to data_offset
+//      (DAT_ALIGN), then the records of all partitions back to back
+//  A v2 file is mmap-ed read-only and DatPartitions hands out spans into the
+//  mapping, the records are never copied. A v1 file is read with one read
+//  per partition into a single buffer. saveDatFile writes v2
+//
+//  build (tools): g++ -O3 -std=c++11 tool.cc dat_file.cc
+#define DAT_MAGIC 0x32544144u  // "DAT2"
+#define DAT_VERSION 2
+#define DAT_ALIGN 4096
+
+struct DatHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;  // sizeof the record type, checked on load
+    uint32_t n_part;
+    uint64_t total;        // records of all partitions
+    uint64_t data_offset;  // first record, DAT_ALIGN aligned
+};
+
+// Records of a .dat file as one block + the partition offsets
+struct DatImage {
+    std::shared_ptr<const void> owner;  // mapping (v2) or read buffer (v1)
+    const char* records;
+    std::vector<uint64_t> offsets;      // n_part + 1, in records
+};
+
+// false: unreadable, truncated or another record size (message on std::cerr)
+bool openDatFile(const std::string& filename, size_t record_size, DatImage* image);
+bool writeDatFile(const std::string& filename, size_t record_size,
+                  const std::vector<const void*>& parts,
+                  const std::vector<uint64_t>& counts);
+
+// Read-only view of count records
+template <typename T>
+class dat_span {
+ public:
+    dat_span() : data_(nullptr), size_(0) {}
+    dat_span(const T* data, size_t size) : data_(data), size_(size) {}
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    const T* data() const { return data_; }
+    const T* begin() const { return data_; }
+    const T* end() const { return data_ + size_; }
+    const T& operator[](size_t i) const { return data_[i]; }
+
+ private:
+    const T* data_;
+    size_t size_;
+};
+
+// Partitions of a .dat file (or of vectors) as spans, indexed like the
+// vector<vector<T>> the loaders return. Copies share the records
+template <typename T>
+class DatPartitions {
+ public:
+    DatPartitions() {}
+    // keeps rows alive, pass it with std::move to avoid the copy
+    DatPartitions(std::vector<std::vector<T>> rows) {
+        auto owned = std::make_shared<std::vector<std::vector<T>>>();
+        owned->swap(rows);
+        for (const std::vector<T>& part : *owned)
+            parts_.push_back(dat_span<T>(part.data(), part.size()));
+        owner_ = owned;
+    }
+    // empty on error
+    static DatPartitions Load(const std::string& filename) {
+        DatPartitions out;
+        DatImage image;
+        if (!openDatFile(filename, sizeof(T), &image))
+            return out;
+        const T* records = reinterpret_cast<const T*>(image.records);
+        for (size_t p = 0; p + 1 < image.offsets.size(); p++)
+            out.parts_.push_back(dat_span<T>(records + image.offsets[p],
+                                             image.offsets[p + 1] - image.offsets[p]));
+        out.owner_ = image.owner;
+        return out;
+    }
+    size_t size() const { return parts_.size(); }
+    bool empty() const { return parts_.empty(); }
+    const dat_span<T>& operator[](size_t p) const { return parts_[p]; }
+
+ private:
+    std::shared_ptr<const void> owner_;
+    std::vector<dat_span<T>> parts_;
+};
+
+// Owning copy, for callers that modify the rows (one memcpy per partition)
+template <typename T>
+std::vector<std::vector<T>> loadDatFile(const std::string& filename) {
+    std::vector<std::vector<T>> result;
+    DatImage image;
+    if (!openDatFile(filename, sizeof(T), &image))
+        return result;
+    const T* records = reinterpret_cast<const T*>(image.records);
+    result.resize(image.offsets.size() - 1);
+    for (size_t p = 0; p < result.size(); p++)
+        result[p].assign(records + image.offsets[p], records + image.offsets[p + 1]);
+    return result;
+}
+
+template <typename T>
+bool saveDatFile(const std::vector<std::vector<T>>& result, const std::string& filename) {
+    std::vector<const void*> parts;
+    std::vector<uint64_t> counts;
+    for (const std::vector<T>& part : result) {
+        parts.push_back(part.data());
+        counts.push_back(part.size());
+    }
+    return writeDatFile(filename, sizeof(T), parts, counts);
+}
+
+#endif
@@ -0,0 +1,57 @@
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include <string>
+#include "sw_full_stack.h"
+
+// draf_dat의 DRAF .dat를 읽어 tile마다 format(DRAF / sparse_row / dense)을
+// 고르고, mixed_dat 폴더에 tile directory와 함께 저장
+//  g++ -O2 generate_mixed_format.cc sw_full_stack.cc mtx_reader.cc dat_file.cc -pthread -o generate_mixed_format
+//  ./generate_mixed_format [auto|draf|dense|sparse_row] [banks_per_group]
+//  pimdramsim3main --mixed-file mixed_dat/tiled_mixed_<dataset>.dat
+int main(int argc, char** argv) {
+    const std::vector<std::string> dataset_names = {
+        "cora",
+        "citeseer",
+        "amazon-photo",
+        "amazon-com",
+        "Pubmed",
+        "corafull",
+        "coauthor-phy",
+        "coauthor-cs",
+        "cornell",
+        "chameleon",
+        "squirrel"
+    };
+
+    const int num_tiles = 64;
+    int format = -1;
+    if (argc > 1 && !parseTileFormat(argv[1], &format)) {
+        std::cerr << "Unknown tile format " << argv[1] << std::endl;
+        return 1;
+    }
+    tile_cost_model model = defaultTileCostModel();
+    if (argc > 2)
+        model.banks_per_group = std::stoul(argv[2]);
+
+    for (const auto& dataset : dataset_names) {
+        const std::string input_path = "draf_dat/tiled_draf_" + dataset + ".dat";
+        const std::string output_path = "mixed_dat/tiled_mixed_" + dataset + ".dat";
+
+        std::cout << "Processing dataset: " << dataset << std::endl;
+        auto draf = loadResultFromFile(input_path, num_tiles);
+        mixed_format_image image = selectTileFormats(draf, model, format);
+        printTileFormatSummary(image);
+        saveMixedToFile(image, output_path);
+
+        // 디버깅용: 저장한 image를 다시 읽어 directory 비교
+        mixed_format_image loaded = loadMixedFromFile(output_path);
+        if (loaded.directory.size() != image.directory.size()) {
+            std::cout << "The results are different!" << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << "All datasets processed successfully." << std::endl;
+    return 0;
+}
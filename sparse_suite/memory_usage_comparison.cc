@@ -9,6 +9,7 @@
 #include <algorithm>
 #include <tuple>
 #include "sw_full_stack.h"
+#include "mtx_reader.h"
 
 #define DEBUG 0
 #define STORE 0
@@ -35,42 +36,20 @@ uint16_t customRound(float value) {
 
 // Function to read Matrix Market (MTX) file
 COOMatrix readMTXFile(const std::string& file_path) {
+    MTXEntries entries = readMTXEntries(file_path); // mtx_reader.h
     COOMatrix matrix;
-    std::ifstream file(file_path);
-    if (!file.is_open()) {
-        throw std::runtime_error("Unable to open file: " + file_path);
-    }
-
-    std::string line;
-    bool is_comment = true;
-
-    // Read header and metadata
-    while (is_comment && std::getline(file, line)) {
-        if (line[0] != '%') {
-            is_comment = false;
-            std::istringstream iss(line);
-            iss >> matrix.n_rows >> matrix.n_cols >> matrix.nnz;
-        }
-    }
-
+    matrix.n_rows = entries.header.n_rows;
+    matrix.n_cols = entries.header.n_cols;
+    matrix.nnz = entries.rows.size();
     matrix.row_indices.reserve(matrix.nnz);
     matrix.col_indices.reserve(matrix.nnz);
     matrix.values.reserve(matrix.nnz);
-
-    // Read COO data
-    uint32_t row, col;
-    float value;
-    while (std::getline(file, line)) {
-        std::istringstream iss(line);
-        iss >> row >> col >> value;
-        matrix.row_indices.push_back(row - 1); // Convert to zero-based indexing
-        matrix.col_indices.push_back(col - 1); // Convert to zero-based indexing
-        //matrix.row_indices.push_back(row); // Convert to 1-based indexing
-        //matrix.col_indices.push_back(col); // Convert to 1-based indexing
-        matrix.values.push_back(customRound(value));
+    for (size_t i = 0; i < matrix.nnz; i++) {
+        matrix.row_indices.push_back(entries.rows[i] - 1); // Convert to zero-based indexing
+        matrix.col_indices.push_back(entries.cols[i] - 1); // Convert to zero-based indexing
+        matrix.values.push_back(customRound(entries.values[i]));
     }
 
-    file.close();
     if(DEBUG)
         std::cout << "Matrix loaded: " << matrix.n_rows << "x" << matrix.n_cols << " with " << matrix.nnz << " non-zero elements." << std::endl;
     return matrix;
@@ -81,24 +60,11 @@ COOMatrix readMTXFile(const std::string& file_path) {
 // COOMatrix 구조체의 .nnz, .n_rows, .n_cols에 정보를 저장
 // 이 정보만 빠르게 읽어와 사용이 가능해짐
 COOMatrixInfo readMTXFileInformation(const std::string& file_path) {
+    MTXHeader header = readMTXHeader(file_path); // mtx_reader.h
     COOMatrixInfo matrix;
-    std::ifstream file(file_path);
-    if (!file.is_open()) {
-        throw std::runtime_error("Unable to open file: " + file_path);
-    }
-
-    std::string line;
-    bool is_comment = true;
-
-    // Read header and metadata
-    while (is_comment && std::getline(file, line)) {
-        if (line[0] != '%') {
-            is_comment = false;
-            std::istringstream iss(line);
-            iss >> matrix.n_rows >> matrix.n_cols >> matrix.nnz;
-        }
-    }
-    file.close();
+    matrix.n_rows = header.n_rows;
+    matrix.n_cols = header.n_cols;
+    matrix.nnz = readMTXNnz(file_path); // symmetric: both triangles
     if(DEBUG)
         std::cout << "Matrix information loaded: " << matrix.n_rows << "x" << matrix.n_cols << " with " << matrix.nnz << " non-zero elements." << std::endl;
     return matrix;
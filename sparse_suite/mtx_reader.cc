@@ -0,0 +1,535 @@
+#include "mtx_reader.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+#define MTX_MIN_CHUNK (1 << 20)  // bytes a reader thread gets at least
+
+namespace {
+
+// Read-only mapping of a whole file
+class MappedFile {
+ public:
+    explicit MappedFile(const std::string& path) : data_(nullptr), size_(0) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("Unable to open file: " + path);
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            throw std::runtime_error("Unable to stat file: " + path);
+        }
+        size_ = st.st_size;
+        if (size_ > 0) {
+            void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                close(fd);
+                throw std::runtime_error("Unable to map file: " + path);
+            }
+            madvise(p, size_, MADV_SEQUENTIAL);
+            data_ = static_cast<const char*>(p);
+        }
+        close(fd);
+    }
+    ~MappedFile() {
+        if (data_)
+            munmap(const_cast<char*>(data_), size_);
+    }
+    const char* begin() const { return data_; }
+    const char* end() const { return data_ + size_; }
+
+ private:
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+    const char* data_;
+    size_t size_;
+};
+
+inline bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+inline const char* skipBlank(const char* p, const char* end) {
+    while (p < end && isBlank(*p))
+        p++;
+    return p;
+}
+
+// first byte of the line after the one p is in
+inline const char* nextLine(const char* p, const char* end) {
+    const char* nl = static_cast<const char*>(memchr(p, '\n', end - p));
+    return nl ? nl + 1 : end;
+}
+
+inline bool parseUint(const char*& p, const char* end, uint64_t* v) {
+    const char* start = p;
+    uint64_t x = 0;
+    while (p < end && (unsigned)(*p - '0') < 10) {
+        x = x * 10 + (*p - '0');
+        p++;
+    }
+    *v = x;
+    return p != start;
+}
+
+const double kPow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                         1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                         1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+float parseFloatSlow(const char* s, const char* e) {
+    std::string token(s, e);
+    return strtof(token.c_str(), nullptr);
+}
+
+// Token [s, e) rounded like strtof
+//  Fast path: <= 19 significant digits and |exp| <= 22, the double m x 10^e
+//  is correctly rounded. Its float is strtof's unless the double sits on a
+//  float midpoint (double rounding), that and everything else (inf, nan,
+//  hex, subnormals) goes to strtof
+float parseFloat(const char* s, const char* e) {
+    const char* p = s;
+    bool neg = false;
+    if (p < e && (*p == '-' || *p == '+')) {
+        neg = (*p == '-');
+        p++;
+    }
+    uint64_t m = 0;
+    int digits = 0, exp10 = 0;
+    bool any = false;
+    for (; p < e && (unsigned)(*p - '0') < 10; p++, any = true) {
+        if (digits == 19)
+            return parseFloatSlow(s, e);
+        m = m * 10 + (*p - '0');
+        digits += (m != 0);
+    }
+    if (p < e && *p == '.') {
+        for (p++; p < e && (unsigned)(*p - '0') < 10; p++, any = true) {
+            if (digits == 19)
+                return parseFloatSlow(s, e);
+            m = m * 10 + (*p - '0');
+            digits += (m != 0);
+            exp10--;
+        }
+    }
+    if (!any)
+        return parseFloatSlow(s, e);
+    if (p < e && (*p == 'e' || *p == 'E')) {
+        p++;
+        bool eneg = false;
+        if (p < e && (*p == '-' || *p == '+')) {
+            eneg = (*p == '-');
+            p++;
+        }
+        uint64_t ev;
+        if (!parseUint(p, e, &ev) || ev > 400)
+            return parseFloatSlow(s, e);
+        exp10 += eneg ? -(int)ev : (int)ev;
+    }
+    if (p != e)
+        return parseFloatSlow(s, e);
+    if (m == 0)
+        return neg ? -0.0f : 0.0f;
+    if (m > (1ULL << 53) || exp10 < -22 || exp10 > 22)
+        return parseFloatSlow(s, e);
+    double d = exp10 < 0 ? m / kPow10[-exp10] : m * kPow10[exp10];
+    if (neg)
+        d = -d;
+    float f = (float)d;
+    if (std::fabs(d) < FLT_MIN || std::fabs(d) > FLT_MAX)
+        return parseFloatSlow(s, e);
+    if ((double)f != d) {
+        float other = std::nextafter(f, d > f ? INFINITY : -INFINITY);
+        if (d - f == other - d)
+            return parseFloatSlow(s, e);
+    }
+    return f;
+}
+
+std::string lowerWord(const char*& p, const char* end) {
+    p = skipBlank(p, end);
+    std::string word;
+    while (p < end && !isBlank(*p) && *p != '\n')
+        word += (char)tolower(*p++);
+    return word;
+}
+
+MTXHeader parseHeader(const char* begin, const char* end,
+                      const std::string& path) {
+    MTXHeader h = {0, 0, 0, MTX_REAL, MTX_GENERAL, 0};
+    const char* p = begin;
+    if (end - p >= 14 && memcmp(p, "%%MatrixMarket", 14) == 0) {
+        p += 14;
+        std::string object = lowerWord(p, end);
+        std::string format = lowerWord(p, end);
+        std::string field = lowerWord(p, end);
+        std::string symmetry = lowerWord(p, end);
+        if (object != "matrix" || format != "coordinate")
+            throw std::runtime_error("Unsupported MatrixMarket " + object +
+                                     " " + format + ": " + path);
+        if (field == "real" || field == "double")
+            h.field = MTX_REAL;
+        else if (field == "integer")
+            h.field = MTX_INTEGER;
+        else if (field == "pattern")
+            h.field = MTX_PATTERN;
+        else if (field == "complex")
+            h.field = MTX_COMPLEX;
+        else
+            throw std::runtime_error("Unsupported MatrixMarket field " +
+                                     field + ": " + path);
+        if (symmetry == "general")
+            h.symmetry = MTX_GENERAL;
+        else if (symmetry == "symmetric")
+            h.symmetry = MTX_SYMMETRIC;
+        else if (symmetry == "skew-symmetric")
+            h.symmetry = MTX_SKEW_SYMMETRIC;
+        else if (symmetry == "hermitian")
+            h.symmetry = MTX_HERMITIAN;
+        else
+            throw std::runtime_error("Unsupported MatrixMarket symmetry " +
+                                     symmetry + ": " + path);
+        p = nextLine(p, end);
+    }
+    // comments and blank lines, then "rows cols entries"
+    while (p < end) {
+        p = skipBlank(p, end);
+        if (p < end && (*p == '%' || *p == '\n')) {
+            p = nextLine(p, end);
+            continue;
+        }
+        uint64_t rows, cols, entries;
+        if (!parseUint(p, end, &rows) ||
+            !parseUint(p = skipBlank(p, end), end, &cols) ||
+            !parseUint(p = skipBlank(p, end), end, &entries))
+            break;
+        h.n_rows = rows;
+        h.n_cols = cols;
+        h.entries = entries;
+        h.data_offset = nextLine(p, end) - begin;
+        return h;
+    }
+    throw std::runtime_error("Missing MatrixMarket size line: " + path);
+}
+
+struct Part {
+    std::vector<uint32_t> rows, cols;
+    std::vector<float> values;
+    const char* error;  // first malformed line, nullptr: none
+};
+
+// Entry lines of [p, end), p at a line start
+void parseChunk(const char* p, const char* end, const MTXHeader& h, Part* out) {
+    bool mirror = (h.symmetry != MTX_GENERAL);
+    float sign = (h.symmetry == MTX_SKEW_SYMMETRIC) ? -1.0f : 1.0f;
+    out->error = nullptr;
+    while (p < end) {
+        p = skipBlank(p, end);
+        if (p == end)
+            break;
+        if (*p == '\n' || *p == '%') {
+            p = nextLine(p, end);
+            continue;
+        }
+        const char* line = p;
+        uint64_t r, c;
+        if (!parseUint(p, end, &r) || !parseUint(p = skipBlank(p, end), end, &c) ||
+            r > UINT32_MAX || c > UINT32_MAX) {
+            out->error = line;
+            return;
+        }
+        float v = 1.0f;  // pattern
+        if (h.field != MTX_PATTERN) {
+            const char* t = p = skipBlank(p, end);
+            while (p < end && !isBlank(*p) && *p != '\n')
+                p++;
+            if (p != t)
+                v = parseFloat(t, p);
+        }
+        out->rows.push_back(r);
+        out->cols.push_back(c);
+        out->values.push_back(v);
+        if (mirror && r != c) {
+            out->rows.push_back(c);
+            out->cols.push_back(r);
+            out->values.push_back(sign * v);
+        }
+        p = nextLine(p, end);
+    }
+}
+
+bool cacheEnabled() {
+    const char* env = getenv("MTX_NO_CACHE");
+    return !(env && *env && strcmp(env, "0") != 0);
+}
+
+// size and mtime (ns) of the .mtx, false: no such file
+bool sourceStamp(const std::string& path, uint64_t* size, int64_t* mtime) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return false;
+    *size = st.st_size;
+    *mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    return true;
+}
+
+// magic, version, source stamp and the file size the arrays need
+bool cacheHeaderValid(const MTXCacheHeader& h, uint64_t file_size,
+                      const std::string& mtx_path) {
+    if (h.magic != MTX_CACHE_MAGIC || h.version != MTX_CACHE_VERSION)
+        return false;
+    if (h.nnz > (file_size - sizeof(MTXCacheHeader)) / 12 ||
+        file_size != sizeof(MTXCacheHeader) + 12 * h.nnz)
+        return false;
+    uint64_t size;
+    int64_t mtime;
+    if (!sourceStamp(mtx_path, &size, &mtime))
+        return false;
+    return h.source_size == size && h.source_mtime == mtime;
+}
+
+uint64_t cacheChecksum(const uint32_t* words, size_t n, uint64_t h) {
+    for (size_t i = 0; i < n; i++) {
+        h ^= words[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+uint64_t entriesChecksum(const uint32_t* rows, const uint32_t* cols,
+                         const float* values, size_t nnz) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    h = cacheChecksum(rows, nnz, h);
+    h = cacheChecksum(cols, nnz, h);
+    return cacheChecksum(reinterpret_cast<const uint32_t*>(values), nnz, h);
+}
+
+MTXHeader toMTXHeader(const MTXCacheHeader& c) {
+    MTXHeader h;
+    h.n_rows = c.n_rows;
+    h.n_cols = c.n_cols;
+    h.entries = c.entries;
+    h.field = static_cast<mtx_field>(c.field);
+    h.symmetry = static_cast<mtx_symmetry>(c.symmetry);
+    h.data_offset = 0;  // not a text file
+    return h;
+}
+
+// Cache header only (pread of 64B), false: no valid cache
+bool readCacheHeader(const std::string& mtx_path, MTXCacheHeader* h) {
+    int fd = open(mtxCachePath(mtx_path).c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0 && (uint64_t)st.st_size >= sizeof(*h) &&
+              pread(fd, h, sizeof(*h), 0) == (ssize_t)sizeof(*h);
+    close(fd);
+    return ok && cacheHeaderValid(*h, st.st_size, mtx_path);
+}
+
+// <file>.coo through a temporary file + rename, so a reader never maps a
+// half-written cache. A read-only suite directory only costs the warning
+void writeCache(const std::string& mtx_path, const MTXEntries& e,
+                uint64_t source_size, int64_t source_mtime) {
+    MTXCacheHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = MTX_CACHE_MAGIC;
+    h.version = MTX_CACHE_VERSION;
+    h.n_rows = e.header.n_rows;
+    h.n_cols = e.header.n_cols;
+    h.entries = e.header.entries;
+    h.nnz = e.rows.size();
+    h.source_size = source_size;
+    h.source_mtime = source_mtime;
+    h.checksum = entriesChecksum(e.rows.data(), e.cols.data(), e.values.data(), h.nnz);
+    h.field = e.header.field;
+    h.symmetry = e.header.symmetry;
+
+    std::string path = mtxCachePath(mtx_path);
+    std::string tmp = path + ".tmp" + std::to_string(getpid());
+    FILE* f = fopen(tmp.c_str(), "wb");
+    bool ok = f != nullptr;
+    if (ok) {
+        ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+             fwrite(e.rows.data(), 4, h.nnz, f) == h.nnz &&
+             fwrite(e.cols.data(), 4, h.nnz, f) == h.nnz &&
+             fwrite(e.values.data(), 4, h.nnz, f) == h.nnz;
+        ok = (fclose(f) == 0) && ok;
+    }
+    if (ok)
+        ok = rename(tmp.c_str(), path.c_str()) == 0;
+    if (!ok) {
+        remove(tmp.c_str());
+        std::cerr << "Unable to write MatrixMarket cache: " << path << std::endl;
+    }
+}
+
+}  // namespace
+
+std::string mtxCachePath(const std::string& file_path) {
+    return file_path + ".coo";
+}
+
+MappedMTX::~MappedMTX() {
+    if (data_)
+        munmap(const_cast<char*>(data_), size_);
+}
+
+bool MappedMTX::Open(const std::string& mtx_path, bool verify_checksum) {
+    if (data_) {
+        munmap(const_cast<char*>(data_), size_);
+        data_ = nullptr;
+    }
+    int fd = open(mtxCachePath(mtx_path).c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < sizeof(MTXCacheHeader)) {
+        close(fd);
+        return false;
+    }
+    void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return false;
+    data_ = static_cast<const char*>(p);
+    size_ = st.st_size;
+    hdr_ = reinterpret_cast<const MTXCacheHeader*>(data_);
+    bool ok = cacheHeaderValid(*hdr_, size_, mtx_path);
+    if (ok && verify_checksum) {
+        madvise(p, size_, MADV_SEQUENTIAL);
+        ok = entriesChecksum(rows(), cols(), values(), hdr_->nnz) == hdr_->checksum;
+    }
+    if (!ok) {
+        munmap(p, size_);
+        data_ = nullptr;
+    }
+    return ok;
+}
+
+MTXHeader MappedMTX::header() const { return toMTXHeader(*hdr_); }
+
+const uint32_t* MappedMTX::rows() const {
+    return reinterpret_cast<const uint32_t*>(data_ + sizeof(MTXCacheHeader));
+}
+
+const uint32_t* MappedMTX::cols() const { return rows() + hdr_->nnz; }
+
+const float* MappedMTX::values() const {
+    return reinterpret_cast<const float*>(cols() + hdr_->nnz);
+}
+
+MTXHeader readMTXHeader(const std::string& file_path) {
+    MTXCacheHeader cached;
+    if (cacheEnabled() && readCacheHeader(file_path, &cached))
+        return toMTXHeader(cached);
+    MappedFile file(file_path);
+    return parseHeader(file.begin(), file.end(), file_path);
+}
+
+uint64_t readMTXNnz(const std::string& file_path) {
+    MTXCacheHeader cached;
+    if (cacheEnabled() && readCacheHeader(file_path, &cached))
+        return cached.nnz;
+    MTXHeader header = readMTXHeader(file_path);
+    if (header.symmetry == MTX_GENERAL)
+        return header.entries;
+    return readMTXEntries(file_path).rows.size();
+}
+
+MTXEntries readMTXEntries(const std::string& file_path, int num_threads) {
+    bool cache = cacheEnabled();
+    if (cache) {
+        MappedMTX mapped;
+        if (mapped.Open(file_path)) {
+            MTXEntries out;
+            out.header = mapped.header();
+            out.rows.assign(mapped.rows(), mapped.rows() + mapped.nnz());
+            out.cols.assign(mapped.cols(), mapped.cols() + mapped.nnz());
+            out.values.assign(mapped.values(), mapped.values() + mapped.nnz());
+            return out;
+        }
+    }
+    // stamp before the parse: a .mtx written meanwhile leaves a stale cache
+    uint64_t source_size = 0;
+    int64_t source_mtime = 0;
+    cache = cache && sourceStamp(file_path, &source_size, &source_mtime);
+
+    MTXEntries out = parseMTXFile(file_path, num_threads);
+    if (cache)
+        writeCache(file_path, out, source_size, source_mtime);
+    return out;
+}
+
+MTXEntries parseMTXFile(const std::string& file_path, int num_threads) {
+    MappedFile file(file_path);
+    MTXEntries out;
+    out.header = parseHeader(file.begin(), file.end(), file_path);
+    const char* data = file.begin() + out.header.data_offset;
+    const char* end = file.end();
+    size_t len = end - data;
+
+    size_t threads = num_threads > 0 ? num_threads : std::thread::hardware_concurrency();
+    threads = std::max<size_t>(1, std::min<size_t>(threads, len / MTX_MIN_CHUNK));
+    // chunk k starts at the first line start at or after len * k / threads
+    std::vector<const char*> cut(threads + 1, end);
+    cut[0] = data;
+    for (size_t k = 1; k < threads; k++) {
+        const char* q = data + len * k / threads;
+        cut[k] = (q <= cut[k - 1]) ? cut[k - 1] : nextLine(q - 1, end);
+    }
+    std::vector<Part> parts(threads);
+    uint64_t expand = (out.header.symmetry != MTX_GENERAL) ? 2 : 1;
+    auto run = [&](size_t k) {
+        uint64_t estimate = len ? out.header.entries * (cut[k + 1] - cut[k]) / len + 16 : 0;
+        parts[k].rows.reserve(estimate * expand);
+        parts[k].cols.reserve(estimate * expand);
+        parts[k].values.reserve(estimate * expand);
+        parseChunk(cut[k], cut[k + 1], out.header, &parts[k]);
+    };
+    std::vector<std::thread> workers;
+    for (size_t k = 1; k < threads; k++)
+        workers.emplace_back(run, k);
+    run(0);
+    for (std::thread& t : workers)
+        t.join();
+
+    for (const Part& part : parts) {
+        if (part.error) {
+            throw std::runtime_error("Malformed MatrixMarket entry at byte " +
+                                     std::to_string(part.error - file.begin()) +
+                                     ": " + file_path);
+        }
+    }
+    if (threads == 1) {
+        out.rows.swap(parts[0].rows);
+        out.cols.swap(parts[0].cols);
+        out.values.swap(parts[0].values);
+        return out;
+    }
+    size_t total = 0;
+    for (const Part& part : parts)
+        total += part.rows.size();
+    out.rows.resize(total);
+    out.cols.resize(total);
+    out.values.resize(total);
+    size_t offset = 0;
+    for (Part& part : parts) {
+        std::copy(part.rows.begin(), part.rows.end(), out.rows.begin() + offset);
+        std::copy(part.cols.begin(), part.cols.end(), out.cols.begin() + offset);
+        std::copy(part.values.begin(), part.values.end(), out.values.begin() + offset);
+        offset += part.rows.size();
+        std::vector<uint32_t>().swap(part.rows);
+        std::vector<uint32_t>().swap(part.cols);
+        std::vector<float>().swap(part.values);
+    }
+    return out;
+}
@@ -0,0 +1,115 @@
+#ifndef MTX_READER_H
+#define MTX_READER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+// Shared MatrixMarket (coordinate) reader
+//  The file is mmap-ed and the entries are parsed by hand (no getline /
+//  istringstream), in parallel chunks split at newline boundaries. The
+//  chunks are concatenated in file order, so the result does not depend on
+//  the thread count. Values are the float `iss >> value` gives (strtof
+//  rounding). Supported: real / integer / pattern / complex (real part)
+//  fields, general / symmetric / skew-symmetric / hermitian. Symmetric
+//  files are expanded, the mirrored entry follows its source entry, and
+//  readMTXNnz counts both triangles. .dat images generated from symmetric
+//  matrices before the expansion hold one triangle and must be regenerated.
+//  Errors throw std::runtime_error like the per-tool readers did
+//
+//  Binary cache: readMTXEntries writes <file>.coo next to the .mtx after the
+//  first parse (see MTXCacheHeader) and later runs mmap it instead of parsing
+//  the text. readMTXHeader reads only the cache header. The cache records the
+//  size and mtime of its .mtx, a changed .mtx is parsed again and the cache
+//  rewritten. MTX_NO_CACHE=1 in the environment turns the cache off
+//
+//  build (tools): g++ -O3 -std=c++11 tool.cc mtx_reader.cc -pthread
+enum mtx_field : uint8_t {
+    MTX_REAL = 0,
+    MTX_INTEGER = 1,
+    MTX_PATTERN = 2,
+    MTX_COMPLEX = 3
+};
+
+enum mtx_symmetry : uint8_t {
+    MTX_GENERAL = 0,
+    MTX_SYMMETRIC = 1,
+    MTX_SKEW_SYMMETRIC = 2,
+    MTX_HERMITIAN = 3
+};
+
+struct MTXHeader {
+    uint32_t n_rows;
+    uint32_t n_cols;
+    uint64_t entries;     // entry lines of the file (symmetric: one triangle)
+    mtx_field field;      // no %%MatrixMarket banner: real
+    mtx_symmetry symmetry;
+    size_t data_offset;   // first byte after the size line
+};
+
+// Entries as in the file: 1-based indices, values as float
+struct MTXEntries {
+    MTXHeader header;
+    std::vector<uint32_t> rows;
+    std::vector<uint32_t> cols;
+    std::vector<float> values;  // pattern: 1
+};
+
+// <file>.coo layout (little endian)
+//  [0, 64)          MTXCacheHeader
+//  [64, ...)        uint32_t rows[nnz], uint32_t cols[nnz], float values[nnz]
+//  checksum is 64-bit FNV-1a over the three arrays, as 32-bit words
+#define MTX_CACHE_MAGIC 0x4f4f4358u  // "XCOO"
+#define MTX_CACHE_VERSION 1
+struct MTXCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t n_rows;
+    uint32_t n_cols;
+    uint64_t entries;       // MTXHeader::entries
+    uint64_t nnz;           // array length (symmetric: both triangles)
+    uint64_t source_size;   // .mtx the cache was built from
+    int64_t source_mtime;   // ns
+    uint64_t checksum;
+    uint8_t field;
+    uint8_t symmetry;
+    uint8_t empty[6];
+};
+
+// Read-only mapping of a valid <file>.coo, the arrays point into the mapping
+class MappedMTX {
+ public:
+    MappedMTX() : data_(nullptr), size_(0) {}
+    ~MappedMTX();
+    // false: no cache, stale or corrupt (verify_checksum) one
+    bool Open(const std::string& mtx_path, bool verify_checksum = true);
+    MTXHeader header() const;
+    uint64_t nnz() const { return hdr_->nnz; }
+    const uint32_t* rows() const;
+    const uint32_t* cols() const;
+    const float* values() const;
+
+ private:
+    MappedMTX(const MappedMTX&);
+    MappedMTX& operator=(const MappedMTX&);
+    const char* data_;
+    size_t size_;
+    const MTXCacheHeader* hdr_;
+};
+
+std::string mtxCachePath(const std::string& file_path);
+
+// Banner and size line only (cache header when there is a valid cache)
+MTXHeader readMTXHeader(const std::string& file_path);
+// Entries after symmetric expansion (= readMTXEntries(...).rows.size()).
+//  General files: the size line. Symmetric ones: the cache header, the file
+//  is parsed (and cached) once when there is no valid cache
+uint64_t readMTXNnz(const std::string& file_path);
+// num_threads 0: hardware concurrency (small files run on one thread)
+//  Served from the cache when it is valid, otherwise parsed and cached
+MTXEntries readMTXEntries(const std::string& file_path, int num_threads = 0);
+// The text parse alone (no cache read or write)
+MTXEntries parseMTXFile(const std::string& file_path, int num_threads = 0);
+
+#endif
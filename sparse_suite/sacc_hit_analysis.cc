@@ -0,0 +1,152 @@
+// SACC hit-rate what-if over the partitioned suite
+//  SACC merges the row indices of two columns (L/R bank) and accumulates
+//  the partial sums whose row index matches. This tool replays that matching
+//  for every tile with the same IntersectSorted kernel as SharedAccumulator
+//  and reports hits / nnz per tile for two column groupings:
+//    order  : columns paired in index order (c0,c1), (c2,c3), ... (current DRAF)
+//    greedy : each column paired with the unpaired column that shares the
+//             most row indices (searched within GREEDY_WINDOW candidates)
+//
+//  build : g++ -O3 -std=c++11 -I../src sacc_hit_analysis.cc sw_full_stack.cc mtx_reader.cc dat_file.cc -pthread -o sacc_hit_analysis
+//  run   : ./sacc_hit_analysis [dataset ...]   (default: generate_DRAF dataset list)
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include "sw_full_stack.h"
+#include "index_intersect.h"
+
+#define NUM_TILES 64
+#define GREEDY_WINDOW 256
+
+using dramsim3::IntersectSorted;
+
+struct TileHits {
+    uint64_t nnz = 0;
+    uint64_t cols = 0;
+    uint64_t order_hits = 0;
+    uint64_t greedy_hits = 0;
+};
+
+// col -> sorted row indices of the tile (empty columns dropped)
+static std::vector<std::vector<uint32_t>> BuildColumns(const COOMatrix& m) {
+    std::vector<std::vector<uint32_t>> cols(m.n_cols + 1);
+    for (size_t i = 0; i < m.row_indices.size(); i++) {
+        if (m.col_indices[i] < cols.size())
+            cols[m.col_indices[i]].push_back(m.row_indices[i]);
+    }
+    std::vector<std::vector<uint32_t>> result;
+    for (auto& c : cols) {
+        if (c.empty())
+            continue;
+        std::sort(c.begin(), c.end());
+        c.erase(std::unique(c.begin(), c.end()), c.end());
+        result.push_back(c);
+    }
+    return result;
+}
+
+static int Overlap(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b) {
+    return IntersectSorted(a.data(), a.size(), b.data(), b.size(), nullptr, nullptr);
+}
+
+static TileHits AnalyzeTile(const COOMatrix& m) {
+    TileHits t;
+    std::vector<std::vector<uint32_t>> cols = BuildColumns(m);
+    t.cols = cols.size();
+    for (auto& c : cols)
+        t.nnz += c.size();
+
+    for (size_t i = 0; i + 1 < cols.size(); i += 2)
+        t.order_hits += Overlap(cols[i], cols[i + 1]);
+
+    // Densest columns pick their partner first
+    std::vector<int> order(cols.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        return cols[a].size() > cols[b].size();
+    });
+    std::vector<bool> paired(cols.size(), false);
+    for (size_t i = 0; i < order.size(); i++) {
+        int c = order[i];
+        if (paired[c])
+            continue;
+        paired[c] = true;
+        int best = -1, best_hits = 0, searched = 0;
+        for (size_t j = i + 1; j < order.size() && searched < GREEDY_WINDOW; j++) {
+            int d = order[j];
+            if (paired[d])
+                continue;
+            searched++;
+            int hits = Overlap(cols[c], cols[d]);
+            if (best < 0 || hits > best_hits) {
+                best = d;
+                best_hits = hits;
+            }
+        }
+        if (best >= 0) {
+            paired[best] = true;
+            t.greedy_hits += best_hits;
+        }
+    }
+    return t;
+}
+
+static double Rate(uint64_t hits, uint64_t nnz) {
+    return nnz ? (double)hits / nnz : 0.0;
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> dataset_names = {
+        "cora",
+        "citeseer",
+        "amazon-photo",
+        "amazon-com",
+        "Pubmed",
+        "corafull",
+        "coauthor-phy",
+        "coauthor-cs",
+        "cornell",
+        "chameleon",
+        "squirrel"
+    };
+    if (argc > 1)
+        dataset_names.assign(argv + 1, argv + argc);
+
+    auto start = std::chrono::steady_clock::now();
+    TileHits suite;
+    std::cout << "dataset,tile,nnz,cols,order_hits,order_rate,greedy_hits,greedy_rate\n";
+    for (const auto& dataset : dataset_names) {
+        const std::string base_path = "./suite/partitioned_default/" + dataset + "/partition_";
+        TileHits total;
+        for (int tile = 0; tile < NUM_TILES; ++tile) {
+            COOMatrix tile_matrix;
+            try {
+                tile_matrix = readMTXFile(base_path + std::to_string(tile) + ".mtx");
+            } catch (const std::runtime_error& e) {
+                std::cerr << e.what() << std::endl;
+                continue;
+            }
+            TileHits t = AnalyzeTile(tile_matrix);
+            std::cout << dataset << "," << tile << "," << t.nnz << "," << t.cols << ","
+                      << t.order_hits << "," << Rate(t.order_hits, t.nnz) << ","
+                      << t.greedy_hits << "," << Rate(t.greedy_hits, t.nnz) << "\n";
+            total.nnz += t.nnz;
+            total.order_hits += t.order_hits;
+            total.greedy_hits += t.greedy_hits;
+        }
+        std::cout << "# " << dataset << " order: " << Rate(total.order_hits, total.nnz)
+                  << " greedy: " << Rate(total.greedy_hits, total.nnz) << std::endl;
+        suite.nnz += total.nnz;
+        suite.order_hits += total.order_hits;
+        suite.greedy_hits += total.greedy_hits;
+    }
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "# suite order: " << Rate(suite.order_hits, suite.nnz)
+              << " greedy: " << Rate(suite.greedy_hits, suite.nnz)
+              << " (" << sec << " s)" << std::endl;
+    return 0;
+}
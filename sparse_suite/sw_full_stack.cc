@@ -7,7 +7,9 @@
 #include <string>
 #include <cmath>
 #include <algorithm>
+#include <cstring>
 #include "sw_full_stack.h"
+#include "mtx_reader.h"
 
 #define DEBUG 0
 #define STORE 0
@@ -22,43 +24,18 @@ uint16_t customRound(float value) {
 }
 
 // Function to read Matrix Market (MTX) file
+//  mtx_reader.h: mmap + parallel parse, 1-based indices as in the file
 COOMatrix readMTXFile(const std::string& file_path) {
+    MTXEntries entries = readMTXEntries(file_path);
     COOMatrix matrix;
-    std::ifstream file(file_path);
-    if (!file.is_open()) {
-        throw std::runtime_error("Unable to open file: " + file_path);
-    }
-
-    std::string line;
-    bool is_comment = true;
-
-    // Read header and metadata
-    while (is_comment && std::getline(file, line)) {
-        if (line[0] != '%') {
-            is_comment = false;
-            std::istringstream iss(line);
-            iss >> matrix.n_rows >> matrix.n_cols >> matrix.nnz;
-        }
-    }
-
-    matrix.row_indices.reserve(matrix.nnz);
-    matrix.col_indices.reserve(matrix.nnz);
-    matrix.values.reserve(matrix.nnz);
-
-    // Read COO data
-    uint32_t row, col;
-    float value;
-    while (std::getline(file, line)) {
-        std::istringstream iss(line);
-        iss >> row >> col >> value;
-        //matrix.row_indices.push_back(row - 1); // Convert to zero-based indexing
-        //matrix.col_indices.push_back(col - 1); // Convert to zero-based indexing
-        matrix.row_indices.push_back(row); // Convert to 1-based indexing
-        matrix.col_indices.push_back(col); // Convert to 1-based indexing
-        matrix.values.push_back(customRound(value));
-    }
-
-    file.close();
+    matrix.n_rows = entries.header.n_rows;
+    matrix.n_cols = entries.header.n_cols;
+    matrix.row_indices.swap(entries.rows);
+    matrix.col_indices.swap(entries.cols);
+    matrix.values.resize(entries.values.size());
+    for (size_t i = 0; i < entries.values.size(); i++)
+        matrix.values[i] = customRound(entries.values[i]);
+    matrix.nnz = matrix.row_indices.size();  // symmetric: both triangles
     std::cout << "Matrix loaded: " << matrix.n_rows << "x" << matrix.n_cols << " with " << matrix.nnz << " non-zero elements." << std::endl;
     return matrix;
 }
@@ -66,26 +43,13 @@ COOMatrix readMTXFile(const std::string& file_path) {
 // Function to read Matrix Market (MTX) file
 // 정보만 반환하기 위해 구성
 // COOMatrix 구조체의 .nnz, .n_rows, .n_cols에 정보를 저장
-// 이 정보만 빠르게 읽어와 사용이 가능해짐
+// 이 정보만 빠르게 읽어와 사용이 가능해짐 (nnz: file의 entry 수)
 COOMatrixInfo readMTXFileInformation(const std::string& file_path) {
+    MTXHeader header = readMTXHeader(file_path);
     COOMatrixInfo matrix;
-    std::ifstream file(file_path);
-    if (!file.is_open()) {
-        throw std::runtime_error("Unable to open file: " + file_path);
-    }
-
-    std::string line;
-    bool is_comment = true;
-
-    // Read header and metadata
-    while (is_comment && std::getline(file, line)) {
-        if (line[0] != '%') {
-            is_comment = false;
-            std::istringstream iss(line);
-            iss >> matrix.n_rows >> matrix.n_cols >> matrix.nnz;
-        }
-    }
-    file.close();
+    matrix.n_rows = header.n_rows;
+    matrix.n_cols = header.n_cols;
+    matrix.nnz = readMTXNnz(file_path); // symmetric: both triangles
     std::cout << "Matrix information loaded: " << matrix.n_rows << "x" << matrix.n_cols << " with " << matrix.nnz << " non-zero elements." << std::endl;
     return matrix;
 }
@@ -93,71 +57,384 @@ COOMatrixInfo readMTXFileInformation(const std::string& file_path) {
 
 //저장 된 sw optimization 결과를 불러오기 위한 코드(여기가 아닌 다른 곳에서 사용)
 //dat 확장자로 구성 된 파일을 불러올 때 사용
+//  v1 / v2 .dat (dat_file.h), v2 is mmap-ed and copied once per partition
 std::vector<std::vector<re_aligned_dram_format>> loadResultFromFile(const std::string& filename, int num_BG) {
-    std::ifstream inFile(filename, std::ios::binary);
+    std::vector<std::vector<re_aligned_dram_format>> result =
+        loadDatFile<re_aligned_dram_format>(filename);
+    if (!result.empty() && num_BG > 0 && result.size() != (size_t)num_BG) {
+        std::cerr << filename << ": " << result.size() << " partitions, expected "
+                  << num_BG << " (one per bankgroup)" << std::endl;
+        return {};
+    }
+    if (!result.empty())
+        std::cout << "Data successfully loaded from " << filename << std::endl;
+    return result;
+}
+
+std::vector<std::vector<sparse_row_format>> loadSparseFromFile(const std::string& filename, int num_BG) {
+    std::vector<std::vector<sparse_row_format>> result =
+        loadDatFile<sparse_row_format>(filename);
+    if (!result.empty() && num_BG > 0 && result.size() != (size_t)num_BG) {
+        std::cerr << filename << ": " << result.size() << " partitions, expected "
+                  << num_BG << " (one per bankgroup)" << std::endl;
+        return {};
+    }
+    if (!result.empty())
+        std::cout << "Data successfully loaded from " << filename << std::endl;
+    return result;
+}
+
+sparse_row_partitions mapSparseFromFile(const std::string& filename) {
+    sparse_row_partitions result = sparse_row_partitions::Load(filename);
+    if (!result.empty())
+        std::cout << "Data successfully mapped from " << filename << std::endl;
+    return result;
+}
+
+std::vector<uint16_t> loadDenseFromFile(const std::string& filename, uint32_t n_cols) {
+    std::ifstream inFile(filename, std::ios::binary | std::ios::ate);
 
     if (!inFile.is_open()) {
         std::cerr << "Failed to open file for loading: " << filename << std::endl;
         return {};
     }
 
-    std::vector<std::vector<re_aligned_dram_format>> result;
+    std::streamsize bytes = inFile.tellg();
+    size_t row_bytes = sizeof(uint16_t) * n_cols;
+    if (n_cols == 0 || bytes <= 0 || bytes % row_bytes != 0) {
+        std::cerr << filename << ": size " << bytes
+                  << "B is not a multiple of " << n_cols << " FP16 columns" << std::endl;
+        return {};
+    }
 
-    // Load the number of outer vectors
-    uint32_t outerSize;
-    inFile.read(reinterpret_cast<char*>(&outerSize), sizeof(uint32_t));
+    std::vector<uint16_t> result(bytes / sizeof(uint16_t));
+    inFile.seekg(0);
+    inFile.read(reinterpret_cast<char*>(result.data()), bytes);
+    inFile.close();
+    std::cout << "Dense matrix (" << result.size() / n_cols << " x " << n_cols
+              << ") loaded from " << filename << std::endl;
 
-    result.resize(outerSize);
+    return result;
+}
 
-    for (uint32_t i = 0; i < outerSize; ++i) {
-        // Load the size of each inner vector
-        uint32_t innerSize;
-        inFile.read(reinterpret_cast<char*>(&innerSize), sizeof(uint32_t));
+////////////////////////PER-TILE FORMAT SELECTION//////////////
+// Host replay of one pass per format (SpmvTransactionGenerator), in triggers
+//  DRAF      : PIM_OP_MODE + 2 banks x (MOV + 16 x (MUL, SACC, SACC) + 16 MOV)
+//  dense     : PIM_OP_MODE + 2 banks x (MOV + 3 blocks x (MUL + 6 MAC + MOV))
+//  sparse_row: DRF load + per row descriptor PIM_OP_MODE +
+//              MOV + trips x (MOV, MUL_DRF, ADD) + MOV
+#define DRAF_PASS_TRIGGERS   (1 + 2 * (1 + PARTITION_SIZE * 3 + PARTITION_SIZE))
+#define DENSE_PASS_TRIGGERS  (1 + 2 * (1 + DENSE_BLOCKS * (1 + (GROUP_SIZE - 1) + 1)))
+
+namespace {
+
+struct tile_nze {
+    uint32_t row; // 1-based
+    uint32_t k;   // column group
+    uint16_t val;
+};
+
+std::vector<tile_nze> tileNonzeros(const re_aligned_dram_format& tile) {
+    std::vector<tile_nze> nze;
+    for (uint32_t k = 0; k < GROUP_SIZE; k++) {
+        if (tile.col_group[k] == 0)
+            continue;
+        for (uint32_t i = 0; i < PARTITION_SIZE; i++) {
+            uint32_t row = tile.row[k * PARTITION_SIZE + i];
+            if (row != 0)
+                nze.push_back({row, k, tile.val[k * PARTITION_SIZE + i]});
+        }
+    }
+    return nze;
+}
 
-        result[i].resize(innerSize);
+// 16-row blocks (0-based) holding a nonzero, ascending
+std::vector<uint32_t> rowBlocks(const std::vector<tile_nze>& nze) {
+    std::vector<uint32_t> blocks;
+    for (const tile_nze& e : nze)
+        blocks.push_back((e.row - 1) / PARTITION_SIZE);
+    std::sort(blocks.begin(), blocks.end());
+    blocks.erase(std::unique(blocks.begin(), blocks.end()), blocks.end());
+    return blocks;
+}
 
-        // Load each re_aligned_dram_format
-        for (uint32_t j = 0; j < innerSize; ++j) {
-            inFile.read(reinterpret_cast<char*>(&result[i][j]), sizeof(re_aligned_dram_format));
+std::vector<dense_tile_format> toDense(const re_aligned_dram_format& tile) {
+    std::vector<tile_nze> nze = tileNonzeros(tile);
+    std::vector<uint32_t> blocks = rowBlocks(nze);
+    std::vector<dense_tile_format> out((blocks.size() + DENSE_BLOCKS - 1) / DENSE_BLOCKS);
+    for (size_t t = 0; t < out.size(); t++) {
+        dense_tile_format& d = out[t];
+        memset(&d, 0, sizeof(d));
+        for (uint32_t k = 0; k < GROUP_SIZE; k++) {
+            d.col_group[k] = tile.col_group[k];
+            d.vec[k] = tile.vec[k];
         }
+        for (uint32_t b = 0; b < DENSE_BLOCKS && t * DENSE_BLOCKS + b < blocks.size(); b++) {
+            d.row_base[b] = blocks[t * DENSE_BLOCKS + b] * PARTITION_SIZE + 1;
+            d.n_block++;
+        }
+    }
+    for (const tile_nze& e : nze) {
+        uint32_t i = std::lower_bound(blocks.begin(), blocks.end(),
+                                      (e.row - 1) / PARTITION_SIZE) - blocks.begin();
+        out[i / DENSE_BLOCKS].val[i % DENSE_BLOCKS][e.k][(e.row - 1) % PARTITION_SIZE] = e.val;
     }
+    return out;
+}
 
-    inFile.close();
-    std::cout << "Data successfully loaded from " << filename << std::endl;
+// One row descriptor per matrix row, at most 7 nonzeros (one per column
+// group), so no column chunks
+std::vector<sparse_row_format> toSparseRow(const re_aligned_dram_format& tile) {
+    std::vector<tile_nze> nze = tileNonzeros(tile);
+    std::stable_sort(nze.begin(), nze.end(),
+                     [](const tile_nze& a, const tile_nze& b) { return a.row < b.row; });
+    std::vector<sparse_row_format> out;
+    for (size_t i = 0; i < nze.size();) {
+        if (out.empty() || out.back().n_rd == MAX_BLOCK_PER_ROW) {
+            out.push_back(sparse_row_format());
+            memset(&out.back(), 0, sizeof(sparse_row_format));
+        }
+        sparse_row_format& block = out.back();
+        row_descriptor& rd = block.row_desc[block.n_rd];
+        rd.row_idx = nze[i].row;
+        for (; i < nze.size() && nze[i].row == rd.row_idx && rd.NZE_count < CHUNK_SIZE; i++) {
+            rd.NZE_val[rd.NZE_count] = nze[i].val;
+            rd.NZE_col_idx[rd.NZE_count] = (uint8_t)nze[i].k;
+            rd.NZE_count++;
+        }
+        block.row_count[block.n_rd] = rd.NZE_count;
+        block.n_rd++;
+    }
+    return out;
+}
 
-    return result;
+// trips: LOOP trips of all n_rd descriptors (sparse_row)
+double passCycles(int format, uint32_t trips, uint32_t n_rd,
+                  const tile_cost_model& model) {
+    double triggers;
+    if (format == TILE_DRAF) {
+        triggers = DRAF_PASS_TRIGGERS;
+    } else if (format == TILE_DENSE) {
+        triggers = DENSE_PASS_TRIGGERS;
+    } else {
+        triggers = PARTITION_SIZE + n_rd * 3 + trips * 3;
+    }
+    return triggers * model.cycles_per_trigger;
 }
-std::vector<std::vector<sparse_row_format>> loadSparseFromFile(const std::string& filename, int num_BG) {
-    std::ifstream inFile(filename, std::ios::binary);
 
-    if (!inFile.is_open()) {
-        std::cerr << "Failed to open file for loading: " << filename << std::endl;
-        return {};
+const char* kTileFormatName[NUM_TILE_FORMATS] = {"draf", "sparse_row", "dense"};
+
+template <typename T>
+void saveNested(std::ofstream& out, const std::vector<std::vector<T>>& v) {
+    uint32_t outerSize = v.size();
+    out.write(reinterpret_cast<const char*>(&outerSize), sizeof(uint32_t));
+    for (const auto& group : v) {
+        uint32_t innerSize = group.size();
+        out.write(reinterpret_cast<const char*>(&innerSize), sizeof(uint32_t));
+        out.write(reinterpret_cast<const char*>(group.data()), sizeof(T) * innerSize);
     }
+}
+
+template <typename T>
+bool loadNested(std::ifstream& in, std::vector<std::vector<T>>* v) {
+    uint32_t outerSize = 0;
+    if (!in.read(reinterpret_cast<char*>(&outerSize), sizeof(uint32_t)))
+        return false;
+    v->resize(outerSize);
+    for (auto& group : *v) {
+        uint32_t innerSize = 0;
+        if (!in.read(reinterpret_cast<char*>(&innerSize), sizeof(uint32_t)))
+            return false;
+        group.resize(innerSize);
+        if (!in.read(reinterpret_cast<char*>(group.data()), sizeof(T) * innerSize))
+            return false;
+    }
+    return true;
+}
 
-    std::vector<std::vector<sparse_row_format>> result;
+}  // namespace
 
-    // Load the number of outer vectors
-    uint32_t outerSize;
-    inFile.read(reinterpret_cast<char*>(&outerSize), sizeof(uint32_t));
+tile_cost_model defaultTileCostModel() {
+    tile_cost_model model;
+    model.banks_per_group = 4;     // HBM2_4Gb_test.ini
+    model.cycles_per_trigger = 2;  // tCCD_L
+    model.footprint_weight = 0;
+    return model;
+}
 
-    result.resize(outerSize);
+// Cycles of the tile in `format`: passes x pass cycles / slots per pass
+//  bytes: DRAM footprint (sparse_row also holds the odd-bank result row)
+double tileFormatCycles(const re_aligned_dram_format& tile, int format,
+                        const tile_cost_model& model, uint32_t* bytes) {
+    double slots = model.banks_per_group;
+    if (format == TILE_DRAF) {
+        *bytes = sizeof(re_aligned_dram_format);
+        return passCycles(format, 0, 0, model) / slots;
+    }
+    if (format == TILE_DENSE) {
+        size_t n = (rowBlocks(tileNonzeros(tile)).size() + DENSE_BLOCKS - 1) / DENSE_BLOCKS;
+        *bytes = n * sizeof(dense_tile_format);
+        return n * passCycles(format, 0, 0, model) / slots;
+    }
+    std::vector<sparse_row_format> blocks = toSparseRow(tile);
+    double cycles = 0;
+    for (const sparse_row_format& block : blocks) {
+        uint32_t trips = 0;
+        for (uint32_t d = 0; d < block.n_rd; d++)
+            trips += std::max(1u, (uint32_t)block.row_desc[d].NZE_count);
+        cycles += passCycles(format, trips, block.n_rd, model) / std::max(1.0, slots / 2);
+    }
+    *bytes = blocks.size() * 2 * 1024;
+    return cycles;
+}
 
-    for (uint32_t i = 0; i < outerSize; ++i) {
-        // Load the size of each inner vector
-        uint32_t innerSize;
-        inFile.read(reinterpret_cast<char*>(&innerSize), sizeof(uint32_t));
+mixed_format_image selectTileFormats(
+    const std::vector<std::vector<re_aligned_dram_format>>& DRAF_BG,
+    const tile_cost_model& model, int format) {
+    mixed_format_image image;
+    image.draf.resize(DRAF_BG.size());
+    image.sparse_row.resize(DRAF_BG.size());
+    image.dense.resize(DRAF_BG.size());
+    for (uint32_t p = 0; p < DRAF_BG.size(); p++) {
+        for (uint32_t j = 0; j < DRAF_BG[p].size(); j++) {
+            const re_aligned_dram_format& tile = DRAF_BG[p][j];
+            tile_entry e;
+            memset(&e, 0, sizeof(e));
+            e.partition = p;
+            e.draf_row = j;
+            e.nnz = tileNonzeros(tile).size();
+            for (uint32_t k = 0; k < GROUP_SIZE; k++)
+                e.col_group[k] = tile.col_group[k];
+            for (int f = 0; f < NUM_TILE_FORMATS; f++)
+                e.cycles[f] = tileFormatCycles(tile, f, model, &e.bytes[f]);
+
+            // empty rows (padding) stay DRAF rows
+            int best = TILE_DRAF;
+            if (e.nnz > 0 && format >= 0) {
+                best = format;
+            } else if (e.nnz > 0) {
+                double best_score = 0;
+                for (int f = 0; f < NUM_TILE_FORMATS; f++) {
+                    double score = e.cycles[f] + model.footprint_weight * e.bytes[f] / 1024.0;
+                    if (f == 0 || score < best_score) {
+                        best = f;
+                        best_score = score;
+                    }
+                }
+            }
+            e.format = best;
+            if (best == TILE_DRAF) {
+                e.first = image.draf[p].size();
+                image.draf[p].push_back(tile);
+            } else if (best == TILE_DENSE) {
+                std::vector<dense_tile_format> rows = toDense(tile);
+                e.first = image.dense[p].size();
+                image.dense[p].insert(image.dense[p].end(), rows.begin(), rows.end());
+            } else {
+                std::vector<sparse_row_format> rows = toSparseRow(tile);
+                e.first = image.sparse_row[p].size();
+                image.sparse_row[p].insert(image.sparse_row[p].end(), rows.begin(), rows.end());
+            }
+            uint32_t size = (best == TILE_DRAF) ? image.draf[p].size()
+                          : (best == TILE_DENSE) ? image.dense[p].size()
+                          : image.sparse_row[p].size();
+            e.count = size - e.first;
+            image.directory.push_back(e);
+        }
+    }
+    return image;
+}
 
-        result[i].resize(innerSize);
+void printTileFormatSummary(const mixed_format_image& image) {
+    uint64_t tiles[NUM_TILE_FORMATS] = {0, 0, 0};
+    uint64_t nnz[NUM_TILE_FORMATS] = {0, 0, 0};
+    uint64_t rows[NUM_TILE_FORMATS] = {0, 0, 0};
+    double cycles = 0, draf_cycles = 0;
+    uint64_t bytes = 0, draf_bytes = 0;
+    for (const tile_entry& e : image.directory) {
+        tiles[e.format]++;
+        nnz[e.format] += e.nnz;
+        rows[e.format] += e.count;
+        cycles += e.cycles[e.format];
+        bytes += e.bytes[e.format];
+        draf_cycles += e.cycles[TILE_DRAF];
+        draf_bytes += e.bytes[TILE_DRAF];
+    }
+    std::cout << "Tile formats (" << image.directory.size() << " tiles):" << std::endl;
+    for (int f = 0; f < NUM_TILE_FORMATS; f++) {
+        std::cout << "  " << kTileFormatName[f] << ": " << tiles[f] << " tiles, "
+                  << nnz[f] << " nnz, " << rows[f] << " rows" << std::endl;
+    }
+    std::cout << "  estimate: " << (uint64_t)cycles << " cycles, " << bytes / 1024
+              << " KB (all DRAF: " << (uint64_t)draf_cycles << " cycles, "
+              << draf_bytes / 1024 << " KB)" << std::endl;
+}
 
-        // Load each sparse_row_format
-        for (uint32_t j = 0; j < innerSize; ++j) {
-            inFile.read(reinterpret_cast<char*>(&result[i][j]), sizeof(sparse_row_format));
+bool parseTileFormat(const std::string& name, int* format) {
+    if (name == "auto") {
+        *format = -1;
+        return true;
+    }
+    for (int f = 0; f < NUM_TILE_FORMATS; f++) {
+        if (name == kTileFormatName[f]) {
+            *format = f;
+            return true;
         }
     }
+    return false;
+}
 
-    inFile.close();
-    std::cout << "Data successfully loaded from " << filename << std::endl;
+void packSparseRow(const sparse_row_format& block, uint8_t* row) {
+    memset(row, 0, 32 * 32);
+    for (uint32_t d = 0; d < block.n_rd && d < 32; d++) {
+        const row_descriptor& rd = block.row_desc[d];
+        uint8_t* word = row + d * 32;
+        memcpy(word, &rd.row_idx, 4);
+        word[4] = rd.NZE_col_idx[0];
+        word[5] = std::max(1, (int)rd.NZE_count) - 1;  // LOOP GRF_A[2] >> 8
+        memcpy(word + 6, rd.NZE_col_idx + 1, CHUNK_SIZE - 1);
+        memcpy(word + 14, rd.NZE_val, sizeof(rd.NZE_val));
+    }
+    for (uint32_t c = 0; c < block.n_chunk && block.n_rd + c < 32; c++)
+        memcpy(row + (block.n_rd + c) * 32, &block.col_chunk[c], sizeof(column_chunk));
+}
 
-    return result;
+// directory, then the DRAF / sparse_row / dense rows like saveResultToFile
+void saveMixedToFile(const mixed_format_image& image, const std::string& filename) {
+    std::ofstream outFile(filename, std::ios::binary);
+    if (!outFile.is_open()) {
+        std::cerr << "Failed to open file for saving: " << filename << std::endl;
+        return;
+    }
+    uint32_t entries = image.directory.size();
+    outFile.write(reinterpret_cast<const char*>(&entries), sizeof(uint32_t));
+    outFile.write(reinterpret_cast<const char*>(image.directory.data()), sizeof(tile_entry) * entries);
+    saveNested(outFile, image.draf);
+    saveNested(outFile, image.sparse_row);
+    saveNested(outFile, image.dense);
+    outFile.close();
+    std::cout << "Mixed-format image saved to " << filename << std::endl;
+}
+
+mixed_format_image loadMixedFromFile(const std::string& filename) {
+    mixed_format_image image;
+    std::ifstream inFile(filename, std::ios::binary);
+    if (!inFile.is_open()) {
+        std::cerr << "Failed to open file for loading: " << filename << std::endl;
+        return image;
+    }
+    uint32_t entries = 0;
+    bool ok = (bool)inFile.read(reinterpret_cast<char*>(&entries), sizeof(uint32_t));
+    if (ok) {
+        image.directory.resize(entries);
+        ok = (bool)inFile.read(reinterpret_cast<char*>(image.directory.data()), sizeof(tile_entry) * entries);
+    }
+    ok = ok && loadNested(inFile, &image.draf) && loadNested(inFile, &image.sparse_row) &&
+         loadNested(inFile, &image.dense);
+    if (!ok) {
+        std::cerr << filename << ": truncated mixed-format image" << std::endl;
+        return mixed_format_image();
+    }
+    std::cout << "Mixed-format image (" << entries << " tiles) loaded from " << filename << std::endl;
+    return image;
 }
@@ -7,6 +7,7 @@
 #include <iostream>
 #include <string>
 #include <algorithm>
+#include "dat_file.h"
 
 
 #define PARTITION_SIZE 16 // col당 NZE 개수
@@ -52,6 +53,63 @@ typedef struct exact_row_size{
     std::vector<column_chunk> col_chunk;
 }exact_row_size;
 
+// Per-tile format selection (selectTileFormats)
+//  A tile is the nonzeros of one DRAF row (7 column groups). Besides the
+//  DRAF row itself they can be stored as
+//   TILE_SPARSE_ROW: sparse_row_format blocks, one row descriptor per matrix
+//                    row, NZE_col_idx = column group k (x from the DRF)
+//   TILE_DENSE     : dense_tile_format, blocks of 16 matrix rows x the 7
+//                    columns, MAC with the x word of the tile
+enum tile_format : uint8_t {
+    TILE_DRAF = 0,
+    TILE_SPARSE_ROW = 1,
+    TILE_DENSE = 2
+};
+#define NUM_TILE_FORMATS 3
+#define DENSE_BLOCKS 3 // 16-row blocks per dense tile
+
+typedef struct dense_tile_format{
+    uint32_t col_group[GROUP_SIZE]; //28B, 1-based, 0: empty
+    uint32_t n_block; //4B
+    uint32_t row_base[DENSE_BLOCKS]; //12B, first matrix row of a block (1-based)
+    uint32_t header_empty[5]; //20B
+    uint16_t result[DENSE_BLOCKS * PARTITION_SIZE]; //32B x 3 = 96B (column 2~4)
+    uint16_t empty[2 * PARTITION_SIZE]; //32B x 2 = 64B
+    uint16_t vec[PARTITION_SIZE]; //32B (column 7), vec[k]: x of col_group[k]
+    uint16_t val[DENSE_BLOCKS][8][PARTITION_SIZE]; //32B x 24 = 768B (column 8~31)
+}dense_tile_format;
+
+// Cost of one tile in every format, in PIM cycles of its channel
+//  A pass is one DRAM row of the channel (all BGs in lockstep) and covers
+//  banks_per_group slots of a BG (sparse_row: the even banks only, the odd
+//  bank takes the result). Trigger counts per pass follow the host replay of
+//  the μkernels in SpmvTransactionGenerator, one trigger per tCCD_L
+typedef struct tile_cost_model{
+    uint32_t banks_per_group;
+    double cycles_per_trigger;
+    double footprint_weight; // cycles charged per KB of footprint
+}tile_cost_model;
+
+typedef struct tile_entry{
+    uint32_t partition; // DRAF_BG index (ch * bankgroups + bg)
+    uint32_t draf_row;  // DRAF row of the partition the tile came from
+    uint32_t format;    // tile_format
+    uint32_t first;     // first row of the format's rows of the partition
+    uint32_t count;     // rows it takes there (DRAF 1)
+    uint32_t nnz;
+    uint32_t col_group[GROUP_SIZE];   // x of the tile (sparse_row DRF image)
+    double cycles[NUM_TILE_FORMATS];  // estimate per format
+    uint32_t bytes[NUM_TILE_FORMATS]; // footprint per format
+}tile_entry;
+
+// Mixed-format image: rows of every format per partition + tile directory
+struct mixed_format_image {
+    std::vector<tile_entry> directory;
+    std::vector<std::vector<re_aligned_dram_format>> draf;
+    std::vector<std::vector<sparse_row_format>> sparse_row;
+    std::vector<std::vector<dense_tile_format>> dense;
+};
+
 // Structure to hold the COO matrix data
 struct COOMatrix {
     std::vector<uint32_t> row_indices;
@@ -74,10 +132,37 @@ struct COOMatrixInfo {
 // 에러가 나서 여기서는 함수 원형만 선언해주고
 // 실제 함수 구현은 tilting_sparse_suite.cc에서 구현
 // 아래 주석의 코드가 실제 함수 구현 코드
+//  num_BG: partitions the file must hold (PIM channels x bankgroups),
+//  a file with another count is refused (empty result), 0 takes any count
 std::vector<std::vector<re_aligned_dram_format>>loadResultFromFile(const std::string& filename, int num_BG);
 uint16_t customRound(float value);
 COOMatrix readMTXFile(const std::string& file_path);
 COOMatrixInfo readMTXFileInformation(const std::string& file_path);
 std::vector<std::vector<sparse_row_format>> loadSparseFromFile(const std::string& filename, int num_BG);
+// .dat as spans into the mmap-ed file (v2, dat_file.h), no copy of the rows
+typedef DatPartitions<re_aligned_dram_format> draf_partitions;
+typedef DatPartitions<sparse_row_format> sparse_row_partitions;
+sparse_row_partitions mapSparseFromFile(const std::string& filename);
+// SpMM dense operand: raw FP16 (uint16_t bits), row-major, n_cols columns
+std::vector<uint16_t> loadDenseFromFile(const std::string& filename, uint32_t n_cols);
+
+// Per-tile format selection
+//  format < 0 picks the cheapest format of every tile (cycles +
+//  footprint_weight x KB), otherwise every non-empty tile gets `format`
+tile_cost_model defaultTileCostModel();
+double tileFormatCycles(const re_aligned_dram_format& tile, int format,
+                        const tile_cost_model& model, uint32_t* bytes);
+mixed_format_image selectTileFormats(
+    const std::vector<std::vector<re_aligned_dram_format>>& DRAF_BG,
+    const tile_cost_model& model, int format = -1);
+void printTileFormatSummary(const mixed_format_image& image);
+bool parseTileFormat(const std::string& name, int* format);
+// 32 words of a sparse_row_format block as it sits in the DRAM row:
+//  row descriptor d at column d (row_idx, NZE_col_idx[0], NZE_count - 1,
+//  NZE_col_idx[1~8], NZE_val[9] = 32B), then the column chunks. Byte 5 is
+//  the LOOP trip byte (GRF_A[2] >> 8) of the sparse_row μkernel
+void packSparseRow(const sparse_row_format& block, uint8_t* row);
+void saveMixedToFile(const mixed_format_image& image, const std::string& filename);
+mixed_format_image loadMixedFromFile(const std::string& filename);
 
 #endif
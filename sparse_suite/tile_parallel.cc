@@ -0,0 +1,90 @@
+#include "tile_parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+
+void runTilesParallel(int num_tiles, int num_threads,
+                      const std::function<void(int)>& build_tile) {
+    int threads = num_threads > 0 ? num_threads : (int)std::thread::hardware_concurrency();
+    threads = std::max(1, std::min(threads, num_tiles));
+    if (threads == 1) {
+        for (int tile = 0; tile < num_tiles; ++tile)
+            build_tile(tile);
+        return;
+    }
+
+    std::atomic<int> next(0);
+    std::atomic<bool> failed(false);
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto worker = [&]() {
+        for (int tile = next++; tile < num_tiles && !failed; tile = next++) {
+            try {
+                build_tile(tile);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error)
+                    error = std::current_exception();
+                failed = true;
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    for (int k = 1; k < threads; ++k)
+        pool.push_back(std::thread(worker));
+    worker();
+    for (std::thread& t : pool)
+        t.join();
+    if (error)
+        std::rethrow_exception(error);
+}
+
+int tileThreadsArg(int argc, char** argv, int index) {
+    if (argc <= index)
+        return 0;
+    return std::max(0, std::stoi(argv[index]));
+}
+
+std::vector<COOMatrix> splitColumnsOnePass(const COOMatrix& matrix, int num_tiles) {
+    uint32_t cols_per_tile = matrix.n_cols / num_tiles;
+    uint32_t remainder = matrix.n_cols % num_tiles;
+    // columns [0, wide_end) sit in the (cols_per_tile + 1)-column tiles
+    uint32_t wide_end = remainder * (cols_per_tile + 1);
+    auto tileOf = [&](uint32_t col) -> int {
+        if (col < wide_end)
+            return col / (cols_per_tile + 1);
+        if (col >= matrix.n_cols)  // also cols_per_tile == 0
+            return -1;
+        return remainder + (col - wide_end) / cols_per_tile;
+    };
+
+    std::vector<uint32_t> counts(num_tiles, 0);
+    for (size_t i = 0; i < matrix.nnz; ++i) {
+        int tile = tileOf(matrix.col_indices[i]);
+        if (tile >= 0)
+            counts[tile]++;
+    }
+
+    std::vector<COOMatrix> tiles(num_tiles);
+    for (int tile = 0; tile < num_tiles; ++tile) {
+        tiles[tile].n_rows = matrix.n_rows;
+        tiles[tile].n_cols = matrix.n_cols;
+        tiles[tile].nnz = counts[tile];
+        tiles[tile].row_indices.reserve(counts[tile]);
+        tiles[tile].col_indices.reserve(counts[tile]);
+        tiles[tile].values.reserve(counts[tile]);
+    }
+    for (size_t i = 0; i < matrix.nnz; ++i) {
+        int tile = tileOf(matrix.col_indices[i]);
+        if (tile < 0)
+            continue;
+        tiles[tile].row_indices.push_back(matrix.row_indices[i]);
+        tiles[tile].col_indices.push_back(matrix.col_indices[i]);
+        tiles[tile].values.push_back(matrix.values[i]);
+    }
+    return tiles;
+}
@@ -0,0 +1,31 @@
+#ifndef TILE_PARALLEL_H
+#define TILE_PARALLEL_H
+
+#include <functional>
+#include <vector>
+#include "sw_full_stack.h"
+
+// Tile-parallel helpers of the DRAF generators (generate_DRAF, tiled64_DRAF,
+// tiled_no_opt_DRAF)
+//  The tiles of a matrix are independent, runTilesParallel builds them on a
+//  pool of std::threads that take the next tile index from a shared counter
+//  (tiles differ a lot in nnz). Every tile writes only its own slot of the
+//  result, so the output is the sequential tool's for any thread count
+//
+//  build (tools): g++ -O3 -std=c++11 tool.cc tile_parallel.cc -pthread
+
+// num_threads 0: hardware concurrency, 1: in order on the calling thread
+//  The first exception of a tile is rethrown once every worker stopped
+void runTilesParallel(int num_tiles, int num_threads,
+                      const std::function<void(int)>& build_tile);
+
+// Thread count of a tool from argv[index] (absent: 0, see runTilesParallel)
+int tileThreadsArg(int argc, char** argv, int index);
+
+// splitMatrixColumnWise in one pass over the nonzeros
+//  Column ranges as before: the first n_cols % num_tiles tiles take one
+//  column more, a column outside [0, n_cols) is in no tile. Counts first,
+//  then every tile is filled once in the matrix order (no copies)
+std::vector<COOMatrix> splitColumnsOnePass(const COOMatrix& matrix, int num_tiles);
+
+#endif
@@ -1,6 +1,8 @@
 #include "configuration.h"
 
+#include <sstream>
 #include <vector>
+#include "pim_config.h"
 
 #ifdef THERMAL
 #include <math.h>
@@ -24,6 +26,7 @@ Config::Config(std::string config_file, std::string out_dir)
     InitTimingParams();
     InitPowerParams();
     InitOtherParams();
+    InitPimParams();
 #ifdef THERMAL
     InitThermalParams();
 #endif  // THERMAL
@@ -178,9 +181,56 @@ void Config::InitOtherParams() {
     json_stats_name = output_prefix + ".json";
     json_epoch_name = output_prefix + "epoch.json";
     txt_stats_name = output_prefix + ".txt";
+    pim_profile = reader.GetBoolean("other", "pim_profile", false);
+    pim_profile_json_name = output_prefix + "_pim_profile.json";
+    pim_profile_folded_name = output_prefix + "_pim_profile.folded";
     return;
 }
 
+void Config::InitPimParams() {
+    pim_banks_per_unit = GetInteger("pim", "banks_per_unit", 2);
+    pim_units_per_sacc = GetInteger("pim", "units_per_sacc", 2);
+    pim_units = pim_banks_per_unit > 0 ? banks / pim_banks_per_unit : 0;
+    pim_words_per_row = columns / BL;
+    pim_partitions = channels * bankgroups;
+    return;
+}
+
+bool Config::ValidatePim(std::string* error) const {
+    std::stringstream ss;
+    auto pow2 = [](int v) { return v > 0 && (v & (v - 1)) == 0; };
+    if (request_size_bytes != WORD_SIZE) {
+        ss << "request size " << request_size_bytes << "B != PIM word "
+           << WORD_SIZE << "B (bus_width / 8 * BL)";
+    } else if (!pow2(channels) || !pow2(bankgroups) ||
+               !pow2(banks_per_group)) {
+        // AddressMapping / ReverseAddressMapping are bit fields
+        ss << "channels (" << channels << "), bankgroups (" << bankgroups
+           << ") and banks_per_group (" << banks_per_group
+           << ") must be powers of two";
+    } else if (rows <= 0x3fff) {
+        ss << "rows " << rows << " do not reach the PIM register rows "
+           << "(0x3ff7 - 0x3fff)";
+    } else if (pim_words_per_row < 32) {
+        ss << pim_words_per_row << " words per row, the 1KB DRAF rows need 32";
+    } else if (pim_banks_per_unit != 2) {
+        // μkernels run on EVEN_BANK / ODD_BANK of one unit
+        ss << "banks_per_unit = " << pim_banks_per_unit
+           << ", PimUnit pairs an even and an odd bank (2)";
+    } else if (pim_units_per_sacc != 2) {
+        ss << "units_per_sacc = " << pim_units_per_sacc
+           << ", SharedAccumulator pairs two PimUnits (2)";
+    } else if (banks % (pim_banks_per_unit * pim_units_per_sacc) != 0) {
+        ss << banks << " banks per channel are not a multiple of "
+           << pim_banks_per_unit * pim_units_per_sacc
+           << " (banks_per_unit x units_per_sacc)";
+    } else {
+        return true;
+    }
+    *error = ss.str();
+    return false;
+}
+
 void Config::InitPowerParams() {
     const auto& reader = *reader_;
     // Power-related parameters
@@ -212,6 +262,18 @@ void Config::InitPowerParams() {
     pre_stb_energy_inc = VDD * IDD2N * devices;
     pre_pd_energy_inc = VDD * IDD2P * devices;
     sref_energy_inc = VDD * IDD6x * devices;
+
+    // PIM logic, counted per operation by PimUnit / SharedAccumulator /
+    // GlobalAccumulator. Defaults are rough 20nm-class estimates
+    pim_alu_energy_inc = reader.GetReal("pim_power", "alu_energy", 12.0);
+    pim_grf_energy_inc = reader.GetReal("pim_power", "grf_access_energy", 2.0);
+    pim_srf_energy_inc = reader.GetReal("pim_power", "srf_access_energy", 0.5);
+    pim_drf_energy_inc = reader.GetReal("pim_power", "drf_access_energy", 2.0);
+    sacc_compare_energy_inc =
+        reader.GetReal("pim_power", "sacc_compare_energy", 0.3);
+    sacc_accumulate_energy_inc =
+        reader.GetReal("pim_power", "sacc_accumulate_energy", 1.0);
+    gacc_op_energy_inc = reader.GetReal("pim_power", "gacc_op_energy", 1.0);
     return;
 }
 
@@ -245,6 +307,27 @@ void Config::InitSystemParams() {
     sref_threshold = GetInteger("system", "sref_threshold", 1000);
     aggressive_precharging_enabled =
         reader.GetBoolean("system", "aggressive_precharging_enabled", false);
+    gacc_width = GetInteger("system", "gacc_width", 1);
+    gacc_queue_depth = GetInteger("system", "gacc_queue_depth", 32);
+    gacc_count = GetInteger("system", "gacc_count", 1);
+    gacc_mapping = reader.Get("system", "gacc_mapping", "block");
+    gacc_hierarchical = reader.GetBoolean("system", "gacc_hierarchical", true);
+    pmem_file = reader.Get("system", "pmem_file", "");
+    pmem_huge_pages = reader.GetBoolean("system", "pmem_huge_pages", true);
+    pmem_checkpoint = reader.Get("system", "pmem_checkpoint", "");
+    pmem_restore = reader.Get("system", "pmem_restore", "");
+    if (gacc_width < 1 || gacc_queue_depth < 1) {
+        std::cerr << "gacc_width and gacc_queue_depth must be positive" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    if (gacc_count < 1 || gacc_count > channels) {
+        std::cerr << "gacc_count must be in [1, channels]" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    if (gacc_mapping != "block" && gacc_mapping != "interleave") {
+        std::cerr << "Unknown gacc_mapping: " << gacc_mapping << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
 
     return;
 }
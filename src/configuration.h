@@ -111,6 +111,16 @@ class Config {
     double pre_pd_energy_inc;
     double sref_energy_inc;
 
+    // [pim_power] per-operation energies (pJ)
+    //  alu: one 16-lane ALU instruction, *_access: one 32B register access
+    double pim_alu_energy_inc;
+    double pim_grf_energy_inc;
+    double pim_srf_energy_inc;
+    double pim_drf_energy_inc;
+    double sacc_compare_energy_inc;     // one index compare of the merge
+    double sacc_accumulate_energy_inc;  // one matched partial-sum add
+    double gacc_op_energy_inc;          // one element move or add in the tree
+
     // HMC
     int num_links;
     int num_dies;
@@ -133,6 +143,19 @@ class Config {
     int sref_threshold;
     bool aggressive_precharging_enabled;
     bool enable_hbm_dual_cmd;
+
+    // Global accumulator merge tree
+    int gacc_width;        // elements per merge node per cycle
+    int gacc_queue_depth;  // entries per merge-tree queue
+    int gacc_count;        // first-level accumulators
+    std::string gacc_mapping;  // channel -> accumulator: "block" or "interleave"
+    bool gacc_hierarchical;    // combine first-level outputs in one more tree
+
+    // Physical memory backing (pmem)
+    std::string pmem_file;  // empty: anonymous mapping, else MAP_SHARED file
+    bool pmem_huge_pages;
+    std::string pmem_checkpoint;  // touched pages saved at PrintStats
+    std::string pmem_restore;     // checkpoint loaded before the run
     
     int epoch_period;
     int output_level;
@@ -141,6 +164,16 @@ class Config {
     std::string json_stats_name;
     std::string json_epoch_name;
     std::string txt_stats_name;
+    // PIM instruction profiler (pim_profile = True in [other])
+    bool pim_profile;
+    std::string pim_profile_json_name;
+    std::string pim_profile_folded_name;  // flame-graph collapsed stacks
+    // PIM geometry, [pim] section + DRAM structure (InitPimParams)
+    int pim_banks_per_unit;  // banks sharing one PimUnit (EVEN / ODD_BANK)
+    int pim_units_per_sacc;  // PimUnits paired by one SharedAccumulator
+    int pim_units;           // PimUnits per channel
+    int pim_words_per_row;   // 32B column words of a row
+    int pim_partitions;      // DRAF / sparse partitions, one per bankgroup
 
     // Computed parameters
     int request_size_bytes;
@@ -155,6 +188,8 @@ class Config {
                 protocol == DRAMProtocol::HBM2);
     }
     bool IsHMC() const { return (protocol == DRAMProtocol::HMC); }
+    // PIM geometry check, only PIM front ends call it (DDR runs share Config)
+    bool ValidatePim(std::string* error) const;
     // yzy: add another function
     bool IsDDR4() const { return (protocol == DRAMProtocol::DDR4); }
 
@@ -189,6 +224,7 @@ class Config {
                    int default_val) const;
     void InitDRAMParams();
     void InitOtherParams();
+    void InitPimParams();
     void InitPowerParams();
     void InitSystemParams();
 #ifdef THERMAL
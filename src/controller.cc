@@ -27,6 +27,7 @@ Controller::Controller(int channel, const Config &config, const Timing &timing)
                           : RowBufPolicy::OPEN_PAGE),
       last_trans_clk_(0),
       write_buffer_threshold_(8),
+      pim_stall_cycles_(0),
       write_draining_(0) {
     if (is_unified_queue_) {
         unified_queue_.reserve(config_.trans_queue_size);
@@ -142,6 +143,11 @@ void Controller::ClockTick() {
         }
     }
 
+    if (pim_stall_cycles_ > 0) {
+        pim_stall_cycles_--;
+        simple_stats_.Increment("pim_stall_cycles");
+    }
+
     ScheduleTransaction();
     clk_++;
     cmd_queue_.ClockTick();
@@ -149,7 +155,18 @@ void Controller::ClockTick() {
     return;
 }
 
+void Controller::CountPreloadWrite(bool activate) {
+    simple_stats_.Increment("num_preload_writes");
+    simple_stats_.Increment("num_writes_done");
+    simple_stats_.Increment("num_write_cmds");
+    if (activate)
+        simple_stats_.Increment("num_act_cmds");
+}
+
 bool Controller::WillAcceptTransaction(uint64_t hex_addr, bool is_write) const {
+    if (pim_stall_cycles_ > 0) {
+        return false;
+    }
     if (is_unified_queue_) {
         return unified_queue_.size() < unified_queue_.capacity();
     } else if (!is_write) {
@@ -31,11 +31,20 @@ class Controller {
     void ClockTick();
     bool WillAcceptTransaction(uint64_t hex_addr, bool is_write) const;
     bool AddTransaction(Transaction trans);
+    // Back-pressure from the PIM side: refuse new transactions for n cycles
+    void AddPimStall(uint64_t n) { pim_stall_cycles_ += n; }
+    // Write that bypassed the queues (preload), counted but not timed
+    void CountPreloadWrite(bool activate);
+    // PIM operation counts for the [pim_power] energy model
+    void AddPimOps(const std::string& name, uint64_t n) {
+        simple_stats_.IncrementBy(name, n);
+    }
     int QueueUsage() const;
     // Stats output
     void PrintEpochStats();
     void PrintFinalStats();
     void ResetStats() { simple_stats_.Reset(); }
+    double TotalEnergy() const { return simple_stats_.TotalEnergy(); }
     std::pair<uint64_t, std::pair<int, uint8_t*>> ReturnDoneTrans(uint64_t clock);
 
     // For barrier
@@ -78,6 +87,9 @@ class Controller {
     // used to calculate inter-arrival latency
     uint64_t last_trans_clk_;
 
+    // remaining cycles the host is held by PIM back-pressure
+    uint64_t pim_stall_cycles_;
+
     // transaction queueing
     int write_draining_;
     void ScheduleTransaction();
@@ -0,0 +1,225 @@
+#include "cpu_cache.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <unordered_set>
+
+namespace dramsim3 {
+
+bool ParseCacheLevels(const std::string& spec,
+                      std::vector<CacheLevelConfig>* levels,
+                      std::string* error) {
+    levels->clear();
+    std::stringstream ss(spec);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        CacheLevelConfig level;
+        char* end;
+        unsigned long long size = strtoull(item.c_str(), &end, 10);
+        if (*end == 'K' || *end == 'k') {
+            size <<= 10;
+            end++;
+        } else if (*end == 'M' || *end == 'm') {
+            size <<= 20;
+            end++;
+        } else if (*end == 'G' || *end == 'g') {
+            size <<= 30;
+            end++;
+        }
+        int ways = 0, latency = 0;
+        if (*end != ':' || sscanf(end, ":%d:%d", &ways, &latency) != 2 ||
+            size == 0 || ways <= 0 || latency < 0) {
+            *error = "cache level \"" + item + "\" is not <size>:<ways>:<latency>";
+            return false;
+        }
+        level.size = size;
+        level.ways = ways;
+        level.latency = latency;
+        levels->push_back(level);
+    }
+    if (levels->empty()) {
+        *error = "no cache level in \"" + spec + "\"";
+        return false;
+    }
+    return true;
+}
+
+SetAssocCache::SetAssocCache(const CacheLevelConfig& config, int line_size)
+    : hits_(0), misses_(0), evictions_(0), config_(config), stamp_(0) {
+    sets_ = config_.size / ((uint64_t)line_size * config_.ways);
+    if (sets_ == 0)
+        sets_ = 1;
+    Way invalid = {0, 0, false, false, false};
+    ways_.assign(sets_ * config_.ways, invalid);
+}
+
+SetAssocCache::Way* SetAssocCache::Find(uint64_t line) {
+    Way* set = &ways_[(line % sets_) * config_.ways];
+    for (int w = 0; w < config_.ways; w++) {
+        if (set[w].valid && set[w].line == line)
+            return &set[w];
+    }
+    return nullptr;
+}
+
+bool SetAssocCache::Access(uint64_t line, bool is_write, bool* prefetched) {
+    Way* way = Find(line);
+    if (!way) {
+        misses_++;
+        return false;
+    }
+    hits_++;
+    way->lru = ++stamp_;
+    way->dirty |= is_write;
+    if (prefetched)
+        *prefetched |= way->prefetched;
+    way->prefetched = false;
+    return true;
+}
+
+bool SetAssocCache::Contains(uint64_t line) const {
+    return const_cast<SetAssocCache*>(this)->Find(line) != nullptr;
+}
+
+bool SetAssocCache::Fill(uint64_t line, bool dirty, bool prefetched,
+                         uint64_t* victim) {
+    Way* way = Find(line);
+    if (way) {
+        way->dirty |= dirty;
+        way->lru = ++stamp_;
+        return false;
+    }
+    // invalid way first, otherwise the least recently used one
+    Way* set = &ways_[(line % sets_) * config_.ways];
+    way = &set[0];
+    for (int w = 0; w < config_.ways; w++) {
+        if (!set[w].valid) {
+            way = &set[w];
+            break;
+        }
+        if (set[w].lru < way->lru)
+            way = &set[w];
+    }
+    bool writeback = way->valid && way->dirty;
+    if (way->valid)
+        evictions_++;
+    if (writeback)
+        *victim = way->line;
+    way->line = line;
+    way->lru = ++stamp_;
+    way->valid = true;
+    way->dirty = dirty;
+    way->prefetched = prefetched;
+    return writeback;
+}
+
+void SetAssocCache::TakeDirty(std::vector<uint64_t>* lines) {
+    for (auto& way : ways_) {
+        if (way.valid && way.dirty) {
+            lines->push_back(way.line);
+            way.dirty = false;
+        }
+    }
+}
+
+CacheHierarchy::CacheHierarchy(const std::vector<CacheLevelConfig>& levels,
+                               int line_size)
+    : line_size_(line_size) {
+    for (const auto& level : levels)
+        levels_.push_back(SetAssocCache(level, line_size));
+}
+
+int CacheHierarchy::Access(uint64_t line, bool is_write, bool* prefetched,
+                           std::vector<uint64_t>* writebacks) {
+    for (int i = 0; i < (int)levels_.size(); i++) {
+        if (levels_[i].Access(line, is_write && i == 0, prefetched)) {
+            // bring the line up, the dirty copy stays where it is. Victims
+            // of these fills cascade down and may leave the LLC
+            for (int j = i - 1; j >= 0; j--)
+                FillLevel(j, line, is_write && j == 0, false, writebacks);
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool CacheHierarchy::Contains(uint64_t line) const {
+    for (const auto& level : levels_) {
+        if (level.Contains(line))
+            return true;
+    }
+    return false;
+}
+
+void CacheHierarchy::Fill(uint64_t line, bool dirty, bool prefetch,
+                          std::vector<uint64_t>* writebacks) {
+    int last = (int)levels_.size() - 1;
+    if (prefetch) {
+        FillLevel(last, line, false, true, writebacks);
+        return;
+    }
+    for (int i = last; i >= 0; i--)
+        FillLevel(i, line, dirty && i == 0, false, writebacks);
+}
+
+void CacheHierarchy::FillLevel(int level, uint64_t line, bool dirty,
+                               bool prefetched,
+                               std::vector<uint64_t>* writebacks) {
+    uint64_t victim;
+    if (!levels_[level].Fill(line, dirty, prefetched, &victim))
+        return;
+    if (level + 1 < (int)levels_.size())
+        FillLevel(level + 1, victim, true, false, writebacks);
+    else if (writebacks)
+        writebacks->push_back(victim);
+}
+
+void CacheHierarchy::Flush(std::vector<uint64_t>* writebacks) {
+    // upper dirty copies are newer, one writeback per line is enough
+    std::vector<uint64_t> dirty;
+    for (auto& level : levels_)
+        level.TakeDirty(&dirty);
+    std::unordered_set<uint64_t> seen(writebacks->begin(), writebacks->end());
+    for (uint64_t line : dirty) {
+        if (seen.insert(line).second)
+            writebacks->push_back(line);
+    }
+}
+
+int CacheHierarchy::Latency(int level) const {
+    int last = (level < 0) ? (int)levels_.size() - 1 : level;
+    return levels_[last].Config().latency;
+}
+
+StridePrefetcher::StridePrefetcher(int streams, int degree) : degree_(degree) {
+    Entry empty = {0, 0, 0, false};
+    table_.assign(streams, empty);
+}
+
+void StridePrefetcher::Observe(int stream, uint64_t line,
+                               std::vector<uint64_t>* prefetch) {
+    Entry& e = table_[stream];
+    if (!e.valid) {
+        e.last_line = line;
+        e.valid = true;
+        return;
+    }
+    int64_t stride = (int64_t)(line - e.last_line);
+    if (stride == 0)
+        return;
+    if (stride == e.stride) {
+        if (e.confidence < 3)
+            e.confidence++;
+    } else {
+        e.stride = stride;
+        e.confidence = 0;
+    }
+    e.last_line = line;
+    if (e.confidence < 1)
+        return;
+    for (int k = 1; k <= degree_; k++)
+        prefetch->push_back(line + e.stride * k);
+}
+
+}  // namespace dramsim3
@@ -0,0 +1,116 @@
+#ifndef __CPU_CACHE_H
+#define __CPU_CACHE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace dramsim3 {
+
+// One cache level, latency: load-to-use of a hit in memory clock cycles
+struct CacheLevelConfig {
+    uint64_t size;
+    int ways;
+    int latency;
+};
+
+// "<size>:<ways>:<latency>,..." from L1 to the LLC, size takes K / M / G
+//  e.g. "32K:8:4,1M:16:14,32M:16:40"
+bool ParseCacheLevels(const std::string& spec,
+                      std::vector<CacheLevelConfig>* levels,
+                      std::string* error);
+
+// Set-associative LRU cache of line numbers (addr / line_size)
+class SetAssocCache {
+ public:
+    SetAssocCache(const CacheLevelConfig& config, int line_size);
+
+    // Demand lookup, updates LRU and sets dirty on a write
+    //  prefetched: the line was brought in by the prefetcher and this is
+    //  its first demand hit
+    bool Access(uint64_t line, bool is_write, bool* prefetched);
+    bool Contains(uint64_t line) const;
+    // Inserts (or updates) line, returns true if a dirty victim was evicted
+    bool Fill(uint64_t line, bool dirty, bool prefetched, uint64_t* victim);
+    // Dirty lines, cleaned
+    void TakeDirty(std::vector<uint64_t>* lines);
+
+    const CacheLevelConfig& Config() const { return config_; }
+    uint64_t Sets() const { return sets_; }
+
+    uint64_t hits_;
+    uint64_t misses_;
+    uint64_t evictions_;
+
+ private:
+    struct Way {
+        uint64_t line;
+        uint64_t lru;  // last access stamp
+        bool valid;
+        bool dirty;
+        bool prefetched;
+    };
+    Way* Find(uint64_t line);
+
+    CacheLevelConfig config_;
+    uint64_t sets_;
+    uint64_t stamp_;
+    std::vector<Way> ways_;  // sets_ x config_.ways
+};
+
+// Non-inclusive write-back, write-allocate hierarchy
+//  Dirty victims of level i go to level i+1, those of the LLC to memory
+class CacheHierarchy {
+ public:
+    CacheHierarchy(const std::vector<CacheLevelConfig>& levels, int line_size);
+
+    // Level that hit (upper levels are filled from it), -1 on a miss in all
+    // levels. A write leaves the line dirty in L1. Memory writebacks of the
+    // upper-level fills are appended
+    int Access(uint64_t line, bool is_write, bool* prefetched,
+               std::vector<uint64_t>* writebacks);
+    bool Contains(uint64_t line) const;
+    // Line returned from memory: demand fills every level, prefetches only
+    // the LLC. Memory writebacks are appended
+    void Fill(uint64_t line, bool dirty, bool prefetch,
+              std::vector<uint64_t>* writebacks);
+    // Writes every dirty line back (end of the kernel)
+    void Flush(std::vector<uint64_t>* writebacks);
+    // Cycles of a lookup that ends at `level`, -1: LLC miss detected
+    int Latency(int level) const;
+
+    int Levels() const { return (int)levels_.size(); }
+    int LineSize() const { return line_size_; }
+    const SetAssocCache& Level(int i) const { return levels_[i]; }
+
+ private:
+    void FillLevel(int level, uint64_t line, bool dirty, bool prefetched,
+                   std::vector<uint64_t>* writebacks);
+
+    std::vector<SetAssocCache> levels_;
+    int line_size_;
+};
+
+// Stride prefetcher, one table entry per access stream (array of the kernel)
+//  Two accesses with the same line stride arm the entry, every further line
+//  change requests `degree` lines ahead along the stride
+class StridePrefetcher {
+ public:
+    StridePrefetcher(int streams, int degree);
+    void Observe(int stream, uint64_t line, std::vector<uint64_t>* prefetch);
+    int Degree() const { return degree_; }
+
+ private:
+    struct Entry {
+        uint64_t last_line;
+        int64_t stride;
+        int confidence;
+        bool valid;
+    };
+    std::vector<Entry> table_;
+    int degree_;
+};
+
+}  // namespace dramsim3
+
+#endif  // __CPU_CACHE_H
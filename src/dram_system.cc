@@ -1,6 +1,7 @@
 #include "dram_system.h"
 
 #include <assert.h>
+#include <algorithm>
 
 namespace dramsim3 {
 
@@ -55,6 +56,7 @@ void BaseDRAMSystem::PrintEpochStats() {
         std::ofstream epoch_out(config_.json_epoch_name, std::ofstream::out);
         epoch_out << "[";
     }
+    TransferPimOps();
     for (size_t i = 0; i < ctrls_.size(); i++) {
         ctrls_[i]->PrintEpochStats();
         std::ofstream epoch_out(config_.json_epoch_name, std::ofstream::app);
@@ -66,6 +68,15 @@ void BaseDRAMSystem::PrintEpochStats() {
     return;
 }
 
+// PIM operation counts enter the channel energy ([pim_power]) at print time
+void BaseDRAMSystem::TransferPimOps() {
+    int channels = std::min((int)ctrls_.size(), config_.channels);
+    for (int i = 0; i < channels; i++) {
+        for (const auto& op : pim_func_sim_->TakeOpCounts(i))
+            ctrls_[i]->AddPimOps(op.first, op.second);
+    }
+}
+
 void BaseDRAMSystem::PrintStats() {
     // Finish epoch output, remove last comma and append ]
     std::ofstream epoch_out(config_.json_epoch_name, std::ios_base::in |
@@ -80,6 +91,7 @@ void BaseDRAMSystem::PrintStats() {
 
     // close it now so that each channel can handle it
     json_out.close();
+    TransferPimOps();
     for (size_t i = 0; i < ctrls_.size(); i++) {
         ctrls_[i]->PrintFinalStats();
         if (i != ctrls_.size() - 1) {
@@ -88,13 +100,27 @@ void BaseDRAMSystem::PrintStats() {
         }
     }
     json_out.open(config_.json_stats_name, std::ofstream::app);
+    // PIM side counters are not owned by any controller
+    json_out << "," << std::endl << "\"pim\":" << pim_func_sim_->GetStatsJson();
+    for (auto it = extra_stats_.begin(); it != extra_stats_.end(); ++it)
+        json_out << "," << std::endl << "\"" << it.key() << "\":" << it.value();
     json_out << "}";
+    if (pim_func_sim_->profiler_)
+        pim_func_sim_->profiler_->Write();
 
 #ifdef THERMAL
     thermal_calc_.PrintFinalPT(clk_);
 #endif  // THERMAL
 }
 
+double BaseDRAMSystem::TotalEnergy() {
+    TransferPimOps();
+    double energy = 0.0;
+    for (size_t i = 0; i < ctrls_.size(); i++)
+        energy += ctrls_[i]->TotalEnergy();
+    return energy;
+}
+
 void BaseDRAMSystem::ResetStats() {
     for (size_t i = 0; i < ctrls_.size(); i++) {
         ctrls_[i]->ResetStats();
@@ -117,6 +143,10 @@ bool BaseDRAMSystem::IsPendingTransaction() {
     return false;
 }
 
+void BaseDRAMSystem::CountPreloadWrite(uint64_t hex_addr, bool activate) {
+    ctrls_[GetChannel(hex_addr)]->CountPreloadWrite(activate);
+}
+
 void BaseDRAMSystem::SetWriteBufferThreshold(int threshold) {
     for (size_t i = 0; i < ctrls_.size(); i++) {
         ctrls_[i]->write_buffer_threshold_ = (threshold < 0) ? 8 : threshold;
@@ -188,6 +218,7 @@ bool JedecDRAMSystem::AddTransaction(uint64_t hex_addr, bool is_write,
         //    std::cout << clk_ << "\t" << std::hex << hex_addr + 0x5000 << std::dec << std::endl; // << " " << is_write << " to PFSim\tch: " << addr.channel << "\tba: " << (addr.bankgroup * 4 + addr.bank) << "\tco: " << addr.column << "\tro: " << addr.row << std::endl;
         
         //여기서 address 정보를 넘겨줌 -> PimFuncSim에서 사용
+        trans.added_cycle = clk_;
         pim_func_sim_->AddTransaction(&trans);
 
         #if 0
@@ -201,6 +232,10 @@ bool JedecDRAMSystem::AddTransaction(uint64_t hex_addr, bool is_write,
         //  returns transaction's complete/execution cycle considering memory
         //  timing information
         ctrls_[channel]->AddTransaction(trans);
+        // SACC queues were full: hold this channel until the merge catches up
+        uint64_t stall = pim_func_sim_->TakeStallCycles(channel);
+        if (stall > 0)
+            ctrls_[channel]->AddPimStall(stall);
     }
     last_req_clk_ = clk_;
     return ok;
@@ -211,6 +246,8 @@ void JedecDRAMSystem::ClockTick() {
         // look ahead and return earlier
         while (true) {
             auto pair = ctrls_[i]->ReturnDoneTrans(clk_);
+            if (pair.second.first != -1)
+                pim_func_sim_->ReturnTransaction(pair.first, pair.second.first == 1);
             if (pair.second.first == 1) {
                 write_callback_(pair.first);
             } else if (pair.second.first == 0) {
@@ -223,6 +260,14 @@ void JedecDRAMSystem::ClockTick() {
     for (size_t i = 0; i < ctrls_.size(); i++) {
         ctrls_[i]->ClockTick();
     }
+    // GACC back-pressure is applied after the controllers tick so the
+    // channel refuses transactions during the next cycle
+    pim_func_sim_->ClockTick();
+    for (size_t i = 0; i < ctrls_.size(); i++) {
+        uint64_t stall = pim_func_sim_->TakeStallCycles(i);
+        if (stall > 0)
+            ctrls_[i]->AddPimStall(stall);
+    }
     clk_++;
 
     if (clk_ % config_.epoch_period == 0) {
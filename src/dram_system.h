@@ -28,7 +28,13 @@ class BaseDRAMSystem {
     //                        std::function<void(uint64_t)> write_callback);
     void PrintEpochStats();
     void PrintStats();
+    // Extra top-level entry of the stats JSON (e.g. "pmem" of the host)
+    void AddStats(const std::string& key, const nlohmann::json& value) {
+        extra_stats_[key] = value;
+    }
     void ResetStats();
+    // Energy (pJ) of all channels so far, PIM ops included
+    double TotalEnergy();
 
     virtual bool WillAcceptTransaction(uint64_t hex_addr,
                                        bool is_write) const = 0;
@@ -40,6 +46,7 @@ class BaseDRAMSystem {
     // For barrier
     bool IsPendingTransaction();
     void SetWriteBufferThreshold(int threshold);
+    void CountPreloadWrite(uint64_t hex_addr, bool activate);
 
     std::function<void(uint64_t req_id, uint8_t* DataPtr)> read_callback_;
     std::function<void(uint64_t req_id)> write_callback_;
@@ -67,6 +74,8 @@ class BaseDRAMSystem {
 
     uint64_t clk_;
     std::vector<Controller*> ctrls_;
+    nlohmann::json extra_stats_;
+    void TransferPimOps();
 
 #ifdef ADDR_TRACE
     std::ofstream address_trace_;
@@ -1,4 +1,5 @@
 #include "./global_acc.h"
+#include <algorithm>
 #include <iostream>
 
 namespace dramsim3{
@@ -27,57 +28,110 @@ int GlobalAccumulator::AddTransaction(uint64_t hex_addr, bool is_write, uint8_t*
     return 0; 
 }
 
-GlobalAccumulator::GlobalAccumulator(Config &config)
-    :config_(config)
+GlobalAccumulator::GlobalAccumulator(Config &config, int id, int num_inputs, int level)
+    :gacc_clk(0),
+    width(config.gacc_width),
+    queue_depth(config.gacc_queue_depth),
+    gacc_id(id),
+    level(level),
+    busy_cycles(0),
+    node_stall_cycles(0),
+    merge_adds(0),
+    num_moves(0),
+    num_results(0),
+    num_reductions(0),
+    last_done_clk(0),
+    occupancy_sum(0),
+    max_occupancy(0),
+    config_(config),
+    num_elements_(0),
+    parent_(nullptr),
+    parent_leaf_(0)
 {
     // Initialize the queues
-    for (int i = 0; i < 16; i++) {
-        pair_queue_1[i] = std::queue<Pair>();
+    //  입력 수만큼 leaf를 두고 root(1개)까지 절반씩 줄여 나감
+    int num_queues = num_inputs;
+    pair_queue_.push_back(std::vector<std::deque<Pair>>(num_queues));
+    while (num_queues > 1) {
+        num_queues = (num_queues + 1) / 2;
+        pair_queue_.push_back(std::vector<std::deque<Pair>>(num_queues));
     }
-    for (int i = 0; i < 8; i++) {
-        pair_queue_2[i] = std::queue<Pair>();
-    }
-    for (int i = 0; i < 4; i++) {
-        pair_queue_3[i] = std::queue<Pair>();
-    }
-    for (int i = 0; i < 2; i++) {
-        pair_queue_4[i] = std::queue<Pair>();
-    }
-    result_pair_queue = std::queue<Pair>();
-
-    // Initialize the accumulators
 }
 
-int GlobalAccumulator::StartAcc() {
-    #ifdef debug_mode
-    std::cout << "Triggering global accumulator\n";
-    #endif
-    while (!IsAllQueueEmpty()) {
-        simulate_step();
-    }
-    return 0; // 작업이 완료되면 0 반환
+void GlobalAccumulator::SetParent(GlobalAccumulator* parent, int parent_leaf) {
+    parent_ = parent;
+    parent_leaf_ = parent_leaf;
 }
 
-int GlobalAccumulator::IsAllQueueEmpty() {
-    for (auto& q : pair_queue_1) {
-        if (!q.empty()) return 0;
-    }
-    for (auto& q : pair_queue_2) {
-        if (!q.empty()) return 0;
-    }
-    for (auto& q : pair_queue_3) {
-        if (!q.empty()) return 0;
+// One pipeline cycle
+//  Levels are visited from the root to the leaves so that an element moves
+//  at most one level per cycle
+void GlobalAccumulator::ClockTick() {
+    gacc_clk++;
+    if (num_elements_ == 0)
+        return;
+    busy_cycles++;
+    occupancy_sum += num_elements_;
+    max_occupancy = std::max(max_occupancy, num_elements_);
+
+    std::deque<Pair>& root = pair_queue_.back()[0];
+    for (int k = 0; k < width && !root.empty(); k++) {
+        if (parent_ && parent_->LeafOccupancy(parent_leaf_) >= queue_depth) {
+            node_stall_cycles++;
+            break;
+        }
+        Pair out = root.front();
+        root.pop_front();
+        num_elements_--;
+        num_moves++;
+        if (out.eos) {
+            num_reductions++;
+            last_done_clk = gacc_clk;
+        } else {
+            num_results++;
+        }
+        if (parent_)
+            parent_->AddDataToPairQueue1(parent_leaf_, out);
+        else if (!out.eos)
+            result.push_back(out);
     }
-    for (auto& q : pair_queue_4) {
-        if (!q.empty()) return 0;
+
+    for (int level = (int)pair_queue_.size() - 2; level >= 0; level--) {
+        std::vector<std::deque<Pair>>& in = pair_queue_[level];
+        for (size_t i = 0; i < in.size(); i += 2) {
+            std::deque<Pair>* RQ = (i + 1 < in.size()) ? &in[i + 1] : nullptr;
+            process_queues(in[i], RQ, pair_queue_[level + 1][i / 2]);
+        }
     }
-    return result_pair_queue.empty() ? 1 : 0;
+}
+
+nlohmann::json GlobalAccumulator::GetStatsJson() const {
+    nlohmann::json j_data;
+    j_data["level"] = level;
+    j_data["inputs"] = pair_queue_[0].size();
+    j_data["busy_cycles"] = busy_cycles;
+    j_data["node_stall_cycles"] = node_stall_cycles;
+    j_data["merge_adds"] = merge_adds;
+    j_data["moves"] = num_moves;
+    j_data["results"] = num_results;
+    j_data["reductions"] = num_reductions;
+    j_data["last_done_clk"] = last_done_clk;
+    j_data["throughput"] = busy_cycles ? (double)num_results / busy_cycles : 0.0;
+    j_data["average_occupancy"] = busy_cycles ? (double)occupancy_sum / busy_cycles : 0.0;
+    j_data["max_occupancy"] = max_occupancy;
+    return j_data;
+}
+
+int GlobalAccumulator::IsAllQueueEmpty() const {
+    return num_elements_ == 0 ? 1 : 0;
 }
 
 //외부에서 들어온 데이터를 queue에 추가하는 함수
+// leaf queue는 bound 하지 않음 (host 쪽 back-pressure는 PimFuncSim에서 처리)
 void GlobalAccumulator::AddDataToPairQueue1(int queue_index, const Pair& data) {
-    if (queue_index >= 0 && queue_index < 16) {
-        pair_queue_1[queue_index].push(data);
+    if (queue_index >= 0 && queue_index < (int)pair_queue_[0].size()) {
+        pair_queue_[0][queue_index].push_back(data);
+        num_elements_++;
     } else {
         // 유효하지 않은 인덱스에 대해 에러 처리 (예: 로그 메시지 출력)
         std::cerr << "Invalid queue index: " << queue_index << std::endl;
@@ -92,6 +146,7 @@ Pair GlobalAccumulator::compare_and_add(Pair LQ_front, Pair RQ_front, bool &shou
         Pair result;
         result.index = LQ_front.index;
         result.data = LQ_front.data + RQ_front.data; // data 값 더하기
+        result.eos = false;
         return result;
     } else if (LQ_front.index > RQ_front.index) {
         should_add = false;
@@ -102,40 +157,57 @@ Pair GlobalAccumulator::compare_and_add(Pair LQ_front, Pair RQ_front, bool &shou
     }
 }
 
-void GlobalAccumulator::simulate_step() {
-    for (int i = 0; i < 16; i += 2) {
-        process_queues(pair_queue_1[i], pair_queue_1[i + 1], pair_queue_2[i / 2]);
-    }
-    for (int i = 0; i < 8; i += 2) {
-        process_queues(pair_queue_2[i], pair_queue_2[i + 1], pair_queue_3[i / 2]);
-    }
-    for (int i = 0; i < 4; i += 2) {
-        process_queues(pair_queue_3[i], pair_queue_3[i + 1], pair_queue_4[i / 2]);
-    }
-    process_queues(pair_queue_4[0], pair_queue_4[1], result_pair_queue);
-}
+// One merge node, RQ == nullptr for the pass-through node of an odd level
+void GlobalAccumulator::process_queues(std::deque<Pair>& LQ, std::deque<Pair>* RQ, std::deque<Pair>& next_queue) {
+    for (int k = 0; k < width; k++) {
+        if (LQ.empty() && (RQ == nullptr || RQ->empty()))
+            return;
+        if ((int)next_queue.size() >= queue_depth) {
+            node_stall_cycles++;
+            return;
+        }
+        if (RQ == nullptr) {
+            next_queue.push_back(LQ.front());
+            LQ.pop_front();
+            num_moves++;
+            continue;
+        }
+        // 한쪽이 비어 있으면 더 작은 index가 올 수 있으므로 대기
+        if (LQ.empty() || RQ->empty())
+            return;
 
-void GlobalAccumulator::process_queues(std::queue<Pair>& LQ, std::queue<Pair>& RQ, std::queue<Pair>& next_queue) {
-    if (!LQ.empty() && !RQ.empty()) {
         //Pair = Index + Data
         Pair LQ_front = LQ.front();
-        Pair RQ_front = RQ.front();
-
-        bool should_add = false;
-        Pair result = compare_and_add(LQ_front, RQ_front, should_add);
-
-        if (should_add) {
-            next_queue.push(result); // 더한 결과를 큐에 추가
-            LQ.pop();
-            RQ.pop();
-        } else if (LQ_front.index == result.index) {
-            next_queue.push(result); // 그냥 pop 된 결과를 queue에 추가
-            RQ.pop();
+        Pair RQ_front = RQ->front();
+
+        if (LQ_front.eos && RQ_front.eos) {
+            next_queue.push_back(LQ_front); // 두 stream 모두 끝
+            LQ.pop_front();
+            RQ->pop_front();
+            num_elements_--;
+        } else if (LQ_front.eos) {
+            next_queue.push_back(RQ_front);
+            RQ->pop_front();
+        } else if (RQ_front.eos) {
+            next_queue.push_back(LQ_front);
+            LQ.pop_front();
         } else {
-            next_queue.push(result); // 그냥 pop 된 결과를 queue에 추가
-            LQ.pop();
+            bool should_add = false;
+            Pair result = compare_and_add(LQ_front, RQ_front, should_add);
+            next_queue.push_back(result);
+            if (should_add) {
+                merge_adds++;
+                LQ.pop_front();
+                RQ->pop_front();
+                num_elements_--;
+            } else if (LQ_front.index == result.index) {
+                LQ.pop_front(); // 그냥 pop 된 결과를 queue에 추가
+            } else {
+                RQ->pop_front(); // 그냥 pop 된 결과를 queue에 추가
+            }
         }
+        num_moves++;
     }
 }
 
-}
\ No newline at end of file
+}
@@ -14,38 +14,49 @@
 #include "./configuration.h"
 #include "./common.h"
 #include "./half.hpp"
-#include <queue> 
+#include "json.hpp"
+#include <deque>
 
 namespace dramsim3 {
 
 typedef struct Pair{
     uint32_t index;
     unit_t data; 
+    bool eos; // end of one channel's stream (TRIGGER_GACC write)
 }Pair;
 
+// Pipelined merge tree of the global accumulator
+//  Level 0 has one leaf queue per channel and every level halves the queue
+//  count down to the root. Each cycle a merge node moves up to gacc_width
+//  elements one level down (adding equal indices), and stalls when its
+//  output queue already holds gacc_queue_depth elements.
+//  A node can only pop one side when the other side has data or has
+//  reached eos, so every input stream must be closed with an eos Pair
+//  With a parent (hierarchical GACC) the root forwards into the parent's
+//  leaf parent_leaf instead of result, stalling while that leaf is full
 class GlobalAccumulator {
 public:
-    GlobalAccumulator(Config &config); //GA는 모든 채널ㅇ르 바라보고 있기에 ID가 필요 없음
+    GlobalAccumulator(Config &config, int id, int num_inputs, int level);
+    void SetParent(GlobalAccumulator* parent, int parent_leaf);
     //Read CMD를 통해 데이터를 Global accumulator가 읽어올 수 있도록
     int AddTransaction(uint64_t hex_addr, bool is_write, uint8_t* DataPtr);
 
-    int StartAcc();
-    int IsAllQueueEmpty();
+    void ClockTick();
+    int IsAllQueueEmpty() const;
     
-    // 외부에서 pair_queue_1에 데이터를 추가하는 함수
+    // 외부에서 leaf queue (pair_queue_[0])에 데이터를 추가하는 함수
     void AddDataToPairQueue1(int queue_index, const Pair& data);
-    std::queue<Pair> pair_queue_1[16];
-    std::queue<Pair> pair_queue_2[8];
-    std::queue<Pair> pair_queue_3[4];
-    std::queue<Pair> pair_queue_4[2];
-    std::queue<Pair> result_pair_queue;
+    int LeafOccupancy(int queue_index) const { return pair_queue_[0][queue_index].size(); }
+    // pair_queue_[level][node], the last level is the root
+    std::vector<std::vector<std::deque<Pair>>> pair_queue_;
+    std::vector<Pair> result; // merged stream of the finished reductions (top level only)
+    nlohmann::json GetStatsJson() const;
     
     void init(uint8_t* pmemAddr, uint64_t pmemAddr_size,
               unsigned int burstSize);
         
     Pair compare_and_add(Pair LQ_front, Pair RQ_front, bool &should_add);
-    void simulate_step();
-    void process_queues(std::queue<Pair>& LQ, std::queue<Pair>& RQ, std::queue<Pair>& result_queue);
+    void process_queues(std::deque<Pair>& LQ, std::deque<Pair>* RQ, std::deque<Pair>& next_queue);
 
     unit_t *bank_data_;
     uint8_t* pmemAddr_;
@@ -53,8 +64,27 @@ public:
     unsigned int burstSize_;
     uint64_t gacc_clk;
 
+    int width;       // elements per merge node per cycle
+    int queue_depth; // capacity of every queue below the leaves
+    int gacc_id;
+    int level;       // 0: fed by channels, 1: combiner of level-0 outputs
+
+    // Statistics
+    uint64_t busy_cycles;
+    uint64_t node_stall_cycles; // node-cycles blocked by a full output queue
+    uint64_t merge_adds;        // equal indices added inside the tree
+    uint64_t num_moves;         // elements advanced one level (root output included)
+    uint64_t num_results;       // elements leaving the root
+    uint64_t num_reductions;    // eos seen at the root
+    uint64_t last_done_clk;
+    uint64_t occupancy_sum;     // elements inside the tree, summed per cycle
+    uint64_t max_occupancy;
+
 protected:
     Config &config_;
+    uint64_t num_elements_; // elements currently inside the tree
+    GlobalAccumulator* parent_;
+    int parent_leaf_;
 
 };
 
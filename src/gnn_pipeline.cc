@@ -0,0 +1,192 @@
+#include "gnn_pipeline.h"
+
+#include <sys/stat.h>
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace dramsim3 {
+
+bool ParseGnnDims(const std::string& spec, std::vector<uint32_t>* dims) {
+    dims->clear();
+    std::stringstream ss(spec);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        char* end;
+        unsigned long v = strtoul(item.c_str(), &end, 10);
+        if (item.empty() || *end != '\0' || v == 0)
+            return false;
+        dims->push_back((uint32_t)v);
+    }
+    return dims->size() >= 2;
+}
+
+GnnPipeline::GnnPipeline(
+    const std::string& config_file, const std::string& output_dir,
+    const sparse_row_partitions& B0_data,
+    const sparse_row_partitions& B2_data,
+    uint32_t nodes, const std::vector<uint32_t>& dims)
+    : pim_combination_(true),
+      pipeline_(false),
+      host_flops_per_cycle_(64.0),
+      host_bytes_per_cycle_(64.0),
+      host_pj_per_flop_(5.0),
+      host_pj_per_byte_(20.0),
+      preload_(false),
+      interleave_channels_(true),
+      issue_width_(1),
+      config_file_(config_file),
+      output_dir_(output_dir),
+      B0_data_(B0_data),
+      B2_data_(B2_data),
+      nodes_(nodes),
+      dims_(dims) {
+    Config config(config_file, output_dir);
+    tck_ = config.tCK;
+    for (size_t l = 0; l + 1 < dims_.size(); l++) {
+        uint32_t in = dims_[l], out = dims_[l + 1];
+        Stage aggregate = {(int)l, "aggregate", 0, 0, true, 0, 0.0};
+        Stage combine = {(int)l, "combine", in, out, true, 0, 0.0};
+        if (out < in) {  // A (H W)
+            aggregate.in = aggregate.out = out;
+            stages_.push_back(combine);
+            stages_.push_back(aggregate);
+        } else {  // (A H) W
+            aggregate.in = aggregate.out = in;
+            stages_.push_back(aggregate);
+            stages_.push_back(combine);
+        }
+    }
+}
+
+std::string GnnPipeline::StageDir(const Stage& stage) {
+    std::string dir = output_dir_ + "/layer" + std::to_string(stage.layer) +
+                      "_" + stage.name;
+    mkdir(dir.c_str(), 0755);
+    return dir;
+}
+
+void GnnPipeline::Setup(TransactionGenerator* g) {
+    g->preload_ = preload_;
+    g->interleave_channels_ = interleave_channels_;
+    g->issue_width_ = issue_width_;
+}
+
+void GnnPipeline::RunAggregation(Stage* stage) {
+    std::vector<uint16_t> output((size_t)nodes_ * stage->out);
+    SpmmTransactionGenerator g(config_file_, StageDir(*stage), B0_data_,
+                               B2_data_, output.data());
+    Setup(&g);
+    g.dense_width_ = stage->in;
+    g.Initialize();
+    uint64_t clk = g.GetClk();
+    g.SetData();
+    g.Execute();
+    g.GetResult();
+    stage->cycles = g.GetClk() - clk;
+    stage->energy = g.TotalEnergy();
+    g.PrintStats();
+}
+
+void GnnPipeline::RunCombination(Stage* stage) {
+    if (!stage->on_pim) {
+        double flops = 2.0 * nodes_ * stage->in * stage->out;
+        double bytes = UNIT_SIZE * ((double)nodes_ * stage->in +
+                                    (double)stage->in * stage->out +
+                                    (double)nodes_ * stage->out);
+        stage->cycles = (uint64_t)std::max(flops / host_flops_per_cycle_,
+                                           bytes / host_bytes_per_cycle_);
+        stage->energy = flops * host_pj_per_flop_ + bytes * host_pj_per_byte_;
+        return;
+    }
+    GemmTransactionGenerator g(config_file_, StageDir(*stage), nodes_,
+                               stage->in, stage->out);
+    Setup(&g);
+    g.Initialize();
+    uint64_t clk = g.GetClk();
+    g.SetData();
+    g.Execute();
+    g.GetResult();
+    stage->cycles = g.GetClk() - clk;
+    stage->energy = g.TotalEnergy();
+    g.PrintStats();
+}
+
+void GnnPipeline::Run() {
+    for (Stage& stage : stages_) {
+        stage.on_pim = (stage.name == "aggregate") || pim_combination_;
+        std::cout << "Layer " << stage.layer << " " << stage.name << " ("
+                  << stage.in << " -> " << stage.out << ", "
+                  << (stage.on_pim ? "PIM" : "host") << ")" << std::endl;
+        if (stage.name == "aggregate")
+            RunAggregation(&stage);
+        else
+            RunCombination(&stage);
+    }
+}
+
+uint64_t GnnPipeline::Latency() const {
+    uint64_t latency = 0;
+    for (const Stage& stage : stages_)
+        latency += stage.cycles;
+    return latency;
+}
+
+uint64_t GnnPipeline::Interval() const {
+    uint64_t pim_busy = 0, host_busy = 0;
+    for (const Stage& stage : stages_)
+        (stage.on_pim ? pim_busy : host_busy) += stage.cycles;
+    return std::max(pim_busy, host_busy);
+}
+
+void GnnPipeline::PrintStats() {
+    std::cout << "GNN: " << nodes_ << " nodes, " << dims_.size() - 1
+              << " layers, combination on "
+              << (pim_combination_ ? "PIM (MAC)" : "host") << std::endl;
+    std::cout << std::setw(6) << "layer" << std::setw(11) << "stage"
+              << std::setw(14) << "width" << std::setw(6) << "unit"
+              << std::setw(14) << "cycles" << std::setw(14) << "energy(uJ)"
+              << std::endl;
+    uint64_t latency = 0, pim_busy = 0, host_busy = 0;
+    double energy = 0.0;
+    std::vector<uint64_t> layer_cycles(dims_.size() - 1, 0);
+    std::vector<double> layer_energy(dims_.size() - 1, 0.0);
+    for (const Stage& stage : stages_) {
+        std::string width = std::to_string(stage.in) + "->" +
+                            std::to_string(stage.out);
+        std::cout << std::setw(6) << stage.layer << std::setw(11) << stage.name
+                  << std::setw(14) << width << std::setw(6)
+                  << (stage.on_pim ? "PIM" : "host") << std::setw(14)
+                  << stage.cycles << std::setw(14) << std::fixed
+                  << std::setprecision(3) << stage.energy * 1e-6
+                  << std::defaultfloat << std::endl;
+        latency += stage.cycles;
+        (stage.on_pim ? pim_busy : host_busy) += stage.cycles;
+        energy += stage.energy;
+        layer_cycles[stage.layer] += stage.cycles;
+        layer_energy[stage.layer] += stage.energy;
+    }
+    for (size_t l = 0; l < layer_cycles.size(); l++) {
+        std::cout << "Layer " << l << ": " << layer_cycles[l] << " cycles, "
+                  << std::fixed << std::setprecision(3)
+                  << layer_energy[l] * 1e-6 << " uJ" << std::defaultfloat
+                  << std::endl;
+    }
+    std::cout << "End-to-end: " << latency << " cycles ("
+              << std::fixed << std::setprecision(3) << latency * tck_ * 1e-3
+              << " us), " << energy * 1e-6 << " uJ" << std::defaultfloat
+              << std::endl;
+    if (pipeline_) {
+        uint64_t interval = Interval();
+        std::cout << "Pipelined: PIM busy " << pim_busy << ", host busy "
+                  << host_busy << ", one inference every " << interval
+                  << " cycles (" << std::fixed << std::setprecision(2)
+                  << (interval ? (double)latency / interval : 0.0)
+                  << "x the unpipelined rate)" << std::defaultfloat
+                  << std::endl;
+    }
+}
+
+}  // namespace dramsim3
@@ -0,0 +1,80 @@
+#ifndef __GNN_PIPELINE_H
+#define __GNN_PIPELINE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "./transaction_generator.h"
+
+namespace dramsim3 {
+
+// "1433,16,7" -> {1433, 16, 7}: feature widths of the input and every layer
+bool ParseGnnDims(const std::string& spec, std::vector<uint32_t>* dims);
+
+// GCN-style layers H' = act(A H W) over the adjacency A of --matrix
+//  Every layer is an aggregation (SpMM A x dense on PIM, SpmmTransaction-
+//  Generator) and a combination (dense x W, GemmTransactionGenerator on PIM
+//  or the host model). A layer aggregates at the smaller width: A (H W) if
+//  W narrows the features, (A H) W otherwise. Each PIM stage runs on its own
+//  generator (stats in output_dir/layer<l>_<stage>), its cycles are
+//  SetData ~ GetResult and its energy the DRAM + PIM energy of the stage
+//  Host model: cycles = max(flops / host_flops_per_cycle_,
+//  bytes / host_bytes_per_cycle_), energy = flops * host_pj_per_flop_ +
+//  bytes * host_pj_per_byte_, bytes = X + W + Y in FP16
+//  pipeline_: consecutive inferences overlap on the two resources, PIM
+//  stages of inference i+1 run while the host does the combinations of i,
+//  the interval is the busier resource (the latency does not change)
+class GnnPipeline {
+ public:
+    GnnPipeline(const std::string& config_file, const std::string& output_dir,
+                const sparse_row_partitions& B0_data,
+                const sparse_row_partitions& B2_data,
+                uint32_t nodes, const std::vector<uint32_t>& dims);
+
+    struct Stage {
+        int layer;
+        std::string name;  // aggregate / combine
+        uint32_t in, out;  // feature widths
+        bool on_pim;
+        uint64_t cycles;
+        double energy;  // pJ
+    };
+
+    void Run();
+    void PrintStats();
+    // in execution order, cycles and energy after Run
+    const std::vector<Stage>& Stages() const { return stages_; }
+    uint64_t Latency() const;
+    // cycles between inferences with pipeline_, the busier resource
+    uint64_t Interval() const;
+
+    bool pim_combination_;  // false: the combination runs on the host model
+    bool pipeline_;
+    double host_flops_per_cycle_;  // per memory clock
+    double host_bytes_per_cycle_;
+    double host_pj_per_flop_;
+    double host_pj_per_byte_;
+    // per-generator options, copied to every PIM stage
+    bool preload_;
+    bool interleave_channels_;
+    int issue_width_;
+
+ private:
+    void RunAggregation(Stage* stage);
+    void RunCombination(Stage* stage);
+    void Setup(TransactionGenerator* g);
+    std::string StageDir(const Stage& stage);
+
+    std::string config_file_;
+    std::string output_dir_;
+    sparse_row_partitions B0_data_;  // every stage shares the mapped rows
+    sparse_row_partitions B2_data_;
+    uint32_t nodes_;
+    std::vector<uint32_t> dims_;
+    std::vector<Stage> stages_;
+    double tck_;
+};
+
+}  // namespace dramsim3
+
+#endif  // __GNN_PIPELINE_H
@@ -0,0 +1,66 @@
+#ifndef __INDEX_INTERSECT_H
+#define __INDEX_INTERSECT_H
+
+#include <stdint.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace dramsim3 {
+
+// Sorted-set intersection of two index lists (SACC index matching)
+//  a, b must be strictly increasing (no duplicates)
+//  Matched positions are written to a_pos[k], b_pos[k] in increasing order
+//  (either may be nullptr when only the count is needed)
+//  Returns the number of matches
+//
+// SSE2 path: 4x4 all-pairs compare. The b block is rotated three times with
+// _mm_shuffle_epi32 so every a lane meets every b lane in 4 compares, then
+// the block with the smaller last element is retired (both on a tie).
+// The tails are finished with the scalar merge
+inline int IntersectSorted(const uint32_t* a, int na, const uint32_t* b,
+                           int nb, int* a_pos, int* b_pos) {
+    int i = 0, j = 0, cnt = 0;
+#ifdef __SSE2__
+    while (i + 4 <= na && j + 4 <= nb) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + j));
+        __m128i m = _mm_cmpeq_epi32(va, vb);
+        m = _mm_or_si128(m, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, 0x39)));
+        m = _mm_or_si128(m, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, 0x4e)));
+        m = _mm_or_si128(m, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, 0x93)));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(m));
+        while (mask) {
+            int k = __builtin_ctz(mask);
+            mask &= mask - 1;
+            int l = 0;
+            while (b[j + l] != a[i + k]) l++;
+            if (a_pos) a_pos[cnt] = i + k;
+            if (b_pos) b_pos[cnt] = j + l;
+            cnt++;
+        }
+        uint32_t a_last = a[i + 3];
+        uint32_t b_last = b[j + 3];
+        if (a_last <= b_last) i += 4;
+        if (b_last <= a_last) j += 4;
+    }
+#endif
+    while (i < na && j < nb) {
+        if (a[i] == b[j]) {
+            if (a_pos) a_pos[cnt] = i;
+            if (b_pos) b_pos[cnt] = j;
+            cnt++;
+            i++;
+            j++;
+        } else if (a[i] < b[j]) {
+            i++;
+        } else {
+            j++;
+        }
+    }
+    return cnt;
+}
+
+}  // namespace dramsim3
+
+#endif  // __INDEX_INTERSECT_H
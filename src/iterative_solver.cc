@@ -0,0 +1,273 @@
+#include "iterative_solver.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include "half.hpp"
+
+using half_float::half;
+
+namespace dramsim3 {
+
+bool IsIterativeSolver(const std::string& name) {
+    return name == "pagerank" || name == "jacobi" || name == "cg";
+}
+
+IterativeSpmv::IterativeSpmv(SpmvTransactionGenerator* spmv,
+                             const COOMatrix& matrix,
+                             const std::string& solver)
+    : damping_(0.85),
+      spmv_(spmv),
+      matrix_(matrix),
+      solver_(solver),
+      converged_(false) {
+    if (!IsIterativeSolver(solver_)) {
+        std::cerr << "Unknown solver " << solver_ << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    if (matrix_.n_rows != matrix_.n_cols) {
+        std::cerr << "Solver " << solver_ << " needs a square matrix, got "
+                  << matrix_.n_rows << "x" << matrix_.n_cols << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    if (spmv_->output_rows_ < matrix_.n_rows) {
+        std::cerr << "Solver " << solver_ << " reads y back, output_rows_ "
+                  << spmv_->output_rows_ << " < " << matrix_.n_rows << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    if (spmv_->pipeline_tile_rows_ > 0) {
+        std::cerr << "Iterative SpMV keeps the matrix resident, "
+                  << "--pipeline-tile is not supported" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+}
+
+void IterativeSpmv::Multiply(const std::vector<double>& x,
+                             std::vector<double>* y) {
+    Iteration it;
+    spmv_->x_vector_.resize(x.size());
+    for (size_t j = 0; j < x.size(); j++) {
+        half h((float)x[j]);
+        memcpy(&spmv_->x_vector_[j], &h, sizeof(uint16_t));
+    }
+    uint64_t clk = spmv_->GetClk();
+    spmv_->ChangeVector();
+    it.vector_cycles = spmv_->GetClk() - clk;
+    it.vector_words = spmv_->vector_words_;
+    clk = spmv_->GetClk();
+    spmv_->start_clk_ = clk;
+    spmv_->Execute();
+    it.execute_cycles = spmv_->GetClk() - clk;
+    clk = spmv_->GetClk();
+    spmv_->GetResult();
+    it.result_cycles = spmv_->GetClk() - clk;
+    it.residual = 0;
+
+    // values are INT16 (unit_t, customRound of the file), indices 1-based
+    //  PageRank only uses the pattern, every link counts once
+    bool pattern = (solver_ == "pagerank");
+    y->assign(matrix_.n_rows, 0.0);
+    for (size_t e = 0; e < matrix_.row_indices.size(); e++) {
+        double a = pattern ? 1.0 : (double)(int16_t)matrix_.values[e];
+        (*y)[matrix_.row_indices[e] - 1] += a * x[matrix_.col_indices[e] - 1];
+    }
+
+    const uint16_t* pim = spmv_->Output();
+    double err = 0, scale = 0;
+    for (size_t i = 0; i < y->size(); i++) {
+        half h(*reinterpret_cast<const half*>(&pim[i]));
+        err = std::max(err, std::fabs((double)(float)h - (*y)[i]));
+        scale = std::max(scale, std::fabs((*y)[i]));
+    }
+    it.pim_error = scale > 0 ? err / scale : err;
+    iterations_.push_back(it);
+}
+
+double IterativeSpmv::MaxPimError() const {
+    double err = 0;
+    for (const Iteration& it : iterations_)
+        err = std::max(err, it.pim_error);
+    return err;
+}
+
+void IterativeSpmv::Run(int max_iters, double tol) {
+    iterations_.clear();
+    converged_ = false;
+    if (solver_ == "pagerank")
+        RunPageRank(max_iters, tol);
+    else if (solver_ == "jacobi")
+        RunJacobi(max_iters, tol);
+    else
+        RunCG(max_iters, tol);
+}
+
+// r' = d A (r / outdeg) + (d * dangling + 1 - d) / n, L1 residual
+void IterativeSpmv::RunPageRank(int max_iters, double tol) {
+    size_t n = matrix_.n_rows;
+    std::vector<double> outdeg(n, 0.0);
+    for (size_t e = 0; e < matrix_.col_indices.size(); e++)
+        outdeg[matrix_.col_indices[e] - 1] += 1.0;
+
+    std::vector<double> r(n, 1.0 / n), x(n), y;
+    for (int k = 0; k < max_iters; k++) {
+        double dangling = 0;
+        for (size_t j = 0; j < n; j++) {
+            if (outdeg[j] > 0) {
+                x[j] = r[j] / outdeg[j];
+            } else {
+                x[j] = 0;
+                dangling += r[j];
+            }
+        }
+        Multiply(x, &y);
+        double base = (damping_ * dangling + 1.0 - damping_) / n;
+        double diff = 0;
+        for (size_t i = 0; i < n; i++) {
+            double next = damping_ * y[i] + base;
+            diff += std::fabs(next - r[i]);
+            r[i] = next;
+        }
+        iterations_.back().residual = diff;
+        if (diff < tol) {
+            converged_ = true;
+            break;
+        }
+    }
+}
+
+// Relative residual |b - A x| / |b|
+void IterativeSpmv::RunJacobi(int max_iters, double tol) {
+    size_t n = matrix_.n_rows;
+    std::vector<double> diag(n, 0.0);
+    for (size_t e = 0; e < matrix_.row_indices.size(); e++) {
+        if (matrix_.row_indices[e] == matrix_.col_indices[e])
+            diag[matrix_.row_indices[e] - 1] += (double)(int16_t)matrix_.values[e];
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (diag[i] == 0) {
+            std::cerr << "Jacobi: zero diagonal in row " << i + 1 << std::endl;
+            AbruptExit(__FILE__, __LINE__);
+        }
+    }
+    std::vector<double> b(n, 0.0);
+    for (size_t e = 0; e < matrix_.row_indices.size(); e++)
+        b[matrix_.row_indices[e] - 1] += (double)(int16_t)matrix_.values[e];
+    double b_norm = 0;
+    for (double v : b)
+        b_norm += v * v;
+    b_norm = std::sqrt(b_norm);
+    if (b_norm == 0)
+        b_norm = 1;
+
+    std::vector<double> x(n, 0.0), y;
+    for (int k = 0; k < max_iters; k++) {
+        Multiply(x, &y);
+        double res = 0;
+        for (size_t i = 0; i < n; i++) {
+            double r = b[i] - y[i];
+            res += r * r;
+            x[i] += r / diag[i];
+        }
+        res = std::sqrt(res) / b_norm;
+        iterations_.back().residual = res;
+        if (res < tol || !std::isfinite(res)) {
+            converged_ = res < tol;
+            break;
+        }
+    }
+}
+
+// Relative residual |r| / |b|, x0 = 0 so r0 = b needs no SpMV
+void IterativeSpmv::RunCG(int max_iters, double tol) {
+    size_t n = matrix_.n_rows;
+    std::vector<double> b(n, 0.0);
+    for (size_t e = 0; e < matrix_.row_indices.size(); e++)
+        b[matrix_.row_indices[e] - 1] += (double)(int16_t)matrix_.values[e];
+    std::vector<double> x(n, 0.0), r = b, p = b, ap;
+    double rr = 0;
+    for (double v : r)
+        rr += v * v;
+    double b_norm = std::sqrt(rr);
+    if (b_norm == 0)
+        b_norm = 1;
+
+    for (int k = 0; k < max_iters; k++) {
+        Multiply(p, &ap);
+        double pap = 0;
+        for (size_t i = 0; i < n; i++)
+            pap += p[i] * ap[i];
+        if (pap == 0) {
+            iterations_.back().residual = std::sqrt(rr) / b_norm;
+            break;
+        }
+        double alpha = rr / pap;
+        double rr_next = 0;
+        for (size_t i = 0; i < n; i++) {
+            x[i] += alpha * p[i];
+            r[i] -= alpha * ap[i];
+            rr_next += r[i] * r[i];
+        }
+        double res = std::sqrt(rr_next) / b_norm;
+        iterations_.back().residual = res;
+        if (res < tol || !std::isfinite(res)) {
+            converged_ = res < tol;
+            break;
+        }
+        double beta = rr_next / rr;
+        rr = rr_next;
+        for (size_t i = 0; i < n; i++)
+            p[i] = r[i] + beta * p[i];
+    }
+}
+
+void IterativeSpmv::PrintStats() {
+    std::cout << "Iterative SpMV (" << solver_ << "): " << iterations_.size()
+              << " iterations, "
+              << (converged_ ? "converged" : "not converged") << std::endl;
+    std::cout << std::setw(6) << "iter" << std::setw(12) << "x words"
+              << std::setw(12) << "Vector" << std::setw(12) << "Execute"
+              << std::setw(12) << "GetResult" << std::setw(12) << "total"
+              << std::setw(14) << "residual" << std::setw(12) << "PIM err"
+              << std::endl;
+    uint64_t sum[4] = {0, 0, 0, 0};
+    for (size_t k = 0; k < iterations_.size(); k++) {
+        const Iteration& it = iterations_[k];
+        uint64_t total = it.vector_cycles + it.execute_cycles + it.result_cycles;
+        std::cout << std::setw(6) << k << std::setw(12) << it.vector_words
+                  << std::setw(12) << it.vector_cycles << std::setw(12)
+                  << it.execute_cycles << std::setw(12) << it.result_cycles
+                  << std::setw(12) << total << std::setw(14)
+                  << std::scientific << std::setprecision(3) << it.residual
+                  << std::setw(12) << it.pim_error << std::defaultfloat
+                  << std::endl;
+        // steady state: the first iteration rewrites every x slot of the
+        // all-ones vector SetData left
+        if (k == 0 && iterations_.size() > 1)
+            continue;
+        sum[0] += it.vector_cycles;
+        sum[1] += it.execute_cycles;
+        sum[2] += it.result_cycles;
+        sum[3] += total;
+    }
+    size_t steady = iterations_.size() > 1 ? iterations_.size() - 1
+                                           : iterations_.size();
+    if (steady == 0)
+        return;
+    // FP16 x and y alone stay around 1e-3
+    double err = MaxPimError();
+    std::cout << "PIM y vs host A x: max error " << std::scientific
+              << std::setprecision(3) << err << std::defaultfloat
+              << (err > 1e-2 ? " (the DRAF val is not the solver's matrix)" : "")
+              << std::endl;
+    std::cout << "Steady state per iteration: " << std::fixed
+              << std::setprecision(1) << (double)sum[3] / steady
+              << " cycles (Vector " << (double)sum[0] / steady << ", Execute "
+              << (double)sum[1] / steady << ", GetResult "
+              << (double)sum[2] / steady << "), vector update "
+              << (sum[3] ? 100.0 * sum[0] / sum[3] : 0.0) << "%"
+              << std::defaultfloat << std::endl;
+}
+
+}  // namespace dramsim3
@@ -0,0 +1,69 @@
+#ifndef __ITERATIVE_SOLVER_H
+#define __ITERATIVE_SOLVER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "./transaction_generator.h"
+
+namespace dramsim3 {
+
+// Iterative solvers on a matrix resident in pmem
+//  SetData writes the matrix once, every iteration is ChangeVector (x slots,
+//  DRAF column 29) + Execute + GetResult (read back y) on the PIM side and
+//  the solver update on the host. The update takes y = A x from the COO
+//  matrix the DRAF was generated from, in double: x goes to the PIM as FP16
+//  and y comes back as FP16, too coarse for the small PageRank ranks.
+//  The y GetResult read back (output_rows_) is compared against the host
+//  product every iteration, the error is relative to max |A x|
+//   pagerank: A(i,j) != 0 is a link j -> i (values ignored),
+//             x_j = r_j / outdeg(j), damping_
+//   jacobi  : x += D^-1 (b - A x), b = A 1
+//   cg      : conjugate gradient, A p per iteration, b = A 1
+//  generate_DRAF writes the nonzero flag to val, which is the PageRank
+//  matrix; jacobi and cg need a DRAF with the values in val, otherwise the
+//  PIM y is the pattern product and the reported error says so
+//  Host time of the reduction and the update is not modelled
+class IterativeSpmv {
+ public:
+    // spmv: Initialize and SetData already done
+    IterativeSpmv(SpmvTransactionGenerator* spmv, const COOMatrix& matrix,
+                  const std::string& solver);
+
+    // Iterates until the residual is below tol or max_iters
+    void Run(int max_iters, double tol);
+    void PrintStats();
+    bool Converged() const { return converged_; }
+    size_t Iterations() const { return iterations_.size(); }
+    double MaxPimError() const;
+
+    double damping_;  // pagerank
+
+ private:
+    struct Iteration {
+        uint64_t vector_cycles;
+        uint64_t execute_cycles;
+        uint64_t result_cycles;
+        uint64_t vector_words;
+        double residual;
+        double pim_error;  // max |y_pim - A x| / max |A x|
+    };
+    // One SpMV y = A x: timed on the PIM, numerics on the host, checked
+    // against the y the PIM returned
+    void Multiply(const std::vector<double>& x, std::vector<double>* y);
+    void RunPageRank(int max_iters, double tol);
+    void RunJacobi(int max_iters, double tol);
+    void RunCG(int max_iters, double tol);
+
+    SpmvTransactionGenerator* spmv_;
+    const COOMatrix& matrix_;
+    std::string solver_;
+    std::vector<Iteration> iterations_;
+    bool converged_;
+};
+
+bool IsIterativeSolver(const std::string& name);
+
+}  // namespace dramsim3
+
+#endif  // __ITERATIVE_SOLVER_H
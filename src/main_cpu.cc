@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 #include "./../ext/headers/args.hxx"
 #include "./transaction_generator.h"
@@ -26,9 +27,25 @@ int main(int argc, const char **argv) {
     args::ValueFlag<std::string> pim_api_arg(
         parser, "pim_api", "PIM API - spmv",
         {"pim-api"}, "add");
-    args::ValueFlag<double> miss_ratio_arg(
-        parser, "miss_ratio", "Miss ratio",
-        {"miss-ratio"}, 1);
+    args::ValueFlag<std::string> matrix_base_arg(
+        parser, "matrix_base", "Matrix base name (e.g., cant, bcsstk32)", {'m', "matrix"}, "cant");
+    args::ValueFlag<std::string> format_arg(
+        parser, "format", "CPU SpMV format - csr, coo",
+        {"format"}, "csr");
+    args::ValueFlag<std::string> cache_arg(
+        parser, "cache", "Cache levels <size>:<ways>:<latency>,... (L1 first)",
+        {"cache"}, "32K:8:4,1M:16:14,32M:16:40");
+    args::ValueFlag<int> line_size_arg(
+        parser, "line_size", "Cache line size (B)", {"line-size"}, 64);
+    args::ValueFlag<int> mshrs_arg(
+        parser, "mshrs", "Outstanding miss lines", {"mshrs"}, 16);
+    args::ValueFlag<int> prefetch_degree_arg(
+        parser, "prefetch_degree", "Stride prefetch degree, 0 disables",
+        {"prefetch-degree"}, 4);
+    args::ValueFlag<int> core_width_arg(
+        parser, "core_width", "Cache accesses per cycle", {"core-width"}, 2);
+    args::ValueFlag<int> window_arg(
+        parser, "window", "x[col] loads waiting for their index", {"window"}, 32);
 
     try {
         parser.ParseCLI(argc, argv);
@@ -54,20 +71,40 @@ int main(int argc, const char **argv) {
     // Initialize modules of PIM-Simulator
     //  Transaction Generator + DRAMsim3 + PIM Functional Simulator
     std::cout << C_GREEN << "Initializing modules..." << C_NORMAL << std::endl;
-    TransactionGenerator * tx_generator;
+    TransactionGenerator * tx_generator = nullptr;
+    std::string mtx_filename = "../sparse_suite/suite/" + args::get(matrix_base_arg) + ".mtx";
 
     // Define operands and Transaction generator for simulating computation
     //TW added
     if(pim_api == "spmv"){
         std::cout << "main_pim.cc: spmv api " << std::endl;
-        uint8_t *A = (uint8_t *) malloc(sizeof(uint16_t)); //Input
-        COOMatrix original_matrix = readMTXFile("../sparse_suite/suite/cant.mtx");
-        //uint8_t *y = (uint8_t *) malloc(sizeof(uint16_t) * N_COLS); //output vector
-        
-        // 밑에는 cpu를 이용하여 연산을 수행할 때의 클럭을 측정하기 위한 코드
-        // 작성하다가 중단
-        tx_generator = new CPUSpmvTransactionGenerator(config_file, output_dir, 
-            original_matrix.n_rows, original_matrix.n_cols, original_matrix.nnz, miss_ratio_arg);
+        std::string format = args::get(format_arg);
+        if (format != "csr" && format != "coo") {
+            std::cerr << "Unknown format " << format << std::endl;
+            return 1;
+        }
+        std::vector<CacheLevelConfig> caches;
+        std::string error;
+        int line_size = args::get(line_size_arg);
+        if (!ParseCacheLevels(args::get(cache_arg), &caches, &error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+        if (line_size < 32 || (line_size & (line_size - 1))) {
+            std::cerr << "--line-size must be a power of two >= 32" << std::endl;
+            return 1;
+        }
+        COOMatrix original_matrix = readMTXFile(mtx_filename);
+
+        CPUSpmvTransactionGenerator *cpu_generator =
+            new CPUSpmvTransactionGenerator(config_file, output_dir,
+                                            original_matrix, format == "csr",
+                                            caches, line_size);
+        cpu_generator->mshrs_ = std::max(1, args::get(mshrs_arg));
+        cpu_generator->prefetch_degree_ = std::max(0, args::get(prefetch_degree_arg));
+        cpu_generator->core_width_ = std::max(1, args::get(core_width_arg));
+        cpu_generator->window_ = std::max(1, args::get(window_arg));
+        tx_generator = cpu_generator;
     }
 
     // JH added
@@ -78,6 +115,11 @@ int main(int argc, const char **argv) {
     }
 
 
+    if (!tx_generator) {
+        std::cerr << "Unknown PIM API " << pim_api << std::endl;
+        return 1;
+    }
+
     std::cout << C_GREEN << "Success Module Initialize" << C_NORMAL << "\n\n";
 
     uint64_t clk;
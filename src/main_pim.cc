@@ -1,7 +1,12 @@
+#include <algorithm>
 #include <iostream>
+#include <cstring>
 #include <random>
 #include "./../ext/headers/args.hxx"
 #include "./transaction_generator.h"
+#include "./multi_stack.h"
+#include "./iterative_solver.h"
+#include "./gnn_pipeline.h"
 #include "half.hpp"
 #include "../sparse_suite/sw_full_stack.h"
 
@@ -27,11 +32,101 @@ int main(int argc, const char **argv) {
     args::Positional<std::string> config_arg(
         parser, "config", "The config file name (mandatory)");
     args::ValueFlag<std::string> pim_api_arg(
-        parser, "pim_api", "PIM API - spmv, nopim_spmv",
+        parser, "pim_api", "PIM API - spmv, nopim_spmv, spmm, gnn, ukernel",
         {"pim-api"}, "add");
     args::ValueFlag<std::string> matrix_base_arg(
         parser, "matrix_base", "Matrix base name (e.g., cant, bcsstk32)", {'m', "matrix"}, "cant");
     args::Flag sw_opt_flag(parser, "sw_opt", "Enable SW_OPT", {'w', "sw-opt"});
+    args::Flag preload_flag(parser, "preload",
+                            "SetData copies the matrix into pmem without timing",
+                            {"preload"});
+    args::Flag preload_count_flag(parser, "preload_count_writes",
+                                  "With --preload, still count the writes in stats",
+                                  {"preload-count-writes"});
+    args::Flag serial_channels_flag(parser, "serial_channels",
+                                    "Issue the channels one after another",
+                                    {"serial-channels"});
+    args::ValueFlag<int> issue_width_arg(
+        parser, "issue_width", "Host requests per channel per cycle (batched)",
+        {"issue-width"}, 1);
+    args::ValueFlag<uint32_t> pipeline_tile_arg(
+        parser, "pipeline_tile",
+        "SpMV: stream the matrix in tiles of N DRAM rows during Execute",
+        {"pipeline-tile"}, 0);
+    args::Flag rebalance_flag(parser, "rebalance",
+                              "SpMV: move DRAF tiles from the longest to the shortest BGs",
+                              {"rebalance"});
+    args::Flag early_exit_flag(parser, "early_exit",
+                               "SpMV: a channel stops after its own last DRAM row",
+                               {"early-exit"});
+    args::Flag gacc_reduction_flag(parser, "gacc_reduction",
+                                   "SpMV: reduce the channels' GRF_A through the global accumulator",
+                                   {"gacc-reduction"});
+    args::ValueFlag<std::string> tile_format_arg(
+        parser, "tile_format",
+        "SpMV: per-tile format - draf, auto (cost model), dense, sparse_row",
+        {"tile-format"}, "draf");
+    args::ValueFlag<std::string> mixed_file_arg(
+        parser, "mixed_file",
+        "SpMV: mixed-format image with tile directory (generate_mixed_format)",
+        {"mixed-file"}, "");
+    args::ValueFlag<uint32_t> dense_width_arg(
+        parser, "dense_width", "SpMM: dense operand width N (output m x N)",
+        {"dense-width"}, DRF_COLS);
+    args::ValueFlag<std::string> dense_file_arg(
+        parser, "dense_file",
+        "SpMM: dense operand, raw FP16 row-major, K <= 16 rows x N columns (default random)",
+        {"dense-file"}, "");
+    args::ValueFlag<int> stacks_arg(
+        parser, "stacks", "SpMV: number of PIM stacks (threads), DRAF tiles split",
+        {"stacks"}, 1);
+    args::ValueFlag<std::string> stack_policy_arg(
+        parser, "stack_policy", "SpMV: tile to stack policy - block, interleave",
+        {"stack-policy"}, "block");
+    args::ValueFlag<double> link_bw_arg(
+        parser, "link_bw", "SpMV: inter-stack link bytes per cycle (reduction)",
+        {"link-bw"}, 32.0);
+    args::ValueFlag<int> link_latency_arg(
+        parser, "link_latency", "SpMV: inter-stack link latency in cycles",
+        {"link-latency"}, 100);
+    args::ValueFlag<std::string> solver_arg(
+        parser, "solver",
+        "SpMV: iterate on the resident matrix - pagerank, jacobi, cg",
+        {"solver"}, "");
+    args::ValueFlag<int> max_iters_arg(
+        parser, "max_iters", "SpMV: iteration limit of --solver",
+        {"max-iters"}, 50);
+    args::ValueFlag<double> tol_arg(
+        parser, "tol", "SpMV: residual --solver stops at",
+        {"tol"}, 1e-6);
+    args::ValueFlag<double> damping_arg(
+        parser, "damping", "SpMV: PageRank damping factor",
+        {"damping"}, 0.85);
+    args::ValueFlag<std::string> gnn_dims_arg(
+        parser, "gnn_dims",
+        "GNN: feature widths of the input and every layer, e.g. 1433,16,7",
+        {"gnn-dims"}, "");
+    args::Flag gnn_host_flag(parser, "gnn_host_combination",
+                             "GNN: dense combination on the host model",
+                             {"gnn-host-combination"});
+    args::Flag gnn_pipeline_flag(parser, "gnn_pipeline",
+                                 "GNN: overlap consecutive inferences on PIM and host",
+                                 {"gnn-pipeline"});
+    args::ValueFlag<double> host_flops_arg(
+        parser, "host_flops", "GNN host model: FLOPs per memory cycle",
+        {"host-flops"}, 64.0);
+    args::ValueFlag<double> host_bw_arg(
+        parser, "host_bw", "GNN host model: bytes per memory cycle",
+        {"host-bw"}, 64.0);
+    args::ValueFlag<std::string> ukernel_arg(
+        parser, "ukernel", "μkernel source for --pim-api ukernel",
+        {"ukernel"}, "");
+    args::ValueFlag<int> ukernel_rows_arg(
+        parser, "ukernel_rows", "Rows (μkernel passes) for --pim-api ukernel",
+        {"ukernel-rows"}, 1);
+    args::ValueFlag<int> loop_count_arg(
+        parser, "loop_count", "LC loaded by LOOP for --pim-api ukernel",
+        {"loop-count"}, 0);
 
     try {
         parser.ParseCLI(argc, argv);
@@ -56,6 +151,9 @@ int main(int argc, const char **argv) {
     std::string matrix_base = args::get(matrix_base_arg);
     bool sw_opt = args::get(sw_opt_flag);
 
+    // one DRAF / sparse partition per (channel, bankgroup) of the config
+    int num_partitions = Config(config_file, output_dir).pim_partitions;
+
     // 생성할 파일 경로 구성
     std::string mtx_filename = "../sparse_suite/suite/" + matrix_base + ".mtx";
     std::string dat_filename = sw_opt 
@@ -68,6 +166,7 @@ int main(int argc, const char **argv) {
     // Initialize modules of PIM-Simulator
     std::cout << C_GREEN << "Initializing modules..." << C_NORMAL << std::endl;
     TransactionGenerator * tx_generator;
+    SpmvTransactionGenerator * iterative_spmv = nullptr;  // --solver
 
     std::random_device random_device;
     auto rng = std::mt19937(random_device());
@@ -75,39 +174,181 @@ int main(int argc, const char **argv) {
 
     if(pim_api == "spmv") {
         std::vector<std::vector<re_aligned_dram_format>> DRAF_BG;
-        DRAF_BG = loadResultFromFile(dat_filename, 64);
+        DRAF_BG = loadResultFromFile(dat_filename, num_partitions);
+        if (DRAF_BG.empty())
+            return 1;
         
         COOMatrixInfo matrix = readMTXFileInformation(mtx_filename);
         int m = matrix.n_rows;
+
+        std::string solver = args::get(solver_arg);
+        if (!solver.empty() && !IsIterativeSolver(solver)) {
+            std::cerr << "Unknown solver " << solver << std::endl;
+            return 1;
+        }
+
+        int stacks = args::get(stacks_arg);
+        if (stacks > 1 && !solver.empty()) {
+            std::cerr << "--solver runs on one stack" << std::endl;
+            return 1;
+        }
+        std::string tile_format = args::get(tile_format_arg);
+        std::string mixed_file = args::get(mixed_file_arg);
+        int format;
+        if (!parseTileFormat(tile_format, &format)) {
+            std::cerr << "Unknown tile format " << tile_format << std::endl;
+            return 1;
+        }
+        bool mixed = (tile_format != "draf" || !mixed_file.empty());
+        if (mixed && (stacks > 1 || !solver.empty())) {
+            std::cerr << "--tile-format / --mixed-file run one stack "
+                      << "without --solver" << std::endl;
+            return 1;
+        }
+        if (stacks > 1) {
+            StackPolicy policy;
+            if (!GetStackPolicy(args::get(stack_policy_arg), &policy)) {
+                std::cerr << "Unknown stack policy " << args::get(stack_policy_arg)
+                          << std::endl;
+                return 1;
+            }
+            MultiStackSpmv multi_stack(config_file, output_dir, DRAF_BG, m,
+                                       stacks, policy);
+            multi_stack.link_bytes_per_cycle_ = args::get(link_bw_arg);
+            multi_stack.link_latency_ = args::get(link_latency_arg);
+            for (int k = 0; k < stacks; k++) {
+                SpmvTransactionGenerator *stack = multi_stack.Stack(k);
+                stack->pipeline_tile_rows_ = args::get(pipeline_tile_arg);
+                stack->rebalance_ = args::get(rebalance_flag);
+                stack->early_exit_ = args::get(early_exit_flag);
+                stack->gacc_reduction_ = args::get(gacc_reduction_flag);
+                stack->preload_ = args::get(preload_flag);
+                stack->preload_count_writes_ = args::get(preload_count_flag);
+                stack->interleave_channels_ = !args::get(serial_channels_flag);
+                stack->issue_width_ = std::max(1, args::get(issue_width_arg));
+            }
+            std::cout << C_GREEN << "Running " << stacks << " stacks..."
+                      << C_NORMAL << std::endl;
+            multi_stack.Run();
+            multi_stack.PrintStats();
+            return 0;
+        }
         uint8_t *output_vector = (uint8_t *) malloc(sizeof(uint16_t) * m);
 
-        tx_generator = new SpmvTransactionGenerator(config_file, output_dir,
-                                                    DRAF_BG, output_vector);
+        SpmvTransactionGenerator *spmv_generator =
+            new SpmvTransactionGenerator(config_file, output_dir, std::move(DRAF_BG),
+                                         output_vector);
+        spmv_generator->output_rows_ = m;
+        spmv_generator->pipeline_tile_rows_ = args::get(pipeline_tile_arg);
+        spmv_generator->rebalance_ = args::get(rebalance_flag);
+        spmv_generator->early_exit_ = args::get(early_exit_flag);
+        spmv_generator->gacc_reduction_ = args::get(gacc_reduction_flag);
+        spmv_generator->tile_format_ = tile_format;
+        if (!mixed_file.empty()) {
+            spmv_generator->mixed_ = loadMixedFromFile(mixed_file);
+            if (spmv_generator->mixed_.directory.empty())
+                return 1;
+        }
+        tx_generator = spmv_generator;
+        if (!solver.empty())
+            iterative_spmv = spmv_generator;
     }
     else if(pim_api == "nopim_spmv") {
-        std::vector<std::vector<re_aligned_dram_format>> DRAF_BG = loadResultFromFile(dat_filename, 64);
+        std::vector<std::vector<re_aligned_dram_format>> DRAF_BG =
+            loadResultFromFile(dat_filename, num_partitions);
+        if (DRAF_BG.empty())
+            return 1;
         
         COOMatrixInfo matrix = readMTXFileInformation(mtx_filename);
         int m = matrix.n_rows;
         uint8_t *output_vector = (uint8_t *) malloc(sizeof(uint16_t) * m);
 
         tx_generator = new NoPIMSpmvTransactionGenerator(config_file, output_dir,
-                                                    DRAF_BG, output_vector);
+                                                    std::move(DRAF_BG), output_vector);
     }
     else if (pim_api == "spmm") { // JH added
-        std::vector<std::vector<sparse_row_format>> BG_tile_bk0;
-        std::vector<std::vector<sparse_row_format>> BG_tile_bk2;
-        BG_tile_bk0 = loadSparseFromFile(b0_filename, 64);
-        BG_tile_bk2 = loadSparseFromFile(b2_filename, 64);
+        // read only: spans into the mapped .dat files, no copy
+        sparse_row_partitions BG_tile_bk0 = mapSparseFromFile(b0_filename);
+        sparse_row_partitions BG_tile_bk2 = mapSparseFromFile(b2_filename);
 
         COOMatrixInfo matrix = readMTXFileInformation(mtx_filename);
         int m = matrix.n_rows;
-        // output demension m x 128
-        uint16_t *output_matrix = (uint16_t *) malloc(sizeof(uint16_t) * m * 128);
+        uint32_t n = args::get(dense_width_arg);
+        if (n == 0) {
+            std::cerr << "--dense-width must be positive" << std::endl;
+            return 1;
+        }
+        // output demension m x N
+        uint16_t *output_matrix = (uint16_t *) malloc(sizeof(uint16_t) * m * n);
+
+        // dense operand: 파일이 없으면 DRF에 올라가는 DRF_ROWS개 row만 random 생성
+        std::vector<uint16_t> dense_matrix;
+        std::string dense_file = args::get(dense_file_arg);
+        if (!dense_file.empty()) {
+            dense_matrix = loadDenseFromFile(dense_file, n);
+            if (dense_matrix.empty())
+                return 1;
+            // MUL_DRF의 DRF row = column index % DRF_ROWS, K는 tiling 안 함
+            if (dense_matrix.size() / n > DRF_ROWS || matrix.n_cols > DRF_ROWS) {
+                std::cerr << "--dense-file: SpMM supports K <= " << DRF_ROWS
+                          << " (matrix has " << matrix.n_cols << " columns, dense file "
+                          << dense_matrix.size() / n << " rows)" << std::endl;
+                return 1;
+            }
+        } else {
+            dense_matrix.resize((size_t)DRF_ROWS * n);
+            for (auto& v : dense_matrix) {
+                half h(f32rng());
+                memcpy(&v, &h, sizeof(uint16_t));
+            }
+        }
 
-        tx_generator = new SpmmTransactionGenerator(config_file, output_dir,
-                                                    BG_tile_bk0, BG_tile_bk2, output_matrix);
+        SpmmTransactionGenerator *spmm_generator =
+            new SpmmTransactionGenerator(config_file, output_dir,
+                                         BG_tile_bk0, BG_tile_bk2, output_matrix);
+        spmm_generator->dense_width_ = n;
+        spmm_generator->dense_matrix_.swap(dense_matrix);
+        tx_generator = spmm_generator;
     }
+    else if (pim_api == "gnn") {
+        std::vector<uint32_t> dims;
+        if (!ParseGnnDims(args::get(gnn_dims_arg), &dims)) {
+            std::cerr << "--gnn-dims needs at least two positive widths"
+                      << std::endl;
+            return 1;
+        }
+        sparse_row_partitions BG_tile_bk0 = mapSparseFromFile(b0_filename);
+        sparse_row_partitions BG_tile_bk2 = mapSparseFromFile(b2_filename);
+        COOMatrixInfo matrix = readMTXFileInformation(mtx_filename);
+
+        GnnPipeline gnn(config_file, output_dir, BG_tile_bk0, BG_tile_bk2,
+                        matrix.n_rows, dims);
+        gnn.pim_combination_ = !args::get(gnn_host_flag);
+        gnn.pipeline_ = args::get(gnn_pipeline_flag);
+        gnn.host_flops_per_cycle_ = args::get(host_flops_arg);
+        gnn.host_bytes_per_cycle_ = args::get(host_bw_arg);
+        gnn.preload_ = args::get(preload_flag);
+        gnn.interleave_channels_ = !args::get(serial_channels_flag);
+        gnn.issue_width_ = std::max(1, args::get(issue_width_arg));
+        std::cout << C_GREEN << "Running GNN layers..." << C_NORMAL << std::endl;
+        gnn.Run();
+        gnn.PrintStats();
+        return 0;
+    }
+    else if (pim_api == "ukernel") {
+        tx_generator = new UKernelTransactionGenerator(
+            config_file, output_dir, args::get(ukernel_arg),
+            args::get(ukernel_rows_arg), args::get(loop_count_arg));
+    }
+    else {
+        std::cerr << "Unknown PIM API " << pim_api << std::endl;
+        return 1;
+    }
+
+    tx_generator->preload_ = args::get(preload_flag);
+    tx_generator->preload_count_writes_ = args::get(preload_count_flag);
+    tx_generator->interleave_channels_ = !args::get(serial_channels_flag);
+    tx_generator->issue_width_ = std::max(1, args::get(issue_width_arg));
 
     std::cout << C_GREEN << "Success Module Initialize" << C_NORMAL << "\n\n";
 
@@ -124,6 +365,20 @@ int main(int argc, const char **argv) {
     clk = tx_generator->GetClk() - clk;
     std::cout << C_GREEN << "Success SetData (" << clk << " cycles)" << C_NORMAL << "\n\n";
 
+    // Iterative solver: the matrix stays in pmem, every iteration rewrites
+    // the x slots and runs Execute + GetResult
+    if (iterative_spmv) {
+        COOMatrix matrix = readMTXFile(mtx_filename);
+        IterativeSpmv solver(iterative_spmv, matrix, args::get(solver_arg));
+        solver.damping_ = args::get(damping_arg);
+        std::cout << C_GREEN << "Iterating..." << C_NORMAL << "\n";
+        solver.Run(args::get(max_iters_arg), args::get(tol_arg));
+        solver.PrintStats();
+        tx_generator->PrintStats();
+        delete tx_generator;
+        return 0;
+    }
+
     std::cout << C_GREEN << "Executing..." << C_NORMAL << "\n";
     tx_generator->is_print_ = true;
     clk = tx_generator->GetClk();
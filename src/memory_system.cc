@@ -48,8 +48,14 @@ bool MemorySystem::AddTransaction(uint64_t hex_addr, bool is_write, uint8_t *Dat
 
 void MemorySystem::PrintStats() const { dram_system_->PrintStats(); }
 
+void MemorySystem::AddStats(const std::string& key, const nlohmann::json& value) {
+    dram_system_->AddStats(key, value);
+}
+
 void MemorySystem::ResetStats() { dram_system_->ResetStats(); }
 
+double MemorySystem::TotalEnergy() { return dram_system_->TotalEnergy(); }
+
 MemorySystem* GetMemorySystem(const std::string &config_file, const std::string &output_dir,
                  std::function<void(uint64_t, uint8_t*)> read_callback,
                  std::function<void(uint64_t)> write_callback) {
@@ -71,6 +77,10 @@ void MemorySystem::SetWriteBufferThreshold(int threshold) {
     dram_system_->SetWriteBufferThreshold(threshold);
 }
 
+void MemorySystem::CountPreloadWrite(uint64_t hex_addr, bool activate) {
+    dram_system_->CountPreloadWrite(hex_addr, activate);
+}
+
 //TW added
 //TO print value how many accumulated
 void MemorySystem::PrintAccumulateCount() {
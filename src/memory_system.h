@@ -25,7 +25,9 @@ class MemorySystem {
     int GetBurstLength() const;
     int GetQueueSize() const;
     void PrintStats() const;
+    void AddStats(const std::string& key, const nlohmann::json& value);
     void ResetStats();
+    double TotalEnergy();  // pJ so far
 
     bool WillAcceptTransaction(uint64_t hex_addr, bool is_write) const;
     bool AddTransaction(uint64_t hex_addr, bool is_write, uint8_t *DataPtr);
@@ -34,6 +36,8 @@ class MemorySystem {
     // For barrier
     bool IsPendingTransaction();
     void SetWriteBufferThreshold(int threshold);
+    // Charge an untimed (preloaded) write to the DRAM statistics
+    void CountPreloadWrite(uint64_t hex_addr, bool activate);
 
     //TW added
     //TO print value how many accumulated
@@ -0,0 +1,226 @@
+#include "multi_stack.h"
+
+#include <sys/stat.h>
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+using half_float::half;
+
+namespace dramsim3 {
+
+bool GetStackPolicy(const std::string& name, StackPolicy* policy) {
+    if (name == "block") {
+        *policy = [](size_t partition, size_t tiles, int stacks) {
+            std::vector<int> stack(tiles);
+            for (size_t t = 0; t < tiles; t++)
+                stack[t] = (int)(t * stacks / tiles);
+            return stack;
+        };
+    } else if (name == "interleave") {
+        *policy = [](size_t partition, size_t tiles, int stacks) {
+            std::vector<int> stack(tiles);
+            for (size_t t = 0; t < tiles; t++)
+                stack[t] = (int)((t + partition) % stacks);
+            return stack;
+        };
+    } else {
+        return false;
+    }
+    return true;
+}
+
+MultiStackSpmv::MultiStackSpmv(
+    const std::string& config_file, const std::string& output_dir,
+    const std::vector<std::vector<re_aligned_dram_format>>& DRAF_BG,
+    uint64_t n_rows, int stacks, StackPolicy policy)
+    : link_bytes_per_cycle_(32.0),
+      link_latency_(100),
+      parallel_(true),
+      config_(config_file, output_dir),
+      shared_rows_(0),
+      reduction_bytes_(0),
+      reduction_cycles_(0) {
+    size_t tile_rows = config_.banks_per_group;
+    std::vector<std::vector<std::vector<re_aligned_dram_format>>> parts(
+        stacks, std::vector<std::vector<re_aligned_dram_format>>(DRAF_BG.size()));
+    tiles_.assign(stacks, 0);
+    nnz_.assign(stacks, 0);
+    rows_.resize(stacks);
+
+    for (size_t p = 0; p < DRAF_BG.size(); p++) {
+        size_t tiles = (DRAF_BG[p].size() + tile_rows - 1) / tile_rows;
+        std::vector<int> stack = policy(p, tiles, stacks);
+        if (stack.size() != tiles) {
+            std::cerr << "Stack policy returned " << stack.size()
+                      << " stacks for " << tiles << " tiles" << std::endl;
+            AbruptExit(__FILE__, __LINE__);
+        }
+        for (size_t t = 0; t < tiles; t++) {
+            int k = stack[t];
+            if (k < 0 || k >= stacks) {
+                std::cerr << "Stack policy: stack " << k << " of " << stacks
+                          << std::endl;
+                AbruptExit(__FILE__, __LINE__);
+            }
+            tiles_[k]++;
+            size_t end = std::min(DRAF_BG[p].size(), (t + 1) * tile_rows);
+            for (size_t j = t * tile_rows; j < end; j++) {
+                const re_aligned_dram_format& row = DRAF_BG[p][j];
+                parts[k][p].push_back(row);
+                for (size_t e = 0; e < GROUP_SIZE * PARTITION_SIZE; e++) {
+                    if (row.row[e] == 0)  // 1-based, 0: empty slot
+                        continue;
+                    nnz_[k]++;
+                    rows_[k].push_back(row.row[e]);
+                }
+            }
+        }
+    }
+
+    for (int k = 0; k < stacks; k++) {
+        std::sort(rows_[k].begin(), rows_[k].end());
+        rows_[k].erase(std::unique(rows_[k].begin(), rows_[k].end()),
+                       rows_[k].end());
+        // stats of every stack in its own directory
+        std::string dir = output_dir + "/stack" + std::to_string(k);
+        mkdir(dir.c_str(), 0755);
+        outputs_.push_back((uint8_t *) malloc(sizeof(uint16_t) * n_rows));
+        stacks_.push_back(new SpmvTransactionGenerator(config_file, dir,
+                                                       std::move(parts[k]),
+                                                       outputs_.back()));
+        stacks_.back()->output_rows_ = n_rows;
+    }
+    y_.assign(n_rows, 0);
+    setdata_cycles_.assign(stacks, 0);
+    execute_cycles_.assign(stacks, 0);
+    result_cycles_.assign(stacks, 0);
+}
+
+MultiStackSpmv::~MultiStackSpmv() {
+    for (size_t k = 0; k < stacks_.size(); k++) {
+        delete stacks_[k];
+        free(outputs_[k]);
+    }
+}
+
+void MultiStackSpmv::RunStack(int k) {
+    SpmvTransactionGenerator* g = stacks_[k];
+    g->Initialize();
+    uint64_t clk = g->GetClk();
+    g->SetData();
+    setdata_cycles_[k] = g->GetClk() - clk;
+    clk = g->GetClk();
+    g->start_clk_ = clk;
+    g->Execute();
+    execute_cycles_[k] = g->GetClk() - clk;
+    clk = g->GetClk();
+    g->GetResult();
+    result_cycles_[k] = g->GetClk() - clk;
+}
+
+void MultiStackSpmv::Run() {
+    if (parallel_) {
+        std::vector<std::thread> threads;
+        for (int k = 0; k < Stacks(); k++)
+            threads.push_back(std::thread(&MultiStackSpmv::RunStack, this, k));
+        for (auto& t : threads)
+            t.join();
+    } else {
+        for (int k = 0; k < Stacks(); k++)
+            RunStack(k);
+    }
+    Reduce();
+}
+
+void MultiStackSpmv::Reduce() {
+    // owner: lowest stack with a partial of the row
+    std::unordered_map<uint32_t, int> owner;
+    for (int k = 0; k < Stacks(); k++) {
+        for (uint32_t r : rows_[k])
+            owner.emplace(r, k);
+    }
+    const uint64_t partial_bytes = sizeof(uint32_t) + UNIT_SIZE;
+    std::vector<uint64_t> sent(Stacks(), 0), received(Stacks(), 0);
+    std::unordered_set<uint32_t> shared;
+    for (int k = 0; k < Stacks(); k++) {
+        const uint16_t* partial = reinterpret_cast<const uint16_t*>(outputs_[k]);
+        for (uint32_t r : rows_[k]) {
+            int o = owner[r];
+            if (o == k)
+                continue;
+            sent[k] += partial_bytes;
+            received[o] += partial_bytes;
+            shared.insert(r);
+            // the owner's adder, in FP16
+            uint16_t* sum = reinterpret_cast<uint16_t*>(outputs_[o]) + r - 1;
+            half h = *reinterpret_cast<half*>(sum) +
+                     *reinterpret_cast<const half*>(&partial[r - 1]);
+            *sum = *reinterpret_cast<uint16_t*>(&h);
+        }
+    }
+    std::fill(y_.begin(), y_.end(), 0);
+    for (const auto& o : owner) {
+        if (o.first <= y_.size())
+            y_[o.first - 1] = reinterpret_cast<const uint16_t*>(outputs_[o.second])[o.first - 1];
+    }
+    shared_rows_ = shared.size();
+    reduction_bytes_ = 0;
+    uint64_t busiest = 0;
+    for (int k = 0; k < Stacks(); k++) {
+        reduction_bytes_ += sent[k];
+        busiest = std::max(busiest, std::max(sent[k], received[k]));
+    }
+    reduction_cycles_ = 0;
+    if (busiest > 0)
+        reduction_cycles_ = link_latency_ +
+            (uint64_t)((double)busiest / link_bytes_per_cycle_ + 0.999999);
+}
+
+void MultiStackSpmv::PrintStats() {
+    uint64_t max_execute = 0, max_total = 0, nnz = 0;
+    for (int k = 0; k < Stacks(); k++) {
+        max_execute = std::max(max_execute, execute_cycles_[k]);
+        max_total = std::max(max_total, setdata_cycles_[k] +
+                                        execute_cycles_[k] + result_cycles_[k]);
+        nnz += nnz_[k];
+    }
+    uint64_t makespan = max_execute + reduction_cycles_;
+
+    std::cout << "Multi-stack SpMV: " << Stacks() << " stacks, "
+              << config_.channels << " channels each" << std::endl;
+    std::cout << std::setw(6) << "stack" << std::setw(10) << "tiles"
+              << std::setw(12) << "nnz" << std::setw(12) << "SetData"
+              << std::setw(12) << "Execute" << std::setw(12) << "GetResult"
+              << std::setw(8) << "util" << std::endl;
+    for (int k = 0; k < Stacks(); k++) {
+        double util = max_execute ? (double)execute_cycles_[k] / max_execute : 0;
+        std::cout << std::setw(6) << k << std::setw(10) << tiles_[k]
+                  << std::setw(12) << nnz_[k] << std::setw(12)
+                  << setdata_cycles_[k] << std::setw(12) << execute_cycles_[k]
+                  << std::setw(12) << result_cycles_[k] << std::setw(7)
+                  << std::fixed << std::setprecision(1) << util * 100 << "%"
+                  << std::endl;
+    }
+    std::cout << "Reduction: " << shared_rows_ << " shared rows, "
+              << reduction_bytes_ << " B over the links, " << reduction_cycles_
+              << " cycles" << std::endl;
+    std::cout << "Execute + reduction: " << makespan << " cycles ("
+              << "SetData + Execute + GetResult max " << max_total << ")"
+              << std::endl;
+    if (makespan > 0) {
+        double nnz_per_cycle = (double)nnz / makespan;
+        std::cout << "Aggregate throughput: " << std::setprecision(3)
+                  << nnz_per_cycle << " nnz/cycle, "
+                  << nnz_per_cycle / config_.tCK << " GNZ/s" << std::endl;
+    }
+
+    for (auto g : stacks_)
+        g->PrintStats();
+}
+
+}  // namespace dramsim3
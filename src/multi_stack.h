@@ -0,0 +1,68 @@
+#ifndef __MULTI_STACK_H
+#define __MULTI_STACK_H
+
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <vector>
+#include "./transaction_generator.h"
+
+namespace dramsim3 {
+
+// Stack of every tile of one partition (DRAF_BG[partition])
+//  A tile is the banks_per_group DRAF rows of one DRAM row of the bankgroup,
+//  the unit a stack receives. Returns `tiles` stack indices in [0, stacks)
+typedef std::function<std::vector<int>(size_t partition, size_t tiles,
+                                       int stacks)> StackPolicy;
+
+// "block"     : contiguous tile ranges, neighbouring rows stay on one stack
+// "interleave": tile t of partition p on stack (t + p) % stacks
+bool GetStackPolicy(const std::string& name, StackPolicy* policy);
+
+// SpMV on several PIM stacks
+//  Every stack is a SpmvTransactionGenerator with its own MemorySystem,
+//  PimFuncSim and pmem, the DRAF tiles are split by a StackPolicy. The stacks
+//  run Initialize ~ GetResult in parallel threads, then the partial outputs
+//  of rows touched by more than one stack are reduced over the inter-stack
+//  links: every partial (4B row index + 2B value) goes to the lowest stack
+//  that holds the row, a stack sends and receives at link_bytes_per_cycle_
+//  (full duplex) after link_latency_. The owner adds the partials to its
+//  output (FP16), Output() is y of every row
+class MultiStackSpmv {
+ public:
+    MultiStackSpmv(const std::string& config_file, const std::string& output_dir,
+                   const std::vector<std::vector<re_aligned_dram_format>>& DRAF_BG,
+                   uint64_t n_rows, int stacks, StackPolicy policy);
+    ~MultiStackSpmv();
+
+    int Stacks() const { return (int)stacks_.size(); }
+    // Per-stack options (preload_, pipeline_tile_rows_, ...) are set here
+    SpmvTransactionGenerator* Stack(int k) { return stacks_[k]; }
+    void Run();
+    void PrintStats();
+    // y (FP16) of rows 1 ~ n_rows after Run
+    const std::vector<uint16_t>& Output() const { return y_; }
+
+    double link_bytes_per_cycle_;
+    int link_latency_;
+    bool parallel_;  // false: the stacks run one after another (same cycles)
+
+ private:
+    void RunStack(int k);
+    void Reduce();
+
+    Config config_;
+    std::vector<SpmvTransactionGenerator*> stacks_;
+    std::vector<uint8_t*> outputs_;
+    std::vector<uint16_t> y_;
+    std::vector<std::vector<uint32_t>> rows_;  // output rows of each stack
+    std::vector<uint64_t> tiles_, nnz_;
+    std::vector<uint64_t> setdata_cycles_, execute_cycles_, result_cycles_;
+    uint64_t shared_rows_;    // rows with partials on more than one stack
+    uint64_t reduction_bytes_;
+    uint64_t reduction_cycles_;
+};
+
+}  // namespace dramsim3
+
+#endif  // __MULTI_STACK_H
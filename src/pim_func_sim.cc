@@ -1,5 +1,6 @@
 #include "./pim_func_sim.h"
 #include <assert.h>
+#include <algorithm>
 #include <iostream>
 
 namespace dramsim3 {
@@ -9,22 +10,66 @@ PimFuncSim::PimFuncSim(Config &config)
     // Set pim_unit's id by its order of pim_unit (= pim_index)
     //하기에 2개 Bank 당 
     // 수정 필요
-    for (int i=0; i< config_.channels * config_.banks / 2; i++) {
+    for (int i=0; i< config_.channels * config_.pim_units; i++) {
         pim_unit_.push_back(new PimUnit(config_, i));
     }
     //TW added to initialize shared_acc_ and global_acc_
-    for (int i=0; i< config_.channels * config_.banks / 4; i++) {
-        PimUnit& pim1 = *pim_unit_[i * 2];      // PimUnit을 참조
-        PimUnit& pim2 = *pim_unit_[i * 2 + 1];  // 
+    //  pim_units_per_sacc(=2)개의 PimUnit 당 하나 (ValidatePim)
+    int units_per_sacc = config_.pim_units_per_sacc;
+    for (int i=0; i< config_.channels * config_.pim_units / units_per_sacc; i++) {
+        PimUnit& pim1 = *pim_unit_[i * units_per_sacc];      // PimUnit을 참조
+        PimUnit& pim2 = *pim_unit_[i * units_per_sacc + 1];  // 
         shared_acc_.push_back(new SharedAccumulator(config_, i, pim1, pim2));
     }
-    //우선 global accumulator는 하나만 선언
     //channel에서 input을 받아서 넘겨주는 방식
-    //vecotr형으로 선언 되어 있기 때문에, 여러개의 global accumulator를 선언할 수 있음
-    // i도 넣어서, id를 표시해 줘야 됨
-    global_acc_.push_back(new GlobalAccumulator(config_));
+    //  gacc_count 개의 global accumulator가 channel group을 나눠 받고
+    //  gacc_hierarchical이면 그 출력을 combiner(마지막 global_acc_)가 다시 합침
+    int gacc_count = config_.gacc_count;
+    gacc_of_channel_.resize(config_.channels);
+    gacc_leaf_of_channel_.resize(config_.channels);
+    std::vector<int> num_inputs(gacc_count, 0);
+    // block: 연속된 channel 구간, 크기 차이는 최대 1 (빈 accumulator 없음)
+    for (int ch = 0; ch < config_.channels; ch++) {
+        int acc = (config_.gacc_mapping == "interleave") ? ch % gacc_count
+                                                          : ch * gacc_count / config_.channels;
+        gacc_of_channel_[ch] = acc;
+        gacc_leaf_of_channel_[ch] = num_inputs[acc]++;
+    }
+    for (int i = 0; i < gacc_count; i++)
+        global_acc_.push_back(new GlobalAccumulator(config_, i, num_inputs[i], 0));
+    if (gacc_count > 1 && config_.gacc_hierarchical) {
+        GlobalAccumulator* combiner =
+            new GlobalAccumulator(config_, gacc_count, gacc_count, 1);
+        for (int i = 0; i < gacc_count; i++)
+            global_acc_[i]->SetParent(combiner, i);
+        global_acc_.push_back(combiner);
+    }
 
     accumulation_count = 0;
+    num_mad_ops.resize(config_.channels, 0);
+    num_relu_ops.resize(config_.channels, 0);
+    saved_transactions.resize(config_.channels, 0);
+    sacc_stall_cycles.resize(config_.channels, 0);
+    sacc_compare_cycles.resize(config_.channels, 0);
+    pending_stall_.resize(config_.channels, 0);
+    gacc_inflight_.resize(config_.channels);
+    gacc_reserved_.resize(config_.channels, 0);
+    gacc_stall_cycles.resize(config_.channels, 0);
+    op_counts_taken_.resize(config_.channels,
+                            std::vector<uint64_t>(kOpCountNames.size(), 0));
+
+    profiler_ = nullptr;
+    if (config_.pim_profile) {
+        profiler_ = new PimProfiler(config_);
+        for (auto unit : pim_unit_)
+            unit->profiler_ = profiler_;
+    }
+}
+
+PimMode PimFuncSim::CurrentMode(int channel) const {
+    if (PIM_OP_MODE[channel])
+        return PimMode::PIM;
+    return bankmode[channel] == "AB" ? PimMode::AB : PimMode::SB;
 }
 
 void PimFuncSim::init(uint8_t* pmemAddr_, uint64_t pmemAddr_size_,
@@ -43,13 +88,14 @@ void PimFuncSim::init(uint8_t* pmemAddr_, uint64_t pmemAddr_size_,
             << config_.channels << " channels\n";
     std::cout << "PimFuncSim initialized!\n";
 
-    for (int i=0; i< config_.channels * config_.banks / 2; i++) {
+    for (int i=0; i< config_.channels * config_.pim_units; i++) {
         pim_unit_[i]->init(pmemAddr, pmemAddr_size, burstSize);
-        if(i%2 == 0) {
-            shared_acc_[i/2]->init(pmemAddr, pmemAddr_size, burstSize);
+        if(i % config_.pim_units_per_sacc == 0) {
+            shared_acc_[i / config_.pim_units_per_sacc]->init(pmemAddr, pmemAddr_size, burstSize);
         }
     }
-    global_acc_[0]->init(pmemAddr, pmemAddr_size, burstSize); 
+    for (auto gacc : global_acc_)
+        gacc->init(pmemAddr, pmemAddr_size, burstSize);
     std::cout << "pim_units initialized!\n";
 }
 
@@ -69,7 +115,7 @@ uint64_t PimFuncSim::ReverseAddressMapping(Address& addr) {
 uint64_t PimFuncSim::GetPimIndex(Address& addr) {
     return (addr.channel * config_.banks +
             addr.bankgroup * config_.banks_per_group +
-            addr.bank) / 2;
+            addr.bank) / config_.pim_banks_per_unit;
 }
 
 // Return to print out debugging information or not
@@ -78,7 +124,7 @@ bool PimFuncSim::DebugMode(uint64_t hex_addr) {
     #ifdef debug_mode
     Address addr = config_.AddressMapping(hex_addr);
     int pim_index = GetPimIndex(addr);
-    if (pim_index == watch_pimindex / (config_.banks / 2)) return true;
+    if (pim_index == watch_pimindex / config_.pim_units) return true;
 
     #endif
     return false;
@@ -89,6 +135,14 @@ bool PimFuncSim::DebugMode(uint64_t hex_addr) {
 //얘는 그냥 사용해도 됨
 bool PimFuncSim::ModeChanger(uint64_t hex_addr) {
     Address addr = config_.AddressMapping(hex_addr);
+    if (profiler_ && addr.row >= 0x3ffd && addr.row <= 0x3fff) {
+        PimMode to = addr.row == 0x3fff ? PimMode::SB
+                   : addr.row == 0x3ffe ? PimMode::AB : PimMode::PIM;
+        // SBMR leaves PIM_OP_MODE set, the channel stays in PIM mode
+        if (to == PimMode::SB && PIM_OP_MODE[addr.channel])
+            to = PimMode::PIM;
+        profiler_->RecordModeSwitch(addr.channel, CurrentMode(addr.channel), to);
+    }
     if (addr.row == 0x3fff) { // MAP_SBMR = 0x3fff
         if (bankmode[addr.channel] == "AB") {
             bankmode[addr.channel] = "SB";
@@ -115,9 +169,18 @@ bool PimFuncSim::ModeChanger(uint64_t hex_addr) {
     return false;
 }
 
+void PimFuncSim::CheckPmemBounds(uint64_t hex_addr) const {
+    if (hex_addr > pmemAddr_size || burstSize > pmemAddr_size - hex_addr) {
+        std::cerr << "PimFuncSim: 0x" << std::hex << hex_addr << std::dec
+                  << " is out of pmem (" << pmemAddr_size << " B)" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+}
+
 // Write DataPtr data to physical memory address of hex_addr
 // 기존 DRAMsim3는 데이터를 저장할 수 없어서 PIMFuncSim에서 데이터를 저장하도록 수정
 void PimFuncSim::PmemWrite(uint64_t hex_addr, uint8_t* DataPtr) {
+    CheckPmemBounds(hex_addr);
     uint8_t *host_addr = pmemAddr + hex_addr;
     memcpy(host_addr, DataPtr, burstSize);
 }
@@ -125,10 +188,197 @@ void PimFuncSim::PmemWrite(uint64_t hex_addr, uint8_t* DataPtr) {
 // Read data from physical memory address of hex_addr to DataPtr
 // 기존 DRAMsim3는 데이터를 저장할 수 없어서 PIMFuncSim에서 데이터를 저장하도록 수정
 void PimFuncSim::PmemRead(uint64_t hex_addr, uint8_t* DataPtr) {
+    CheckPmemBounds(hex_addr);
     uint8_t *host_addr = pmemAddr + hex_addr;
     memcpy(DataPtr, host_addr, burstSize);
 }
 
+// Count fused ALU work of one PIM trigger
+//  mad_ops / relu_ops are what the trigger's first unit executed (0 or 1 each).
+//  Without MAD the bias needs its own ADD trigger, and without the ReLU flag
+//  the activation needs another pass over the same GRF, so each fused stage
+//  saves one host transaction per channel
+void PimFuncSim::CountFusedOps(int channel, uint64_t mad_ops, uint64_t relu_ops) {
+    num_mad_ops[channel] += mad_ops;
+    num_relu_ops[channel] += relu_ops;
+    saved_transactions[channel] += mad_ops + relu_ops;
+}
+
+// Number of non-zero indices one SACC load brings into a queue
+//  (bank_temp_ of one SACC, 8 indices)
+static int CountIndices(const uint32_t* indices) {
+    int cnt = 0;
+    for (int i = 0; i < 8; i++)
+        if (indices[i] != 0)
+            cnt++;
+    return cnt;
+}
+
+uint64_t PimFuncSim::TakeStallCycles(int channel) {
+    uint64_t stall = pending_stall_[channel];
+    pending_stall_[channel] = 0;
+    return stall;
+}
+
+void PimFuncSim::IssueGacc(const Address& addr, uint64_t hex_addr, bool is_write) {
+    GaccInput input;
+    input.hex_addr = hex_addr;
+    input.arrived = false;
+    if (is_write) {
+        Pair eos = {0, 0, true};
+        input.pairs.push_back(eos);
+    } else {
+        // GRF_A register (column % 8) of the addressed unit, zeros are skipped
+        Address unit_addr = addr;
+        PimUnit* unit = pim_unit_[GetPimIndex(unit_addr)];
+        int reg = addr.column % 8;
+        for (int lane = 0; lane < UNITS_PER_WORD; lane++) {
+            unit_t data = unit->GRF_A_[reg * UNITS_PER_WORD + lane];
+            if (data != 0) {
+                Pair p = {(uint32_t)(addr.column * UNITS_PER_WORD + lane), data, false};
+                input.pairs.push_back(p);
+            }
+        }
+    }
+    gacc_reserved_[addr.channel] += input.pairs.size();
+    gacc_inflight_[addr.channel].push_back(input);
+}
+
+void PimFuncSim::ReturnTransaction(uint64_t hex_addr, bool is_write) {
+    Address addr = config_.AddressMapping(hex_addr);
+    if (addr.row != 0x3ff9)
+        return;
+    std::deque<GaccInput>& inflight = gacc_inflight_[addr.channel];
+    for (auto& input : inflight) {
+        if (!input.arrived && input.hex_addr == hex_addr) {
+            input.arrived = true;
+            break;
+        }
+    }
+    // 발행 순서대로 leaf queue에 넣어야 index 정렬이 유지됨
+    while (!inflight.empty() && inflight.front().arrived) {
+        GlobalAccumulator* gacc = global_acc_[gacc_of_channel_[addr.channel]];
+        for (const auto& p : inflight.front().pairs)
+            gacc->AddDataToPairQueue1(gacc_leaf_of_channel_[addr.channel], p);
+        gacc_reserved_[addr.channel] -= inflight.front().pairs.size();
+        inflight.pop_front();
+    }
+}
+
+// Advance the GACC pipeline and hold channels whose leaf queue cannot take
+// another burst
+void PimFuncSim::ClockTick() {
+    // combiner first, so a forwarded element waits one cycle per tree
+    for (int i = (int)global_acc_.size() - 1; i >= 0; i--)
+        global_acc_[i]->ClockTick();
+    if (profiler_) {
+        for (int ch = 0; ch < config_.channels; ch++)
+            profiler_->TickMode(ch, CurrentMode(ch));
+    }
+    for (int ch = 0; ch < config_.channels; ch++) {
+        GlobalAccumulator* gacc = global_acc_[gacc_of_channel_[ch]];
+        int occupancy = gacc->LeafOccupancy(gacc_leaf_of_channel_[ch]) + gacc_reserved_[ch];
+        if (occupancy > 0 &&
+            occupancy + UNITS_PER_WORD > gacc->queue_depth) {
+            gacc_stall_cycles[ch]++;
+            pending_stall_[ch]++;
+        }
+    }
+}
+
+const std::vector<std::string> PimFuncSim::kOpCountNames = {
+    "num_pim_alu_ops",   "num_pim_grf_accesses", "num_pim_srf_accesses",
+    "num_pim_drf_accesses", "num_sacc_compares", "num_sacc_accumulates",
+    "num_gacc_ops"};
+
+// Share `ops` of a unit fed by `n` channels, `rank`-th of them
+static uint64_t EvenShare(uint64_t ops, int rank, int n) {
+    return ops * (rank + 1) / n - ops * rank / n;
+}
+
+std::vector<uint64_t> PimFuncSim::OpCounts(int channel) const {
+    std::vector<uint64_t> counts(kOpCountNames.size(), 0);
+    int units = config_.pim_units;
+    for (int i = channel * units; i < (channel + 1) * units; i++) {
+        counts[0] += pim_unit_[i]->num_alu_ops;
+        counts[1] += pim_unit_[i]->num_grf_accesses;
+        counts[2] += pim_unit_[i]->num_srf_accesses;
+        counts[3] += pim_unit_[i]->num_drf_accesses;
+    }
+    int sas = config_.pim_units / config_.pim_units_per_sacc;
+    for (int i = channel * sas; i < (channel + 1) * sas; i++) {
+        counts[4] += shared_acc_[i]->compare_cycles;
+        counts[5] += shared_acc_[i]->num_accumulates;
+    }
+    const GlobalAccumulator* acc = global_acc_[gacc_of_channel_[channel]];
+    counts[6] += EvenShare(acc->num_moves + acc->merge_adds,
+                           gacc_leaf_of_channel_[channel],
+                           acc->pair_queue_[0].size());
+    if (global_acc_.size() > (size_t)config_.gacc_count) {
+        const GlobalAccumulator* combiner = global_acc_.back();
+        counts[6] += EvenShare(combiner->num_moves + combiner->merge_adds,
+                               channel, config_.channels);
+    }
+    return counts;
+}
+
+std::vector<std::pair<std::string, uint64_t>> PimFuncSim::TakeOpCounts(int channel) {
+    std::vector<std::pair<std::string, uint64_t>> deltas;
+    std::vector<uint64_t> counts = OpCounts(channel);
+    std::vector<uint64_t>& taken = op_counts_taken_[channel];
+    for (size_t k = 0; k < counts.size(); k++) {
+        // an even share may dip by one between calls, never hand out less
+        if (counts[k] > taken[k]) {
+            deltas.emplace_back(kOpCountNames[k], counts[k] - taken[k]);
+            taken[k] = counts[k];
+        }
+    }
+    return deltas;
+}
+
+nlohmann::json PimFuncSim::GetStatsJson() const {
+    nlohmann::json j_data;
+    uint64_t total_saved = 0;
+    for (int ch = 0; ch < config_.channels; ch++) {
+        std::string key = std::to_string(ch);
+        j_data["num_mad_ops"][key] = num_mad_ops[ch];
+        j_data["num_relu_ops"][key] = num_relu_ops[ch];
+        j_data["saved_transactions"][key] = saved_transactions[ch];
+        j_data["sacc_stall_cycles"][key] = sacc_stall_cycles[ch];
+        j_data["sacc_compare_cycles"][key] = sacc_compare_cycles[ch];
+        j_data["gacc_stall_cycles"][key] = gacc_stall_cycles[ch];
+        total_saved += saved_transactions[ch];
+    }
+    j_data["total_saved_transactions"] = total_saved;
+
+    // [pim_power] breakdown over all channels (pJ)
+    std::vector<uint64_t> ops(kOpCountNames.size(), 0);
+    for (int ch = 0; ch < config_.channels; ch++) {
+        std::vector<uint64_t> counts = OpCounts(ch);
+        for (size_t k = 0; k < ops.size(); k++)
+            ops[k] += counts[k];
+    }
+    for (size_t k = 0; k < ops.size(); k++)
+        j_data["ops"][kOpCountNames[k]] = ops[k];
+    nlohmann::json energy;
+    energy["alu"] = ops[0] * config_.pim_alu_energy_inc;
+    energy["grf"] = ops[1] * config_.pim_grf_energy_inc;
+    energy["srf"] = ops[2] * config_.pim_srf_energy_inc;
+    energy["drf"] = ops[3] * config_.pim_drf_energy_inc;
+    energy["sacc"] = ops[4] * config_.sacc_compare_energy_inc +
+                     ops[5] * config_.sacc_accumulate_energy_inc;
+    energy["gacc"] = ops[6] * config_.gacc_op_energy_inc;
+    double pim_total = 0.0;
+    for (auto it = energy.begin(); it != energy.end(); ++it)
+        pim_total += it.value().get<double>();
+    energy["total"] = pim_total;
+    j_data["energy"] = energy;
+    j_data["accumulation_count"] = accumulation_count;
+    for (size_t i = 0; i < global_acc_.size(); i++)
+        j_data["gacc"][std::to_string(i)] = global_acc_[i]->GetStatsJson();
+    return j_data;
+}
+
 //  Performs physical memory RD/WR, bank mode change, set PIM register,
 //  execute PIM computation and write result to physical memory
 //  AddTransaction을 통해 transaction을 받아서 처리하는 함수
@@ -202,7 +452,7 @@ void PimFuncSim::AddTransaction(Transaction *trans) {
                 if (addr.row == 0x3ffa) {  // set SRF_A, SRF_M
                     if (DebugMode(hex_addr))
                         std::cout << "SetSrf\n";
-                    for (int i=0; i< config_.banks/2; i++) {
+                    for (int i=0; i< config_.pim_units; i++) {
                         int pim_index = GetPimIndex(addr) + i;
                         pim_unit_[pim_index]->SetSrf(hex_addr, DataPtr);
                     }
@@ -210,7 +460,7 @@ void PimFuncSim::AddTransaction(Transaction *trans) {
                 } else if (addr.row == 0x3ffb) {  // set GRF_A, GRF_B
                     if (DebugMode(hex_addr))
                         std::cout << "SetGrf\n";
-                    for (int i=0; i< config_.banks/2; i++) {
+                    for (int i=0; i< config_.pim_units; i++) {
                         int pim_index = GetPimIndex(addr) + i;
                         pim_unit_[pim_index]->SetGrf(hex_addr, DataPtr);
                     }
@@ -218,7 +468,7 @@ void PimFuncSim::AddTransaction(Transaction *trans) {
                 } else if (addr.row == 0x3ffc) {  // set CRF
                     if (DebugMode(hex_addr))
                         std::cout << "SetCrf\n";
-                    for (int i=0; i< config_.banks/2; i++) {
+                    for (int i=0; i< config_.pim_units; i++) {
                         int pim_index = GetPimIndex(addr) + i;
                         pim_unit_[pim_index]->SetCrf(hex_addr, DataPtr);
                     }
@@ -232,21 +482,18 @@ void PimFuncSim::AddTransaction(Transaction *trans) {
                         std::cout << " Bank : " << addr.bank;
                         std::cout << " Triggering global accumulator\n";
                     }
-                    //TW added
-                    std::cout << "Pim_func_sim: Triggering global accumulator\n";
-                    global_acc_[0]->StartAcc();
-                    // 추후 global_acc_[1]도 추가할 수 있음
-                    // global_acc_[1]->StartAcc();
+                    IssueGacc(addr, hex_addr, is_write);
                 }          
 
                 else {  // RD, WR
                     // check if it is evenbank or oddbank
-                    int evenodd = addr.bank % 2;
+                    int evenodd = addr.bank % config_.pim_banks_per_unit;
                     if (DebugMode(hex_addr))
                         std::cout << "RD/WR\n";
-                    for (int i=evenodd; i< config_.banks; i+=2) {
-                        Address tmp_addr = Address(addr.channel, addr.rank, i/4,
-                                                   i%4, addr.row, addr.column);
+                    for (int i=evenodd; i< config_.banks; i+=config_.pim_banks_per_unit) {
+                        Address tmp_addr = Address(addr.channel, addr.rank,
+                                                   i / config_.banks_per_group,
+                                                   i % config_.banks_per_group, addr.row, addr.column);
                         uint64_t tmp_hex_addr = ReverseAddressMapping(tmp_addr);
 
                         if (is_write)
@@ -269,21 +516,21 @@ void PimFuncSim::AddTransaction(Transaction *trans) {
         if (addr.row == 0x3ffa) {  // set SRF_A, SRF_M
             if (DebugMode(hex_addr))
                 std::cout << "SetSrf\n";
-            for (int i=0; i< config_.banks/2; i++) {
+            for (int i=0; i< config_.pim_units; i++) {
                 int pim_index = GetPimIndex(addr) + i;
                 pim_unit_[pim_index]->SetSrf(hex_addr, DataPtr);
             }
         } else if (addr.row == 0x3ffb) {  // set GRF_A, GRF_B
             if (DebugMode(hex_addr))
                 std::cout << "SetGrf\n";
-            for (int i=0; i< config_.banks/2; i++) {
+            for (int i=0; i< config_.pim_units; i++) {
                 int pim_index = GetPimIndex(addr) + i;
                 pim_unit_[pim_index]->SetGrf(hex_addr, DataPtr);
             }
         } else if (addr.row == 0x3ffc) {  // set CRF
             if (DebugMode(hex_addr))
                 std::cout << "SetCrf\n";
-            for (int i=0; i< config_.banks/2; i++) {
+            for (int i=0; i< config_.pim_units; i++) {
                 int pim_index = GetPimIndex(addr) + i;
                 pim_unit_[pim_index]->SetCrf(hex_addr, DataPtr);
             }
@@ -294,34 +541,41 @@ void PimFuncSim::AddTransaction(Transaction *trans) {
                 std::cout << " Bank : " << addr.bank;
                 std::cout << " Triggering global accumulator\n";
             }
-            // TW added
-            global_acc_[0]->StartAcc();
-            // 추후 global_acc_[1]도 추가할 수 있음
-            // global_acc_[1]->StartAcc();
+            IssueGacc(addr, hex_addr, is_write);
         } else if (addr.row == 0x3ff7) { // JH added set DRF
             if (DebugMode(hex_addr))
                 std::cout << "SetDrf\n";
-            for (int i=0; i< config_.banks/2; i++) {
+            for (int i=0; i< config_.pim_units; i++) {
                 int pim_index = GetPimIndex(addr) + i;
                 pim_unit_[pim_index]->SetDrf(hex_addr, DataPtr);
             }
         }     
          else {  // RD, WR
             // check if it is evenbank or oddbank
-            int evenodd = addr.bank % 2;
+            int evenodd = addr.bank % config_.pim_banks_per_unit;
             if (DebugMode(hex_addr))
                 std::cout << "RD/WR (Trigger PIM inst.)\n";
-            for (int i=evenodd; i< config_.banks; i+=2) {
-                Address tmp_addr = Address(addr.channel, addr.rank, i/4,
-                                           i%4, addr.row, addr.column);
+            // all units of a trigger run the same CRF entry, count it once
+            PimUnit* first_unit = pim_unit_[GetPimIndex(addr)];
+            uint64_t mad_before = first_unit->num_mad_ops;
+            uint64_t relu_before = first_unit->num_relu_ops;
+            if (profiler_)
+                profiler_->RecordTrigger(addr.channel);
+            // SA loads of one trigger go in parallel, the slowest one holds the host
+            uint64_t trigger_stall = 0;
+            int per_sacc = config_.pim_units_per_sacc;
+            for (int i=evenodd; i< config_.banks; i+=config_.pim_banks_per_unit) {
+                Address tmp_addr = Address(addr.channel, addr.rank,
+                                           i / config_.banks_per_group,
+                                           i % config_.banks_per_group, addr.row, addr.column);
                 uint64_t tmp_hex_addr = ReverseAddressMapping(tmp_addr);
 
-                int pim_index = GetPimIndex(addr) + i/2;
+                int pim_index = GetPimIndex(addr) + i / config_.pim_banks_per_unit;
 
                 //shared_acc에 물려있는 pim_unit에 access 할 수 있도록 수정
                 //trnasaction_generator.cc 에서 하나의 transaction을 보내도,
                 //여기서 even / odd 전체 bank에 대해서 transaction을 보냄
-                int ret = shared_acc_[pim_index/2]->pim_unit_[pim_index%2]->AddTransaction(tmp_hex_addr,
+                int ret = shared_acc_[pim_index/per_sacc]->pim_unit_[pim_index%per_sacc]->AddTransaction(tmp_hex_addr,
                                                                is_write,
                                                                DataPtr);
                 // Tw added
@@ -329,27 +583,34 @@ void PimFuncSim::AddTransaction(Transaction *trans) {
                 // (TODO) 비교하는 부분 수정 필요
                 if(pim_index > 0){
                     int pim_index_SACC = pim_index - 1;
-                    if(pim_index % 2 == 1){ //1,3,5,7... 만 연산할 수 있도록
-                        if(shared_acc_[pim_index/2]->pim_unit_[pim_index%2]->enter_SACC == true \
-                            && shared_acc_[pim_index_SACC/2]->pim_unit_[pim_index_SACC%2]->enter_SACC == true)
+                    if(pim_index % per_sacc == per_sacc - 1){ //1,3,5,7... 만 연산할 수 있도록
+                        if(shared_acc_[pim_index/per_sacc]->pim_unit_[pim_index%per_sacc]->enter_SACC == true \
+                            && shared_acc_[pim_index_SACC/per_sacc]->pim_unit_[pim_index_SACC%per_sacc]->enter_SACC == true)
                         {
                             /*if (DebugMode(hex_addr)){
                                 std::cout << " Pim_func_sim: Trigger SACC\n";
                                 std::cout << " Pim index : " << pim_index << " Pim index SACC : " << pim_index_SACC << "\n";
                             }*/
+                            SharedAccumulator* sa = shared_acc_[pim_index/per_sacc];
+                            uint32_t* L_indices = sa->pim_unit_[pim_index%per_sacc]->bank_temp_;
+                            uint32_t* R_indices = shared_acc_[pim_index_SACC/per_sacc]->pim_unit_[pim_index_SACC%per_sacc]->bank_temp_;
+                            uint64_t stall = sa->ReserveSlots(trans->added_cycle,
+                                                              CountIndices(L_indices),
+                                                              CountIndices(R_indices));
                             // Send data from DRAM to L_IQ, R_IQ
                             if(addr.column % 2 == 0){
                                 //왼쪽 홀수, 오른쪽 짝수
-                                shared_acc_[pim_index/2]->loadIndices(hex_addr, shared_acc_[pim_index/2]->pim_unit_[pim_index%2]->bank_temp_, 
-                                                                    shared_acc_[pim_index_SACC/2]->pim_unit_[pim_index_SACC%2]->bank_temp_);
+                                sa->loadIndices(hex_addr, L_indices, R_indices);
                             }
                             else //다음 index로 넘어가기 위해 두개의 함수를 구분
-                                shared_acc_[pim_index/2]->loadIndices_2(hex_addr, shared_acc_[pim_index/2]->pim_unit_[pim_index%2]->bank_temp_,
-                                                                    shared_acc_[pim_index_SACC/2]->pim_unit_[pim_index_SACC%2]->bank_temp_);
-                            shared_acc_[pim_index/2]->runSimulation(hex_addr);
-                            shared_acc_[pim_index/2]->pim_unit_[pim_index%2]->enter_SACC = false;
-                            shared_acc_[pim_index_SACC/2]->pim_unit_[pim_index_SACC%2]->enter_SACC = false;      
-                            accumulation_count += shared_acc_[pim_index/2]-> accumulate_count;            
+                                sa->loadIndices_2(hex_addr, L_indices, R_indices);
+                            sa->runSimulation(hex_addr);
+                            stall += sa->TimeMerge(trans->added_cycle + stall);
+                            trigger_stall = std::max(trigger_stall, stall);
+                            sacc_compare_cycles[addr.channel] += sa->hold_steps + sa->merge_steps;
+                            shared_acc_[pim_index/per_sacc]->pim_unit_[pim_index%per_sacc]->enter_SACC = false;
+                            shared_acc_[pim_index_SACC/per_sacc]->pim_unit_[pim_index_SACC%per_sacc]->enter_SACC = false;      
+                            accumulation_count += shared_acc_[pim_index/per_sacc]-> accumulate_count;            
                         }
                     } 
                 }
@@ -359,9 +620,20 @@ void PimFuncSim::AddTransaction(Transaction *trans) {
                     if (DebugMode(hex_addr)){
                         std::cout << " Pim_func_sim : PIM → AB mode change\n";
                     }
+                    if (profiler_ && PIM_OP_MODE[addr.channel]) {
+                        PIM_OP_MODE[addr.channel] = false;
+                        profiler_->RecordModeSwitch(addr.channel, PimMode::PIM,
+                                                    CurrentMode(addr.channel));
+                    }
                     PIM_OP_MODE[addr.channel] = false;
                 }
             }
+            CountFusedOps(addr.channel, first_unit->num_mad_ops - mad_before,
+                          first_unit->num_relu_ops - relu_before);
+            if (trigger_stall > 0) {
+                sacc_stall_cycles[addr.channel] += trigger_stall;
+                pending_stall_[addr.channel] += trigger_stall;
+            }
         }
     }
 }
@@ -8,9 +8,11 @@
 #include "pim_unit.h"
 #include "configuration.h"
 #include "common.h"
+#include "json.hpp"
 //TW added
 #include "shared_acc.h"
 #include "global_acc.h"
+#include "pim_profiler.h"
 
 
 namespace dramsim3 {
@@ -19,6 +21,9 @@ class PimFuncSim {
  public:
     PimFuncSim(Config &config);
     void AddTransaction(Transaction *trans);
+    // Read/write returned by the controller (drives the GACC inputs)
+    void ReturnTransaction(uint64_t hex_addr, bool is_write);
+    void ClockTick();
     bool DebugMode(uint64_t hex_addr);
     bool ModeChanger(uint64_t hex_addr);
 
@@ -38,6 +43,7 @@ class PimFuncSim {
     uint64_t GetPimIndex(Address& addr);
     void PmemWrite(uint64_t hex_addr, uint8_t* DataPtr);
     void PmemRead(uint64_t hex_addr, uint8_t* DataPtr);
+    void CheckPmemBounds(uint64_t hex_addr) const;
     void init(uint8_t* pmemAddr, uint64_t pmemAddr_size,
               unsigned int burstSize);
 
@@ -45,8 +51,57 @@ class PimFuncSim {
    //To print value how many accumulated
    int accumulation_count = 0;
 
+   // Fused ALU statistics (per channel)
+   //  saved_transactions: host triggers that MAD / fused ReLU made unnecessary
+   std::vector<uint64_t> num_mad_ops;
+   std::vector<uint64_t> num_relu_ops;
+   std::vector<uint64_t> saved_transactions;
+   void CountFusedOps(int channel, uint64_t mad_ops, uint64_t relu_ops);
+
+   // SACC merge timing (per channel)
+   //  sacc_stall_cycles: cycles the host is held because the index queues
+   //  had no room for a load, handed to the controller via TakeStallCycles
+   std::vector<uint64_t> sacc_stall_cycles;
+   std::vector<uint64_t> sacc_compare_cycles;
+   uint64_t TakeStallCycles(int channel);
+
+   // GACC input path
+   //  A TRIGGER_GACC read captures one GRF_A register of the addressed unit
+   //  as (index, data) pairs, a TRIGGER_GACC write closes the channel's
+   //  stream. Both enter the leaf queue in issue order once the controller
+   //  returns them. gacc_stall_cycles: cycles a channel was held because
+   //  its leaf queue had no room for another burst
+   struct GaccInput {
+       uint64_t hex_addr;
+       bool arrived;
+       std::vector<Pair> pairs;
+   };
+   std::vector<std::deque<GaccInput>> gacc_inflight_;
+   std::vector<int> gacc_reserved_; // pairs in flight per channel
+   std::vector<uint64_t> gacc_stall_cycles;
+   std::vector<int> gacc_of_channel_;      // first-level accumulator of a channel
+   std::vector<int> gacc_leaf_of_channel_; // leaf queue inside that accumulator
+   void IssueGacc(const Address& addr, uint64_t hex_addr, bool is_write);
+   nlohmann::json GetStatsJson() const;
+
+   // Operation counts for the [pim_power] energy model (per channel)
+   //  PimUnit / SharedAccumulator counts belong to the channel of the unit.
+   //  GACC moves and adds are split evenly over the channels feeding the
+   //  accumulator (the combiner over all channels).
+   //  TakeOpCounts returns (counter name, increment since the last call)
+   //  for the channel's controller
+   static const std::vector<std::string> kOpCountNames;
+   std::vector<uint64_t> OpCounts(int channel) const;
+   std::vector<std::pair<std::string, uint64_t>> TakeOpCounts(int channel);
+
+   // Instruction profiler, nullptr unless pim_profile is set
+   PimProfiler* profiler_;
+   PimMode CurrentMode(int channel) const;
+
  protected:
     Config &config_;
+    std::vector<uint64_t> pending_stall_;
+    std::vector<std::vector<uint64_t>> op_counts_taken_;
 };
 
 }  // namespace dramsim3
@@ -0,0 +1,184 @@
+#include "pim_profiler.h"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+namespace dramsim3 {
+
+PimProfiler::PimProfiler(const Config& config)
+    : config_(config),
+      units_per_channel_(config.pim_units),
+      slot_count_(config.channels, std::vector<uint64_t>(PROFILE_CRF_SLOTS, 0)),
+      op_count_(config.channels, std::vector<uint64_t>(PROFILE_OPCODES, 0)),
+      slot_op_(config.channels, std::vector<int>(PROFILE_CRF_SLOTS, -1)),
+      aam_index_(PROFILE_CRF_SLOTS,
+                 std::vector<std::vector<uint64_t>>(
+                     3, std::vector<uint64_t>(PROFILE_AAM_INDICES, 0))),
+      branch_entries_(PROFILE_CRF_SLOTS, 0),
+      branch_taken_(PROFILE_CRF_SLOTS, 0),
+      triggers_(config.channels, 0),
+      mode_cycles_(config.channels,
+                   std::vector<uint64_t>((int)PimMode::NUM_MODES, 0)),
+      mode_switches_(config.channels,
+                     std::vector<uint64_t>((int)PimMode::NUM_MODES *
+                                               (int)PimMode::NUM_MODES, 0)) {}
+
+const char* PimProfiler::OpName(int op) {
+    // PIM_OPERATION values (pim_config.h), 3, 6, 7 are unused
+    static const char* names[PROFILE_OPCODES] = {
+        "NOP", "JUMP", "EXIT", "OP3",  "MOV",  "FILL",    "OP6",  "OP7",
+        "ADD", "MUL",  "MAC",  "MAD",  "SACC", "LOOP", "MUL_DRF", "OP15"};
+    return (op >= 0 && op < PROFILE_OPCODES) ? names[op] : "UNKNOWN";
+}
+
+const char* PimProfiler::ModeName(PimMode mode) {
+    switch (mode) {
+        case PimMode::SB:
+            return "SB";
+        case PimMode::AB:
+            return "AB";
+        case PimMode::PIM:
+            return "PIM";
+        default:
+            return "UNKNOWN";
+    }
+}
+
+void PimProfiler::RecordExec(int pim_id, int slot, PIM_OPERATION op) {
+    int channel = pim_id / units_per_channel_;
+    if (channel >= config_.channels || slot < 0 || slot >= PROFILE_CRF_SLOTS)
+        return;
+    int opcode = static_cast<int>(op);
+    slot_count_[channel][slot]++;
+    slot_op_[channel][slot] = opcode;
+    if (opcode >= 0 && opcode < PROFILE_OPCODES)
+        op_count_[channel][opcode]++;
+}
+
+void PimProfiler::RecordAam(int slot, int dst_idx, int src0_idx, int src1_idx) {
+    if (slot < 0 || slot >= PROFILE_CRF_SLOTS)
+        return;
+    int idx[3] = {dst_idx, src0_idx, src1_idx};
+    for (int k = 0; k < 3; k++) {
+        if (idx[k] >= 0 && idx[k] < PROFILE_AAM_INDICES)
+            aam_index_[slot][k][idx[k]]++;
+    }
+}
+
+void PimProfiler::RecordBranch(int slot, bool entered, bool taken) {
+    if (slot < 0 || slot >= PROFILE_CRF_SLOTS)
+        return;
+    if (entered)
+        branch_entries_[slot]++;
+    if (taken)
+        branch_taken_[slot]++;
+}
+
+void PimProfiler::RecordTrigger(int channel) { triggers_[channel]++; }
+
+void PimProfiler::RecordModeSwitch(int channel, PimMode from, PimMode to) {
+    if (from == to)
+        return;
+    mode_switches_[channel][(int)from * (int)PimMode::NUM_MODES + (int)to]++;
+}
+
+void PimProfiler::TickMode(int channel, PimMode mode) {
+    mode_cycles_[channel][(int)mode]++;
+}
+
+nlohmann::json PimProfiler::GetJson() const {
+    nlohmann::json j_data;
+    const int num_modes = (int)PimMode::NUM_MODES;
+    for (int ch = 0; ch < config_.channels; ch++) {
+        std::string key = std::to_string(ch);
+        nlohmann::json j_ch;
+        for (int slot = 0; slot < PROFILE_CRF_SLOTS; slot++) {
+            if (slot_count_[ch][slot] == 0)
+                continue;
+            nlohmann::json j_slot;
+            j_slot["op"] = OpName(slot_op_[ch][slot]);
+            j_slot["count"] = slot_count_[ch][slot];
+            j_ch["slots"][std::to_string(slot)] = j_slot;
+        }
+        for (int op = 0; op < PROFILE_OPCODES; op++) {
+            if (op_count_[ch][op] != 0)
+                j_ch["opcodes"][OpName(op)] = op_count_[ch][op];
+        }
+        for (int m = 0; m < num_modes; m++)
+            j_ch["mode_cycles"][ModeName((PimMode)m)] = mode_cycles_[ch][m];
+        uint64_t switches = 0;
+        for (int from = 0; from < num_modes; from++) {
+            for (int to = 0; to < num_modes; to++) {
+                uint64_t n = mode_switches_[ch][from * num_modes + to];
+                if (n == 0)
+                    continue;
+                std::string name = std::string(ModeName((PimMode)from)) +
+                                   "->" + ModeName((PimMode)to);
+                j_ch["mode_switches"][name] = n;
+                switches += n;
+            }
+        }
+        j_ch["num_mode_switches"] = switches;
+        j_ch["triggers"] = triggers_[ch];
+        uint64_t pim_cycles = mode_cycles_[ch][(int)PimMode::PIM];
+        j_ch["trigger_density"] =
+            pim_cycles ? (double)triggers_[ch] / pim_cycles : 0.0;
+        j_data["channels"][key] = j_ch;
+    }
+
+    const char* operands[3] = {"dst", "src0", "src1"};
+    for (int slot = 0; slot < PROFILE_CRF_SLOTS; slot++) {
+        std::string key = std::to_string(slot);
+        for (int k = 0; k < 3; k++) {
+            uint64_t total = 0;
+            for (int i = 0; i < PROFILE_AAM_INDICES; i++)
+                total += aam_index_[slot][k][i];
+            if (total == 0)
+                continue;
+            for (int i = 0; i < PROFILE_AAM_INDICES; i++)
+                j_data["aam_index"][key][operands[k]].push_back(
+                    aam_index_[slot][k][i]);
+        }
+        if (branch_entries_[slot] != 0 || branch_taken_[slot] != 0) {
+            nlohmann::json j_br;
+            j_br["entries"] = branch_entries_[slot];
+            j_br["taken"] = branch_taken_[slot];
+            // jumps back per loop entry
+            j_br["average_trips"] =
+                branch_entries_[slot]
+                    ? (double)branch_taken_[slot] / branch_entries_[slot]
+                    : 0.0;
+            j_data["branches"][key] = j_br;
+        }
+    }
+    return j_data;
+}
+
+void PimProfiler::Write() const {
+    std::ofstream j_out(config_.pim_profile_json_name);
+    if (!j_out.is_open()) {
+        std::cerr << "Cannot open " << config_.pim_profile_json_name
+                  << std::endl;
+        return;
+    }
+    j_out << std::setw(2) << GetJson() << std::endl;
+
+    std::ofstream f_out(config_.pim_profile_folded_name);
+    if (!f_out.is_open()) {
+        std::cerr << "Cannot open " << config_.pim_profile_folded_name
+                  << std::endl;
+        return;
+    }
+    for (int ch = 0; ch < config_.channels; ch++) {
+        for (int slot = 0; slot < PROFILE_CRF_SLOTS; slot++) {
+            if (slot_count_[ch][slot] == 0)
+                continue;
+            f_out << "ch" << ch << ";CRF[" << slot << "]:"
+                  << OpName(slot_op_[ch][slot]) << " " << slot_count_[ch][slot]
+                  << "\n";
+        }
+    }
+}
+
+}  // namespace dramsim3
@@ -0,0 +1,69 @@
+#ifndef __PIM_PROFILER_H
+#define __PIM_PROFILER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "configuration.h"
+#include "pim_config.h"
+#include "json.hpp"
+
+namespace dramsim3 {
+
+#define PROFILE_CRF_SLOTS 32
+#define PROFILE_OPCODES 16
+#define PROFILE_AAM_INDICES 8
+
+enum class PimMode { SB = 0, AB, PIM, NUM_MODES };
+
+// Instruction-level profile of the PIM units (pim_profile = True)
+//  PimUnit reports every executed CRF slot, the AAM indices it computed and
+//  the JUMP / LOOP decisions, PimFuncSim reports triggers, bank mode of every
+//  channel per cycle and the mode changes
+//  Written at PrintStats as
+//   <prefix>_pim_profile.json   : counters
+//   <prefix>_pim_profile.folded : "ch<c>;CRF[<slot>]:<OP> <executions>"
+//                                 for flamegraph.pl / speedscope
+class PimProfiler {
+ public:
+    PimProfiler(const Config& config);
+
+    // PimUnit side, pim_id is the unit index of PimFuncSim::pim_unit_
+    void RecordExec(int pim_id, int slot, PIM_OPERATION op);
+    void RecordAam(int slot, int dst_idx, int src0_idx, int src1_idx);
+    //  entered: LC was loaded by this visit, taken: jumped back to the target
+    void RecordBranch(int slot, bool entered, bool taken);
+
+    // PimFuncSim side
+    void RecordTrigger(int channel);
+    void RecordModeSwitch(int channel, PimMode from, PimMode to);
+    void TickMode(int channel, PimMode mode);
+
+    nlohmann::json GetJson() const;
+    void Write() const;
+
+    static const char* OpName(int op);
+    static const char* ModeName(PimMode mode);
+
+ private:
+    const Config& config_;
+    int units_per_channel_;
+
+    // [channel][slot], [channel][opcode]
+    std::vector<std::vector<uint64_t>> slot_count_;
+    std::vector<std::vector<uint64_t>> op_count_;
+    std::vector<std::vector<int>> slot_op_;  // last opcode seen in the slot
+    // [slot][operand: dst, src0, src1][index]
+    std::vector<std::vector<std::vector<uint64_t>>> aam_index_;
+    // [slot]
+    std::vector<uint64_t> branch_entries_;
+    std::vector<uint64_t> branch_taken_;
+    // [channel]
+    std::vector<uint64_t> triggers_;
+    std::vector<std::vector<uint64_t>> mode_cycles_;
+    std::vector<std::vector<uint64_t>> mode_switches_;  // [ch][from * N + to]
+};
+
+}  // namespace dramsim3
+
+#endif  // __PIM_PROFILER_H
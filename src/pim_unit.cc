@@ -12,6 +12,13 @@ PimUnit::PimUnit(Config &config, int id)
     PPC = 0;  // PIM program counter : Points the PIM Instruction to execute in
               //                       CRF register
     LC  = 0;  // Loop counter : A counter to perform NOP, JUMP Instructions
+    num_alu_ops = 0;
+    num_grf_accesses = 0;
+    num_srf_accesses = 0;
+    num_drf_accesses = 0;
+    num_mad_ops = 0;
+    num_relu_ops = 0;
+    profiler_ = nullptr;
 
     // Initialize PIM Registers
     // TW added
@@ -89,6 +96,7 @@ void PimUnit::PrintPIM_IST(PimInstruction inst) { //PIM Config.h 파일의 PIM_O
     else if (inst.PIM_OP == (PIM_OPERATION)11) std::cout << "MAD\t";
     else if (inst.PIM_OP == (PIM_OPERATION)12) std::cout << "SACC\t"; //TW added
     else if (inst.PIM_OP == (PIM_OPERATION)13) std::cout << "LOOP\t"; //JH added
+    else if (inst.PIM_OP == (PIM_OPERATION)14) std::cout << "MUL_DRF\t";
     else std::cout << "UNKNOWN\t";
 
     if (inst.pim_op_type == (PIM_OP_TYPE)0) {  // CONTROL
@@ -133,6 +141,10 @@ void PimUnit::PrintPIM_IST(PimInstruction inst) { //PIM Config.h 파일의 PIM_O
             else std::cout << "(A)";
         }
         std::cout << "  ";
+        if (inst.PIM_OP == PIM_OPERATION::MAD)
+            std::cout << "SRF_A[" << inst.src2_idx << "]  ";
+        if (inst.is_relu)
+            std::cout << "RELU";
     }
     //TW added
     else if(inst.pim_op_type == (PIM_OP_TYPE)3) {  // SACC
@@ -155,6 +167,7 @@ void PimUnit::SetSrf(uint64_t hex_addr, uint8_t* DataPtr) {
     if (DebugMode()) std::cout << " PU: SetSrf\n";
     memcpy(SRF_A_, DataPtr, SRF_SIZE);
     memcpy(SRF_M_, DataPtr + SRF_SIZE, SRF_SIZE);
+    num_srf_accesses++;
 }
 
 // Set pim_unit's GRF Register
@@ -174,14 +187,18 @@ void PimUnit::SetGrf(uint64_t hex_addr, uint8_t* DataPtr) {
         unit_t* target = GRF_B_ + (addr.column-8) *WORD_SIZE / sizeof(unit_t);
         memcpy(target, DataPtr, WORD_SIZE);
     }
+    num_grf_accesses++;
 }
 
 // JH added
 // Set DRF
 void PimUnit::SetDrf(uint64_t hex_addr, uint8_t* DataPtr) {
     if (DebugMode()) std::cout << "  PU: SetDrf\n";
-    // Address addr = config_.AddressMapping(hex_addr);
-    memcpy(DRF_, DataPtr, DRF_SIZE); //512B
+    // one 32B DRF row per write, row = column of the MAP_DRF address
+    Address addr = config_.AddressMapping(hex_addr);
+    unit_t* target = DRF_ + (addr.column % (DRF_SIZE / WORD_SIZE)) * WORD_SIZE / sizeof(unit_t);
+    memcpy(target, DataPtr, WORD_SIZE);
+    num_drf_accesses++;
 }
 
 // Set pim_unit's CRF Register
@@ -208,6 +225,7 @@ void PimUnit::PushCrf(int CRF_idx, uint8_t* DataPtr) {
     CRF[CRF_idx].is_dst_fix = CheckDstFix(DataPtr);
     CRF[CRF_idx].is_src0_fix = CheckSrc0Fix(DataPtr);
     CRF[CRF_idx].is_src1_fix = CheckSrc1Fix(DataPtr);
+    CRF[CRF_idx].is_relu = false;
 
     switch (CRF[CRF_idx].PIM_OP) {
         case PIM_OPERATION::ADD: //ADD를 지원하기 위해서는 8개로 변경 필요 //TW added
@@ -221,6 +239,10 @@ void PimUnit::PushCrf(int CRF_idx, uint8_t* DataPtr) {
             CRF[CRF_idx].dst_idx  = BitToDstIdx(DataPtr);
             CRF[CRF_idx].src0_idx = BitToSrc0Idx(DataPtr);
             CRF[CRF_idx].src1_idx = BitToSrc1Idx(DataPtr);
+            // MAD은 SRF_A[src2_idx]를 bias로 더함
+            CRF[CRF_idx].src2_idx = BitToSrc2Idx(DataPtr);
+            // ReLU bit은 ALU 명령어에서만 의미가 있음 (CONTROL은 같은 bit를 imm0로 사용)
+            CRF[CRF_idx].is_relu = CheckReLU(DataPtr);
             break;
         case PIM_OPERATION::MOV:
         case PIM_OPERATION::FILL:
@@ -271,6 +293,7 @@ void PimUnit::PushCrf(int CRF_idx, uint8_t* DataPtr) {
             CRF[CRF_idx].src0_idx = BitToSrc0Idx(DataPtr); 
             // SRF_M의 몇 번째 스칼라를 사용할지 src1_idx에 저장 (필요 시)
             CRF[CRF_idx].src1_idx = BitToSrc1Idx(DataPtr); 
+            CRF[CRF_idx].is_relu = CheckReLU(DataPtr);
             break;
         default:
             break;
@@ -291,6 +314,9 @@ int PimUnit::AddTransaction(uint64_t hex_addr, bool is_write,
     if (!is_write)
         memcpy(bank_data_ , pmemAddr_ + hex_addr, WORD_SIZE); 
 
+    if (profiler_)
+        profiler_->RecordExec(pim_id, PPC, CRF[PPC].PIM_OP);
+
     // Map operand data's offset to computation pointers properly
     SetOperandAddr(hex_addr);
 
@@ -323,6 +349,10 @@ int PimUnit::AddTransaction(uint64_t hex_addr, bool is_write,
     //  Performed by using LC(Loop Counter)
     //  LC copies the number of iterations and gets lower by 1 when executed
     //  Repeats until LC gets to 1 and escapes the iteration
+    if (profiler_ && (CRF[PPC].PIM_OP == PIM_OPERATION::NOP ||
+                      CRF[PPC].PIM_OP == PIM_OPERATION::JUMP ||
+                      CRF[PPC].PIM_OP == PIM_OPERATION::LOOP))
+        profiler_->RecordExec(pim_id, PPC, CRF[PPC].PIM_OP);
     if (CRF[PPC].PIM_OP == PIM_OPERATION::NOP) {
         if (LC == 0) {
             LC = CRF[PPC].imm1;
@@ -338,6 +368,8 @@ int PimUnit::AddTransaction(uint64_t hex_addr, bool is_write,
         }
         return 0;
     } else if (CRF[PPC].PIM_OP == PIM_OPERATION::JUMP) {
+        if (profiler_)
+            profiler_->RecordBranch(PPC, LC == 0, LC != 1);
         if (LC == 0) {
             LC = CRF[PPC].imm1;
             PPC = CRF[PPC].imm0;
@@ -352,6 +384,12 @@ int PimUnit::AddTransaction(uint64_t hex_addr, bool is_write,
             std::cout << "  PU: JUMP left (" << LC << ")\n";
         }
     } else if (CRF[PPC].PIM_OP == PIM_OPERATION::LOOP) {
+        if (profiler_) {
+            bool entered = (LC == 0);
+            bool taken = entered ? (((GRF_A_[CRF[PPC].src0_idx] >> 8) & 0xFF) > 0)
+                                 : (LC > 1);
+            profiler_->RecordBranch(PPC, entered, taken);
+        }
         if (LC == 0) {
             // GRF_A_[2]의 상위 8비트(1Byte)만 읽어서 LC에 저장
             LC = (GRF_A_[CRF[PPC].src0_idx] >> 8) & 0xFF;
@@ -380,6 +418,8 @@ int PimUnit::AddTransaction(uint64_t hex_addr, bool is_write,
     // When pointed PIM_INSTRUCTION is EXIT, μkernel is finished
     // Reset PPC and return EXIT_END
     if (CRF[PPC].PIM_OP == PIM_OPERATION::EXIT) {
+        if (profiler_)
+            profiler_->RecordExec(pim_id, PPC, CRF[PPC].PIM_OP);
         if (DebugMode()) {
             std::cout << "  PU: EXIT\n";
         }
@@ -421,6 +461,8 @@ void PimUnit::SetOperandAddr(uint64_t hex_addr) {
             src0_idx += 2;
             src0_idx = src0_idx % 8;
         }
+        if (profiler_)
+            profiler_->RecordAam(PPC, dst_idx, src0_idx, src1_idx);
         // TW hard coded end
 
         /*
@@ -509,7 +551,7 @@ void PimUnit::SetOperandAddr(uint64_t hex_addr) {
         drf_row_idx = drf_row_idx % 16; 
         
         // 4. 계산된 Row Index를 기반으로 src0 포인터 설정 (DRF는 512B, 한 Row는 32B = 16 unit_t)
-        src0 = DRF_ + drf_row_idx * WORD_SIZE;
+        src0 = DRF_ + drf_row_idx * WORD_SIZE / sizeof(unit_t);
         
             if (DebugMode()) {
                 std::cout << "  PU: MUL_DRF loaded index " << (int)drf_row_idx 
@@ -547,7 +589,8 @@ void PimUnit::SetOperandAddr(uint64_t hex_addr) {
                 //여기로만 들어감
                 // (TODO) src1_idx 값이 AA에 따라 변화 해버림
                 if(CRF[PPC].PIM_OP == PIM_OPERATION::MUL){
-                    src1 = SRF_M_ + src1_idx-1;
+                    // 이전 index, SRF_M은 8개라 0 → 7로 wrap (SRF_M_[-1]을 읽던 문제)
+                    src1 = SRF_M_ + (src1_idx + 7) % 8;
                 }
                 else{
                     src1 = SRF_M_ + src1_idx;
@@ -585,6 +628,11 @@ void PimUnit::SetOperandAddr(uint64_t hex_addr) {
         }
     }
 
+    // set src2 address (MAD bias)
+    //  bias is a scalar in SRF_A and broadcast to every lane in _MAD
+    if (CRF[PPC].PIM_OP == PIM_OPERATION::MAD)
+        src2 = SRF_A_ + CRF[PPC].src2_idx;
+
     // set BANK, operand address
     // . set dst address
     if (CRF[PPC].dst == PIM_OPERAND::BANK){
@@ -639,6 +687,49 @@ void PimUnit::Execute() {
         default:
             break;
     }
+    // Fused activation, applied on the ALU result before it leaves dst
+    if (CRF[PPC].pim_op_type == PIM_OP_TYPE::ALU && CRF[PPC].is_relu)
+        _ReLU();
+
+    // Energy bookkeeping, one access per register operand
+    const PimInstruction& inst = CRF[PPC];
+    if (inst.pim_op_type == PIM_OP_TYPE::ALU) {
+        num_alu_ops++;
+        CountOperand(inst.dst);
+        CountOperand(inst.src0);
+        CountOperand(inst.src1);
+        if (inst.PIM_OP == PIM_OPERATION::MAC)  // accumulator read
+            CountOperand(inst.dst);
+        if (inst.PIM_OP == PIM_OPERATION::MAD) {  // SRF_A bias
+            num_srf_accesses++;
+            num_mad_ops++;
+        }
+        if (inst.is_relu)
+            num_relu_ops++;
+        if (inst.PIM_OP == PIM_OPERATION::MUL_DRF)  // GRF_A row index
+            num_grf_accesses++;
+    } else if (inst.pim_op_type == PIM_OP_TYPE::DATA) {
+        CountOperand(inst.dst);
+        CountOperand(inst.src0);
+    }
+}
+
+void PimUnit::CountOperand(PIM_OPERAND operand) {
+    switch (operand) {
+        case PIM_OPERAND::GRF_A:
+        case PIM_OPERAND::GRF_B:
+            num_grf_accesses++;
+            break;
+        case PIM_OPERAND::SRF_A:
+        case PIM_OPERAND::SRF_M:
+            num_srf_accesses++;
+            break;
+        case PIM_OPERAND::DRF:
+            num_drf_accesses++;
+            break;
+        default:  // BANK is counted by the DRAM command energy
+            break;
+    }
 }
 
 // TW added
@@ -738,8 +829,34 @@ void PimUnit::_MAC() {
         }
     }
 }
+// dst = src0 * src1 + src2
+//  src2 is the SRF_A bias (scalar), src1 is broadcast like _MAC when SRF_M
 void PimUnit::_MAD() {
-    std::cout << "not yet\n";
+    half h_src2(*reinterpret_cast<half*>(&src2[0]));
+    if (CRF[PPC].src1 == PIM_OPERAND::SRF_M) {
+        for (int i = 0; i < UNITS_PER_WORD; i++) {
+            half h_src0(*reinterpret_cast<half*>(&src0[i]));
+            half h_src1(*reinterpret_cast<half*>(&src1[0]));
+            half h_dst = fma(h_src0, h_src1, h_src2);
+            dst[i] = *reinterpret_cast<unit_t*>(&h_dst);
+        }
+    } else {
+        for (int i = 0; i < UNITS_PER_WORD; i++) {
+            half h_src0(*reinterpret_cast<half*>(&src0[i]));
+            half h_src1(*reinterpret_cast<half*>(&src1[i]));
+            half h_dst = fma(h_src0, h_src1, h_src2);
+            dst[i] = *reinterpret_cast<unit_t*>(&h_dst);
+        }
+    }
+}
+
+// Clamp negative lanes of dst to zero
+//  FP16과 INT16 모두 bit 15가 sign bit이므로 unit_t 종류와 무관하게 동작
+void PimUnit::_ReLU() {
+    for (int i = 0; i < UNITS_PER_WORD; i++) {
+        if (dst[i] & 0x8000)
+            dst[i] = 0;
+    }
 }
 
 void PimUnit::_MOV() {
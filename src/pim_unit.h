@@ -14,6 +14,7 @@
 #include "./configuration.h"
 #include "./common.h"
 #include "./half.hpp"
+#include "./pim_profiler.h"
 
 namespace dramsim3 {
 
@@ -30,7 +31,9 @@ class PimInstruction{
     int dst_idx;
     int src0_idx;
     int src1_idx;
-    //int src2_idx;
+    int src2_idx; // SRF_A index of the MAD bias
+
+    bool is_relu; // clamp negative results of ALU ops to zero
 
     bool is_dst_fix;
     bool is_src0_fix;
@@ -62,11 +65,26 @@ class PimUnit {
     void _MAC();
     void _MAD();
     void _MOV();
+    void _ReLU();
 
     void _SACC();
     bool enter_SACC;
     // TW added end
 
+    // Operation counts for the [pim_power] energy model
+    //  *_accesses count 32B register reads/writes, host Set* writes included
+    void CountOperand(PIM_OPERAND operand);
+    uint64_t num_alu_ops;
+    uint64_t num_grf_accesses;
+    uint64_t num_srf_accesses;
+    uint64_t num_drf_accesses;
+    // Fused work of executed ALU ops (MAD bias add, ReLU flag)
+    uint64_t num_mad_ops;
+    uint64_t num_relu_ops;
+
+    // Set by PimFuncSim when pim_profile is on, nullptr otherwise
+    PimProfiler* profiler_;
+
     PimInstruction CRF[32];
     uint8_t PPC;
     int LC;
@@ -85,6 +103,7 @@ class PimUnit {
     unit_t *dst;
     unit_t *src0;
     unit_t *src1;
+    unit_t *src2;
     unit_t *bank_data_;
 
     uint8_t* pmemAddr_;
@@ -0,0 +1,171 @@
+#include "pmem.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "common.h"
+
+namespace dramsim3 {
+
+namespace {
+const char kCheckpointMagic[8] = {'P', 'M', 'E', 'M', 'C', 'K', 'P', 'T'};
+}
+
+PmemBackend::PmemBackend(uint64_t size, const std::string& path,
+                         bool huge_pages)
+    : base_(nullptr),
+      size_(size),
+      page_size_(sysconf(_SC_PAGESIZE)),
+      fd_(-1) {
+    void* addr;
+    if (path.empty()) {
+        addr = mmap(NULL, size_, PROT_READ | PROT_WRITE,
+                    MAP_ANONYMOUS | MAP_PRIVATE | MAP_NORESERVE, -1, 0);
+    } else {
+        fd_ = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd_ < 0) {
+            perror("open");
+            AbruptExit(__FILE__, __LINE__);
+        }
+        struct stat st;
+        if (fstat(fd_, &st) != 0 ||
+            ((uint64_t)st.st_size < size_ && ftruncate(fd_, size_) != 0)) {
+            perror("ftruncate");
+            AbruptExit(__FILE__, __LINE__);
+        }
+        addr = mmap(NULL, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    }
+    if (addr == MAP_FAILED) {
+        perror("mmap");
+        AbruptExit(__FILE__, __LINE__);
+    }
+    base_ = static_cast<uint8_t*>(addr);
+
+#ifdef MADV_HUGEPAGE
+    // THP is best effort: unsupported kernels or file systems keep 4K pages
+    if (huge_pages && madvise(base_, size_, MADV_HUGEPAGE) != 0)
+        perror("madvise(MADV_HUGEPAGE)");
+#endif
+}
+
+PmemBackend::~PmemBackend() {
+    munmap(base_, size_);
+    if (fd_ >= 0)
+        close(fd_);
+}
+
+PmemBackend* PmemBackend::Create(const Config& config) {
+    uint64_t size = (uint64_t)config.channels * config.channel_size * 1024 * 1024;
+    return new PmemBackend(size, config.pmem_file, config.pmem_huge_pages);
+}
+
+std::vector<uint64_t> PmemBackend::TouchedPages() const {
+    if (IsFileBacked())
+        return MappedPages();
+    uint64_t num_pages = (size_ + page_size_ - 1) / page_size_;
+    std::vector<unsigned char> vec(num_pages);
+    std::vector<uint64_t> pages;
+    if (mincore(base_, size_, vec.data()) != 0) {
+        perror("mincore");
+        return pages;
+    }
+    for (uint64_t i = 0; i < num_pages; i++) {
+        if (vec[i] & 1)
+            pages.push_back(i);
+    }
+    return pages;
+}
+
+// pagemap: one 64-bit entry per virtual page, bit 63 present, bit 62 swapped
+std::vector<uint64_t> PmemBackend::MappedPages() const {
+    std::vector<uint64_t> pages;
+    int fd = open("/proc/self/pagemap", O_RDONLY);
+    if (fd < 0) {
+        perror("open(/proc/self/pagemap)");
+        return pages;
+    }
+    uint64_t num_pages = (size_ + page_size_ - 1) / page_size_;
+    uint64_t first = reinterpret_cast<uintptr_t>(base_) / page_size_;
+    std::vector<uint64_t> entries(std::min<uint64_t>(num_pages, 65536));
+    for (uint64_t i = 0; i < num_pages; i += entries.size()) {
+        uint64_t n = std::min<uint64_t>(entries.size(), num_pages - i);
+        ssize_t len = pread(fd, entries.data(), n * sizeof(uint64_t),
+                            (first + i) * sizeof(uint64_t));
+        if (len != (ssize_t)(n * sizeof(uint64_t))) {
+            perror("pread(/proc/self/pagemap)");
+            pages.clear();
+            break;
+        }
+        for (uint64_t k = 0; k < n; k++) {
+            if (entries[k] >> 62)
+                pages.push_back(i + k);
+        }
+    }
+    close(fd);
+    return pages;
+}
+
+uint64_t PmemBackend::ResidentBytes() const {
+    return TouchedPages().size() * page_size_;
+}
+
+// Format: magic, page size, pmem size, page count, (page index, page data)*
+bool PmemBackend::SaveCheckpoint(const std::string& path) const {
+    std::ofstream out(path, std::ios::binary);
+    if (!out.is_open()) {
+        std::cerr << "Cannot open checkpoint " << path << std::endl;
+        return false;
+    }
+    std::vector<uint64_t> pages = TouchedPages();
+    uint64_t count = pages.size();
+    out.write(kCheckpointMagic, sizeof(kCheckpointMagic));
+    out.write(reinterpret_cast<const char*>(&page_size_), sizeof(page_size_));
+    out.write(reinterpret_cast<const char*>(&size_), sizeof(size_));
+    out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    for (uint64_t page : pages) {
+        uint64_t len = std::min(page_size_, size_ - page * page_size_);
+        out.write(reinterpret_cast<const char*>(&page), sizeof(page));
+        out.write(reinterpret_cast<const char*>(base_ + page * page_size_), len);
+    }
+    return out.good();
+}
+
+bool PmemBackend::LoadCheckpoint(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        std::cerr << "Cannot open checkpoint " << path << std::endl;
+        return false;
+    }
+    char magic[sizeof(kCheckpointMagic)];
+    uint64_t page_size, size, count;
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char*>(&page_size), sizeof(page_size));
+    in.read(reinterpret_cast<char*>(&size), sizeof(size));
+    in.read(reinterpret_cast<char*>(&count), sizeof(count));
+    if (!in || memcmp(magic, kCheckpointMagic, sizeof(magic)) != 0 ||
+        size > size_) {
+        std::cerr << "Invalid checkpoint " << path << std::endl;
+        return false;
+    }
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t page;
+        in.read(reinterpret_cast<char*>(&page), sizeof(page));
+        uint64_t offset = page * page_size;
+        if (!in || offset >= size) {
+            std::cerr << "Invalid checkpoint " << path << std::endl;
+            return false;
+        }
+        in.read(reinterpret_cast<char*>(base_ + offset),
+                std::min(page_size, size - offset));
+    }
+    return in.good();
+}
+
+}  // namespace dramsim3
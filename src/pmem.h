@@ -0,0 +1,60 @@
+#ifndef __PMEM_H
+#define __PMEM_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "configuration.h"
+
+namespace dramsim3 {
+
+// Backing store of the simulated physical memory (pmem)
+//  Anonymous : MAP_PRIVATE | MAP_NORESERVE, a page is only populated when it
+//              is first touched, so resident memory follows the matrix size
+//  File      : MAP_SHARED on `path` (created / extended to size), the image
+//              outlives the run and can be shared by several simulators
+//  huge_pages asks for transparent huge pages with MADV_HUGEPAGE
+class PmemBackend {
+ public:
+    PmemBackend(uint64_t size, const std::string& path, bool huge_pages);
+    ~PmemBackend();
+    // size = channels * channel_size (MB), pmem_file / pmem_huge_pages
+    // from the [system] section
+    static PmemBackend* Create(const Config& config);
+
+    uint8_t* Base() const { return base_; }
+    uint64_t Size() const { return size_; }
+    bool IsFileBacked() const { return fd_ >= 0; }
+    bool Contains(uint64_t offset, uint64_t len) const {
+        return offset <= size_ && len <= size_ - offset;
+    }
+
+    // Touched-page tracking
+    //  Pages populated so far, covers every accessor of Base() without
+    //  instrumenting the memcpy paths. Anonymous: mincore. File: mincore
+    //  would also report the file's pages cached by earlier runs, so the
+    //  pages present in this process's page table (/proc/self/pagemap)
+    uint64_t PageSize() const { return page_size_; }
+    std::vector<uint64_t> TouchedPages() const;
+    uint64_t ResidentBytes() const;
+
+    // Checkpoint of the touched pages only
+    //  Restoring writes those pages back, untouched pages keep their data
+    //  (zero for an anonymous pmem)
+    //  [system] pmem_checkpoint saves one at PrintStats, pmem_restore loads
+    //  one before the run
+    bool SaveCheckpoint(const std::string& path) const;
+    bool LoadCheckpoint(const std::string& path);
+
+ private:
+    std::vector<uint64_t> MappedPages() const;
+
+    uint8_t* base_;
+    uint64_t size_;
+    uint64_t page_size_;
+    int fd_;
+};
+
+}  // namespace dramsim3
+
+#endif  // __PMEM_H
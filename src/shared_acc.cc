@@ -1,14 +1,16 @@
+#include <algorithm>
 #include <iostream>
 #include "./shared_acc.h"
 
-#define MAX_QUEUE_SIZE 16
-
 namespace dramsim3 {
 
 SharedAccumulator::SharedAccumulator(Config &config, int id, PimUnit& pim1, PimUnit& pim2)
     : PimUnit(config, id),  // Call the PimUnit constructor
       SA_id(id),
-      sa_clk(0), 
+      sa_clk(0),
+      merge_steps(0),
+      hold_steps(0),
+      compare_cycles(0),
       L_Q_pop_cnt(0),
       R_Q_pop_cnt(0),
       config_(config) {
@@ -16,12 +18,13 @@ SharedAccumulator::SharedAccumulator(Config &config, int id, PimUnit& pim1, PimU
     pim_unit_.push_back(&pim1);
     pim_unit_.push_back(&pim2);
 
-    column_data = (uint32_t*) malloc(WORD_SIZE);
+    column_data = (uint32_t*) calloc(1, WORD_SIZE);  // compared before the first ReadColumn
     sa_clk = 0;
     column_index = 0;
     previous_column = 0;
 
     accumulate_count = 0;
+    num_accumulates = 0;
 }
 
 void SharedAccumulator::init(uint8_t* pmemAddr, uint64_t pmemAddr_size,
@@ -48,6 +51,16 @@ uint64_t SharedAccumulator::ReverseAddressMapping(Address& addr) {
     return hex_addr << config_.shift_bits;
 }
 
+// GRF_A_ order of index slot i of a SACC trigger at column offset_column
+//  The host SACC columns run past column 31 (RowTriggers), the DRAM column
+//  then wraps to 0~7 and (column - 8) * 4 goes negative. Wrap the order
+//  into GRF_A_ instead of reading/writing in front of it
+int SharedAccumulator::GrfOrder(int i, int offset_column) {
+    const int grf_units = GRF_SIZE / (int)sizeof(unit_t);
+    int order = (i + offset_column * 4) % grf_units;
+    return order < 0 ? order + grf_units : order;
+}
+
 //Index Queue에 데이터를 넣는 함수
 //MOV 명령어 시행시 DRAM row에서 데이터를 받아와야 함
 //이때, DRAM row에서 받아온 데이터를 Index Queue에 넣어주는 함수
@@ -56,21 +69,22 @@ void SharedAccumulator::loadIndices(uint64_t hex_addr, uint32_t *L_indices, uint
     //std::cout << "SA: Data loaded to Shared Accumulator ID: " << SA_id << std::endl;
     //DRAM의 column address를 기반으로 GRF access index를 결정할 수 있도록 offset 도입
     Address addr = config_.AddressMapping(hex_addr);
-    uint32_t offset = (addr.column - 8) * 4;
+    int offset_column = (int)addr.column - 8;
+    Element L[8], R[8];
+    int nL = 0, nR = 0;
     for (size_t i = 0; i < 8; i++) {
         //std::cout << " SA: L_indices[" << i << "]: " << L_indices[i]<<" ";
-        if(L_indices[i] != 0){
-            L_IQ.push(Element(i+offset,L_indices[i]));
-        }
+        if(L_indices[i] != 0)
+            L[nL++] = Element(GrfOrder(i, offset_column),L_indices[i]);
     }
 
     //std::cout << std::endl;
     for (size_t i = 0; i < 8 /*R_indices.size()*/; i++) {
         //std::cout << "SA: R_indices[" << i << "]: " << R_indices[i] <<" ";
-        if(R_indices[i] != 0){
-            R_IQ.push(Element(i+offset,R_indices[i]));
-        }
+        if(R_indices[i] != 0)
+            R[nR++] = Element(GrfOrder(i, offset_column),R_indices[i]);
     }
+    PushIndices(L, nL, R, nR);
     //std::cout << "\n\n";
 }
 
@@ -80,23 +94,81 @@ void SharedAccumulator::loadIndices_2(uint64_t hex_addr, uint32_t *L_indices, ui
     //std::cout << "SA: Data loaded to Shared Accumulator ID: " << SA_id << std::endl;
     //DRAM의 column address를 기반으로 GRF access index를 결정할 수 있도록 offset 도입
     Address addr = config_.AddressMapping(hex_addr);
-    uint32_t offset = (addr.column - 9) * 4;
+    int offset_column = (int)addr.column - 9;
+    Element L[8], R[8];
+    int nL = 0, nR = 0;
     for (size_t i = 8; i < 16; i++) {
         //std::cout << " SA: L_indices[" << i << "]: " << L_indices[i-8]<<" ";
-        if(L_indices[i] != 0){
-            L_IQ.push(Element(i+offset,L_indices[i]));
-        }
+        // bank_temp_는 8개 (SACC 한 번의 32B), index만 8 ~ 15
+        if(L_indices[i-8] != 0)
+            L[nL++] = Element(GrfOrder(i, offset_column),L_indices[i-8]);
     }
     //std::cout << std::endl;
     for (size_t i = 8; i < 16 /*R_indices.size()*/; i++) {
         //std::cout << "SA: R_indices[" << i << "]: " << R_indices[i-8] <<" ";
-        if(R_indices[i] != 0){
-            R_IQ.push(Element(i+offset,R_indices[i]));
-        }
+        if(R_indices[i-8] != 0)
+            R[nR++] = Element(GrfOrder(i, offset_column),R_indices[i-8]);
     }
+    PushIndices(L, nL, R, nR);
     //std::cout << "\n\n";
 }
 
+// Entries enter as soon as their queue has a slot. While one is full the
+// host waits and the merge engine compares (one per cycle) to free one
+void SharedAccumulator::PushIndices(const Element* L, int nL,
+                                    const Element* R, int nR) {
+    int li = 0, ri = 0;
+    while (true) {
+        while (li < nL && L_IQ.push(L[li])) li++;
+        while (ri < nR && R_IQ.push(R[ri])) ri++;
+        if (li == nL && ri == nR)
+            break;
+        if (!L_IQ.empty() && !R_IQ.empty()) {
+            simulateStep();
+        } else if (L_IQ.empty()) {  // R_IQ is full, no partner to compare
+            R_IQ.pop();
+            R_Q_pop_cnt++;
+            step_pops_.push_back(POP_R);
+        } else {
+            L_IQ.pop();
+            L_Q_pop_cnt++;
+            step_pops_.push_back(POP_L);
+        }
+        hold_steps++;
+    }
+}
+
+uint64_t SharedAccumulator::ReserveSlots(uint64_t clk, int L_in, int R_in) {
+    hold_steps = 0;
+    while (!retire_.empty() && retire_.front().clk <= clk)
+        retire_.pop_front();
+    int L = L_IQ.size(), R = R_IQ.size();
+    for (const Retire& r : retire_) {
+        L += (r.pops & POP_L) != 0;
+        R += (r.pops & POP_R) != 0;
+    }
+    uint64_t ready = clk;
+    for (const Retire& r : retire_) {
+        if (L + L_in <= MAX_QUEUE_SIZE && R + R_in <= MAX_QUEUE_SIZE)
+            break;
+        ready = r.clk;
+        L -= (r.pops & POP_L) != 0;
+        R -= (r.pops & POP_R) != 0;
+    }
+    return ready - clk;
+}
+
+// The compares of the load run back to back once the engine is free, the
+// first hold_steps of them before the host may go on
+uint64_t SharedAccumulator::TimeMerge(uint64_t clk) {
+    uint64_t start = std::max(clk, sa_clk);
+    for (size_t k = 0; k < step_pops_.size(); k++)
+        retire_.push_back(Retire{start + k + 1, step_pops_[k]});
+    sa_clk = start + step_pops_.size();
+    compare_cycles += step_pops_.size();
+    step_pops_.clear();
+    return hold_steps;
+}
 
 //Printx Clk 함수는 몇 클럭이 소모 될지 출력하는 함수
 //sa_clk는 Shared Accumulator의 클럭 수를 나타냄
@@ -125,6 +197,7 @@ void SharedAccumulator::simulateStep() {
             L_Q_pop_cnt++;
             R_IQ.pop();
             R_Q_pop_cnt++;
+            step_pops_.push_back(POP_L | POP_R);
             
             // Signal load unit
             loadUnit(L_front.order, R_front.order); //order는 GRF를 access하기 위해 generate 된 index
@@ -133,11 +206,13 @@ void SharedAccumulator::simulateStep() {
             // Pop R_IQ
             R_IQ.pop();
             R_Q_pop_cnt++;
+            step_pops_.push_back(POP_R);
         } else {
             //std::cout << "SA: MISS R is bigger than L\n";
             // Pop L_IQ
             L_IQ.pop();
             L_Q_pop_cnt++;
+            step_pops_.push_back(POP_L);
         }
     }
     else{
@@ -161,6 +236,7 @@ void SharedAccumulator::loadUnit(int index_l, int index_r) {
     //std::cout << "SA: SA ID: " << SA_id << " Index Same " << std::endl;
     //std::cout << "L_IQ.size : " << L_IQ.size() << " R_IQ.size : " << R_IQ.size() << std::endl;
     accumulate_count++;
+    num_accumulates++;
     // Example: Load a value from GRF
     //uint64_t address = index * sizeof(int);  // Assuming an address mapping
     uint16_t data_l = 0;
@@ -178,16 +254,74 @@ void SharedAccumulator::loadUnit(int index_l, int index_r) {
     pim_unit_[0]->GRF_A_[index_l] = data_l + data_r;
 }
 
+// Copies one queue out as plain arrays, false if not strictly increasing
+static bool QueueToSorted(const RingQueue<Element, MAX_QUEUE_SIZE>& q,
+                          uint32_t* values, int* orders) {
+    for (int k = 0; k < q.size(); k++) {
+        values[k] = q.at(k).value;
+        orders[k] = q.at(k).order;
+        if (values[k] == 0 || (k > 0 && values[k] <= values[k - 1]))
+            return false;
+    }
+    return true;
+}
+
+bool SharedAccumulator::MergeSorted() {
+    int nL = L_IQ.size();
+    int nR = R_IQ.size();
+    if (nL == 0 || nR == 0)
+        return false;
+    uint32_t L_val[MAX_QUEUE_SIZE], R_val[MAX_QUEUE_SIZE];
+    int L_ord[MAX_QUEUE_SIZE], R_ord[MAX_QUEUE_SIZE];
+    if (!QueueToSorted(L_IQ, L_val, L_ord) || !QueueToSorted(R_IQ, R_val, R_ord))
+        return false;
+
+    int L_pos[MAX_QUEUE_SIZE], R_pos[MAX_QUEUE_SIZE];
+    int matches = IntersectSorted(L_val, nL, R_val, nR, L_pos, R_pos);
+    for (int k = 0; k < matches; k++)
+        loadUnit(L_ord[L_pos[k]], R_ord[R_pos[k]]);
+
+    // The step-by-step merge stops when the side with the smaller last
+    // index runs out; the other side keeps everything above that index
+    int L_used = nL, R_used = nR;
+    if (L_val[nL - 1] < R_val[nR - 1]) {
+        R_used = 0;
+        while (R_val[R_used] <= L_val[nL - 1]) R_used++;
+    } else if (R_val[nR - 1] < L_val[nL - 1]) {
+        L_used = 0;
+        while (L_val[L_used] <= R_val[nR - 1]) L_used++;
+    }
+    // pops of each compare for the cycle model, in simulateStep order
+    for (int i = 0, j = 0; i < nL && j < nR;) {
+        if (L_val[i] == R_val[j]) {
+            step_pops_.push_back(POP_L | POP_R);
+            i++;
+            j++;
+        } else if (L_val[i] > R_val[j]) {
+            step_pops_.push_back(POP_R);
+            j++;
+        } else {
+            step_pops_.push_back(POP_L);
+            i++;
+        }
+    }
+    for (int k = 0; k < L_used; k++) L_IQ.pop();
+    for (int k = 0; k < R_used; k++) R_IQ.pop();
+    L_Q_pop_cnt += L_used;
+    R_Q_pop_cnt += R_used;
+    merge_steps += L_used + R_used - matches;
+    return true;
+}
+
 //TW added 2025.02.22
 void SharedAccumulator::FlushQueue(){
-    while(!L_IQ.empty())
-        L_IQ.pop();
-    while(!R_IQ.empty())
-        R_IQ.pop();
+    L_IQ.clear();
+    R_IQ.clear();
 }
 
 void SharedAccumulator::runSimulation(uint64_t hex_addr) {
     accumulate_count = 0;
+    merge_steps = 0;
     #ifdef debug_mode
     //std::cout << "Shared Accumulator ID: " << SA_id << " simulation\n";
     #endif
@@ -203,15 +337,17 @@ void SharedAccumulator::runSimulation(uint64_t hex_addr) {
     //std::cout <<"previous column : " << previous_column << " current column : " << column_data[column_index] << std::endl;
     
     if(column_index != 0 && previous_column != column_data[column_index]){
+        // the cleared queue has no entries left to retire
+        uint8_t cleared = (SA_id % 2 == 1) ? POP_L : POP_R;
+        for (Retire& r : retire_)
+            r.pops &= ~cleared;
         if(SA_id % 2 == 1){
             //std::cout<< "SA: SA ID: " << SA_id << " L_IQ is flushed\n";
-            while(!L_IQ.empty())
-                L_IQ.pop();
+            L_IQ.clear();
         }
         else{
             //std::cout<< "SA: SA ID: " << SA_id << " R_IQ is flushed\n";
-            while(!R_IQ.empty())
-                R_IQ.pop();
+            R_IQ.clear();
         }
     }
     previous_column = column_data[column_index];
@@ -230,34 +366,28 @@ void SharedAccumulator::runSimulation(uint64_t hex_addr) {
         //std::cout << "column_data[" << i << "] : " << column_data[i] << std::endl;
         if(column_data[7] != 0){
             std::cerr << "SA: Column data is not empty\n";
-            exit(1);
+            AbruptExit(__FILE__, __LINE__);
         }
     }*/
-    while (!L_IQ.empty() || !R_IQ.empty()) {
-        //std::cout << "L_IQ.size : " << L_IQ.size() << " R_IQ.size : " << R_IQ.size() << std::endl;
-        //과정이 끝나고 flush 가 필요
-        simulateStep();
-        loop++;
-        if(L_IQ.empty() || R_IQ.empty()){
-            break;
+    // Sorted queues: match everything in one intersection
+    // otherwise one compare per simulateStep
+    if (!MergeSorted()) {
+        while (!L_IQ.empty() || !R_IQ.empty()) {
+            //std::cout << "L_IQ.size : " << L_IQ.size() << " R_IQ.size : " << R_IQ.size() << std::endl;
+            //과정이 끝나고 flush 가 필요
+            // with one queue empty there is nothing to compare
+            if (!L_IQ.empty() && !R_IQ.empty())
+                merge_steps++;
+            simulateStep();
+            loop++;
+            if(L_IQ.empty() || R_IQ.empty()){
+                break;
+            }
+            if (loop > 100000) {
+                std::cerr << "SA: Infinite loop detected\n";
+                AbruptExit(__FILE__, __LINE__);
+            }
         }
-        if (loop > 100000) {
-            std::cerr << "SA: Infinite loop detected\n";
-            exit(1);
-        }
-    }
-
-    //std::cout << "L_IQ.size : " << L_IQ.size() << " R_IQ.size : " << R_IQ.size() << std::endl;
-    // TW added flush at 2025.02.22
-    // QUEUE가 8개를 넘어서서 데이터가 존재하면 flush
-    if(L_IQ.size() > MAX_QUEUE_SIZE /2 || R_IQ.size() > MAX_QUEUE_SIZE /2){
-        std::cout << "L_IQ.size : " << L_IQ.size() << " R_IQ.size : " << R_IQ.size() << std::endl;
-        std::cout << "SA ID: " << SA_id << " L_IQ & R_IQ flushed\n";
-        FlushQueue();
-    }
-    if(L_IQ.size() > MAX_QUEUE_SIZE || R_IQ.size() > MAX_QUEUE_SIZE){
-        std::cerr << "SA ID: " << SA_id << " L_IQ or R_IQ is overflowed\n";
-        exit(1);
     }
 }
 
@@ -2,7 +2,7 @@
 #define SHARED_ACC_H
 
 #include <iostream>
-#include <queue>
+#include <deque>
 #include <vector>
 #include <array>  // 배열 사용
 #include "pim_unit.h"  // Include the PimUnit class
@@ -10,6 +10,9 @@
 #include "common.h"
 #include "pim_config.h"
 #include "pim_utils.h"
+#include "index_intersect.h"
+
+#define MAX_QUEUE_SIZE 16
 
 namespace dramsim3 {
 
@@ -21,14 +24,52 @@ struct Element {
     uint8_t order;
     unit_t value;
 
+    Element() : order(0), value(0) {}
     Element(int o, int v) : order(o), value(v) {}
 };
 
+// Fixed-capacity FIFO for the SACC index queues
+//  Storage is part of the object, push/pop only move head and size
+//  (std::queue allocated a deque chunk on every refill)
+template <typename T, int N>
+class RingQueue {
+ public:
+    RingQueue() : head_(0), size_(0) {}
+    bool empty() const { return size_ == 0; }
+    bool full() const { return size_ == N; }
+    int size() const { return size_; }
+    int capacity() const { return N; }
+    T& front() { return buf_[head_]; }
+    const T& front() const { return buf_[head_]; }
+    // k-th element from the head
+    const T& at(int k) const { return buf_[(head_ + k) % N]; }
+    // Returns false (and drops nothing) when the queue is full
+    bool push(const T& v) {
+        if (full()) return false;
+        buf_[(head_ + size_) % N] = v;
+        size_++;
+        return true;
+    }
+    void pop() {
+        head_ = (head_ + 1) % N;
+        size_--;
+    }
+    void clear() {
+        head_ = 0;
+        size_ = 0;
+    }
+
+ private:
+    T buf_[N];
+    int head_;
+    int size_;
+};
+
 // SharedAccumulator inherits from PimUnit
 class SharedAccumulator : public PimUnit {
 public:
-    std::queue<Element> L_IQ;
-    std::queue<Element> R_IQ;
+    RingQueue<Element, MAX_QUEUE_SIZE> L_IQ;
+    RingQueue<Element, MAX_QUEUE_SIZE> R_IQ;
 
     // Constructor
     SharedAccumulator(Config &config, int id, PimUnit& pim1, PimUnit& pim2);
@@ -40,6 +81,25 @@ public:
     void simulateStep();
     void loadUnit(int index_l, int index_r);
     void runSimulation(uint64_t hex_addr);
+    // Whole-queue merge with IntersectSorted (index_intersect.h)
+    //  Same matches, pops and merge_steps as repeated simulateStep calls.
+    //  Returns false (nothing done) when a queue is empty or not strictly
+    //  increasing, the caller then falls back to simulateStep
+    bool MergeSorted();
+
+    // Cycle model of the index-matching merge (one compare per cycle)
+    //  Every compare pops one entry of L_IQ, R_IQ or both. The merge runs
+    //  functionally at once, its compares retire one per cycle from sa_clk on.
+    //  ReserveSlots: called before a load. A queue holds its residue plus the
+    //  entries whose compare has not retired yet; returns the cycles until
+    //  both queues have room for L_in / R_in (or until the engine is idle)
+    //  loadIndices: if a queue is still full, compares run while the host
+    //  waits (hold_steps). A queue without partner retires its oldest index
+    //  unmatched, the value stays in its GRF
+    //  TimeMerge: schedules the compares of this load from clk on, returns
+    //  the extra host stall (hold_steps)
+    uint64_t ReserveSlots(uint64_t clk, int L_in, int R_in);
+    uint64_t TimeMerge(uint64_t clk);
     void PrintClk();
     void init(uint8_t* pmemAddr, uint64_t pmemAddr_size,
               unsigned int burstSize);
@@ -54,7 +114,10 @@ public:
 
     // Additional member variables
     int SA_id;
-    uint64_t sa_clk;
+    uint64_t sa_clk;        // merge engine is busy until this cycle
+    uint64_t merge_steps;   // compares done by the last runSimulation
+    uint64_t hold_steps;    // compares the last load waited for
+    uint64_t compare_cycles;
     int L_Q_pop_cnt;
     int R_Q_pop_cnt;
 
@@ -69,9 +132,23 @@ public:
     uint32_t previous_column;
 
     uint32_t accumulate_count;
+    uint64_t num_accumulates;  // matched adds over the whole run ([pim_power])
 
 protected:
     Config &config_;
+
+private:
+    int GrfOrder(int i, int offset_column);
+    void PushIndices(const Element* L, int nL, const Element* R, int nR);
+
+    // pops of one compare, bit 0: L_IQ, bit 1: R_IQ
+    enum { POP_L = 1, POP_R = 2 };
+    struct Retire {
+        uint64_t clk;  // the slots are free from this cycle on
+        uint8_t pops;
+    };
+    std::vector<uint8_t> step_pops_;  // compares of this load, in order
+    std::deque<Retire> retire_;       // scheduled compares not retired yet
 };
 
 }  // namespace dramsim3
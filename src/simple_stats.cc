@@ -36,6 +36,17 @@ SimpleStats::SimpleStats(const Config& config, int channel_id)
     InitStat("num_srefe_cmds", "counter", "Number of SREFE commands");
     InitStat("num_srefx_cmds", "counter", "Number of SREFX commands");
     InitStat("hbm_dual_cmds", "counter", "Number of cycles dual cmds issued");
+    InitStat("num_preload_writes", "counter",
+             "Number of untimed writes counted by preload");
+    InitStat("pim_stall_cycles", "counter",
+             "Number of cycles the host was held by PIM back-pressure");
+    InitStat("num_pim_alu_ops", "counter", "Number of PIM ALU instructions");
+    InitStat("num_pim_grf_accesses", "counter", "Number of GRF accesses");
+    InitStat("num_pim_srf_accesses", "counter", "Number of SRF accesses");
+    InitStat("num_pim_drf_accesses", "counter", "Number of DRF accesses");
+    InitStat("num_sacc_compares", "counter", "Number of SACC index compares");
+    InitStat("num_sacc_accumulates", "counter", "Number of SACC matched adds");
+    InitStat("num_gacc_ops", "counter", "Number of GACC moves and adds");
 
     // double stats
     InitStat("act_energy", "double", "Activation energy");
@@ -43,6 +54,12 @@ SimpleStats::SimpleStats(const Config& config, int channel_id)
     InitStat("write_energy", "double", "Write energy");
     InitStat("ref_energy", "double", "Refresh energy");
     InitStat("refb_energy", "double", "Refresh-bank energy");
+    InitStat("pim_alu_energy", "double", "PIM ALU energy");
+    InitStat("pim_grf_energy", "double", "PIM GRF energy");
+    InitStat("pim_srf_energy", "double", "PIM SRF energy");
+    InitStat("pim_drf_energy", "double", "PIM DRF energy");
+    InitStat("sacc_energy", "double", "Shared accumulator energy");
+    InitStat("gacc_energy", "double", "Global accumulator energy");
 
     // Vector counter stats
     InitVecStat("all_bank_idle_cycles", "vec_counter",
@@ -103,6 +120,38 @@ double SimpleStats::RankBackgroundEnergy(const int rank) const{
            vec_doubles_.at("sref_energy")[rank];
 }
 
+double SimpleStats::TotalEnergy() const {
+    auto count = [this](const std::string& name) -> double {
+        auto c = counters_.find(name);
+        auto e = epoch_counters_.find(name);
+        return (double)((c == counters_.end() ? 0 : c->second) +
+                        (e == epoch_counters_.end() ? 0 : e->second));
+    };
+    auto vec_count = [this](const std::string& name, int i) -> double {
+        return (double)(vec_counters_.at(name)[i] +
+                        epoch_vec_counters_.at(name)[i]);
+    };
+    double energy = count("num_act_cmds") * config_.act_energy_inc +
+                    count("num_read_cmds") * config_.read_energy_inc +
+                    count("num_write_cmds") * config_.write_energy_inc +
+                    count("num_ref_cmds") * config_.ref_energy_inc +
+                    count("num_refb_cmds") * config_.refb_energy_inc;
+    for (int i = 0; i < config_.ranks; i++) {
+        energy += vec_count("rank_active_cycles", i) * config_.act_stb_energy_inc +
+                  vec_count("all_bank_idle_cycles", i) * config_.pre_stb_energy_inc +
+                  vec_count("sref_cycles", i) * config_.sref_energy_inc;
+    }
+    // [pim_power], see UpdatePimEnergy
+    energy += count("num_pim_alu_ops") * config_.pim_alu_energy_inc +
+              count("num_pim_grf_accesses") * config_.pim_grf_energy_inc +
+              count("num_pim_srf_accesses") * config_.pim_srf_energy_inc +
+              count("num_pim_drf_accesses") * config_.pim_drf_energy_inc +
+              count("num_sacc_compares") * config_.sacc_compare_energy_inc +
+              count("num_sacc_accumulates") * config_.sacc_accumulate_energy_inc +
+              count("num_gacc_ops") * config_.gacc_op_energy_inc;
+    return energy;
+}
+
 void SimpleStats::PrintEpochStats() {
     UpdateEpochStats();
     if (config_.output_level >= 1) {
@@ -359,6 +408,27 @@ void SimpleStats::UpdatePrints(bool epoch) {
     }
 }
 
+// PIM logic energy ([pim_power]) from the counts handed over by PimFuncSim
+double SimpleStats::UpdatePimEnergy(
+    std::unordered_map<std::string, uint64_t>& counters) {
+    doubles_["pim_alu_energy"] =
+        counters["num_pim_alu_ops"] * config_.pim_alu_energy_inc;
+    doubles_["pim_grf_energy"] =
+        counters["num_pim_grf_accesses"] * config_.pim_grf_energy_inc;
+    doubles_["pim_srf_energy"] =
+        counters["num_pim_srf_accesses"] * config_.pim_srf_energy_inc;
+    doubles_["pim_drf_energy"] =
+        counters["num_pim_drf_accesses"] * config_.pim_drf_energy_inc;
+    doubles_["sacc_energy"] =
+        counters["num_sacc_compares"] * config_.sacc_compare_energy_inc +
+        counters["num_sacc_accumulates"] * config_.sacc_accumulate_energy_inc;
+    doubles_["gacc_energy"] =
+        counters["num_gacc_ops"] * config_.gacc_op_energy_inc;
+    return doubles_["pim_alu_energy"] + doubles_["pim_grf_energy"] +
+           doubles_["pim_srf_energy"] + doubles_["pim_drf_energy"] +
+           doubles_["sacc_energy"] + doubles_["gacc_energy"];
+}
+
 void SimpleStats::UpdateEpochStats() {
     // push counter values as is
     UpdateCounters();
@@ -375,6 +445,8 @@ void SimpleStats::UpdateEpochStats() {
     doubles_["refb_energy"] =
         epoch_counters_["num_refb_cmds"] * config_.refb_energy_inc;
 
+    double pim_energy = UpdatePimEnergy(epoch_counters_);
+
     // vector doubles, update first, then push
     double background_energy = 0.0;
     for (int i = 0; i < config_.ranks; i++) {
@@ -401,7 +473,8 @@ void SimpleStats::UpdateEpochStats() {
 
     double total_energy = doubles_["act_energy"] + doubles_["read_energy"] +
                           doubles_["write_energy"] + doubles_["ref_energy"] +
-                          doubles_["refb_energy"] + background_energy;
+                          doubles_["refb_energy"] + background_energy +
+                          pim_energy;
     calculated_["total_energy"] = total_energy;
     calculated_["average_power"] = total_energy / epoch_counters_["num_cycles"];
     calculated_["average_read_latency"] =
@@ -434,6 +507,7 @@ void SimpleStats::UpdateFinalStats() {
     doubles_["ref_energy"] = counters_["num_ref_cmds"] * config_.ref_energy_inc;
     doubles_["refb_energy"] =
         counters_["num_refb_cmds"] * config_.refb_energy_inc;
+    double pim_energy = UpdatePimEnergy(counters_);
 
     // vector doubles, update first, then push
     double background_energy = 0.0;
@@ -462,7 +536,8 @@ void SimpleStats::UpdateFinalStats() {
 
     double total_energy = doubles_["act_energy"] + doubles_["read_energy"] +
                           doubles_["write_energy"] + doubles_["ref_energy"] +
-                          doubles_["refb_energy"] + background_energy;
+                          doubles_["refb_energy"] + background_energy +
+                          pim_energy;
     calculated_["total_energy"] = total_energy;
     calculated_["average_power"] = total_energy / counters_["num_cycles"];
     // calculated_["average_read_latency"] = GetHistoAvg("read_latency");
@@ -17,6 +17,11 @@ class SimpleStats {
     // incrementing counter
     void Increment(const std::string name) { epoch_counters_[name] += 1; }
 
+    // increment counter by number
+    void IncrementBy(const std::string name, uint64_t num) {
+        epoch_counters_[name] += num;
+    }
+
     // incrementing for vec counter
     void IncrementVec(const std::string name, int pos) {
         epoch_vec_counters_[name][pos] += 1;
@@ -33,6 +38,10 @@ class SimpleStats {
     // return per rank background energy
     double RankBackgroundEnergy(const int r) const;
 
+    // Total energy (pJ) up to now, same sum as total_energy of the final
+    // stats without touching the stats
+    double TotalEnergy() const;
+
     // Epoch update
     void PrintEpochStats();
 
@@ -56,6 +65,7 @@ class SimpleStats {
 
     void UpdateCounters();
     void UpdateHistoBins();
+    double UpdatePimEnergy(std::unordered_map<std::string, uint64_t>& counters);
     void UpdatePrints(bool epoch);
     double GetHistoAvg(const HistoCount& histo_counts) const;
     std::string GetTextHeader(bool is_final) const;
@@ -6,6 +6,89 @@ using half_float::half;
 
 namespace dramsim3 {
 
+// μkernels of the generators, assembled by UKernel (ukernel.h) at Initialize
+const char* kUKernelSpmv =
+    ".bank even\n"
+    "MOV(AAM0) SRF_M BANK\n"
+    "MUL(AAM0) GRF_A BANK SRF_M\n"
+    "SACC(AAM0) BANK BANK\n"
+    "SACC(AAM0) BANK BANK\n"
+    "JUMP -3 6\n"
+    "MOV(AAM0) BANK GRF_A\n"
+    "JUMP -1 6\n"
+    ".bank odd\n"
+    "MOV(AAM0) SRF_M BANK\n"
+    "MUL(AAM0) GRF_A BANK SRF_M\n"
+    "SACC(AAM0) BANK BANK\n"
+    "SACC(AAM0) BANK BANK\n"
+    "JUMP -3 6\n"
+    "MOV(AAM0) BANK GRF_A\n"
+    "JUMP -1 6\n"
+    "EXIT\n";
+
+// JH added
+//  LOOP returns to ukernel[1] for every nonzero of the row chunk,
+//  JUMP -6 16 to ukernel[0] for the 16 chunks (the old table had the python
+//  immediates -11 / -15, i.e. targets outside the CRF)
+const char* kUKernelSpmm =
+    ".bank even\n"
+    "MOV(AAM0) GRF_A BANK\n"
+    "MOV(AAM0) SRF_M GRF_A\n"
+    "MUL_DRF(AAM0) GRF_B DRF SRF_M\n"
+    "ADD(AAM0) GRF_B GRF_B GRF_B\n"
+    "LOOP -3 GRF_A[2]\n"
+    "SACC(AAM0) GRF_B GRF_B\n"
+    "JUMP -6 16\n"
+    ".bank odd\n"
+    "MOV(AAM0) BANK GRF_B\n"
+    "JUMP -1 7\n"
+    "EXIT\n";
+
+// Dense SpMV tiles (dense_tile_format): SRF_M = x of the 7 columns
+//  (column 7), per 16-row block GRF_B[0] = sum_k word k x SRF_M[k] and the
+//  block result goes to column 2 + b
+const char* kUKernelSpmvDense =
+    ".bank even\n"
+    ".col 7\n"  "MOV(AAM0) SRF_M BANK\n"
+    ".col 8\n"  "MUL(AAM0) GRF_B[0] BANK SRF_M\n"
+    ".col 9\n"  "MAC(AAM0) GRF_B[0] BANK SRF_M\n" "JUMP -1 5\n"
+    ".col 2\n"  "MOV(AAM0) BANK GRF_B[0]\n"
+    ".col 16\n" "MUL(AAM0) GRF_B[0] BANK SRF_M\n"
+    ".col 17\n" "MAC(AAM0) GRF_B[0] BANK SRF_M\n" "JUMP -1 5\n"
+    ".col 3\n"  "MOV(AAM0) BANK GRF_B[0]\n"
+    ".col 24\n" "MUL(AAM0) GRF_B[0] BANK SRF_M\n"
+    ".col 25\n" "MAC(AAM0) GRF_B[0] BANK SRF_M\n" "JUMP -1 5\n"
+    ".col 4\n"  "MOV(AAM0) BANK GRF_B[0]\n"
+    ".bank odd\n"
+    ".col 7\n"  "MOV(AAM0) SRF_M BANK\n"
+    ".col 8\n"  "MUL(AAM0) GRF_B[0] BANK SRF_M\n"
+    ".col 9\n"  "MAC(AAM0) GRF_B[0] BANK SRF_M\n" "JUMP -1 5\n"
+    ".col 2\n"  "MOV(AAM0) BANK GRF_B[0]\n"
+    ".col 16\n" "MUL(AAM0) GRF_B[0] BANK SRF_M\n"
+    ".col 17\n" "MAC(AAM0) GRF_B[0] BANK SRF_M\n" "JUMP -1 5\n"
+    ".col 3\n"  "MOV(AAM0) BANK GRF_B[0]\n"
+    ".col 24\n" "MUL(AAM0) GRF_B[0] BANK SRF_M\n"
+    ".col 25\n" "MAC(AAM0) GRF_B[0] BANK SRF_M\n" "JUMP -1 5\n"
+    ".col 4\n"  "MOV(AAM0) BANK GRF_B[0]\n"
+    "EXIT\n";
+
+// sparse_row SpMV tiles, one pass per row descriptor (column d): the
+//  descriptor word goes to GRF_A[0], MUL_DRF takes DRF row NZE_col_idx[0]
+//  (byte 4), LOOP repeats MUL_DRF/ADD for the nonzeros (trip byte 5,
+//  packSparseRow) and the sum goes to ODD column d.
+//  The PimUnit has one LC for NOP/JUMP/LOOP, so the row descriptors are not
+//  an outer JUMP like kUKernelSpmm but separate passes
+const char* kUKernelSpmvSparseRow =
+    ".bank even\n"
+    "MOV(AAM0) GRF_A[0] BANK\n"
+    "MOV(AAM0) SRF_M GRF_A[0]\n"
+    "MUL_DRF(AAM0) GRF_B DRF[2] SRF_M\n"
+    "ADD(AAM0) GRF_B GRF_B GRF_B\n"
+    "LOOP -3 GRF_A[2]\n"
+    ".bank odd\n"
+    "MOV(AAM0) BANK GRF_B\n"
+    "EXIT\n";
+
 void TransactionGenerator::ReadCallBack(uint64_t addr, uint8_t *DataPtr) {
     return;
 }
@@ -13,6 +96,25 @@ void TransactionGenerator::WriteCallBack(uint64_t addr) {
     return;
 }
 
+void TransactionGenerator::PrintStats() {
+    nlohmann::json pmem;
+    pmem["size"] = pmem_->Size();
+    pmem["file_backed"] = pmem_->IsFileBacked();
+    pmem["resident_bytes"] = pmem_->ResidentBytes();
+    memory_system_.AddStats("pmem", pmem);
+    memory_system_.PrintStats();
+
+    std::string path = config_->pmem_checkpoint;
+    if (path.empty())
+        return;
+    if (path[0] != '/')
+        path = config_->output_dir + path;
+    if (!pmem_->SaveCheckpoint(path))
+        AbruptExit(__FILE__, __LINE__);
+    std::cout << "pmem checkpoint: " << path << " ("
+              << pmem_->TouchedPages().size() << " pages)" << std::endl;
+}
+
 // Map 64-bit hex_address into structured address
 //HBM2_4Gb_test.ini 파일에 정의된 Address Mapping을 이용하여 hex_addr을 Address로 변환
 //Address는 Row, Rank, Column, Bankgroup, Bank, Channel로 구성
@@ -27,6 +129,21 @@ uint64_t TransactionGenerator::ReverseAddressMapping(Address& addr) {
     return hex_addr << config_->shift_bits;
 }
 
+void TransactionGenerator::CheckPimGeometry(size_t partitions) {
+    std::string error;
+    if (!config_->ValidatePim(&error)) {
+        std::cerr << "PIM config: " << error << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    // DRAF_BG_ / B0_data_: one partition per (channel, bankgroup)
+    if (partitions != 0 && partitions != (size_t)config_->pim_partitions) {
+        std::cerr << "PIM config: " << partitions << " data partitions, "
+                  << config_->channels << " channels x " << config_->bankgroups
+                  << " bankgroups need " << config_->pim_partitions << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+}
+
 // Returns the minimum multiple of stride that is higher than num
 uint64_t TransactionGenerator::Ceiling(uint64_t num, uint64_t stride) {
     std::cout << "num : " << num << ", stride : " << stride << \
@@ -34,6 +151,28 @@ uint64_t TransactionGenerator::Ceiling(uint64_t num, uint64_t stride) {
     return ((num + stride - 1) / stride) * stride;
 }
 
+// Write one 32B word of the input data
+//  preload_ off : timed write transaction
+//  preload_ on  : copied straight into pmem at the same address, no cycles.
+//                 With preload_count_writes_ the write (and one ACT per row,
+//                 first_in_row) is still charged to the DRAM statistics
+void TransactionGenerator::SetDataWord(uint64_t hex_addr, const uint8_t *DataPtr,
+                                       bool first_in_row) {
+    if (!preload_) {
+        TryAddTransaction(hex_addr, true, const_cast<uint8_t*>(DataPtr));
+        return;
+    }
+    // same check as PimFuncSim::PmemWrite on the timed path
+    if (!pmem_->Contains(hex_addr, burstSize_)) {
+        std::cerr << "SetDataWord: 0x" << std::hex << hex_addr << std::dec
+                  << " is out of pmem (" << pmem_->Size() << " B)" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    std::memcpy(pmemAddr_ + hex_addr, DataPtr, burstSize_);
+    if (preload_count_writes_)
+        memory_system_.CountPreloadWrite(hex_addr, first_in_row);
+}
+
 // Send transaction to memory_system (DRAMsim3 + PIM Functional Simulator)
 //  hex_addr : address to RD/WR from physical memory or change bank mode
 //  is_write : denotes to Read or Write
@@ -46,20 +185,9 @@ void TransactionGenerator::TryAddTransaction(uint64_t hex_addr, bool is_write,
         clk_++;
     }
     // Send transaction to memory_system
-    if (is_write) {
-        //burstSize_ = 32B
-        uint8_t *new_data = (uint8_t *) malloc(burstSize_);
-        std::memcpy(new_data, DataPtr, burstSize_);
-	    //std::cout << std::hex << clk_ << "\twrite\t" << hex_addr << std::dec << std::endl;
-        memory_system_.AddTransaction(hex_addr, is_write, new_data);
-        memory_system_.ClockTick();
-        clk_++;
-    } else {
-		//std::cout << std::hex << clk_ << "\tread\t" << hex_addr << std::dec << std::endl;
-        memory_system_.AddTransaction(hex_addr, is_write, DataPtr);
-        memory_system_.ClockTick();
-        clk_++;
-    }
+    SubmitTransaction(hex_addr, is_write, DataPtr);
+    memory_system_.ClockTick();
+    clk_++;
 
     #if 0
     if(is_write)
@@ -79,6 +207,22 @@ void TransactionGenerator::TryAddTransaction(uint64_t hex_addr, bool is_write,
     
 }
 
+// Hand one transaction to memory_system without advancing the clock, the
+// caller checked WillAcceptTransaction
+void TransactionGenerator::SubmitTransaction(uint64_t hex_addr, bool is_write,
+                                             uint8_t *DataPtr) {
+    if (is_write) {
+        //burstSize_ = 32B
+        uint8_t *new_data = (uint8_t *) malloc(burstSize_);
+        std::memcpy(new_data, DataPtr, burstSize_);
+	    //std::cout << std::hex << clk_ << "\twrite\t" << hex_addr << std::dec << std::endl;
+        memory_system_.AddTransaction(hex_addr, is_write, new_data);
+    } else {
+		//std::cout << std::hex << clk_ << "\tread\t" << hex_addr << std::dec << std::endl;
+        memory_system_.AddTransaction(hex_addr, is_write, DataPtr);
+    }
+}
+
 // Prevent turning out of order between transaction parts
 //  Change memory's threshold and wait until all pending transactions are
 //  executed
@@ -92,6 +236,91 @@ void TransactionGenerator::Barrier() {
     memory_system_.SetWriteBufferThreshold(-1);
 }
 
+// Issue per-channel transaction streams
+//  interleave_channels_ on  : every cycle each channel whose queue accepts
+//                             gets up to issue_width_ transactions
+//                             (round-robin start), a full channel is skipped
+//                             instead of stalling the others
+//  interleave_channels_ off : channel after channel with TryAddTransaction
+//                             (the old issue order)
+//  The order inside one channel is kept, the PIM units see the same triggers
+void TransactionGenerator::IssueInterleaved(int channels, StreamFn next) {
+    std::vector<std::vector<HostTransaction>> stream(channels);
+    std::vector<size_t> pos(channels, 0);
+    std::vector<bool> done(channels, false);
+
+    if (!interleave_channels_) {
+        for (int ch = 0; ch < channels; ch++) {
+            while (next(ch, stream[ch])) {
+                for (const HostTransaction& t : stream[ch])
+                    TryAddTransaction(t.hex_addr, t.is_write,
+                                      t.data ? t.data : data_temp_);
+                stream[ch].clear();
+            }
+        }
+        return;
+    }
+
+    int remaining = channels;
+    int start = 0;
+    while (remaining > 0) {
+        for (int i = 0; i < channels; i++) {
+            int ch = (start + i) % channels;
+            for (int w = 0; w < issue_width_ && !done[ch]; w++) {
+                // refill, skipping empty chunks
+                while (pos[ch] == stream[ch].size()) {
+                    stream[ch].clear();
+                    pos[ch] = 0;
+                    if (!next(ch, stream[ch])) {
+                        done[ch] = true;
+                        remaining--;
+                        break;
+                    }
+                }
+                if (done[ch])
+                    break;
+                const HostTransaction& t = stream[ch][pos[ch]];
+                if (!memory_system_.WillAcceptTransaction(t.hex_addr,
+                                                          t.is_write))
+                    break;
+                SubmitTransaction(t.hex_addr, t.is_write,
+                                  t.data ? t.data : data_temp_);
+                pos[ch]++;
+            }
+        }
+        start = (start + 1) % channels;
+        memory_system_.ClockTick();
+        clk_++;
+    }
+}
+
+// Batched submission of independent transactions
+//  Split by channel and issued with IssueInterleaved, so every controller
+//  queue with room is filled in the same cycle. With interleave_channels_
+//  off they go one by one in the given order
+void TransactionGenerator::AddTransactions(const HostTransaction *txs,
+                                           size_t n) {
+    if (!interleave_channels_) {
+        for (size_t i = 0; i < n; i++)
+            TryAddTransaction(txs[i].hex_addr, txs[i].is_write,
+                              txs[i].data ? txs[i].data : data_temp_);
+        return;
+    }
+    std::vector<std::vector<HostTransaction>> per_channel(config_->channels);
+    for (size_t i = 0; i < n; i++)
+        per_channel[config_->AddressMapping(txs[i].hex_addr).channel]
+            .push_back(txs[i]);
+    std::vector<bool> taken(config_->channels, false);
+    IssueInterleaved(config_->channels,
+                     [&](int ch, std::vector<HostTransaction>& out) {
+                         if (taken[ch] || per_channel[ch].empty())
+                             return false;
+                         taken[ch] = true;
+                         out.swap(per_channel[ch]);
+                         return true;
+                     });
+}
+
 void SpmmTransactionGenerator::Initialize() {
     std::cout<<"Initialize SpmmTransactionGenerator" << std::endl;
     addr_B0_ = 0; // base address
@@ -152,19 +381,12 @@ void SpmmTransactionGenerator::Initialize() {
     std::cout << "Max ukernel iteration: " << kernel_execution_time_ << std::endl;
     std::cout << "Min ukernel iteration: " << min_kernel_execution_time_ << std::endl;
 
-    // SpMM Ukernel 정의 (총 11개 명령어)
+    // SpMM Ukernel 정의 (총 10개 명령어, kUKernelSpmm)
     ukernel_spmm_ = (uint32_t *) malloc(sizeof(uint32_t) * 32); // 32개 명령어 분량 할당 (넉넉하게)
-    
-    ukernel_spmm_[0]=0b01000010000000001000000000000000;  // MOV(AAM0) GRF_A BANK
-    ukernel_spmm_[1]=0b01001000010000001000000000000000;  // MOV(AAM0) SRF_M GRF_A           
-    ukernel_spmm_[2]=0b10010101011000001000000000000000;  // MUL_DRF(AAM0) GRF_B DRF SRF_M   
-    ukernel_spmm_[3]=0b10000100100100001000000000000000;  // ADD(AAM0) GRF_B GRF_B GRF_B
-    ukernel_spmm_[4]=0b11010000010001000101100010100000;  // LOOP -3 GRF_A[2]    
-    ukernel_spmm_[5]=0b11000100100000001000000000000000;  // SACC(AAM0) GRF_B GRF_B              
-    ukernel_spmm_[6]=0b00010000000001000111100000011000;  // JUMP -7 16                       
-    ukernel_spmm_[7]=0b01000000100000001000000000000000;  // MOV(AAM0) BANK GRF_B            
-    ukernel_spmm_[8]=0b00010000000001000100100000001111;  // JUMP -1 7                       
-    ukernel_spmm_[9]=0b00100000000000000000000000000000;  // EXIT
+    UKernel kernel;
+    if (!kernel.Assemble(kUKernelSpmm))
+        AbruptExit(__FILE__, __LINE__);
+    kernel.CopyTo(ukernel_spmm_, 32);
 
     // no BGA
     // ukernel_spmm_[0]=0b01000010000000001000000000000000;  // MOV(AAM0) GRF_A BANK
@@ -177,10 +399,48 @@ void SpmmTransactionGenerator::Initialize() {
     // ukernel_spmm_[7]=0b00010000000001000100100000001111;  // JUMP -1 7                       
     // ukernel_spmm_[8]=0b00100000000000000000000000000000;  // EXIT
 
+    // Dense operand을 DRF 크기(DRF_ROWS x DRF_COLS)로 N 방향 tiling
+    //  tile t = dense rows 0..15, columns t*16 .. t*16+15 (나머지는 0)
+    if (dense_width_ == 0) {
+        std::cerr << "SpMM dense width must be positive" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    dense_tiles_ = (dense_width_ + DRF_COLS - 1) / DRF_COLS;
+    output_row_stride_ = kernel_execution_time_;
+    // result rows of the last tile must stay below the PIM register rows
+    if ((uint64_t)dense_tiles_ * output_row_stride_ > MAP_DRF) {
+        std::cerr << "SpMM dense width " << dense_width_
+                  << " does not fit the result rows" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    // MUL_DRF takes DRF row (column index % DRF_ROWS) for every nonzero of
+    //  a row, so K is not tiled: dense rows past DRF_ROWS would alias
+    size_t dense_rows = dense_matrix_.size() / dense_width_;
+    if (dense_rows > DRF_ROWS) {
+        std::cerr << "SpMM dense operand has " << dense_rows << " rows, the DRF holds "
+                  << DRF_ROWS << " (K tiling is not supported)" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    size_t tile_units = DRF_SIZE / sizeof(uint16_t);
+    drf_tiles_.assign(dense_tiles_ * tile_units, 0x3c00);  // FP16 1.0
+    if (!dense_matrix_.empty()) {
+        for (int t = 0; t < dense_tiles_; t++) {
+            for (int r = 0; r < DRF_ROWS; r++) {
+                for (int c = 0; c < DRF_COLS; c++) {
+                    uint32_t col = t * DRF_COLS + c;
+                    drf_tiles_[t * tile_units + r * DRF_COLS + c] =
+                        ((size_t)r < dense_rows && col < dense_width_)
+                            ? dense_matrix_[r * dense_width_ + col] : 0;
+                }
+            }
+        }
+    }
+    std::cout << "Dense width: " << dense_width_ << " (" << dense_tiles_
+              << " DRF tiles)" << std::endl;
 }
 void SpmmTransactionGenerator::SetData() {
     // strided size of one operand with one computation part(minimum)
-    // UNIT_SIZE = 2, SIZE_WORD = 32, NUM_BANK = 256
+    // UNIT_SIZE = 2, SIZE_WORD = 32, num_banks_ = 256
     // strided_size = 2 * 32 * 256 = 16384
 
     #ifdef debug_mode
@@ -193,7 +453,7 @@ void SpmmTransactionGenerator::SetData() {
     // // 16(ch) * 4(bg) = 64개의 (채널, 뱅크그룹) 조합을 순회
     // for (size_t i = 0; i < B0_data_.size(); ++i) {
     //     uint32_t bg = i % 4;          // BankGroup (0, 1, 2, 3)
-    //     uint32_t current_ch = i / 4;  // Channel (0 ~ 15)
+    //     uint32_t current_ch = i / num_bankgroups_;  // Channel (0 ~ 15)
         
     //     // 현재 (ch, bg)에 할당된 모든 블록(j)을 순회
     //     for (size_t j = 0; j < B0_data_[i].size(); ++j) {
@@ -223,7 +483,7 @@ void SpmmTransactionGenerator::SetData() {
     // }
     // for (size_t i = 0; i < B2_data_.size(); ++i) {
     //     uint32_t bg = i % 4;          // BankGroup (0, 1, 2, 3)
-    //     uint32_t current_ch = i / 4;  // Channel (0 ~ 15)
+    //     uint32_t current_ch = i / num_bankgroups_;  // Channel (0 ~ 15)
         
     //     for (size_t j = 0; j < B2_data_[i].size(); ++j) {
     //         // 1. Bank(ba)를 2로 고정합니다.
@@ -250,21 +510,8 @@ void SpmmTransactionGenerator::SetData() {
     // }
     // Barrier();
 
-    #ifdef debug_mode
-    std::cout << "\nHOST:\tLoad Dense Matrix to DRF (512B)\n";
-    #endif
-    // DRF는 512B = 32B * 16 Rows. MAP_DRF(0x3ff7)의 col 0~15에 쓰기.
-    for (int ch = 0; ch < NUM_CHANNEL; ch++) {
-        // for (int bg = 0; bg < 4; bg++) {
-        for (int co = 0; co < 16; co++) {
-            Address addr(ch, 0, 0, EVEN_BANK, MAP_DRF, co);
-            uint64_t hex_addr = ReverseAddressMapping(addr);
-            // data_temp_에는 적절한 Dense Matrix 데이터가 들어있다고 가정
-            TryAddTransaction(hex_addr, true, data_temp_);
-        }
-        // }
-    }
-    Barrier();
+    // Dense Matrix의 DRF load는 Execute에서 tile마다 수행 (DrfLoad)
+    //  MAP_DRF는 PIM mode에서만 PimUnit::SetDrf로 전달됨
 
     //exit(1);
     std::cout << "SetData Done" << std::endl;
@@ -274,7 +521,7 @@ void SpmmTransactionGenerator::SetData() {
     #ifdef debug_mode
     std::cout << "\nHOST:\t[1] SB -> AB \n";
     #endif
-    for (int ch = 0; ch < NUM_CHANNEL; ch++) {
+    for (int ch = 0; ch < num_channels_; ch++) {
         Address addr(ch, 0, 0, 0, MAP_ABMR, 0);
         uint64_t hex_addr = ReverseAddressMapping(addr);
         TryAddTransaction(hex_addr, false, data_temp_);
@@ -284,7 +531,7 @@ void SpmmTransactionGenerator::SetData() {
     #ifdef debug_mode
     std::cout << "\nHOST:\tProgram SpMM μkernel \n";
     #endif
-    for (int ch = 0; ch < NUM_CHANNEL; ch++) {
+    for (int ch = 0; ch < num_channels_; ch++) {
         // Ukernel이 총 10개 명령어로, 32Byte(명령어 8개) 단위로 전송 시 2번의 트랜잭션이 필요
         // co=0: 명령어 0~7 전송
         // co=1: 명령어 8~15 전송 (여기서는 8~9번 명령어와 나머지 NOP가 전송됨)
@@ -307,109 +554,148 @@ void SpmmTransactionGenerator::Execute() {
     #endif
     *data_temp_ |= 1;
     
-    for (int ch = 0; ch < NUM_CHANNEL; ch++) {
+    total_n_rows.assign(num_channels_, 0); // initialize counts
+    for (int ch = 0; ch < num_channels_; ch++) {
         //ch, rank, bankgroup, bank, row, column
         Address addr(ch, 0, 0, 0, MAP_PIM_OP_MODE, 0); // MAP_PIM_OP_MODE = 0x3ffd
         uint64_t hex_addr = ReverseAddressMapping(addr);
         TryAddTransaction(hex_addr, true, data_temp_);
-        total_n_rows[ch] = 0; // initialize counts
     }
     Barrier();
     #ifdef debug_mode
     std::cout << "\nHOST:\tExecute μkernel\n";
     #endif
 
-    for (int ch = 0; ch < NUM_CHANNEL; ch++) {
-    // for (int ro = 0; ro < kernel_execution_time_; ro++) {
-        int n_rows = (int) max_b0 ? B0_data_[ch * 4 + 0].size() : B2_data_[ch * 4 + 0].size(); // bankgroup 0 고정
-        int accum_rds = 0;
-        for (int ro = 0; ro < n_rows; ro++) {
-        // for (int ch = 0; ch < NUM_CHANNEL; ch++) {
-            int rd_index = 0;
-            int n_rds_per_row = (int) max_b0 ? B0_data_[ch * 4 + 0][ro].n_rd : B2_data_[ch * 4 + 0][ro].n_rd;
-            total_n_rows[ch] += n_rds_per_row;
-            // ukernel iteration per row buffer
-            // int n_chunk_per_row_buffer = (int) max_b0 ? B0_data_[ch * 4 + 0][ro].n_chunk : B2_data_[ch * 4 + 0][ro].n_chunk;
-            accum_rds = (n_rds_per_row > 16) ? accum_rds += (n_rds_per_row - 16) : accum_rds; // 16개 초과하는 RD가 있으면 누적
-            int ad_iter = 1;
-            if (accum_rds > 16) {
-                ad_iter += 1;
-                accum_rds = accum_rds - 16;
-            }
-            for (int ad = 0; ad < ad_iter; ad++ ) {
-                for (int j = 0; j < 16; j++) { // JUMP 16번 반복 (j = 0 to 15)
-                    // MOV(AAM0) GRF_A EVEN_BANK
-                    int co = 0;
-                    Address addr(ch, 0, 0, EVEN_BANK, ro, co); 
-                    uint64_t hex_addr = ReverseAddressMapping(addr);
-                    TryAddTransaction(addr_B0_ + hex_addr, false, data_temp_);
-
-                    // Determine loop count
-                    int loop = (int) max_b0 ? B0_data_[ch * 4 + 0][ro].row_count[rd_index] : B2_data_[ch * 4 + 0][ro].row_count[rd_index];
-                    if (loop == 0 || ad > 0) loop = 1;
-                    rd_index++;
-                    for (int k = 0; k < loop; k++) { // loop
-                        // Execute ukernel 0 MOV(AAM0) SRF_M GRF_A
-                        // AAM(0) 및 col=0으로 트리거
-                        Address addr_0(ch, 0, 0, EVEN_BANK, ro, co); 
-                        uint64_t hex_addr_0 = ReverseAddressMapping(addr_0);
-                        TryAddTransaction(addr_B0_ + hex_addr_0, false, data_temp_);
-                        // ukernel[1]: MUL_DRF(AAM0) GRF_B DRF SRF_M
-                        // GRF_A[24] -> DRF Index, SRF_M[0] * DRF[idx] -> GRF_B[j]
-                        // AAM(0), col=1, dst=GRF_B[j] (j는 JUMP 루프 카운터)
-                        Address addr_1(ch, 0, 0, EVEN_BANK, ro, j * 1); // col=j (AAM으로 GRF_B[j] 선택)
-                        uint64_t hex_addr_1 = ReverseAddressMapping(addr_1);
-                        TryAddTransaction(hex_addr_1, false, data_temp_);
-
-                        // ukernel[2]: ADD(AAM0) GRF_B GRF_B GRF_B
-                        Address addr_2(ch, 0, 0, EVEN_BANK, ro, j * 1); // col=j
-                        uint64_t hex_addr_2 = ReverseAddressMapping(addr_2);
-                        TryAddTransaction(hex_addr_2, false, data_temp_);
-
-                        // ukernel[3]: LOOP -2 GRF_A[2] (PIM 유닛이 내부적으로 PPC를 1로 돌림)
-                        Address addr_3(ch, 0, 0, EVEN_BANK, ro, j * 1); // col=j
-                        uint64_t hex_addr_3 = ReverseAddressMapping(addr_3);
-                        TryAddTransaction(hex_addr_3, false, data_temp_);
-                    } // end loop
-                    // ukernel[4]: SACC(AAM0) GRF_B GRF_B
-                    Address addr_4(ch, 0, 0, EVEN_BANK, ro, j * 1); // col=j
-                    TryAddTransaction(ReverseAddressMapping(addr_4), false, data_temp_);
-                    
-                    // ukernel[6]: JUMP -6 16 (PIM 유닛이 내부적으로 PPC를 1로 돌림)
-                    Address addr_6(ch, 0, 0, EVEN_BANK, ro, j * 1); // col=j
-                    TryAddTransaction(ReverseAddressMapping(addr_6), false, data_temp_);
-                } // end jump
-            } // end ad_iter
-            // ukernel[8] (JUMP -1 7)에 의해 8번 반복 (w = 0 to 7)
-            // GRF_B[0] ~ GRF_B[7]을 Bank 0, Col 0~7에 씀
-            for (int w = 0; w < 8; w++) {
-                // ukernel[7]: MOV(AAM0) BANK GRF_B
-                // AAM(0), col=w, src0=GRF_B[w]
-                Address addr_7(ch, 0, 0, ODD_BANK, ro, w); // col=w (0~7)
-                TryAddTransaction(ReverseAddressMapping(addr_7), true, data_temp_); // Write=true
-
-                // ukernel[8]: JUMP -1 7
-                Address addr_8(ch, 0, 0, ODD_BANK, ro, w); // col=w (0~7)
-                TryAddTransaction(ReverseAddressMapping(addr_8), true, data_temp_); // Write=true
-            }
-
-            // ukernel[9]: EXIT
-            Address addr_9(ch, 0, 0, EVEN_BANK, ro, 8); // 다음 col (8)
-            TryAddTransaction(ReverseAddressMapping(addr_9), false, data_temp_);
-
+    // Per-channel trigger streams, one DRAM row per chunk, issued with the
+    // channels interleaved (IssueInterleaved). Each dense tile replays all
+    // rows after loading its DRF; a channel reloads as soon as its own rows
+    // of the previous tile are issued, the others keep executing
+    std::vector<int> tile(num_channels_, 0);
+    std::vector<int> next_row(num_channels_, -1); // -1: DRF of tile not loaded
+    std::vector<int> accum_rds(num_channels_, 0);
+    IssueInterleaved(num_channels_, [&](int ch, std::vector<HostTransaction>& out) {
+        int n_rows = (int) max_b0 ? B0_data_[ch * num_bankgroups_ + 0].size() : B2_data_[ch * num_bankgroups_ + 0].size(); // bankgroup 0 고정
+        if (next_row[ch] >= n_rows) {
+            tile[ch]++;
+            next_row[ch] = -1;
+            accum_rds[ch] = 0;
         }
-        
-    }
+        if (tile[ch] >= dense_tiles_)
+            return false;
+        if (next_row[ch] < 0) {
+            DrfLoad(ch, tile[ch], out);
+            next_row[ch] = 0;
+            return true;
+        }
+        int ro = next_row[ch]++;
+        RowTriggers(ch, ro, tile[ch] * output_row_stride_ + ro, accum_rds[ch],
+                    out);
+        return true;
+    });
 
     Barrier();
 }
+// DRF load of one dense tile (DRF_SIZE = 16 x 32B writes to MAP_DRF)
+//  SetDrf takes one 32B row per write (row = column). EXIT of the previous
+//  pass left the channel in AB mode, so tiles after the first re-enter PIM
+void SpmmTransactionGenerator::DrfLoad(int ch, int tile,
+                                       std::vector<HostTransaction>& out) {
+    if (tile > 0) {
+        Address addr(ch, 0, 0, 0, MAP_PIM_OP_MODE, 0);
+        HostTransaction t = {ReverseAddressMapping(addr), true, nullptr};
+        out.push_back(t);
+    }
+    uint8_t *image = (uint8_t*)&drf_tiles_[tile * (DRF_SIZE / sizeof(uint16_t))];
+    for (int co = 0; co < DRF_ROWS; co++) {
+        Address addr(ch, 0, 0, EVEN_BANK, MAP_DRF, co);
+        HostTransaction t = {ReverseAddressMapping(addr), true, image + co * WORD_SIZE};
+        out.push_back(t);
+    }
+}
+// Host triggers of one DRAM row of channel ch (the hand-written μkernel
+// replay, accum_rds carries the RDs beyond 16 over to the next row)
+//  out_ro: ODD_BANK row that receives the GRF_B results
+void SpmmTransactionGenerator::RowTriggers(int ch, int ro, int out_ro,
+                                           int& accum_rds,
+                                           std::vector<HostTransaction>& out) {
+    auto push = [&](uint64_t hex_addr, bool is_write) {
+        HostTransaction t = {hex_addr, is_write, nullptr};
+        out.push_back(t);
+    };
+    int rd_index = 0;
+    int n_rds_per_row = (int) max_b0 ? B0_data_[ch * num_bankgroups_ + 0][ro].n_rd : B2_data_[ch * num_bankgroups_ + 0][ro].n_rd;
+    total_n_rows[ch] += n_rds_per_row;
+    // ukernel iteration per row buffer
+    accum_rds = (n_rds_per_row > 16) ? accum_rds += (n_rds_per_row - 16) : accum_rds; // 16개 초과하는 RD가 있으면 누적
+    int ad_iter = 1;
+    if (accum_rds > 16) {
+        ad_iter += 1;
+        accum_rds = accum_rds - 16;
+    }
+    for (int ad = 0; ad < ad_iter; ad++ ) {
+        for (int j = 0; j < 16; j++) { // JUMP 16번 반복 (j = 0 to 15)
+            // MOV(AAM0) GRF_A EVEN_BANK
+            int co = 0;
+            Address addr(ch, 0, 0, EVEN_BANK, ro, co);
+            push(addr_B0_ + ReverseAddressMapping(addr), false);
+
+            // Determine loop count
+            int loop = (int) max_b0 ? B0_data_[ch * num_bankgroups_ + 0][ro].row_count[rd_index] : B2_data_[ch * num_bankgroups_ + 0][ro].row_count[rd_index];
+            if (loop == 0 || ad > 0) loop = 1;
+            rd_index++;
+            for (int k = 0; k < loop; k++) { // loop
+                // ukernel[1]: MOV(AAM0) SRF_M GRF_A
+                // AAM(0) 및 col=0으로 트리거
+                Address addr_0(ch, 0, 0, EVEN_BANK, ro, co);
+                push(addr_B0_ + ReverseAddressMapping(addr_0), false);
+                // ukernel[2]: MUL_DRF(AAM0) GRF_B DRF SRF_M
+                // GRF_A[24] -> DRF Index, SRF_M[0] * DRF[idx] -> GRF_B[j]
+                // AAM(0), col=j (AAM으로 GRF_B[j] 선택)
+                Address addr_1(ch, 0, 0, EVEN_BANK, ro, j * 1);
+                push(ReverseAddressMapping(addr_1), false);
+
+                // ukernel[3]: ADD(AAM0) GRF_B GRF_B GRF_B
+                Address addr_2(ch, 0, 0, EVEN_BANK, ro, j * 1); // col=j
+                push(ReverseAddressMapping(addr_2), false);
+
+                // ukernel[4]: LOOP -3 GRF_A[2] (PIM 유닛이 내부적으로 PPC를 1로 돌림)
+                Address addr_3(ch, 0, 0, EVEN_BANK, ro, j * 1); // col=j
+                push(ReverseAddressMapping(addr_3), false);
+            } // end loop
+            // ukernel[5]: SACC(AAM0) GRF_B GRF_B
+            Address addr_4(ch, 0, 0, EVEN_BANK, ro, j * 1); // col=j
+            push(ReverseAddressMapping(addr_4), false);
+
+            // ukernel[6]: JUMP -6 16 (PIM 유닛이 내부적으로 PPC를 0으로 돌림)
+            Address addr_6(ch, 0, 0, EVEN_BANK, ro, j * 1); // col=j
+            push(ReverseAddressMapping(addr_6), false);
+        } // end jump
+    } // end ad_iter
+    // ukernel[8] (JUMP -1 7)에 의해 8번 반복 (w = 0 to 7)
+    // GRF_B[0] ~ GRF_B[7]을 Bank 0, Col 0~7에 씀
+    for (int w = 0; w < 8; w++) {
+        // ukernel[7]: MOV(AAM0) BANK GRF_B
+        // AAM(0), col=w, src0=GRF_B[w]
+        Address addr_7(ch, 0, 0, ODD_BANK, out_ro, w); // col=w (0~7)
+        push(ReverseAddressMapping(addr_7), true); // Write=true
+
+        // ukernel[8]: JUMP -1 7
+        Address addr_8(ch, 0, 0, ODD_BANK, out_ro, w); // col=w (0~7)
+        push(ReverseAddressMapping(addr_8), true); // Write=true
+    }
+
+    // ukernel[9]: EXIT
+    Address addr_9(ch, 0, 0, EVEN_BANK, ro, 8); // 다음 col (8)
+    push(ReverseAddressMapping(addr_9), false);
+}
+
 void SpmmTransactionGenerator::GetResult() {
     // no need to change mode for write to bank
     // SB mode change 후, logic die로 partial data 전송
     #ifdef debug_mode
     std::cout << "HOST:\t[4] AB -> SB \n";
     #endif
-    for (int ch = 0; ch < NUM_CHANNEL; ch++) {
+    for (int ch = 0; ch < num_channels_; ch++) {
         Address addr(ch, 0, 0, 0, MAP_SBMR, 0);
         uint64_t hex_addr = ReverseAddressMapping(addr);
         TryAddTransaction(hex_addr, false, data_temp_);
@@ -417,12 +703,16 @@ void SpmmTransactionGenerator::GetResult() {
     Barrier();
     *data_temp_ |= 1;
 
-    for (int ch = 0; ch < NUM_CHANNEL; ch++) {
-        for (int ro = 0; ro < total_n_rows[ch]/32; ++ro) { // 1kb 당 32 x 16
-            for (int co = 0; co < 32; co++) {
-                Address addr(ch, 0, 0, ODD_BANK, ro, co); // ODD_BANK에 저장된 결과
-                uint64_t hex_addr = ReverseAddressMapping(addr);
-                TryAddTransaction(hex_addr, false, data_temp_);
+    for (int ch = 0; ch < num_channels_; ch++) {
+        // 결과는 dense tile마다 output_row_stride_ 간격의 ODD_BANK row에 있음
+        int tile_rds = total_n_rows[ch] / dense_tiles_;
+        for (int t = 0; t < dense_tiles_; t++) {
+            for (int ro = 0; ro < tile_rds/32; ++ro) { // 1kb 당 32 x 16
+                for (int co = 0; co < 32; co++) {
+                    Address addr(ch, 0, 0, ODD_BANK, t * output_row_stride_ + ro, co); // ODD_BANK에 저장된 결과
+                    uint64_t hex_addr = ReverseAddressMapping(addr);
+                    TryAddTransaction(hex_addr, false, data_temp_);
+                }
             }
         }
         for (int co = 0; co < 32; co++) {   
@@ -448,7 +738,7 @@ void SpmvTransactionGenerator::Initialize() { //여기는 코딩 끝
 
     //ukenrnel_access_size는 모두 SIZE_WORD * 8 * NUM_BANK로 동일
     //ukernel_access_size = Word(32) * 8 * # of Bank(256) = 65536
-    ukernel_access_size_ = SIZE_WORD * 8 * NUM_BANK; // SIZE_WORD = 32, NUM_BANK = 256 (Channel 당 Bank 수는 16, 16채널)
+    ukernel_access_size_ = SIZE_WORD * 8 * num_banks_; // SIZE_WORD = 32, num_banks_ = channels x banks (HBM2 test config 16 x 16 = 256)
     //UNIT_SIZE = 2, ukernel_access_size_ = 65536
     
     // (TODO) N을 어떻게 결정?
@@ -458,6 +748,48 @@ void SpmvTransactionGenerator::Initialize() { //여기는 코딩 끝
     // Define ukernel for spmv
     ukernel_spmv_ = (uint32_t *) malloc(sizeof(uint32_t) * 32);
 
+    // Per-tile formats: the tiles that stay DRAF rows run as before
+    if (Mixed() && rebalance_) {
+        std::cerr << "--rebalance moves DRAF rows, not the rows of a "
+                  << "mixed-format image" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    if (rebalance_)
+        Rebalance();
+    // the merge tree pairs the channels row by row, the pipelined groups
+    // run their rows in different steps
+    if (gacc_reduction_ && pipeline_tile_rows_ > 0) {
+        std::cerr << "--gacc-reduction needs every channel in the same row, "
+                  << "not with --pipeline-tile" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    if (tile_format_ != "draf" && !Mixed()) {
+        int format;
+        if (!parseTileFormat(tile_format_, &format)) {
+            std::cerr << "Unknown tile format " << tile_format_ << std::endl;
+            AbruptExit(__FILE__, __LINE__);
+        }
+        tile_cost_model model = defaultTileCostModel();
+        model.banks_per_group = banks_per_group_;
+        model.cycles_per_trigger = config_->tCCD_L;
+        mixed_ = selectTileFormats(DRAF_BG_, model, format);
+    }
+    if (Mixed()) {
+        if (pipeline_tile_rows_ > 0) {
+            std::cerr << "Pipelined SpMV streams DRAF rows only, "
+                      << "mixed tile formats are not supported" << std::endl;
+            AbruptExit(__FILE__, __LINE__);
+        }
+        CheckPimGeometry(mixed_.draf.size());
+        printTileFormatSummary(mixed_);
+        // whole DRAM rows of DRAF, padded with empty rows like Rebalance
+        re_aligned_dram_format empty;
+        memset(&empty, 0, sizeof(empty));
+        DRAF_BG_ = mixed_.draf;
+        for (std::vector<re_aligned_dram_format>& rows : DRAF_BG_)
+            rows.resize((rows.size() + banks_per_group_ - 1) / banks_per_group_ * banks_per_group_, empty);
+    }
+
     // ukernel을 몇번 실행시킬지 결정하기 위해 추가한 코드
     // 가장 row를 많이 차지하는 DRAF_BG를 찾아서 그것을 기준으로 ukernel_count_per_pim_를 결정
     size_t max_size = 0;
@@ -473,32 +805,207 @@ void SpmvTransactionGenerator::Initialize() { //여기는 코딩 끝
     }
 
     // 가장 많은 row를 차지하는 DRAF_BG를 찾아서 그것을 기준으로 ukernel_count_per_pim_를 결정
-    // 4를 나누는 것은 BG 기준으로 묶여 있기 때문에, 4등분이 이루어지는 것을 고려
-    kernel_execution_time_ = DRAF_BG_[max_index].size() / 4; // ukernel_count_per_pim_
+    // banks_per_group_으로 나누는 것은 BG 기준으로 묶여 있기 때문에, bank 수만큼 등분이 이루어지는 것을 고려
+    kernel_execution_time_ = DRAF_BG_[max_index].size() / banks_per_group_; // ukernel_count_per_pim_
     std::cout << "Max # of rows: " << kernel_execution_time_ << std::endl;
+
+    // early_exit_: channel 별로 가장 긴 BG 만큼만 실행
+    channel_rows_.assign(num_channels_, kernel_execution_time_);
+    if (early_exit_) {
+        for (int ch = 0; ch < num_channels_; ch++) {
+            uint32_t rows = 0;
+            for (int bg = 0; bg < num_bankgroups_; bg++)
+                rows = std::max(rows, (uint32_t)(DRAF_BG_[ch * num_bankgroups_ + bg].size() / banks_per_group_));
+            channel_rows_[ch] = rows;
+        }
+    }
     
-    //Even bank
-    // 하나의 ROW가 process 됨
-    ukernel_spmv_[0]=0b01001000000000001000000000000000;  // MOV(AAM0) SRF_M BANK
-    ukernel_spmv_[1]=0b10010010001000001000000000000000;  // MUL(AAM0) GRF_A BANK SRF_M
-    ukernel_spmv_[2]=0b11000000000000001000000000000000;  // SACC(AAM0) BANK BANK
-    ukernel_spmv_[3]=0b11000000000000001000000000000000;  // SACC(AAM0) BANK BANK
-    ukernel_spmv_[4]=0b00010000000001000001100000000110;  // JUMP -3 6
-    ukernel_spmv_[5]=0b01000000010000001000000000000000;  // MOV(AAM0) BANK GRF_A
-    ukernel_spmv_[6]=0b00010000000001000000100000000110; //JUMP -1 6
-
-    //Odd bank
-    // 하나의 ROW가 process 됨
-    ukernel_spmv_[7]=0b01001000000000001000000000000000;  // MOV(AAM0) SRF_M BANK
-    ukernel_spmv_[8]=0b10010010001000001000000000000000;  // MUL(AAM0) GRF_A BANK SRF_M
-    ukernel_spmv_[9]=0b11000000000000001000000000000000;  // SACC(AAM0) BANK BANK
-    ukernel_spmv_[10]=0b11000000000000001000000000000000;  // SACC(AAM0) BANK BANK
-    ukernel_spmv_[11]=0b00010000000001000001100000000110;  // JUMP -3 6
-    ukernel_spmv_[12]=0b01000000010000001000000000000000;  // MOV(AAM0) BANK GRF_A
-    ukernel_spmv_[13]=0b00010000000001000000100000000110;  //JUMP -1 6
-    // Exit
-    ukernel_spmv_[14]=0b00100000000000000000000000000000;  // EXIT
+    // Even bank / Odd bank 각각 하나의 ROW가 process 됨 (kUKernelSpmv)
+    UKernel kernel;
+    if (!kernel.Assemble(kUKernelSpmv))
+        AbruptExit(__FILE__, __LINE__);
+    kernel.CopyTo(ukernel_spmv_, 32);
+    spmv_schedule_ = kernel.Schedule();
+    for (const UKernelTrigger& t : spmv_schedule_) {
+        bool placed = t.op == PIM_OPERATION::MUL || t.op == PIM_OPERATION::SACC ||
+                      t.op == PIM_OPERATION::MOV;
+        if (!placed) {
+            std::cerr << "RowTriggers has no column for slot " << t.slot
+                      << " (" << kernel.Source(t.slot) << ")" << std::endl;
+            AbruptExit(__FILE__, __LINE__);
+        }
+    }
+    if (spmv_schedule_.empty())
+        AbruptExit(__FILE__, __LINE__);
 
+    if (Mixed())
+        InitializeMixed();
+}
+
+// Rows, μkernels and sparse_row images of the dense / sparse_row tiles
+//  dense rows start above the DRAF rows (and the rows their SACC triggers
+//  reach), sparse_row rows above the dense rows. Dense tiles take every
+//  bank like DRAF rows, a sparse_row block the EVEN bank of a PimUnit and
+//  the ODD bank the results
+void SpmvTransactionGenerator::InitializeMixed() {
+    size_t parts = DRAF_BG_.size();
+    if (mixed_.dense.size() != parts || mixed_.sparse_row.size() != parts) {
+        std::cerr << "Mixed-format image: " << parts << " DRAF, "
+                  << mixed_.dense.size() << " dense, "
+                  << mixed_.sparse_row.size() << " sparse_row partitions"
+                  << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    if (config_->pim_units > DRF_COLS) {
+        std::cerr << config_->pim_units << " PimUnits per channel do not fit "
+                  << "the " << DRF_COLS << " DRF lanes of sparse_row tiles"
+                  << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    uint32_t units_per_bg = banks_per_group_ / config_->pim_banks_per_unit;
+    dense_base_ = kernel_execution_time_ > 0 ? kernel_execution_time_ + RowLookahead() : 0;
+    dense_rows_.assign(num_channels_, 0);
+    sparse_row_rows_.assign(num_channels_, 0);
+    for (size_t p = 0; p < parts; p++) {
+        int ch = p / num_bankgroups_;
+        uint32_t dense = (mixed_.dense[p].size() + banks_per_group_ - 1) / banks_per_group_;
+        uint32_t sparse = (mixed_.sparse_row[p].size() + units_per_bg - 1) / units_per_bg;
+        dense_rows_[ch] = std::max(dense_rows_[ch], dense);
+        sparse_row_rows_[ch] = std::max(sparse_row_rows_[ch], sparse);
+    }
+    uint32_t dense_max = *std::max_element(dense_rows_.begin(), dense_rows_.end());
+    uint32_t sparse_max = *std::max_element(sparse_row_rows_.begin(), sparse_row_rows_.end());
+    // like the DRAF rows, every channel runs the longest channel's rows
+    if (!early_exit_) {
+        dense_rows_.assign(num_channels_, dense_max);
+        sparse_row_rows_.assign(num_channels_, sparse_max);
+    }
+    sparse_row_base_ = dense_base_ + dense_max;
+    if (sparse_row_base_ + sparse_max > MAP_DRF) {
+        std::cerr << "Mixed-format rows (" << sparse_row_base_ + sparse_max
+                  << ") do not fit below the PIM registers" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+
+    // sparse_row block -> tile directory entry (x of its column groups)
+    sparse_row_tile_.assign(parts, std::vector<uint32_t>());
+    for (size_t p = 0; p < parts; p++)
+        sparse_row_tile_[p].assign(mixed_.sparse_row[p].size(), 0);
+    for (size_t i = 0; i < mixed_.directory.size(); i++) {
+        const tile_entry& e = mixed_.directory[i];
+        if (e.format != TILE_SPARSE_ROW)
+            continue;
+        if (e.partition >= parts || e.first + e.count > sparse_row_tile_[e.partition].size()) {
+            std::cerr << "Mixed-format image: tile " << i
+                      << " points past its sparse_row rows" << std::endl;
+            AbruptExit(__FILE__, __LINE__);
+        }
+        for (uint32_t j = e.first; j < e.first + e.count; j++)
+            sparse_row_tile_[e.partition][j] = i;
+    }
+    // 32 words per block (packSparseRow), every PimUnit of the channel's
+    // rows has one (empty units too): the PimUnits run in lockstep, so the
+    // LOOP trip byte of descriptor d is the longest descriptor d of the row
+    sparse_row_image_.assign(parts, std::vector<uint8_t>());
+    sparse_row_trips_.assign(num_channels_, std::vector<uint8_t>());
+    for (int ch = 0; ch < num_channels_; ch++)
+        sparse_row_trips_[ch].assign(sparse_row_rows_[ch] * MAX_BLOCK_PER_ROW, 0);
+    for (size_t p = 0; p < parts; p++) {
+        int ch = p / num_bankgroups_;
+        sparse_row_image_[p].assign(sparse_row_rows_[ch] * units_per_bg * 32 * SIZE_WORD, 0);
+        for (size_t j = 0; j < mixed_.sparse_row[p].size(); j++) {
+            const sparse_row_format& block = mixed_.sparse_row[p][j];
+            packSparseRow(block, &sparse_row_image_[p][j * 32 * SIZE_WORD]);
+            uint8_t* trips = &sparse_row_trips_[ch][j / units_per_bg * MAX_BLOCK_PER_ROW];
+            for (uint32_t d = 0; d < block.n_rd && d < MAX_BLOCK_PER_ROW; d++)
+                trips[d] = std::max(trips[d], (uint8_t)std::max(1, (int)block.row_desc[d].NZE_count));
+        }
+    }
+    for (size_t p = 0; p < parts; p++) {
+        int ch = p / num_bankgroups_;
+        for (size_t j = 0; j < sparse_row_image_[p].size() / (32 * SIZE_WORD); j++) {
+            const uint8_t* trips = &sparse_row_trips_[ch][j / units_per_bg * MAX_BLOCK_PER_ROW];
+            for (int d = 0; d < MAX_BLOCK_PER_ROW && trips[d] > 0; d++)
+                sparse_row_image_[p][(j * 32 + d) * SIZE_WORD + 5] = trips[d] - 1;
+        }
+    }
+    drf_image_.assign((size_t)num_channels_ * DRF_ROWS * DRF_COLS, 0);
+
+    if (!dense_kernel_.Assemble(kUKernelSpmvDense))
+        AbruptExit(__FILE__, __LINE__);
+    dense_kernel_.CopyTo(dense_crf_, 32);
+    dense_schedule_ = dense_kernel_.Schedule();
+    if (dense_schedule_.empty())
+        AbruptExit(__FILE__, __LINE__);
+    if (!sparse_row_kernel_.Assemble(kUKernelSpmvSparseRow))
+        AbruptExit(__FILE__, __LINE__);
+    sparse_row_kernel_.CopyTo(sparse_row_crf_, 32);
+
+    std::cout << "Mixed rows: DRAF 0~" << kernel_execution_time_ << ", dense "
+              << dense_base_ << "~" << dense_base_ + dense_max << " ("
+              << dense_schedule_.size() << " triggers per pass), sparse_row "
+              << sparse_row_base_ << "~" << sparse_row_base_ + sparse_max
+              << std::endl;
+}
+
+// Moves DRAF tiles from the longest to the shortest BGs until they differ by
+// at most one tile. Every channel runs as many DRAM rows as the longest BG
+// (kernel_execution_time_), so that is the makespan.
+//  A tile is the banks_per_group_ DRAF rows of one DRAM row of a BG: the two
+//  PimUnits of a SharedAccumulator see the same rows as before and the SACC
+//  pairs are kept. Rows carry their own column group (col_group, vec), so a
+//  tile can go to any BG of any channel, ties prefer the same channel.
+//  Partial tiles are padded with empty rows (row index 0), they used to be
+//  dropped by the rounding down of kernel_execution_time_
+void SpmvTransactionGenerator::Rebalance() {
+    size_t bpg = banks_per_group_;
+    size_t parts = DRAF_BG_.size();
+    std::vector<size_t> tiles(parts);
+    size_t before = 0, total = 0;
+    for (size_t p = 0; p < parts; p++) {
+        tiles[p] = (DRAF_BG_[p].size() + bpg - 1) / bpg;
+        before = std::max(before, tiles[p]);
+        total += tiles[p];
+    }
+    re_aligned_dram_format empty;
+    memset(&empty, 0, sizeof(empty));
+    uint64_t moved = 0, cross_channel = 0;
+    while (parts > 0) {
+        size_t hi = 0, lo = 0;
+        for (size_t p = 1; p < parts; p++) {
+            if (tiles[p] > tiles[hi])
+                hi = p;
+        }
+        for (size_t p = 1; p < parts; p++) {
+            bool same = (p / num_bankgroups_ == hi / num_bankgroups_);
+            bool lo_same = (lo / num_bankgroups_ == hi / num_bankgroups_);
+            if (tiles[p] < tiles[lo] || (tiles[p] == tiles[lo] && same && !lo_same))
+                lo = p;
+        }
+        if (tiles[hi] < tiles[lo] + 2)
+            break;
+        // last tile of hi goes behind the last whole tile of lo
+        std::vector<re_aligned_dram_format>& src = DRAF_BG_[hi];
+        std::vector<re_aligned_dram_format>& dst = DRAF_BG_[lo];
+        dst.resize(tiles[lo] * bpg, empty);
+        size_t begin = (tiles[hi] - 1) * bpg;
+        dst.insert(dst.end(), src.begin() + begin, src.end());
+        src.resize(begin);
+        tiles[hi]--;
+        tiles[lo]++;
+        moved++;
+        if (hi / num_bankgroups_ != lo / num_bankgroups_)
+            cross_channel++;
+    }
+    size_t after = 0;
+    for (size_t p = 0; p < parts; p++) {
+        DRAF_BG_[p].resize(tiles[p] * bpg, empty);
+        after = std::max(after, tiles[p]);
+    }
+    std::cout << "Rebalance: makespan " << before << " -> " << after
+              << " DRAM rows (mean " << (parts ? (double)total / parts : 0.0)
+              << "), " << moved << " tiles moved, " << cross_channel
+              << " across channels" << std::endl;
 }
 
 //Memory에 PIM연산을 위한 데이터를 저장하는 과정
@@ -506,25 +1013,27 @@ void SpmvTransactionGenerator::Initialize() { //여기는 코딩 끝
 //column index 1번, value 7번, row index 14번, vector 1번 = 23번
 void SpmvTransactionGenerator::SetData(){
     // strided size of one operand with one computation part(minimum)
-    // UNIT_SIZE = 2, SIZE_WORD = 32, NUM_BANK = 256
+    // UNIT_SIZE = 2, SIZE_WORD = 32, num_banks_ = 256
     // strided_size = 2 * 32 * 256 = 16384
     
-    //uint64_t strided_size = Ceiling(n_ *x UNIT_SIZE, SIZE_WORD * NUM_BANK);
+    //uint64_t strided_size = Ceiling(n_ *x UNIT_SIZE, SIZE_WORD * num_banks_);
 
     #ifdef debug_mode
     std::cout << "HOST:\tSet input data...\n";
     #endif
 
     //std::cout<<"DRAF_BG_.size() : "<<DRAF_BG_.size()<<std::endl;
-    for (size_t i = 0; i < DRAF_BG_.size(); ++i) {
+    // Pipelined mode streams the DRAF rows during Execute (ExecutePipelined)
+    size_t num_bg = (pipeline_tile_rows_ > 0) ? 0 : DRAF_BG_.size();
+    for (size_t i = 0; i < num_bg; ++i) {
         //std::cout<<"DRAF_BG_["<<i<<"].size() : "<<DRAF_BG_[i].size()<<std::endl;
         //i=0 ~ 63
-        uint32_t bg = i % 4;          // Fixed bg for each DRAF_BG[i] //bg = 0, 1, 2, 3
+        uint32_t bg = i % num_bankgroups_; // Fixed bg for each DRAF_BG[i] //bg = 0, 1, 2, 3
         uint32_t ro = 0;     // Start row at 0 for each DRAF_BG[i]
-        uint32_t current_ch = i / 4;  // Increment ch after every 4 bg //ch = 0 ~ 15
+        uint32_t current_ch = i / num_bankgroups_;  // Increment ch after every 4 bg //ch = 0 ~ 15
 
         for (size_t j = 0; j < DRAF_BG_[i].size(); ++j) {
-            uint32_t ba = j % 4;      // Bank cycles 0, 1, 2, 3
+            uint32_t ba = j % banks_per_group_; // Bank cycles 0, 1, 2, 3
             if (ba == 0 && j > 0) {
                 ro++;        // Increment row after each full cycle of ba
             }
@@ -554,7 +1063,7 @@ void SpmvTransactionGenerator::SetData(){
                 Address addr(current_ch, 0, bg, ba, ro, co);
                 uint64_t hex_addr = ReverseAddressMapping(addr);
                 if(co <= 21 || co ==29){
-                    TryAddTransaction(hex_addr, true, const_cast<uint8_t*>(data_ptr + co*SIZE_WORD));
+                    SetDataWord(hex_addr, data_ptr + co*SIZE_WORD, co == 0);
                     // (TODO) 여기 쓰이는 데이터가 맞는지 확인 필요
                     /*if(taewoon_debugg){
                         if(co == 0){ //Col = 0일 때는 32B 4B data 8개
@@ -607,6 +1116,8 @@ void SpmvTransactionGenerator::SetData(){
             }
         }
     }
+    if (Mixed())
+        WriteMixedRows();
     //exit(1);
     std::cout << "SetData Done" << std::endl;
     Barrier();
@@ -615,7 +1126,7 @@ void SpmvTransactionGenerator::SetData(){
     #ifdef debug_mode
     std::cout << "\nHOST:\t[1] SB -> AB \n";
     #endif
-    for (int ch = 0; ch < NUM_CHANNEL; ch++) {
+    for (int ch = 0; ch < num_channels_; ch++) {
         Address addr(ch, 0, 0, 0, MAP_ABMR, 0);
         uint64_t hex_addr = ReverseAddressMapping(addr);
         TryAddTransaction(hex_addr, false, data_temp_);
@@ -626,7 +1137,7 @@ void SpmvTransactionGenerator::SetData(){
     #ifdef debug_mode
     std::cout << "\nHOST:\tProgram SpMV μkernel \n";
     #endif
-    for (int ch = 0; ch < NUM_CHANNEL; ch++) {
+    for (int ch = 0; ch < num_channels_; ch++) {
         for (int co = 0; co < 3; co++) { //for (int co = 0; co < 1; co++) {
             Address addr(ch, 0, 0, 0, MAP_CRF, co);
             uint64_t hex_addr = ReverseAddressMapping(addr);
@@ -637,6 +1148,10 @@ void SpmvTransactionGenerator::SetData(){
 }
 
 void SpmvTransactionGenerator::Execute() {
+    if (pipeline_tile_rows_ > 0) {
+        ExecutePipelined();
+        return;
+    }
     // NUM_WORD_PER_ROW = 32
     #ifdef debug_mode
     std::cout << "HOST:\tkernel_execution_time: " << kernel_execution_time_ << std::endl;
@@ -649,7 +1164,9 @@ void SpmvTransactionGenerator::Execute() {
         std::cout << "HOST:\t[2] AB -> PIM \n";
         #endif
         *data_temp_ |= 1;
-        for (int ch = 0; ch < NUM_CHANNEL; ch++) {
+        for (int ch = 0; ch < num_channels_; ch++) {
+            if ((uint32_t)ro >= channel_rows_[ch])  // early_exit_: channel done
+                continue;
             //ch, rank, bankgroup, bank, row, column
             Address addr(ch, 0, 0, 0, MAP_PIM_OP_MODE, 0); // MAP_PIM_OP_MODE = 0x3ffd
             uint64_t hex_addr = ReverseAddressMapping(addr);
@@ -663,153 +1180,377 @@ void SpmvTransactionGenerator::Execute() {
         std::cout << "\nHOST:\tExecute μkernel\n";
         #endif
 
+        // Trigger transactions of both banks are independent across the
+        // channels, submitted as one batch (AddTransactions)
+        std::vector<HostTransaction> batch;
+        for (int ch = 0; ch < num_channels_; ch++) {
+            if ((uint32_t)ro < channel_rows_[ch])
+                RowTriggers(ch, ro, batch);
+        }
+        AddTransactions(batch);
+
+        // Global accumulator trigger 하기 위한 코드
+        //  TRIGGER_GACC read: GRF_A register (= column) 하나를 merge tree로 보냄
+        //  TRIGGER_GACC write: 해당 channel의 stream 종료
+        //  early_exit_로 끝난 channel도 매 row eos를 보내야 merge node가
+        //  다른 channel의 stream을 계속 내려보냄 (빈 stream)
+        if (!gacc_reduction_)
+            continue;
         #ifdef debug_mode
-        std::cout << "\nHOST:\tExecute Evenbank\n";
+        std::cout << "\nHOST:\tExecute Global Accumulator\n";
         #endif
-
-        // Execute ukernel 0 (MOV 명령어)
-        for (int ch = 0; ch < NUM_CHANNEL; ch++) {
-            uint64_t co = 29;
-            Address addr(ch, 0, 0, EVEN_BANK, ro, co); //Column 29 indicate vector
+        for (uint64_t co = 0; co < 8; co++) {
+            for (int ch = 0; ch < num_channels_; ch++) {
+                if ((uint32_t)ro >= channel_rows_[ch])
+                    continue;
+                //channel, rank, bankgroup, bank, row, column
+                Address addr(ch, 0, 0, ODD_BANK, TRIGGER_GACC, co);
+                uint64_t hex_addr = ReverseAddressMapping(addr);
+                TryAddTransaction(hex_addr, false, data_temp_);
+            }
+        }
+        for (int ch = 0; ch < num_channels_; ch++) {
+            Address addr(ch, 0, 0, ODD_BANK, TRIGGER_GACC, 0);
             uint64_t hex_addr = ReverseAddressMapping(addr);
-            TryAddTransaction(addr_DRAF_ + hex_addr, false, data_temp_);
+            TryAddTransaction(hex_addr, true, data_temp_);
         }
+        
+    }
 
-        // Execute ukernel 1-4 (MUL, SACC, SACC, JUMP 명령어)
-        // (TODO) 다음과 같이 동작하도록 구성해야 됨
-        uint64_t sacc_offset = 7;
-        for (uint64_t co = 0; co < 16; co++) { // JH modify
-        // for (uint64_t co = 1; co < 8; co++) {
-            for (int ch = 0; ch < NUM_CHANNEL; ch++) {
-                //channel, rank, bankgroup, bank, row, column
-                Address addr(ch, 0, 0, EVEN_BANK, ro, co);
-                uint64_t hex_addr = ReverseAddressMapping(addr);
-                // 1. Transaction for trigger MUL
-                TryAddTransaction(addr_DRAF_ + hex_addr, false, data_temp_);
-                Address addr1(ch, 0, 0, EVEN_BANK, ro, co + sacc_offset); //8, 10...
-                hex_addr = ReverseAddressMapping(addr1);
-                // 2. Transaction for trigger SACC + NOP
-                //SACC
-                TryAddTransaction(addr_DRAF_ + hex_addr, false, data_temp_);
-                //NOP
-                //TryAddTransaction(addr_DRAF_ + hex_addr, false, data_temp_);
-                Address addr2(ch, 0, 0, EVEN_BANK, ro, co + sacc_offset+1); //9, 11...
-                hex_addr = ReverseAddressMapping(addr2);
-                // 3. Transaction for trigger SACC + NOP 
-                //SACC
-                TryAddTransaction(addr_DRAF_ + hex_addr, false, data_temp_);
-                //NOP
-                //TryAddTransaction(addr_DRAF_ + hex_addr, false, data_temp_);
-                // 4. JUMP는 자동으로
-                sacc_offset++;
+    Barrier();
+
+    if (Mixed()) {
+        std::cout << "Mixed SpMV: draf " << kernel_execution_time_ << " rows, "
+                  << clk_ - start_clk_ << " cycles" << std::endl;
+        ExecuteFormat(TILE_DENSE);
+        ExecuteFormat(TILE_SPARSE_ROW);
+    }
+}
+
+// SetData writes of the dense / sparse_row rows: dense header (columns 0,
+// 1), x (7) and the column words of the used blocks, sparse_row the words
+// of the row descriptors and column chunks
+void SpmvTransactionGenerator::WriteMixedRows() {
+    for (size_t p = 0; p < DRAF_BG_.size(); p++) {
+        int ch = p / num_bankgroups_;
+        int bg = p % num_bankgroups_;
+        for (size_t j = 0; j < mixed_.dense[p].size(); j++) {
+            const dense_tile_format& tile = mixed_.dense[p][j];
+            const uint8_t* data_ptr = reinterpret_cast<const uint8_t*>(&tile);
+            for (uint32_t co = 0; co < 32; co++) {
+                bool used = co <= 1 || co == 7 ||
+                            (co >= 8 && (co - 8) / 8 < tile.n_block && co % 8 < GROUP_SIZE);
+                if (!used)
+                    continue;
+                Address addr(ch, 0, bg, j % banks_per_group_,
+                             dense_base_ + j / banks_per_group_, co);
+                SetDataWord(ReverseAddressMapping(addr), data_ptr + co * SIZE_WORD, co == 0);
             }
         }
-        // (TODO) MOV(AAM0) BANK GRF_A를 추가해야 됨
-        // JUMP 로 MOV가 7번 수행 될 수 있게 JUMP -1 6로 설정
-        // column = 22 ~ 28
-        // for(uint64_t co = 22; co < 29; co++){
-        for(uint64_t co = 0; co < 16; co++){ // JH modify
-            for(int ch = 0; ch < NUM_CHANNEL; ch++){
-                Address addr(ch, 0, 0, EVEN_BANK, false, co);
-                uint64_t hex_addr = ReverseAddressMapping(addr);
-                TryAddTransaction(hex_addr, false, data_temp_);
+        uint32_t units_per_bg = banks_per_group_ / config_->pim_banks_per_unit;
+        for (size_t j = 0; j < sparse_row_image_[p].size() / (32 * SIZE_WORD); j++) {
+            const uint8_t* data_ptr = &sparse_row_image_[p][j * 32 * SIZE_WORD];
+            const uint8_t* trips = &sparse_row_trips_[ch][j / units_per_bg * MAX_BLOCK_PER_ROW];
+            uint32_t words = 0;
+            while (words < MAX_BLOCK_PER_ROW && trips[words] > 0)
+                words++;
+            if (j < mixed_.sparse_row[p].size()) {
+                const sparse_row_format& block = mixed_.sparse_row[p][j];
+                words = std::max(words, std::min(32u, block.n_rd + block.n_chunk));
+            }
+            Address slot = SparseRowSlot(p, j);
+            for (uint32_t co = 0; co < words; co++) {
+                slot.column = co;
+                SetDataWord(ReverseAddressMapping(slot), data_ptr + co * SIZE_WORD, co == 0);
             }
         }
-        
-        // To trigger global accumulator
-        /*for (uint64_t co = 22; co < 29; co++) {
-            for (int ch = 0; ch < NUM_CHANNEL; ch++) {
-                //channel, rank, bankgroup, bank, row, column
-                Address addr(ch, 0, 0, EVEN_BANK, TRIGGER_GACC, co);
-                uint64_t hex_addr = ReverseAddressMapping(addr);
-                //TryAddTransaction(addr_DRAF_ + hex_addr, false, data_temp_);
-                TryAddTransaction(hex_addr, false, data_temp_);
+    }
+}
+
+// EVEN bank of sparse_row block j of partition p (PimUnit j % units of the
+// BG, one DRAM row per units blocks)
+Address SpmvTransactionGenerator::SparseRowSlot(int p, uint32_t j) {
+    uint32_t units_per_bg = banks_per_group_ / config_->pim_banks_per_unit;
+    int unit = j % units_per_bg;
+    return Address(p / num_bankgroups_, 0, p % num_bankgroups_,
+                   unit * config_->pim_banks_per_unit + EVEN_BANK,
+                   sparse_row_base_ + j / units_per_bg, 0);
+}
+
+// Rows of one non-DRAF format: the CRF of a channel gets the format's
+// μkernel (AB mode, EXIT of the last pass left it there), then one pass per
+// DRAM row. Channels are independent and interleaved (IssueInterleaved)
+void SpmvTransactionGenerator::ExecuteFormat(int format) {
+    bool dense = (format == TILE_DENSE);
+    const std::vector<uint32_t>& rows = dense ? dense_rows_ : sparse_row_rows_;
+    uint32_t* crf = dense ? dense_crf_ : sparse_row_crf_;
+    int crf_writes = dense ? dense_kernel_.CrfWrites() : sparse_row_kernel_.CrfWrites();
+    if (*std::max_element(rows.begin(), rows.end()) == 0)
+        return;
+    uint64_t clk = clk_;
+    *data_temp_ |= 1;
+    std::vector<int> next_row(num_channels_, -1);  // -1: CRF not programmed
+    IssueInterleaved(num_channels_, [&](int ch, std::vector<HostTransaction>& out) {
+        if (next_row[ch] >= (int)rows[ch])
+            return false;
+        if (next_row[ch] < 0) {
+            for (int co = 0; co < crf_writes; co++) {
+                Address addr(ch, 0, 0, 0, MAP_CRF, co);
+                out.push_back({ReverseAddressMapping(addr), true,
+                               reinterpret_cast<uint8_t*>(&crf[co * 8])});
             }
-        }*/
+            next_row[ch] = 0;
+            return true;
+        }
+        int ro = next_row[ch]++;
+        if (dense)
+            DenseTriggers(ch, dense_base_ + ro, out);
+        else
+            SparseRowTriggers(ch, ro, out);
+        return true;
+    });
+    Barrier();
+    std::cout << "Mixed SpMV: " << (dense ? "dense " : "sparse_row ")
+              << *std::max_element(rows.begin(), rows.end()) << " rows, "
+              << clk_ - clk << " cycles" << std::endl;
+}
 
-        #ifdef debug_mode
-        std::cout << "\nHOST:\tExecute Oddbank\n";
-        #endif
-        
-        // Execute ukernel 0 (MOV 명령어)
-        #ifdef debug_mode
-        std::cout << "\nHOST:\tExecute μkernel 0\n";
-        #endif
-        for (int ch = 0; ch < NUM_CHANNEL; ch++) {
-            uint64_t co = 29;
-            Address addr(ch, 0, 0, ODD_BANK, ro, co); //Column 29 indicate vector
-            uint64_t hex_addr = ReverseAddressMapping(addr);
-            TryAddTransaction(addr_DRAF_ + hex_addr, false, data_temp_);
+// One pass of kUKernelSpmvDense over DRAM row ro (UKernel::Schedule)
+void SpmvTransactionGenerator::DenseTriggers(int ch, int ro,
+                                             std::vector<HostTransaction>& out) {
+    Address mode(ch, 0, 0, 0, MAP_PIM_OP_MODE, 0);
+    out.push_back({ReverseAddressMapping(mode), true, nullptr});
+    for (const UKernelTrigger& t : dense_schedule_) {
+        Address addr(ch, 0, 0, t.bank, ro, t.column);
+        out.push_back({addr_DRAF_ + ReverseAddressMapping(addr), t.is_write, nullptr});
+    }
+}
+
+// DRF word of a 1-based column (0: empty): x_vector_, 1 like the vec
+// slots of generate_DRAF before the first ChangeVector
+uint16_t SpmvTransactionGenerator::SparseRowX(uint32_t col) const {
+    if (col == 0)
+        return 0;
+    return (col <= x_vector_.size()) ? x_vector_[col - 1] : 1;
+}
+
+// sparse_row row r of channel ch (DRAM row sparse_row_base_ + r)
+//  The DRF holds x of the column groups of every PimUnit's tile (DRF row k,
+//  lane = PimUnit), written once per row in PIM mode. Then one
+//  kUKernelSpmvSparseRow pass per row descriptor d, the trips of its LOOP
+//  are the byte InitializeMixed wrote to every PimUnit of the row
+void SpmvTransactionGenerator::SparseRowTriggers(int ch, int r,
+                                                 std::vector<HostTransaction>& out) {
+    uint32_t units_per_bg = banks_per_group_ / config_->pim_banks_per_unit;
+    uint16_t* drf = &drf_image_[(size_t)ch * DRF_ROWS * DRF_COLS];
+    std::fill(drf, drf + DRF_ROWS * DRF_COLS, 0);
+    for (int bg = 0; bg < num_bankgroups_; bg++) {
+        int p = ch * num_bankgroups_ + bg;
+        for (uint32_t u = 0; u < units_per_bg; u++) {
+            uint32_t j = r * units_per_bg + u;
+            if (j >= mixed_.sparse_row[p].size())
+                continue;
+            const tile_entry& e = mixed_.directory[sparse_row_tile_[p][j]];
+            int lane = bg * units_per_bg + u;
+            for (int k = 0; k < GROUP_SIZE; k++) {
+                drf[k * DRF_COLS + lane] = SparseRowX(e.col_group[k]);
+            }
         }
+    }
+    int ro = sparse_row_base_ + r;
+    const uint8_t* trips = &sparse_row_trips_[ch][r * MAX_BLOCK_PER_ROW];
+    for (int d = 0; d < MAX_BLOCK_PER_ROW && trips[d] > 0; d++) {
+        // Mode transition: AB -> AB-PIM, the DRF is written in PIM mode only
+        Address mode(ch, 0, 0, 0, MAP_PIM_OP_MODE, 0);
+        out.push_back({ReverseAddressMapping(mode), true, nullptr});
+        if (d == 0) {
+            for (int co = 0; co < DRF_ROWS; co++) {
+                Address addr(ch, 0, 0, EVEN_BANK, MAP_DRF, co);
+                out.push_back({ReverseAddressMapping(addr), true,
+                               reinterpret_cast<uint8_t*>(drf + co * DRF_COLS)});
+            }
+        }
+        int loop = trips[d] - 1;
+        for (const UKernelTrigger& t :
+             sparse_row_kernel_.Schedule([loop](int) { return loop; })) {
+            Address addr(ch, 0, 0, t.bank, ro, t.column + d);
+            out.push_back({addr_DRAF_ + ReverseAddressMapping(addr), t.is_write, nullptr});
+        }
+    }
+}
 
-        #ifdef debug_mode
-        std::cout << "\nHOST:\tExecute μkernel 1-4\n";
-        #endif
+// μkernel triggers of DRAM row ro of one channel, even bank then odd bank
+//  sacc_offset advanced once per (co, ch) in the channel-major loop this
+//  replaced, the columns are kept as they were
+void SpmvTransactionGenerator::RowTriggers(int ch, int ro,
+                                           std::vector<HostTransaction>& out) {
+    // One host read per step of the μkernel pass (UKernel::Schedule), the
+    // step decides the column:
+    //  MOV SRF_M BANK  : column 29 (vector)
+    //  MUL             : DRAF column of the JUMP trip
+    //  SACC, SACC      : index columns co + sacc_offset, co + sacc_offset + 1
+    //  MOV BANK GRF_A  : row 0, column of the JUMP trip
+    bool second_sacc = false;
+    for (const UKernelTrigger& t : spmv_schedule_) {
+        int bank = t.bank ? ODD_BANK : EVEN_BANK;
+        uint64_t co = t.column;
+        if (t.op == PIM_OPERATION::MOV && !t.is_write) {
+            Address addr(ch, 0, 0, bank, ro, 29);
+            out.push_back({addr_DRAF_ + ReverseAddressMapping(addr), false, nullptr});
+        } else if (t.op == PIM_OPERATION::MUL) {
+            Address addr(ch, 0, 0, bank, ro, co);
+            out.push_back({addr_DRAF_ + ReverseAddressMapping(addr), false, nullptr});
+        } else if (t.op == PIM_OPERATION::SACC) {
+            uint64_t sacc_offset = 7 + co * num_channels_ + ch;
+            Address addr(ch, 0, 0, bank, ro, co + sacc_offset + (second_sacc ? 1 : 0));
+            out.push_back({addr_DRAF_ + ReverseAddressMapping(addr), false, nullptr});
+        } else {  // MOV BANK GRF_A
+            Address addr(ch, 0, 0, bank, 0, co);
+            out.push_back({ReverseAddressMapping(addr), false, nullptr});
+        }
+        second_sacc = (t.op == PIM_OPERATION::SACC) && !second_sacc;
+    }
+}
 
-        // Execute ukernel 1-4 (MUL, SACC, SACC, JUMP 명령어)
-        // (TODO) 다음과 같이 동작하도록 구성해야 됨
-        sacc_offset = 7;
-        // for (uint64_t co = 1; co < 8; co++) { 
-        for (uint64_t co = 0; co < 16; co++) { // JH modify
-            for (int ch = 0; ch < NUM_CHANNEL; ch++) {
-                //channel, rank, bankgroup, bank, row, column
-                Address addr(ch, 0, 0, ODD_BANK, ro, co);
-                uint64_t hex_addr = ReverseAddressMapping(addr);
-                // 1. Transaction for trigger MUL
-                TryAddTransaction(addr_DRAF_ + hex_addr, false, data_temp_);
-                Address addr1(ch, 0, 0, ODD_BANK, ro, co + sacc_offset);
-                hex_addr = ReverseAddressMapping(addr1);
-                // 2. Transaction for trigger SACC + NOP
-                //SACC
-                TryAddTransaction(addr_DRAF_ + hex_addr, false, data_temp_);
-                //NOP
-                //TryAddTransaction(addr_DRAF_ + hex_addr, false, data_temp_);
-                Address addr2(ch, 0, 0, ODD_BANK, ro, co + sacc_offset+1);
-                hex_addr = ReverseAddressMapping(addr2);
-                // 3. Transaction for trigger SACC + NOP
-                //SACC
-                TryAddTransaction(addr_DRAF_ + hex_addr, false, data_temp_);
-                //NOP
-                //TryAddTransaction(addr_DRAF_ + hex_addr, false, data_temp_);
-                // 4. JUMP는 자동으로
-                sacc_offset++;
+// SetData writes of the DRAF rows [ro_begin, ro_end) of one channel
+//  (DRAF_BG_[ch * bankgroups + bg][ro * banks_per_group + ba],
+//   columns 0~21 and 29)
+void SpmvTransactionGenerator::WriteRows(int ch, uint32_t ro_begin,
+                                         uint32_t ro_end,
+                                         std::vector<HostTransaction>& out) {
+    size_t bpg = banks_per_group_;
+    for (int bg = 0; bg < num_bankgroups_; bg++) {
+        std::vector<re_aligned_dram_format>& rows = DRAF_BG_[ch * num_bankgroups_ + bg];
+        for (size_t j = ro_begin * bpg; j < rows.size() && j < ro_end * bpg; j++) {
+            uint32_t ro = j / bpg;
+            uint32_t ba = j % bpg;
+            uint8_t* data_ptr = reinterpret_cast<uint8_t*>(&rows[j]);
+            for (uint32_t co = 0; co < 32; co++) {
+                if (co > 21 && co != 29)
+                    continue;
+                Address addr(ch, 0, bg, ba, ro, co);
+                out.push_back({ReverseAddressMapping(addr), true,
+                               data_ptr + co * SIZE_WORD});
             }
         }
+    }
+}
 
-        // (TODO) MOV(AAM0) BANK GRF_A를 추가해야 됨
-        // JUMP 로 MOV가 7번 수행 될 수 있게 JUMP -1 6로 설정
-        // column = 22 ~ 28
-        // for(uint64_t co = 22; co < 29; co++){
-        for(uint64_t co = 0; co < 16; co++){ // JH modify
-            for(int ch = 0; ch < NUM_CHANNEL; ch++){
-                Address addr(ch, 0, 0, ODD_BANK, false, co);
-                uint64_t hex_addr = ReverseAddressMapping(addr);
-                TryAddTransaction(hex_addr, false, data_temp_);
+// DRAM rows past ro that the triggers of row ro reach (the SACC columns run
+// past column 31, RowTriggers)
+uint32_t SpmvTransactionGenerator::RowLookahead() {
+    uint32_t lookahead = 0;
+    std::vector<HostTransaction> probe;
+    for (int ch = 0; ch < num_channels_; ch++)
+        RowTriggers(ch, 0, probe);
+    for (const HostTransaction& t : probe)
+        lookahead = std::max(lookahead,
+                             (uint32_t)config_->AddressMapping(t.hex_addr).row);
+    return lookahead;
+}
+
+// Double-buffered streaming of the matrix (pipeline_tile_rows_ > 0)
+//  The DRAM rows are cut into tiles of pipeline_tile_rows_ rows. Even
+//  channels run load(0) exec(0) load(1) exec(1) ..., odd channels the same
+//  one step later, so while one group executes tile k in PIM mode the other
+//  writes its DRAF rows of tile k / k+1 in SB mode (bank mode is per
+//  channel, PimFuncSim). The loads of a step are spread over the rows the
+//  other group executes. SetData only programs the CRF in this mode
+//  The SACC trigger columns run past column 31 into the following DRAM rows
+//  (RowTriggers), so loading tile k also covers the rows its execution
+//  reaches (lookahead) and a row is never written after it was used
+void SpmvTransactionGenerator::ExecutePipelined() {
+    uint32_t tile = pipeline_tile_rows_;
+    uint32_t num_tiles = (kernel_execution_time_ + tile - 1) / tile;
+    uint64_t overlap_clk = 0, load_clk = 0, exec_clk = 0;
+    uint64_t begin_clk = clk_;
+
+    uint32_t lookahead = RowLookahead();
+    uint32_t loaded[2] = {0, 0};  // rows loaded per group
+
+    // group g is at phase (step - g): even = load, odd = exec
+    for (uint32_t step = 0; step <= 2 * num_tiles; step++) {
+        int load_group = -1, exec_group = -1;
+        uint32_t load_tile = 0, exec_tile = 0;
+        for (int g = 0; g < 2; g++) {
+            if (step < (uint32_t)g || step - g >= 2 * num_tiles)
+                continue;
+            uint32_t phase = step - g;
+            if (phase % 2 == 0) {
+                load_group = g;
+                load_tile = phase / 2;
+            } else {
+                exec_group = g;
+                exec_tile = phase / 2;
             }
         }
+        uint64_t step_clk = clk_;
+
+        // Mode transition: loading channels AB -> SB, executing SB -> AB
+        for (int ch = 0; ch < num_channels_; ch++) {
+            if (ch % 2 != load_group && ch % 2 != exec_group)
+                continue;
+            Address addr(ch, 0, 0, 0, ch % 2 == load_group ? MAP_SBMR : MAP_ABMR, 0);
+            TryAddTransaction(ReverseAddressMapping(addr), false, data_temp_);
+        }
+        Barrier();
 
-        /*
-        // Global accumulator trigger 하기 위한 코드
-        // Shared accumulator 동작 검증 후 주석 풀고
-        // 동작 검증 필요 
-        #ifdef debug_mode
-        std::cout << "\nHOST:\tExecute Global Accumulator\n";
-        #endif
-        
-        // To trigger global accumulator
-        for (uint64_t co = 22; co < 29; co++) {
-            for (int ch = 0; ch < NUM_CHANNEL; ch++) {
-                //channel, rank, bankgroup, bank, row, column
-                Address addr(ch, 0, 0, ODD_BANK, TRIGGER_GACC, co);
-                uint64_t hex_addr = ReverseAddressMapping(addr);
-                //TryAddTransaction(addr_DRAF_ + hex_addr, false, data_temp_);
-                TryAddTransaction(hex_addr, false, data_temp_);
+        uint32_t exec_begin = exec_tile * tile;
+        uint32_t exec_end = std::min(exec_begin + tile, kernel_execution_time_);
+        uint32_t load_begin = 0, load_end = 0;
+        if (load_group >= 0) {
+            load_begin = loaded[load_group];
+            load_end = std::min((load_tile + 1) * tile + lookahead,
+                                kernel_execution_time_);
+            load_end = std::max(load_begin, load_end);
+            loaded[load_group] = load_end;
+        }
+        uint32_t iters = (exec_group >= 0) ? exec_end - exec_begin : 1;
+        for (uint32_t it = 0; it < iters; it++) {
+            std::vector<HostTransaction> batch;
+            if (exec_group >= 0) {
+                // Mode transition: AB -> AB-PIM, EXIT drops back to AB
+                *data_temp_ |= 1;
+                uint32_t ro = exec_begin + it;
+                for (int ch = exec_group; ch < num_channels_; ch += 2) {
+                    if (ro >= channel_rows_[ch])
+                        continue;
+                    Address addr(ch, 0, 0, 0, MAP_PIM_OP_MODE, 0);
+                    TryAddTransaction(ReverseAddressMapping(addr), true, data_temp_);
+                }
+                Barrier();
+                for (int ch = exec_group; ch < num_channels_; ch += 2) {
+                    if (ro < channel_rows_[ch])
+                        RowTriggers(ch, ro, batch);
+                }
             }
-        }*/
-        
+            if (load_group >= 0) {
+                uint32_t n = load_end - load_begin;
+                uint32_t from = load_begin + n * it / iters;
+                uint32_t to = load_begin + n * (it + 1) / iters;
+                for (int ch = load_group; ch < num_channels_; ch += 2)
+                    WriteRows(ch, from, to, batch);
+            }
+            AddTransactions(batch);
+        }
+        Barrier();
+
+        step_clk = clk_ - step_clk;
+        if (load_group >= 0 && exec_group >= 0)
+            overlap_clk += step_clk;
+        else if (load_group >= 0)
+            load_clk += step_clk;
+        else
+            exec_clk += step_clk;
     }
 
-    Barrier();
+    uint64_t total_clk = clk_ - begin_clk;
+    std::cout << "Pipelined SpMV: " << num_tiles << " tiles of " << tile
+              << " rows (lookahead " << lookahead << "), " << total_clk << " cycles (load only " << load_clk
+              << ", exec only " << exec_clk << ", load || exec " << overlap_clk
+              << ", overlap "
+              << (total_clk ? 100.0 * overlap_clk / total_clk : 0.0) << "%)"
+              << std::endl;
 }
 
 void SpmvTransactionGenerator::GetResult() {
@@ -822,7 +1563,7 @@ void SpmvTransactionGenerator::GetResult() {
     #ifdef debug_mode
     std::cout << "HOST:\t[4] AB -> SB \n";
     #endif
-    for (int ch = 0; ch < NUM_CHANNEL; ch++) {
+    for (int ch = 0; ch < num_channels_; ch++) {
         Address addr(ch, 0, 0, 0, MAP_SBMR, 0);
         uint64_t hex_addr = ReverseAddressMapping(addr);
         TryAddTransaction(hex_addr, false, data_temp_);
@@ -838,12 +1579,12 @@ void SpmvTransactionGenerator::GetResult() {
 
     // 1044869번의 memory cycle, 22972의 Loop count
     for (size_t i = 0; i < DRAF_BG_.size(); ++i) {
-        uint32_t bg = i % 4;          // Fixed bg for each DRAF_BG[i] //bg = 0, 1, 2, 3
+        uint32_t bg = i % num_bankgroups_; // Fixed bg for each DRAF_BG[i] //bg = 0, 1, 2, 3
         uint32_t ro = 0;     // Start row at 0 for each DRAF_BG[i]
-        uint32_t ch = i / 4;  // Increment ch after every 4 bg //ch = 0 ~ 15
+        uint32_t ch = i / num_bankgroups_;  // Increment ch after every 4 bg //ch = 0 ~ 15
 
         for (size_t j = 0; j < DRAF_BG_[i].size(); ++j) {
-            uint32_t ba = j % 4;      // Bank cycles 0, 1, 2, 3
+            uint32_t ba = j % banks_per_group_; // Bank cycles 0, 1, 2, 3
             if (ba == 0 && j > 0) {
                 ro++;        // Increment row after each full cycle of ba
             }
@@ -870,6 +1611,33 @@ void SpmvTransactionGenerator::GetResult() {
         }
     }
 
+    // Mixed formats: dense block results (columns 2~4), sparse_row sum of
+    // row descriptor d (ODD bank column d)
+    if (Mixed()) {
+        std::vector<HostTransaction> batch;
+        for (size_t p = 0; p < DRAF_BG_.size(); p++) {
+            int ch = p / num_bankgroups_;
+            int bg = p % num_bankgroups_;
+            for (size_t j = 0; j < mixed_.dense[p].size(); j++) {
+                for (uint32_t b = 0; b < mixed_.dense[p][j].n_block; b++) {
+                    Address addr(ch, 0, bg, j % banks_per_group_,
+                                 dense_base_ + j / banks_per_group_, 2 + b);
+                    batch.push_back({addr_DRAF_ + ReverseAddressMapping(addr), false, partial_value_});
+                }
+            }
+            for (size_t j = 0; j < mixed_.sparse_row[p].size(); j++) {
+                Address addr = SparseRowSlot(p, j);
+                addr.bank += ODD_BANK;
+                uint32_t words = std::min(mixed_.sparse_row[p][j].n_rd, (uint32_t)MAX_BLOCK_PER_ROW);
+                for (uint32_t co = 0; co < words; co++) {
+                    addr.column = co;
+                    batch.push_back({addr_DRAF_ + ReverseAddressMapping(addr), false, partial_value_});
+                }
+            }
+        }
+        AddTransactions(batch);
+    }
+
     // 483920의 memory cycle, 23040의 Loop count
     //BG accumulator region의 데이터를 읽어와 추가적인 accumulating을 하는 경우를 가정
     //읽어올 때, 데이터가 0 일경우 Row index도 0으로 처리하여, 연산에서 빠지도록 했음을 가정
@@ -878,7 +1646,7 @@ void SpmvTransactionGenerator::GetResult() {
     /*for (int ro = 0; ro < kernel_execution_time_; ro++) {
         for(int BA = 0; BA < 4; BA++){
             for(int BG = 0; BG < 4; BG++){
-                for (int ch = 0; ch < NUM_CHANNEL; ch++) {
+                for (int ch = 0; ch < num_channels_; ch++) {
                     for (uint64_t co = 8; co <= 21; co++) {
                         Address addr(ch, 0, BG, BA, ro, co);
                         uint64_t hex_addr = ReverseAddressMapping(addr);
@@ -894,11 +1662,69 @@ void SpmvTransactionGenerator::GetResult() {
         }
     }*/
     Barrier();
+    ReduceOutput();
 
     // To print accumulation count
     memory_system_.PrintAccumulateCount();
 }
 
+// y of the resident matrix into output_vector_ (output_rows_ FP16 words)
+//  Partials in float, one rounding to FP16 per row. Mixed formats add the
+//  dense blocks (x from the tile) and the sparse_row descriptors (x from
+//  the DRF image, SparseRowX)
+void SpmvTransactionGenerator::ReduceOutput() {
+    if (output_rows_ == 0)
+        return;
+    std::vector<float> y(output_rows_, 0.0f);
+    auto add = [&](uint32_t row, uint16_t val, uint16_t x) {  // row 1-based
+        if (row == 0 || row > output_rows_)
+            return;
+        y[row - 1] += (float)(int16_t)val * (float)*reinterpret_cast<const half*>(&x);
+    };
+    for (const auto& part : DRAF_BG_) {
+        for (const re_aligned_dram_format& f : part) {
+            for (int k = 0; k < GROUP_SIZE; k++) {
+                if (f.col_group[k] == 0)
+                    continue;
+                for (int i = 0; i < PARTITION_SIZE; i++)
+                    add(f.row[k * PARTITION_SIZE + i], f.val[k * PARTITION_SIZE + i], f.vec[k]);
+            }
+        }
+    }
+    if (Mixed()) {
+        for (size_t p = 0; p < DRAF_BG_.size(); p++) {
+            for (const dense_tile_format& d : mixed_.dense[p]) {
+                for (uint32_t b = 0; b < d.n_block && b < DENSE_BLOCKS; b++) {
+                    for (int k = 0; k < GROUP_SIZE; k++) {
+                        if (d.col_group[k] == 0)
+                            continue;
+                        for (int i = 0; i < PARTITION_SIZE; i++)
+                            add(d.row_base[b] + i, d.val[b][k][i], d.vec[k]);
+                    }
+                }
+            }
+            // selectTileFormats blocks have no column chunks
+            for (size_t j = 0; j < mixed_.sparse_row[p].size(); j++) {
+                const sparse_row_format& block = mixed_.sparse_row[p][j];
+                const tile_entry& e = mixed_.directory[sparse_row_tile_[p][j]];
+                for (uint32_t r = 0; r < block.n_rd && r < MAX_BLOCK_PER_ROW; r++) {
+                    const row_descriptor& rd = block.row_desc[r];
+                    for (int n = 0; n < rd.NZE_count && n < CHUNK_SIZE; n++) {
+                        uint8_t k = rd.NZE_col_idx[n];
+                        if (k < GROUP_SIZE)
+                            add(rd.row_idx, rd.NZE_val[n], SparseRowX(e.col_group[k]));
+                    }
+                }
+            }
+        }
+    }
+    uint16_t* out = reinterpret_cast<uint16_t*>(output_vector_);
+    for (uint64_t r = 0; r < output_rows_; r++) {
+        half h(y[r]);
+        std::memcpy(&out[r], &h, sizeof(uint16_t));
+    }
+}
+
 void SpmvTransactionGenerator::AdditionalAccumulation(){
     #ifdef debug_mode
     std::cout << "HOST:\t Additional accumulation start \n";
@@ -930,8 +1756,67 @@ void SpmvTransactionGenerator::AdditionalAccumulation(){
     std::cout << "ERROR : " << h_err << std::endl;
 }*/
 
+// Rewrites the x slots of the resident matrix (DRAF column 29) from
+// x_vector_, the rest of the DRAF rows and the CRF stay as SetData left them.
+//  vec[k] is x of column col_group[k], only words that changed are written.
+//  Runs in SB mode (GetResult leaves the channels there) and switches back
+//  to AB for the next Execute
 void SpmvTransactionGenerator::ChangeVector() {
-    
+    if (pipeline_tile_rows_ > 0) {
+        std::cerr << "ChangeVector needs the matrix resident, "
+                  << "pipelined SpMV streams it" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    if (Mixed()) {
+        std::cerr << "ChangeVector rewrites DRAF x slots only, "
+                  << "mixed tile formats are not supported" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    vector_words_ = 0;
+
+    // Mode transition: AB -> SB (no-op after GetResult)
+    for (int ch = 0; ch < num_channels_; ch++) {
+        Address addr(ch, 0, 0, 0, MAP_SBMR, 0);
+        TryAddTransaction(ReverseAddressMapping(addr), false, data_temp_);
+    }
+    Barrier();
+
+    std::vector<HostTransaction> batch;
+    size_t bpg = banks_per_group_;
+    for (int ch = 0; ch < num_channels_; ch++) {
+        for (int bg = 0; bg < num_bankgroups_; bg++) {
+            std::vector<re_aligned_dram_format>& rows = DRAF_BG_[ch * num_bankgroups_ + bg];
+            for (size_t j = 0; j < rows.size(); j++) {
+                re_aligned_dram_format& row = rows[j];
+                bool changed = false;
+                for (int k = 0; k < GROUP_SIZE; k++) {
+                    uint32_t col = row.col_group[k];  // 1-based, 0: empty
+                    uint16_t x = 0;
+                    if (col != 0 && col <= x_vector_.size())
+                        x = x_vector_[col - 1];
+                    if (row.vec[k] != x) {
+                        row.vec[k] = x;
+                        changed = true;
+                    }
+                }
+                if (!changed)
+                    continue;
+                Address addr(ch, 0, bg, j % bpg, j / bpg, 29);
+                batch.push_back({addr_DRAF_ + ReverseAddressMapping(addr), true,
+                                 reinterpret_cast<uint8_t*>(row.vec)});
+                vector_words_++;
+            }
+        }
+    }
+    AddTransactions(batch);
+    Barrier();
+
+    // Mode transition: SB -> AB, the SpMV μkernel is still in the CRF
+    for (int ch = 0; ch < num_channels_; ch++) {
+        Address addr(ch, 0, 0, 0, MAP_ABMR, 0);
+        TryAddTransaction(ReverseAddressMapping(addr), false, data_temp_);
+    }
+    Barrier();
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////
@@ -950,7 +1835,7 @@ void NoPIMSpmvTransactionGenerator::Initialize() { //여기는 코딩 끝
 
     //ukenrnel_access_size는 모두 SIZE_WORD * 8 * NUM_BANK로 동일
     //ukernel_access_size = Word(32) * 8 * # of Bank(256) = 65536
-    ukernel_access_size_ = SIZE_WORD * 8 * NUM_BANK; // SIZE_WORD = 32, NUM_BANK = 256 (Channel 당 Bank 수는 16, 16채널)
+    ukernel_access_size_ = SIZE_WORD * 8 * num_banks_; // SIZE_WORD = 32, num_banks_ = channels x banks (HBM2 test config 16 x 16 = 256)
     //UNIT_SIZE = 2, ukernel_access_size_ = 65536
     
     // (TODO) N을 어떻게 결정?
@@ -975,8 +1860,8 @@ void NoPIMSpmvTransactionGenerator::Initialize() { //여기는 코딩 끝
     }
 
     // 가장 많은 row를 차지하는 DRAF_BG를 찾아서 그것을 기준으로 ukernel_count_per_pim_를 결정
-    // 4를 나누는 것은 BG 기준으로 묶여 있기 때문에, 4등분이 이루어지는 것을 고려
-    kernel_execution_time_ = DRAF_BG_[max_index].size() / 4; // ukernel_count_per_pim_
+    // banks_per_group_으로 나누는 것은 BG 기준으로 묶여 있기 때문에, bank 수만큼 등분이 이루어지는 것을 고려
+    kernel_execution_time_ = DRAF_BG_[max_index].size() / banks_per_group_; // ukernel_count_per_pim_
     std::cout << "Max # of rows: " << kernel_execution_time_ << std::endl;
 
 }
@@ -986,10 +1871,10 @@ void NoPIMSpmvTransactionGenerator::Initialize() { //여기는 코딩 끝
 //column index 1번, value 7번, row index 14번, vector 1번 = 23번
 void NoPIMSpmvTransactionGenerator::SetData(){
     // strided size of one operand with one computation part(minimum)
-    // UNIT_SIZE = 2, SIZE_WORD = 32, NUM_BANK = 256
+    // UNIT_SIZE = 2, SIZE_WORD = 32, num_banks_ = 256
     // strided_size = 2 * 32 * 256 = 16384
     
-    //uint64_t strided_size = Ceiling(n_ * UNIT_SIZE, SIZE_WORD * NUM_BANK);
+    //uint64_t strided_size = Ceiling(n_ * UNIT_SIZE, SIZE_WORD * num_banks_);
 
     #ifdef debug_mode
     std::cout << "HOST:\tSet input data...\n";
@@ -999,12 +1884,12 @@ void NoPIMSpmvTransactionGenerator::SetData(){
     for (size_t i = 0; i < DRAF_BG_.size(); ++i) {
         //std::cout<<"DRAF_BG_["<<i<<"].size() : "<<DRAF_BG_[i].size()<<std::endl;
         //i=0 ~ 63
-        uint32_t bg = i % 4;          // Fixed bg for each DRAF_BG[i] //bg = 0, 1, 2, 3
+        uint32_t bg = i % num_bankgroups_; // Fixed bg for each DRAF_BG[i] //bg = 0, 1, 2, 3
         uint32_t ro = 0;     // Start row at 0 for each DRAF_BG[i]
-        uint32_t current_ch = i / 4;  // Increment ch after every 4 bg //ch = 0 ~ 15
+        uint32_t current_ch = i / num_bankgroups_;  // Increment ch after every 4 bg //ch = 0 ~ 15
 
         for (size_t j = 0; j < DRAF_BG_[i].size(); ++j) {
-            uint32_t ba = j % 4;      // Bank cycles 0, 1, 2, 3
+            uint32_t ba = j % banks_per_group_; // Bank cycles 0, 1, 2, 3
             if (ba == 0 && j > 0) {
                 ro++;        // Increment row after each full cycle of ba
             }
@@ -1034,7 +1919,7 @@ void NoPIMSpmvTransactionGenerator::SetData(){
                 Address addr(current_ch, 0, bg, ba, ro, co);
                 uint64_t hex_addr = ReverseAddressMapping(addr);
                 if(co <= 21 || co ==29){
-                    TryAddTransaction(hex_addr, true, const_cast<uint8_t*>(data_ptr + co*SIZE_WORD));
+                    SetDataWord(hex_addr, data_ptr + co*SIZE_WORD, co == 0);
                 }
             }
         }
@@ -1059,12 +1944,12 @@ void NoPIMSpmvTransactionGenerator::GetResult() {
 
     // 1044869번의 memory cycle, 22972의 Loop count
     for (size_t i = 0; i < DRAF_BG_.size(); ++i) {
-        uint32_t bg = i % 4;          // Fixed bg for each DRAF_BG[i] //bg = 0, 1, 2, 3
+        uint32_t bg = i % num_bankgroups_; // Fixed bg for each DRAF_BG[i] //bg = 0, 1, 2, 3
         uint32_t ro = 0;     // Start row at 0 for each DRAF_BG[i]
-        uint32_t ch = i / 4;  // Increment ch after every 4 bg //ch = 0 ~ 15
+        uint32_t ch = i / num_bankgroups_;  // Increment ch after every 4 bg //ch = 0 ~ 15
 
         for (size_t j = 0; j < DRAF_BG_[i].size(); ++j) {
-            uint32_t ba = j % 4;      // Bank cycles 0, 1, 2, 3
+            uint32_t ba = j % banks_per_group_; // Bank cycles 0, 1, 2, 3
             if (ba == 0 && j > 0) {
                 ro++;        // Increment row after each full cycle of ba
             }
@@ -1092,7 +1977,7 @@ void NoPIMSpmvTransactionGenerator::GetResult() {
     /*for (int ro = 0; ro < kernel_execution_time_; ro++) {
         for(int BA = 0; BA < 4; BA++){
             for(int BG = 0; BG < 4; BG++){
-                for (int ch = 0; ch < NUM_CHANNEL; ch++) {
+                for (int ch = 0; ch < num_channels_; ch++) {
                     for (uint64_t co = 8; co <= 21; co++) {
                         Address addr(ch, 0, BG, BA, ro, co);
                         uint64_t hex_addr = ReverseAddressMapping(addr);
@@ -1125,67 +2010,599 @@ void NoPIMSpmvTransactionGenerator::GetResult() {
 
 //여기 작성해야 됨 -> CPU가 실행했을 때 memory clock cycle을 측정해야 하기에 필요
 ////////////////////////////TW Added///////////////////////////////////////////
-// Initialize variables and ukernel
+// Build CSR / COO arrays and place them in memory
 void CPUSpmvTransactionGenerator::Initialize() {
+    // readMTXFile keeps the 1-based indices of the file
+    uint32_t nnz = matrix_.row_indices.size();
+    matrix_.nnz = nnz;
+    for (uint32_t k = 0; k < nnz; k++) {
+        matrix_.n_rows = std::max(matrix_.n_rows, matrix_.row_indices[k] + 1);
+        matrix_.n_cols = std::max(matrix_.n_cols, matrix_.col_indices[k] + 1);
+    }
+    col_.resize(nnz);
+    val_.resize(nnz);
+    if (csr_) {
+        // counting sort by row, file order inside a row
+        row_ptr_.assign(matrix_.n_rows + 1, 0);
+        for (uint32_t k = 0; k < nnz; k++)
+            row_ptr_[matrix_.row_indices[k] + 1]++;
+        for (uint32_t r = 0; r < matrix_.n_rows; r++)
+            row_ptr_[r + 1] += row_ptr_[r];
+        std::vector<uint32_t> fill(row_ptr_.begin(), row_ptr_.end() - 1);
+        for (uint32_t k = 0; k < nnz; k++) {
+            uint32_t pos = fill[matrix_.row_indices[k]]++;
+            col_[pos] = matrix_.col_indices[k];
+            val_[pos] = matrix_.values[k];
+        }
+    } else {
+        row_ = matrix_.row_indices;
+        col_ = matrix_.col_indices;
+        val_ = matrix_.values;
+    }
+    x_.assign(matrix_.n_cols, 1.0f);
+    y_.assign(matrix_.n_rows, 0.0f);
+
     // Compute the starting addresses for each array in memory
+    uint64_t row_bytes = csr_ ? (uint64_t)(matrix_.n_rows + 1) * sizeof(uint32_t)
+                              : (uint64_t)nnz * sizeof(uint32_t);
     addr_row_indices_ = 0;
-    addr_col_indices_ = Ceiling(nnz_ * sizeof(uint32_t), SIZE_ROW * NUM_BANK);
-    addr_val_ = addr_col_indices_ + Ceiling(nnz_ * sizeof(uint32_t), SIZE_ROW * NUM_BANK);
-    addr_x_ = addr_val_ + Ceiling(nnz_ * sizeof(uint16_t), SIZE_ROW * NUM_BANK);
-    addr_y_ = addr_x_ + Ceiling(n_cols_ * UNIT_SIZE, SIZE_ROW * NUM_BANK);
-
-    // Clear caches
-    cache_col_.clear();
-    cache_x_.clear();
+    addr_col_indices_ = Ceiling(row_bytes, row_size_ * num_banks_);
+    addr_val_ = addr_col_indices_ + Ceiling(nnz * sizeof(uint32_t), row_size_ * num_banks_);
+    addr_x_ = addr_val_ + Ceiling(nnz * sizeof(uint16_t), row_size_ * num_banks_);
+    addr_y_ = addr_x_ + Ceiling(matrix_.n_cols * UNIT_SIZE, row_size_ * num_banks_);
+
+    prefetcher_ = StridePrefetcher(NUM_STREAMS, prefetch_degree_);
+    mshr_.clear();
+    prefetch_q_.clear();
+    writeback_q_.clear();
+    pending_.clear();
+    pending_pos_ = 0;
+    next_item_ = 0;
+    window_q_.clear();
+    ready_clk_ = 0;
+    accesses_ = mem_reads_ = mem_writes_ = mshr_merges_ = 0;
+    prefetch_issued_ = prefetch_useful_ = prefetch_late_ = 0;
+    mshr_stall_cycles_ = dep_stall_cycles_ = mem_stall_cycles_ = 0;
+
+    std::cout << "CPU SpMV (" << (csr_ ? "CSR" : "COO") << "): "
+              << matrix_.n_rows << " x " << matrix_.n_cols << ", nnz "
+              << nnz << std::endl;
+    for (int i = 0; i < cache_.Levels(); i++) {
+        const CacheLevelConfig& c = cache_.Level(i).Config();
+        std::cout << "  L" << i + 1 << ": " << (c.size >> 10) << "KB "
+                  << c.ways << "-way, " << cache_.Level(i).Sets()
+                  << " sets, " << c.latency << " cycles" << std::endl;
+    }
+    std::cout << "  line " << cache_.LineSize() << "B, " << mshrs_
+              << " MSHRs, prefetch degree " << prefetch_degree_
+              << ", width " << core_width_ << ", window " << window_
+              << std::endl;
+}
+
+// Accesses of the next CSR row / COO nonzero, y is computed on the way
+void CPUSpmvTransactionGenerator::NextAccesses() {
+    pending_.clear();
+    pending_pos_ = 0;
+    auto push = [&](uint64_t addr, bool is_write, int stream) {
+        CpuAccess a = {addr, is_write, stream, 0, false, 0};
+        pending_.push_back(a);
+    };
+    // values are INT16 (unit_t, customRound of the file)
+    auto value = [&](uint32_t k) { return (float)(int16_t)val_[k]; };
+    if (csr_) {
+        if (next_item_ >= matrix_.n_rows)
+            return;
+        uint32_t r = next_item_++;
+        if (r == 0)
+            push(addr_row_indices_, false, ROW_STREAM);
+        push(addr_row_indices_ + (uint64_t)(r + 1) * sizeof(uint32_t), false,
+             ROW_STREAM);
+        float sum = 0.0f;
+        for (uint32_t k = row_ptr_[r]; k < row_ptr_[r + 1]; k++) {
+            push(addr_col_indices_ + (uint64_t)k * sizeof(uint32_t), false, COL_STREAM);
+            push(addr_val_ + (uint64_t)k * sizeof(uint16_t), false, VAL_STREAM);
+            push(addr_x_ + (uint64_t)col_[k] * UNIT_SIZE, false, X_STREAM);
+            sum += value(k) * x_[col_[k]];
+        }
+        y_[r] = sum;
+        push(addr_y_ + (uint64_t)r * UNIT_SIZE, true, Y_STREAM);
+    } else {
+        if (next_item_ >= matrix_.nnz)
+            return;
+        uint32_t k = next_item_++;
+        push(addr_row_indices_ + (uint64_t)k * sizeof(uint32_t), false, ROW_STREAM);
+        push(addr_col_indices_ + (uint64_t)k * sizeof(uint32_t), false, COL_STREAM);
+        push(addr_val_ + (uint64_t)k * sizeof(uint16_t), false, VAL_STREAM);
+        push(addr_x_ + (uint64_t)col_[k] * UNIT_SIZE, false, X_STREAM);
+        y_[row_[k]] += value(k) * x_[col_[k]];
+        // y[row] += ..., read-modify-write of a write-allocate line
+        push(addr_y_ + (uint64_t)row_[k] * UNIT_SIZE, true, Y_STREAM);
+    }
+}
+
+// All bursts of a line must be accepted in the same cycle
+bool CPUSpmvTransactionGenerator::CanIssueLine(uint64_t line) {
+    int line_size = cache_.LineSize();
+    for (int b = 0; b < line_size; b += burstSize_) {
+        if (!memory_system_.WillAcceptTransaction(line * line_size + b, false))
+            return false;
+    }
+    return true;
+}
+
+void CPUSpmvTransactionGenerator::IssueLine(uint64_t line, bool prefetch) {
+    int line_size = cache_.LineSize();
+    Mshr entry = {0, false, prefetch};
+    for (int b = 0; b < line_size; b += burstSize_) {
+        SubmitTransaction(line * line_size + b, false, data_temp_);
+        entry.bursts++;
+        mem_reads_++;
+    }
+    mshr_[line] = entry;
+}
+
+// x[col] can go once the column index load it depends on is done
+bool CPUSpmvTransactionGenerator::DepReady(const CpuAccess& access) const {
+    if (access.stream != X_STREAM)
+        return true;
+    return !(access.dep_pending && mshr_.count(access.dep_line)) &&
+           clk_ >= access.dep_ready_clk;
+}
+
+// One demand access, false: stalled this cycle (nothing changed)
+bool CPUSpmvTransactionGenerator::Issue(const CpuAccess& access) {
+    uint64_t line = access.addr / cache_.LineSize();
+    auto it = mshr_.find(line);
+    bool miss = (it == mshr_.end()) && !cache_.Contains(line);
+    if (miss && (int)mshr_.size() >= mshrs_) {
+        mshr_stall_cycles_++;
+        return false;
+    }
+    if (miss && !CanIssueLine(line)) {
+        mem_stall_cycles_++;
+        return false;
+    }
+
+    accesses_++;
+    bool useful = false;
+    int level = -1;
+    bool outstanding = false;
+    if (it == mshr_.end()) {
+        std::vector<uint64_t> writebacks;
+        level = cache_.Access(line, access.is_write, &useful, &writebacks);
+        QueueWritebacks(writebacks);
+    }
+    if (useful)
+        prefetch_useful_++;
+    if (level >= 0) {
+        ready_clk_ = std::max(ready_clk_, clk_ + cache_.Latency(level));
+    } else if (it != mshr_.end()) {
+        // secondary miss, merged into the outstanding line
+        mshr_merges_++;
+        if (it->second.prefetch) {
+            prefetch_late_++;
+            it->second.prefetch = false;
+        }
+        it->second.dirty |= access.is_write;
+        outstanding = true;
+    } else {
+        IssueLine(line, false);
+        mshr_[line].dirty = access.is_write;
+        outstanding = true;
+    }
+    if (access.stream == COL_STREAM) {
+        // the x[col] access of this nonzero follows the value load
+        for (size_t i = pending_pos_ + 1; i < pending_.size(); i++) {
+            if (pending_[i].stream == X_STREAM) {
+                pending_[i].dep_line = line;
+                pending_[i].dep_pending = outstanding;
+                pending_[i].dep_ready_clk =
+                    outstanding ? 0 : clk_ + cache_.Latency(level);
+                break;
+            }
+        }
+    }
+
+    if (prefetch_degree_ > 0) {
+        std::vector<uint64_t> candidates;
+        prefetcher_.Observe(access.stream, line, &candidates);
+        for (uint64_t p : candidates) {
+            if (prefetch_q_.size() >= (size_t)2 * mshrs_)
+                prefetch_q_.pop_front();
+            prefetch_q_.push_back(p);
+        }
+    }
+    return true;
+}
+
+// Writebacks and prefetches use the memory slots demand misses left over,
+// a prefetch never takes the last free MSHR
+void CPUSpmvTransactionGenerator::IssueBackground() {
+    while (!writeback_q_.empty() &&
+           memory_system_.WillAcceptTransaction(writeback_q_.front(), true)) {
+        SubmitTransaction(writeback_q_.front(), true, data_temp_);
+        writeback_q_.pop_front();
+        mem_writes_++;
+    }
+    while (!prefetch_q_.empty() && (int)mshr_.size() < mshrs_ - 1) {
+        uint64_t line = prefetch_q_.front();
+        if (mshr_.count(line) || cache_.Contains(line)) {
+            prefetch_q_.pop_front();
+            continue;
+        }
+        if (!CanIssueLine(line))
+            break;
+        prefetch_q_.pop_front();
+        IssueLine(line, true);
+        prefetch_issued_++;
+    }
+}
+
+void CPUSpmvTransactionGenerator::ReadCallBack(uint64_t addr, uint8_t *DataPtr) {
+    auto it = mshr_.find(addr / cache_.LineSize());
+    if (it == mshr_.end() || --it->second.bursts > 0)
+        return;
+    std::vector<uint64_t> writebacks;
+    cache_.Fill(it->first, it->second.dirty, it->second.prefetch, &writebacks);
+    QueueWritebacks(writebacks);
+    mshr_.erase(it);
+}
+
+// Dirty lines leaving the LLC, one memory write per burst
+void CPUSpmvTransactionGenerator::QueueWritebacks(const std::vector<uint64_t>& lines) {
+    for (uint64_t line : lines) {
+        for (int b = 0; b < cache_.LineSize(); b += burstSize_)
+            writeback_q_.push_back(line * cache_.LineSize() + b);
+    }
+}
+
+void CPUSpmvTransactionGenerator::Tick() {
+    memory_system_.ClockTick();
+    clk_++;
 }
 
+// Accesses dispatch in program order, core_width_ per cycle. An x[col]
+// whose column index is not loaded yet waits in a window of window_ entries
+// while the independent accesses behind it go on (out-of-order core)
 void CPUSpmvTransactionGenerator::Execute() {
-    
-    //Changing column only
-    //Address addr(current_ch, 0, bg, ba, ro, co);
-    for(uint32_t co = 0; co< 32; co++){
-        Address addr(0, 0, 0, 0, 0, co);
-        uint64_t hex_addr = ReverseAddressMapping(addr);
-        TryAddTransaction(hex_addr, true, data_temp_);
+    NextAccesses();
+    while (true) {
+        IssueBackground();
+        int slots = core_width_;
+        for (auto it = window_q_.begin(); it != window_q_.end() && slots > 0;) {
+            if (DepReady(*it) && Issue(*it)) {
+                it = window_q_.erase(it);
+                slots--;
+            } else {
+                ++it;
+            }
+        }
+        for (; slots > 0; slots--) {
+            if (pending_pos_ >= pending_.size())
+                NextAccesses();
+            if (pending_.empty())
+                break;
+            const CpuAccess& access = pending_[pending_pos_];
+            if (!DepReady(access)) {
+                if ((int)window_q_.size() >= window_) {
+                    dep_stall_cycles_++;
+                    break;
+                }
+                window_q_.push_back(access);
+            } else if (!Issue(access)) {
+                break;
+            }
+            pending_pos_++;
+        }
+        if (pending_.empty() && window_q_.empty() && mshr_.empty())
+            break;
+        Tick();
     }
+    // hits still in the pipeline
+    while (clk_ < ready_clk_)
+        Tick();
+}
 
+// Dirty lines (y) are written back at the end of the kernel
+void CPUSpmvTransactionGenerator::GetResult() {
+    std::vector<uint64_t> writebacks;
+    cache_.Flush(&writebacks);
+    QueueWritebacks(writebacks);
+    while (!writeback_q_.empty()) {
+        IssueBackground();
+        Tick();
+    }
     Barrier();
-    
-    for (uint32_t idx = 0; idx < 1; idx++) {
-        uint32_t row, col;
-        uint16_t value;
+    PrintCacheStats();
+}
 
-        // Load row index (row_indices[idx])
-        TryAddTransaction(addr_row_indices_ + idx * sizeof(uint32_t), false, data_temp_);
+void CPUSpmvTransactionGenerator::PrintCacheStats() {
+    std::cout << "CPU SpMV: " << accesses_ << " accesses, " << mshr_merges_
+              << " merged into outstanding misses" << std::endl;
+    for (int i = 0; i < cache_.Levels(); i++) {
+        const SetAssocCache& c = cache_.Level(i);
+        uint64_t lookups = c.hits_ + c.misses_;
+        std::cout << "  L" << i + 1 << ": hits " << c.hits_ << ", misses "
+                  << c.misses_ << ", hit rate "
+                  << (lookups ? 100.0 * c.hits_ / lookups : 0.0) << " %"
+                  << std::endl;
+    }
+    std::cout << "  prefetch: issued " << prefetch_issued_ << ", useful "
+              << prefetch_useful_ << ", late " << prefetch_late_ << std::endl;
+    std::cout << "  stall cycles: MSHR " << mshr_stall_cycles_
+              << ", window full " << dep_stall_cycles_ << ", memory "
+              << mem_stall_cycles_ << std::endl;
+    std::cout << "  memory: " << mem_reads_ << " reads, " << mem_writes_
+              << " writes (" << burstSize_ << "B)" << std::endl;
+    double checksum = 0.0;
+    for (float v : y_)
+        checksum += v;
+    std::cout << "  y checksum " << checksum << std::endl;
+}
+////////////////////////////TW Added end///////////////////////////////////////
+
+void GemmTransactionGenerator::Initialize() {
+    std::cout << "Initialize GemmTransactionGenerator" << std::endl;
+    if (n_ == 0 || k_ == 0 || m_ == 0) {
+        std::cerr << "GEMM needs positive n, K, M" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    int units = config_->pim_units;
+    slices_ = (m_ + NUM_UNIT_PER_WORD - 1) / NUM_UNIT_PER_WORD;
+    rounds_ = (slices_ + units - 1) / units;
+
+    // k blocks of at most 256 (JUMP count), multiple of 8 (SRF_M)
+    uint32_t k8 = (k_ + 7) / 8 * 8;
+    blocks_ = (k8 + 255) / 256;
+    block_ = ((k8 + blocks_ - 1) / blocks_ + 7) / 8 * 8;
+    w_rows_ = (blocks_ * block_ + SIZE_WORD - 1) / SIZE_WORD;
+    out_base_ = rounds_ * w_rows_;
+    uint64_t nodes = (n_ + num_channels_ - 1) / num_channels_;
+    uint64_t out_rows = (nodes * rounds_ * 8 + SIZE_WORD - 1) / SIZE_WORD;
+    if (out_base_ + out_rows > MAP_DRF) {
+        std::cerr << "GEMM " << n_ << "x" << k_ << "x" << m_
+                  << " does not fit the rows below the PIM registers"
+                  << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
 
-        // Check if column index is in cache
-        uint64_t col_addr = addr_col_indices_ + idx * sizeof(uint32_t);
-        if (cache_col_.find(col_addr) == cache_col_.end()) {
-            std::cout << "CPU: Cache miss for column index" << std::endl;
-            TryAddTransaction(col_addr, false, data_temp_);
-            cache_col_[col_addr] = true; // Mark as cached
+    std::string source =
+        ".bank even\n"
+        "MAC(AAM0) GRF_B BANK SRF_M\n"
+        "JUMP -1 " + std::to_string(block_ - 1) + "\n"
+        ".bank odd\n"
+        "MOV(AAM0) BANK GRF_B\n"
+        "JUMP -1 7\n"
+        "EXIT\n";
+    if (!kernel_.Assemble(source))
+        AbruptExit(__FILE__, __LINE__);
+    kernel_.CopyTo(crf_, 32);
+    schedule_ = kernel_.Schedule();
+    if (schedule_.empty())
+        AbruptExit(__FILE__, __LINE__);
+
+    // W slices, padded with zeros past K and M
+    const uint16_t one = 0x3c00;  // FP16 1.0
+    uint32_t k_pad = blocks_ * block_;
+    w_image_.assign((size_t)slices_ * k_pad * NUM_UNIT_PER_WORD, 0);
+    for (int s = 0; s < slices_; s++) {
+        for (uint32_t k = 0; k < k_; k++) {
+            for (int l = 0; l < NUM_UNIT_PER_WORD; l++) {
+                uint32_t col = s * NUM_UNIT_PER_WORD + l;
+                if (col >= m_)
+                    continue;
+                w_image_[((size_t)s * k_pad + k) * NUM_UNIT_PER_WORD + l] =
+                    weight_.empty() ? one : weight_[(size_t)k * m_ + col];
+            }
+        }
+    }
+    srf_image_.assign((size_t)num_channels_ * (block_ / 8) * NUM_UNIT_PER_WORD, 0);
+    zero_.assign(NUM_UNIT_PER_WORD, 0);
+    std::cout << "GEMM " << n_ << "x" << k_ << "x" << m_ << ": " << slices_
+              << " slices, " << rounds_ << " rounds, " << blocks_
+              << " blocks of " << block_ << " k, " << schedule_.size()
+              << " triggers per pass" << std::endl;
+}
+
+void GemmTransactionGenerator::SetData() {
+    // W of every slice into the EVEN bank of its PimUnit, on every channel
+    uint32_t k_pad = blocks_ * block_;
+    int units = config_->pim_units;
+    for (int ch = 0; ch < num_channels_; ch++) {
+        for (int s = 0; s < slices_; s++) {
+            int bank = (s % units) * config_->pim_banks_per_unit + EVEN_BANK;
+            int round = s / units;
+            for (uint32_t k = 0; k < k_pad; k++) {
+                Address addr(ch, 0, bank / banks_per_group_,
+                             bank % banks_per_group_,
+                             round * w_rows_ + k / SIZE_WORD, k % SIZE_WORD);
+                const uint16_t* word =
+                    &w_image_[((size_t)s * k_pad + k) * NUM_UNIT_PER_WORD];
+                SetDataWord(ReverseAddressMapping(addr),
+                            reinterpret_cast<const uint8_t*>(word),
+                            k % SIZE_WORD == 0);
+            }
         }
+    }
+    Barrier();
 
-        // Check if value is in cache
-        uint64_t val_addr = addr_val_ + idx * sizeof(uint16_t);
-        TryAddTransaction(val_addr, false, data_temp_); // Always read value (no cache for value)
+    // Mode transition: SB -> AB
+    for (int ch = 0; ch < num_channels_; ch++) {
+        Address addr(ch, 0, 0, 0, MAP_ABMR, 0);
+        TryAddTransaction(ReverseAddressMapping(addr), false, data_temp_);
+    }
+    Barrier();
 
-        // Check if x[col] is in cache
-        uint64_t x_addr = addr_x_ + col * UNIT_SIZE;
-        if (cache_x_.find(x_addr / 32) == cache_x_.end()) {
-            TryAddTransaction(x_addr, false, data_temp_);
-            cache_x_[x_addr / 32] = true; // Cache x[col] by 32B block
+    // Program μkernel into CRF register, 8 instructions per 32B write
+    for (int ch = 0; ch < num_channels_; ch++) {
+        for (int co = 0; co < kernel_.CrfWrites(); co++) {
+            Address addr(ch, 0, 0, 0, MAP_CRF, co);
+            TryAddTransaction(ReverseAddressMapping(addr), true,
+                              (uint8_t*)&crf_[co * 8]);
         }
+    }
+    Barrier();
+}
 
-        Barrier(); // Ensure all reads are completed before the next transaction
+// ODD bank word g of (node, round) of PimUnit `unit`, in node order
+Address GemmTransactionGenerator::OutputWord(int ch, int unit, uint32_t node,
+                                             int round, int g) {
+    uint64_t w = ((uint64_t)(node / num_channels_) * rounds_ + round) * 8 + g;
+    int bank = unit * config_->pim_banks_per_unit + ODD_BANK;
+    return Address(ch, 0, bank / banks_per_group_, bank % banks_per_group_,
+                   out_base_ + w / SIZE_WORD, w % SIZE_WORD);
+}
 
-        // Write to y[row] (simulate write transaction)
-        uint64_t y_addr = addr_y_ + row * UNIT_SIZE;
-        TryAddTransaction(y_addr, true, data_temp_);
+// One μkernel pass: k block `block` of node for slice round `round`
+void GemmTransactionGenerator::Pass(int ch, uint32_t node, int round,
+                                    uint32_t block,
+                                    std::vector<HostTransaction>& out) {
+    // Mode transition: AB -> AB-PIM, EXIT drops the channel back to AB
+    Address mode(ch, 0, 0, 0, MAP_PIM_OP_MODE, 0);
+    out.push_back({ReverseAddressMapping(mode), true, nullptr});
+    if (block == 0) {
+        for (int g = 0; g < 8; g++) {
+            Address addr(ch, 0, 0, 0, MAP_GRF, 8 + g);
+            out.push_back({ReverseAddressMapping(addr), true,
+                           reinterpret_cast<uint8_t*>(zero_.data())});
+        }
+    }
+    // SRF images of this pass: SRF_A unused, SRF_M = x[node, k .. k+7]
+    uint16_t* srf = &srf_image_[(size_t)ch * (block_ / 8) * NUM_UNIT_PER_WORD];
+    const uint16_t one = 0x3c00;
+    for (uint32_t c = 0; c < block_ / 8; c++) {
+        for (int i = 0; i < 8; i++) {
+            uint32_t k = block * block_ + c * 8 + i;
+            uint16_t x = 0;
+            if (k < k_)
+                x = input_.empty() ? one : input_[(size_t)node * k_ + k];
+            srf[c * NUM_UNIT_PER_WORD + 8 + i] = x;
+        }
+    }
+    uint32_t mac = 0;
+    for (const UKernelTrigger& t : schedule_) {
+        if (t.op == PIM_OPERATION::MAC) {
+            if (mac % 8 == 0) {
+                Address addr(ch, 0, 0, 0, MAP_SRF, 0);
+                out.push_back({ReverseAddressMapping(addr), true,
+                               reinterpret_cast<uint8_t*>(
+                                   srf + (mac / 8) * NUM_UNIT_PER_WORD)});
+            }
+            uint32_t k = block * block_ + mac++;
+            Address addr(ch, 0, 0, EVEN_BANK, round * w_rows_ + k / SIZE_WORD,
+                         k % SIZE_WORD);
+            out.push_back({ReverseAddressMapping(addr), false, nullptr});
+        } else if (t.is_write) {
+            Address addr = OutputWord(ch, 0, node, round, t.column % 8);
+            out.push_back({ReverseAddressMapping(addr), true, nullptr});
+        } else {
+            Address addr(ch, 0, 0, t.bank, round * w_rows_, t.column);
+            out.push_back({ReverseAddressMapping(addr), false, nullptr});
+        }
+    }
+}
+
+void GemmTransactionGenerator::Execute() {
+    // Per channel: nodes ch, ch + channels, ..., every round, every k block
+    std::vector<uint64_t> step(num_channels_, 0);
+    uint64_t passes = (uint64_t)rounds_ * blocks_;
+    IssueInterleaved(num_channels_, [&](int ch, std::vector<HostTransaction>& out) {
+        uint64_t node = ch + (step[ch] / passes) * num_channels_;
+        if (node >= n_)
+            return false;
+        uint64_t p = step[ch]++ % passes;
+        Pass(ch, (uint32_t)node, (int)(p / blocks_), (uint32_t)(p % blocks_),
+             out);
+        return true;
+    });
+    Barrier();
+}
+
+void GemmTransactionGenerator::GetResult() {
+    // Mode transition: AB -> SB
+    for (int ch = 0; ch < num_channels_; ch++) {
+        Address addr(ch, 0, 0, 0, MAP_SBMR, 0);
+        TryAddTransaction(ReverseAddressMapping(addr), false, data_temp_);
+    }
+    Barrier();
 
-        Barrier(); // Ensure proper transaction order
+    // 8 partial words per node and slice, the host adds them up
+    int units = config_->pim_units;
+    std::vector<HostTransaction> batch;
+    for (uint32_t node = 0; node < n_; node++) {
+        int ch = node % num_channels_;
+        for (int s = 0; s < slices_; s++) {
+            for (int g = 0; g < 8; g++) {
+                Address addr = OutputWord(ch, s % units, node, s / units, g);
+                batch.push_back({ReverseAddressMapping(addr), false, nullptr});
+            }
+        }
     }
+    AddTransactions(batch);
+    Barrier();
+}
+
+void UKernelTransactionGenerator::Initialize() {
+    std::cout << "Initialize UKernelTransactionGenerator" << std::endl;
+    if (!kernel_.AssembleFile(ukernel_file_))
+        AbruptExit(__FILE__, __LINE__);
+    kernel_.CopyTo(crf_, 32);
+    int loop_count = loop_count_;
+    schedule_ = kernel_.Schedule([loop_count](int) { return loop_count; });
+    if (schedule_.empty())
+        AbruptExit(__FILE__, __LINE__);
+    std::cout << "μkernel: " << kernel_.Size() << " instructions, "
+              << schedule_.size() << " triggers per pass" << std::endl;
+}
+
+void UKernelTransactionGenerator::SetData() {
+    // Mode transition: SB -> AB
+    for (int ch = 0; ch < num_channels_; ch++) {
+        Address addr(ch, 0, 0, 0, MAP_ABMR, 0);
+        TryAddTransaction(ReverseAddressMapping(addr), false, data_temp_);
+    }
+    Barrier();
+
+    // Program μkernel into CRF register, 8 instructions per 32B write
+    for (int ch = 0; ch < num_channels_; ch++) {
+        for (int co = 0; co < kernel_.CrfWrites(); co++) {
+            Address addr(ch, 0, 0, 0, MAP_CRF, co);
+            TryAddTransaction(ReverseAddressMapping(addr), true,
+                              (uint8_t*)&crf_[co * 8]);
+        }
+    }
+    Barrier();
+}
+
+void UKernelTransactionGenerator::Execute() {
+    // One pass per row, the channels are interleaved trigger by trigger
+    for (int ro = 0; ro < rows_; ro++) {
+        // Mode transition: AB -> AB-PIM, EXIT drops the channel back to AB
+        *data_temp_ |= 1;
+        for (int ch = 0; ch < num_channels_; ch++) {
+            Address addr(ch, 0, 0, 0, MAP_PIM_OP_MODE, 0);
+            TryAddTransaction(ReverseAddressMapping(addr), true, data_temp_);
+        }
+        Barrier();
+
+        for (const UKernelTrigger& t : schedule_) {
+            for (int ch = 0; ch < num_channels_; ch++) {
+                Address addr(ch, 0, 0, t.bank, ro, t.column);
+                TryAddTransaction(ReverseAddressMapping(addr), t.is_write,
+                                  data_temp_);
+            }
+        }
+        Barrier();
+    }
+}
+
+void UKernelTransactionGenerator::GetResult() {
+    // Mode transition: AB -> SB
+    for (int ch = 0; ch < num_channels_; ch++) {
+        Address addr(ch, 0, 0, 0, MAP_SBMR, 0);
+        TryAddTransaction(ReverseAddressMapping(addr), false, data_temp_);
+    }
+    Barrier();
 }
-////////////////////////////TW Added end///////////////////////////////////////
 
 }  // namespace dramsim3
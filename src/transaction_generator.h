@@ -6,11 +6,19 @@
 #include <stdlib.h>
 #include <string>
 #include <cstdint>
+#include <deque>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include "./memory_system.h"
 #include "./configuration.h"
 #include "./common.h"
 #include "./pim_config.h"
 #include "./half.hpp"
+#include "./pmem.h"
+#include "./ukernel.h"
+#include "./cpu_cache.h"
 #include "../sparse_suite/sw_full_stack.h"
 
 //#include "./../coo_partitioned/spmvArrCSC.h"
@@ -18,13 +26,9 @@
 #define EVEN_BANK 0
 #define ODD_BANK  1
 
-#define NUM_WORD_PER_ROW     32
+// Channel / bank / row geometry comes from Config (num_channels_, ...)
 #define NUM_UNIT_PER_WORD    16
-#define NUM_CHANNEL          16 //TW added
-#define NUM_BANK_PER_CHANNEL 16
-#define NUM_BANK             (NUM_BANK_PER_CHANNEL * NUM_CHANNEL) //16 * 16 = 256
 #define SIZE_WORD            32
-#define SIZE_ROW             (SIZE_WORD * NUM_WORD_PER_ROW) //32 * 32 = 1024
 
 // Mapping을 위한 주소들에 대한 정의
 #define MAP_SBMR             0x3fff //Single Bank Mode Register
@@ -39,6 +43,8 @@
 // JH added
 #define MAP_PPMR             0x3ff8 // partitioned pim mode for SpMM
 #define MAP_DRF              0x3ff7 // Dense register file
+#define DRF_ROWS             (DRF_SIZE / WORD_SIZE) // 16, MUL_DRF row index
+#define DRF_COLS             (WORD_SIZE / UNIT_SIZE) // 16 FP16 lanes
 
 #define C_NORMAL "\033[0m"
 #define C_RED    "\033[031m"
@@ -48,6 +54,20 @@
 
 namespace dramsim3 {
 
+// μkernel sources of the generators (UKernel syntax, ukernel.h)
+extern const char* kUKernelSpmv;
+extern const char* kUKernelSpmm;
+extern const char* kUKernelSpmvDense;
+extern const char* kUKernelSpmvSparseRow;
+
+// One host request of a batch / per-channel stream (see IssueInterleaved)
+//  data : 32B of a write, nullptr uses data_temp_
+struct HostTransaction {
+    uint64_t hex_addr;
+    bool is_write;
+    uint8_t *data;
+};
+
 class TransactionGenerator {
  public:
     TransactionGenerator(const std::string& config_file,
@@ -60,24 +80,34 @@ class TransactionGenerator {
                         std::placeholders::_1)),
           config_(new Config(config_file, output_dir)),
           clk_(0) {
-        pmemAddr_size_ = (uint64_t)4 * 1024 * 1024 * 1024;
-        pmemAddr_ = (uint8_t *) mmap(NULL, pmemAddr_size_,
-                                     PROT_READ | PROT_WRITE,
-                                     MAP_ANON | MAP_PRIVATE,
-                                     -1, 0);
-        if (pmemAddr_ == (uint8_t*) MAP_FAILED)
-            perror("mmap");
+        // channels x channel_size, populated lazily (see pmem.h)
+        pmem_ = PmemBackend::Create(*config_);
+        if (!config_->pmem_restore.empty() &&
+            !pmem_->LoadCheckpoint(config_->pmem_restore))
+            AbruptExit(__FILE__, __LINE__);
+        pmemAddr_ = pmem_->Base();
+        pmemAddr_size_ = pmem_->Size();
         burstSize_ = 32; // 32B
 
         data_temp_ = (uint8_t *) malloc(burstSize_);
 
         memory_system_.init(pmemAddr_, pmemAddr_size_, burstSize_);
 
+        num_channels_ = config_->channels;
+        num_bankgroups_ = config_->bankgroups;
+        banks_per_group_ = config_->banks_per_group;
+        num_banks_ = (uint64_t)config_->channels * config_->banks;
+        row_size_ = (uint64_t)SIZE_WORD * config_->pim_words_per_row;
+
         is_print_ = false;
+        preload_ = false;
+        preload_count_writes_ = false;
+        interleave_channels_ = true;
+        issue_width_ = 1;
         start_clk_ = 0;
         cnt_ = 0;
     }
-    ~TransactionGenerator() { delete(config_); }
+    ~TransactionGenerator() { delete(pmem_); delete(config_); }
     // virtual void ClockTick() = 0;
     virtual void Initialize() = 0;
     virtual void SetData() = 0;
@@ -89,27 +119,57 @@ class TransactionGenerator {
 
    //아래에 있는 Function들은 모든 transacion generator에서 사용할 수 있는 함수들
    //위의 함수는 override를 하여, 사용하는 경우의 transaction generator가 각각 정의
-    void ReadCallBack(uint64_t addr, uint8_t *DataPtr);
+    virtual void ReadCallBack(uint64_t addr, uint8_t *DataPtr);
     void WriteCallBack(uint64_t addr);
-    void PrintStats() { memory_system_.PrintStats(); }
+    // DRAM / PIM stats plus the pmem residency, [system] pmem_checkpoint
+    // also saves the touched pmem pages (relative paths in output_dir)
+    void PrintStats();
+    double TotalEnergy() { return memory_system_.TotalEnergy(); }  // pJ
     uint64_t ReverseAddressMapping(Address& addr);
     uint64_t Ceiling(uint64_t num, uint64_t stride);
     void TryAddTransaction(uint64_t hex_addr, bool is_write, uint8_t *DataPtr);
+    void SetDataWord(uint64_t hex_addr, const uint8_t *DataPtr, bool first_in_row);
     void Barrier();
+    // next(ch, out) fills `out` with the next transactions of channel ch and
+    // returns false once the channel has no more work
+    typedef std::function<bool(int, std::vector<HostTransaction>&)> StreamFn;
+    void IssueInterleaved(int channels, StreamFn next);
+    // Independent transactions, only the order inside a channel is kept
+    void AddTransactions(const HostTransaction *txs, size_t n);
+    void AddTransactions(const std::vector<HostTransaction>& txs) {
+        AddTransactions(txs.data(), txs.size());
+    }
 	uint64_t GetClk() { return clk_; }
 
     bool is_print_;
+    bool preload_;              // SetData copies the input into pmem untimed
+    bool preload_count_writes_; // ... and still counts the writes in stats
+    bool interleave_channels_;  // IssueInterleaved round-robins the channels
+    int issue_width_;           // requests per channel per cycle (batched)
     uint64_t start_clk_;
     int cnt_;
 
  protected:
+    void SubmitTransaction(uint64_t hex_addr, bool is_write, uint8_t *DataPtr);
+    // PIM generators: exits if the config is not a PIM geometry
+    //  (Config::ValidatePim), partitions: DRAF / sparse partitions given
+    void CheckPimGeometry(size_t partitions = 0);
+
     MemorySystem memory_system_;
     const Config *config_;
+    PmemBackend *pmem_;
     uint8_t *pmemAddr_;
     uint64_t pmemAddr_size_;
     unsigned int burstSize_;
     uint64_t clk_;
 
+    // PIM geometry, from config_
+    int num_channels_;
+    int num_bankgroups_;
+    int banks_per_group_;
+    uint64_t num_banks_;  // banks of all channels
+    uint64_t row_size_;   // bytes of a row
+
     uint8_t *data_temp_;
 };
 
@@ -121,7 +181,16 @@ class SpmvTransactionGenerator : public TransactionGenerator {
                              std::vector<std::vector<re_aligned_dram_format>> DRAF_BG,
                              uint8_t *output_vector)
         : TransactionGenerator(config_file, output_dir),
-          DRAF_BG_(DRAF_BG), output_vector_(output_vector){}
+          DRAF_BG_(std::move(DRAF_BG)), output_vector_(output_vector) {
+        CheckPimGeometry(DRAF_BG_.size());
+        pipeline_tile_rows_ = 0;
+        rebalance_ = false;
+        early_exit_ = false;
+        gacc_reduction_ = false;
+        vector_words_ = 0;
+        tile_format_ = "draf";
+        output_rows_ = 0;
+    }
     void Initialize() override;
     void SetData() override;
     void Execute() override;
@@ -132,11 +201,50 @@ class SpmvTransactionGenerator : public TransactionGenerator {
 
     uint8_t *partial_index_;
     uint8_t *partial_value_;
+    uint32_t pipeline_tile_rows_;  // > 0: stream the matrix during Execute
+    bool rebalance_;   // Initialize moves DRAF tiles to the lighter BGs
+    bool early_exit_;  // a channel stops after its own last DRAM row
+    bool gacc_reduction_;  // per row, GRF_A of every channel into the GACC tree
+    // ChangeVector input: x of every matrix column as FP16 (col_group - 1)
+    std::vector<uint16_t> x_vector_;
+    uint64_t vector_words_;  // column-29 words the last ChangeVector wrote
+    // GetResult writes y (FP16) of rows 1 ~ output_rows_ to output_vector_,
+    //  0: timing only. The host replay does not keep a result per DRAF row
+    //  in pmem, y is the reduction of the resident image: val (INT16) x vec
+    //  (FP16, x of col_group) summed per row index
+    uint64_t output_rows_;
+    const uint16_t *Output() const {
+        return reinterpret_cast<const uint16_t *>(output_vector_);
+    }
+    // Per-tile formats (selectTileFormats, sw_full_stack.h)
+    //  "draf": every tile stays a DRAF row, "auto": cheapest format per tile
+    //  (cost model from the config), "dense" / "sparse_row": every tile
+    //  A mixed_ image with a directory is used as it is (loadMixedFromFile)
+    //  Rows of a format sit above the previous format's rows, Execute runs
+    //  the DRAF rows, then per format reprograms the CRF and runs its rows
+    std::string tile_format_;
+    mixed_format_image mixed_;
 
  private:
     void ExecuteBank(int bank);
+    void ReduceOutput();
+    void RowTriggers(int ch, int ro, std::vector<HostTransaction>& out);
+    void WriteRows(int ch, uint32_t ro_begin, uint32_t ro_end,
+                   std::vector<HostTransaction>& out);
+    void ExecutePipelined();
+    void Rebalance();
+    uint32_t RowLookahead();
+    bool Mixed() const { return !mixed_.directory.empty(); }
+    void InitializeMixed();
+    void WriteMixedRows();
+    void ExecuteFormat(int format);
+    void DenseTriggers(int ch, int ro, std::vector<HostTransaction>& out);
+    void SparseRowTriggers(int ch, int ro, std::vector<HostTransaction>& out);
+    Address SparseRowSlot(int p, uint32_t j);
+    uint16_t SparseRowX(uint32_t col) const;
 
     std::vector<std::vector<re_aligned_dram_format>> DRAF_BG_;
+    std::vector<uint32_t> channel_rows_;  // DRAM rows Execute runs per channel
     uint8_t *output_vector_; 
     uint32_t kernel_execution_time_;
     //uint64_t m_, n_; //Matrix의 크기를 전달하기 위한 코드
@@ -145,6 +253,20 @@ class SpmvTransactionGenerator : public TransactionGenerator {
     uint64_t ukernel_count_per_pim_;
     uint32_t *ukernel_spmv_;
     uint32_t *ukernel_spmv_last_;
+    std::vector<UKernelTrigger> spmv_schedule_;  // one pass of kUKernelSpmv
+
+    // mixed formats: first DRAM row and rows per channel of each format
+    uint32_t dense_base_, sparse_row_base_;
+    std::vector<uint32_t> dense_rows_, sparse_row_rows_;
+    UKernel dense_kernel_;
+    std::vector<UKernelTrigger> dense_schedule_;
+    uint32_t dense_crf_[32];
+    UKernel sparse_row_kernel_;
+    uint32_t sparse_row_crf_[32];
+    std::vector<std::vector<uint32_t>> sparse_row_tile_;  // block -> directory
+    std::vector<std::vector<uint8_t>> sparse_row_image_;  // packed blocks
+    std::vector<std::vector<uint8_t>> sparse_row_trips_;  // [ch][r * 32 + d], 0: none
+    std::vector<uint16_t> drf_image_;  // DRF of one sparse_row DRAM row
 };
 
 //TW added
@@ -155,7 +277,9 @@ class NoPIMSpmvTransactionGenerator : public TransactionGenerator {
                                std::vector<std::vector<re_aligned_dram_format>> DRAF_BG,
                                uint8_t *output_vector)
           : TransactionGenerator(config_file, output_dir),
-            DRAF_BG_(DRAF_BG), output_vector_(output_vector){}
+            DRAF_BG_(std::move(DRAF_BG)), output_vector_(output_vector) {
+          CheckPimGeometry(DRAF_BG_.size());
+      }
       void Initialize() override;
       void SetData() override;
       void Execute() override{};
@@ -183,36 +307,94 @@ class NoPIMSpmvTransactionGenerator : public TransactionGenerator {
   
 
 //TW added
+// CPU SpMV baseline, y = A x on one core (CSR or COO in file order)
+//  Every access goes through a set-associative LRU hierarchy (cpu_cache.h),
+//  only LLC misses, stride prefetches and dirty writebacks reach the
+//  MemorySystem. At most mshrs_ lines are outstanding, x[col] waits for the
+//  load of its column index (up to window_ of them, the rest go on) and
+//  core_width_ accesses issue per cycle
 class CPUSpmvTransactionGenerator : public TransactionGenerator {
  public:
     CPUSpmvTransactionGenerator(const std::string& config_file,
                              const std::string& output_dir,
-                             uint32_t n_rows,
-                             uint32_t n_cols, 
-                             uint32_t nnz, 
-                             double miss_ratio)
+                             const COOMatrix& matrix,
+                             bool csr,
+                             const std::vector<CacheLevelConfig>& caches,
+                             int line_size)
         : TransactionGenerator(config_file, output_dir),
-          n_rows_(n_rows), n_cols_(n_cols), nnz_(nnz), miss_ratio_(miss_ratio) {}
+          matrix_(matrix), csr_(csr), cache_(caches, line_size),
+          prefetcher_(NUM_STREAMS, 0) {
+        mshrs_ = 16;
+        prefetch_degree_ = 4;
+        core_width_ = 2;
+        window_ = 32;
+    }
     void Initialize() override;
     void SetData() override {};
     void Execute() override;
-    void GetResult() override {};
+    void GetResult() override;
     void CheckResult() override {};
     void AdditionalAccumulation() override{};
     void ChangeVector() override {};
+    void ReadCallBack(uint64_t addr, uint8_t *DataPtr) override;
+
+    int mshrs_;            // outstanding LLC miss lines
+    int prefetch_degree_;  // lines per prefetch, 0 disables the prefetcher
+    int core_width_;       // cache accesses per memory cycle
+    int window_;           // x[col] loads waiting for their index
 
  private:
-    void ExecuteBank(int bank, int batch);
-    
-    uint32_t n_rows_, n_cols_, nnz_;
-    double miss_ratio_;
-    uint32_t addr_row_indices_, addr_col_indices_, addr_val_; 
-    uint32_t addr_x_, addr_y_;
-    
-   // Cache for column indices and vector x elements
-    std::unordered_map<uint64_t, bool> cache_col_; // Cache to track accessed column indices
-    std::unordered_map<uint64_t, uint16_t> cache_x_; // Cache for vector x elements (32B granularity)
+    // access streams (prefetcher table index)
+    enum { ROW_STREAM = 0, COL_STREAM, VAL_STREAM, X_STREAM, Y_STREAM,
+           NUM_STREAMS };
+    struct CpuAccess {
+        uint64_t addr;
+        bool is_write;
+        int stream;
+        // x[col]: the column index load it waits for
+        uint64_t dep_line;
+        bool dep_pending;        // dep_line was a miss
+        uint64_t dep_ready_clk;  // hit latency
+    };
+    struct Mshr {
+        int bursts;     // reads still in flight
+        bool dirty;     // a demand write merged into the miss
+        bool prefetch;  // no demand access yet
+    };
+    void NextAccesses();
+    bool DepReady(const CpuAccess& access) const;
+    bool Issue(const CpuAccess& access);
+    bool CanIssueLine(uint64_t line);
+    void IssueLine(uint64_t line, bool prefetch);
+    void IssueBackground();
+    void QueueWritebacks(const std::vector<uint64_t>& lines);
+    void Tick();
+    void PrintCacheStats();
+
+    COOMatrix matrix_;
+    bool csr_;
+    std::vector<uint32_t> row_ptr_, col_, row_;
+    std::vector<uint16_t> val_;
+    std::vector<float> x_, y_;
+    uint64_t addr_row_indices_, addr_col_indices_, addr_val_;
+    uint64_t addr_x_, addr_y_;
+
+    CacheHierarchy cache_;
+    StridePrefetcher prefetcher_;
+    std::unordered_map<uint64_t, Mshr> mshr_;
+    std::deque<uint64_t> prefetch_q_;
+    std::deque<uint64_t> writeback_q_;  // burst addresses
 
+    // access stream, refilled one row (CSR) / nonzero (COO) at a time
+    std::vector<CpuAccess> pending_;
+    size_t pending_pos_;
+    uint32_t next_item_;
+    std::deque<CpuAccess> window_q_;  // x[col] waiting for the index
+    uint64_t ready_clk_;     // completion of the latest hit
+
+    uint64_t accesses_, mem_reads_, mem_writes_, mshr_merges_;
+    uint64_t prefetch_issued_, prefetch_useful_, prefetch_late_;
+    uint64_t mshr_stall_cycles_, dep_stall_cycles_, mem_stall_cycles_;
 };
 
 //TW added end
@@ -222,11 +404,15 @@ class SpmmTransactionGenerator : public TransactionGenerator {
  public:
    SpmmTransactionGenerator(const std::string& config_file,
                              const std::string& output_dir,
-                             std::vector<std::vector<sparse_row_format>> B0_data,
-                             std::vector<std::vector<sparse_row_format>> B2_data,
+                             sparse_row_partitions B0_data,
+                             sparse_row_partitions B2_data,
                              uint16_t *output_matrix)
         : TransactionGenerator(config_file, output_dir),
-          B0_data_(B0_data), B2_data_(B2_data), output_matrix_(output_matrix) {}
+          B0_data_(B0_data), B2_data_(B2_data), output_matrix_(output_matrix) {
+        CheckPimGeometry(B0_data_.size());
+        CheckPimGeometry(B2_data_.size());
+        dense_width_ = DRF_COLS;
+    }
     void Initialize() override;
     void SetData() override;
     void Execute() override;
@@ -237,26 +423,124 @@ class SpmmTransactionGenerator : public TransactionGenerator {
 
     uint8_t *partial_index_;
     uint8_t *partial_value_;
+    // Dense operand (FP16 bits, row-major, dense_width_ columns)
+    //  Execute runs one pass per DRF tile of DRF_COLS columns and reloads the
+    //  DRF in between. At most DRF_ROWS rows (K is not tiled, Initialize).
+    //  Empty: every DRF tile is FP16 1.0
+    uint32_t dense_width_;
+    std::vector<uint16_t> dense_matrix_;
+    // DRF tiles built by Initialize, tile t = DRF_ROWS x DRF_COLS FP16
+    int DenseTiles() const { return dense_tiles_; }
+    const uint16_t *DrfTile(int tile) const {
+        return &drf_tiles_[tile * (DRF_SIZE / sizeof(uint16_t))];
+    }
 
  private:
+    void RowTriggers(int ch, int ro, int out_ro, int& accum_rds,
+                     std::vector<HostTransaction>& out);
+    void DrfLoad(int ch, int tile, std::vector<HostTransaction>& out);
     void ExecuteBank(int bank);
    
-    std::vector<std::vector<sparse_row_format>> B0_data_;
-    std::vector<std::vector<sparse_row_format>> B2_data_;
+    // spans into the mapped .dat (mapSparseFromFile), read only
+    sparse_row_partitions B0_data_;
+    sparse_row_partitions B2_data_;
     uint16_t *output_matrix_;
     uint32_t kernel_execution_time_;
     uint32_t min_kernel_execution_time_;
     bool max_b0;
     int max_index;
-    int total_n_rows[NUM_CHANNEL];
+    std::vector<int> total_n_rows;
     uint64_t addr_B0_, addr_B2_, addr_output_matrix_;
     uint64_t ukernel_access_size_;
     uint64_t ukernel_count_per_pim_;
     uint32_t *ukernel_spmm_;
     uint32_t *ukernel_spmm_last_;
+    int dense_tiles_;
+    uint32_t output_row_stride_;      // ODD_BANK rows per dense tile
+    std::vector<uint16_t> drf_tiles_; // DRF image (DRF_SIZE) per tile
 };
 
 
+// Dense Y = X W on PIM with MAC (X: n x K, W: K x M, FP16)
+//  W stays in the EVEN banks: PimUnit u of round r holds the 16 output
+//  columns of slice r * pim_units + u, one word per k (row k / 32, column
+//  k % 32 of its W rows). Every channel keeps a copy of W and takes the
+//  nodes i % channels. A pass covers a block of k: the host broadcasts
+//  x[i, k .. k+7] with one SRF write, MAC(AAM0) GRF_B BANK SRF_M adds word k
+//  times SRF_M[k % 8] into GRF_B[k % 8], then MOV BANK GRF_B stores the 8
+//  partial words in the ODD bank. GRF_B is cleared (MAP_GRF) per node and
+//  round, the last pass leaves the result and the host sums the 8 partials
+class GemmTransactionGenerator : public TransactionGenerator {
+ public:
+    GemmTransactionGenerator(const std::string& config_file,
+                             const std::string& output_dir,
+                             uint32_t n, uint32_t k, uint32_t m)
+        : TransactionGenerator(config_file, output_dir),
+          n_(n), k_(k), m_(m) {
+        CheckPimGeometry();
+    }
+    void Initialize() override;
+    void SetData() override;
+    void Execute() override;
+    void GetResult() override;
+    void AdditionalAccumulation() override {};
+    void CheckResult() override {};
+    void ChangeVector() override {};
+
+    // FP16 bits, row-major. Empty: all ones (timing does not depend on them)
+    std::vector<uint16_t> input_;   // n x K
+    std::vector<uint16_t> weight_;  // K x M
+
+ private:
+    void Pass(int ch, uint32_t node, int round, uint32_t block,
+              std::vector<HostTransaction>& out);
+    Address OutputWord(int ch, int unit, uint32_t node, int round, int g);
+
+    uint32_t n_, k_, m_;
+    int slices_;           // 16-column slices of W
+    int rounds_;           // slices / pim_units, rounded up
+    uint32_t block_;       // k per pass (multiple of 8, JUMP count <= 256)
+    uint32_t blocks_;
+    uint32_t w_rows_;      // DRAM rows of W per round
+    uint32_t out_base_;    // first output row (ODD bank)
+    UKernel kernel_;
+    std::vector<UKernelTrigger> schedule_;
+    uint32_t crf_[32];
+    std::vector<uint16_t> w_image_;    // slice x K words of 16 lanes
+    std::vector<uint16_t> srf_image_;  // 32B per SRF write (SRF_A, SRF_M)
+    std::vector<uint16_t> zero_;       // GRF_B clear
+};
+
+// Replays an assembled μkernel file (ukernel.h) on every channel
+//  SetData programs the CRF, Execute runs one pass per DRAM row with the
+//  host schedule derived by UKernel::Schedule, LOOPs take loop_count trips
+class UKernelTransactionGenerator : public TransactionGenerator {
+ public:
+    UKernelTransactionGenerator(const std::string& config_file,
+                                const std::string& output_dir,
+                                const std::string& ukernel_file,
+                                int rows, int loop_count)
+        : TransactionGenerator(config_file, output_dir),
+          ukernel_file_(ukernel_file), rows_(rows), loop_count_(loop_count) {
+        CheckPimGeometry();
+    }
+    void Initialize() override;
+    void SetData() override;
+    void Execute() override;
+    void GetResult() override;
+    void AdditionalAccumulation() override {};
+    void CheckResult() override {};
+    void ChangeVector() override {};
+
+ private:
+    std::string ukernel_file_;
+    int rows_;
+    int loop_count_;
+    UKernel kernel_;
+    std::vector<UKernelTrigger> schedule_;
+    uint32_t crf_[32];
+};
+
 }  // namespace dramsim3
 
 #endif //__TRANSACTION_GENERATOR_H
@@ -0,0 +1,408 @@
+#include "ukernel.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "common.h"
+#include "pim_utils.h"
+
+namespace dramsim3 {
+
+namespace {
+
+const int kCrfSlots = 32;  // PimUnit::CRF
+
+struct Mnemonic {
+    const char* name;
+    PIM_OPERATION op;
+};
+
+// MUL_DRF: python maps it to MUL (substring match), the DRF source selects
+// the DRF path in PimUnit::Execute
+const Mnemonic kMnemonics[] = {
+    {"NOP", PIM_OPERATION::NOP},   {"JUMP", PIM_OPERATION::JUMP},
+    {"EXIT", PIM_OPERATION::EXIT}, {"MOV", PIM_OPERATION::MOV},
+    {"FILL", PIM_OPERATION::FILL}, {"ADD", PIM_OPERATION::ADD},
+    {"MUL", PIM_OPERATION::MUL},   {"MUL_DRF", PIM_OPERATION::MUL},
+    {"MAC", PIM_OPERATION::MAC},   {"MAD", PIM_OPERATION::MAD},
+    {"SACC", PIM_OPERATION::SACC}, {"LOOP", PIM_OPERATION::LOOP}};
+
+const char* kOperands[] = {"BANK", "GRF_A", "GRF_B", "SRF_A", "SRF_M", "DRF"};
+
+bool ParseInt(const std::string& word, int* value) {
+    if (word.empty())
+        return false;
+    char* end;
+    long v = strtol(word.c_str(), &end, 10);
+    if (*end != '\0')
+        return false;
+    *value = (int)v;
+    return true;
+}
+
+// "GRF_B", "GRF_B[2]" (fixed index), "GRF_B[A2]" (AAM index field)
+bool ParseOperand(const std::string& word, PIM_OPERAND* operand, int* idx,
+                  bool* fix) {
+    std::string name = word;
+    *idx = 0;
+    *fix = false;
+    size_t open = word.find('[');
+    if (open != std::string::npos) {
+        if (word.back() != ']')
+            return false;
+        name = word.substr(0, open);
+        std::string inside = word.substr(open + 1, word.size() - open - 2);
+        *fix = true;
+        if (!inside.empty() && inside[0] == 'A') {
+            *fix = false;
+            inside = inside.substr(1);
+        }
+        if (!ParseInt(inside, idx) || *idx < 0 || *idx > 7)
+            return false;
+    }
+    for (int i = 0; i < (int)(sizeof(kOperands) / sizeof(kOperands[0])); i++) {
+        if (name == kOperands[i]) {
+            *operand = (PIM_OPERAND)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// imm0 : sign bit 18, magnitude bits 17..11 (BitToImm0)
+uint32_t EncodeImm0(int imm0) {
+    uint32_t code = (uint32_t)(imm0 < 0 ? -imm0 : imm0) << 11;
+    if (imm0 < 0)
+        code |= 1u << 18;
+    return code;
+}
+
+}  // namespace
+
+bool UKernel::Encode(const std::string& line, uint32_t* code,
+                     std::string* error) {
+    std::istringstream iss(line);
+    std::vector<std::string> words;
+    std::string word;
+    while (iss >> word)
+        words.push_back(word);
+    if (words.empty()) {
+        *error = "empty instruction";
+        return false;
+    }
+
+    // OP[_RELU][(AAMn)]
+    std::string mnemonic = words[0];
+    bool aam = false;
+    size_t paren = mnemonic.find('(');
+    if (paren != std::string::npos) {
+        std::string mode = mnemonic.substr(paren);
+        mnemonic = mnemonic.substr(0, paren);
+        aam = mode.compare(0, 2, "(A") == 0;
+    }
+    bool relu = false;
+    if (mnemonic.size() > 5 &&
+        mnemonic.compare(mnemonic.size() - 5, 5, "_RELU") == 0) {
+        relu = true;
+        mnemonic = mnemonic.substr(0, mnemonic.size() - 5);
+    }
+    bool found = false;
+    PIM_OPERATION op = PIM_OPERATION::NOP;
+    for (const Mnemonic& m : kMnemonics) {
+        if (mnemonic == m.name) {
+            op = m.op;
+            found = true;
+            break;
+        }
+    }
+    if (!found) {
+        *error = "unknown instruction " + words[0];
+        return false;
+    }
+
+    *code = (uint32_t)op << 28;
+    if (aam)
+        *code |= 1u << 15;
+    if (relu)
+        *code |= 1u << 12;
+
+    int imm;
+    switch (op) {
+        case PIM_OPERATION::EXIT:
+            if (words.size() != 1) {
+                *error = "EXIT takes no operand";
+                return false;
+            }
+            return true;
+        case PIM_OPERATION::NOP:
+            // NOP [imm1], PimUnit reads the count from imm1
+            if (words.size() > 2) {
+                *error = "NOP takes one count";
+                return false;
+            }
+            imm = 0;
+            if (words.size() == 2 &&
+                (!ParseInt(words[1], &imm) || imm < 0 || imm > 255)) {
+                *error = "NOP count must be 0..255";
+                return false;
+            }
+            *code |= (uint32_t)imm;
+            return true;
+        case PIM_OPERATION::JUMP:
+            if (words.size() != 3 || !ParseInt(words[1], &imm) || imm < -127 ||
+                imm > 127) {
+                *error = "JUMP needs imm0 (-127..127) and imm1";
+                return false;
+            }
+            *code |= EncodeImm0(imm);
+            if (!ParseInt(words[2], &imm) || imm < 0 || imm > 255) {
+                *error = "JUMP count must be 0..255";
+                return false;
+            }
+            *code |= (uint32_t)imm;
+            return true;
+        case PIM_OPERATION::LOOP: {
+            if (words.size() != 3 || !ParseInt(words[1], &imm) || imm < -127 ||
+                imm > 127) {
+                *error = "LOOP needs imm0 (-127..127) and GRF_A[idx]";
+                return false;
+            }
+            *code |= EncodeImm0(imm);
+            PIM_OPERAND operand;
+            int idx;
+            bool fix;
+            if (!ParseOperand(words[2], &operand, &idx, &fix) ||
+                operand != PIM_OPERAND::GRF_A) {
+                *error = "LOOP count must come from GRF_A[idx]";
+                return false;
+            }
+            *code |= (uint32_t)operand << 22 | (uint32_t)idx << 4 |
+                     (fix ? 1u << 7 : 0);
+            return true;
+        }
+        default:
+            break;
+    }
+
+    // dst src0 [src1 [SRF_A[bias]]]
+    size_t max_words = (op == PIM_OPERATION::MAD) ? 5 : 4;
+    if (words.size() < 3 || words.size() > max_words) {
+        *error = words[0] + ": wrong number of operands";
+        return false;
+    }
+    const int shift[3] = {25, 22, 19};
+    const int idx_shift[3] = {8, 4, 0};
+    for (size_t k = 1; k < words.size() && k <= 3; k++) {
+        PIM_OPERAND operand;
+        int idx;
+        bool fix;
+        if (!ParseOperand(words[k], &operand, &idx, &fix)) {
+            *error = "bad operand " + words[k];
+            return false;
+        }
+        *code |= (uint32_t)operand << shift[k - 1];
+        *code |= (uint32_t)(idx | (fix ? 8 : 0)) << idx_shift[k - 1];
+    }
+    if (words.size() == 5) {
+        PIM_OPERAND operand;
+        int idx;
+        bool fix;
+        if (!ParseOperand(words[4], &operand, &idx, &fix) ||
+            operand != PIM_OPERAND::SRF_A) {
+            *error = "MAD bias must be SRF_A[idx]";
+            return false;
+        }
+        *code |= (uint32_t)idx << 16;
+    }
+    return true;
+}
+
+bool UKernel::Assemble(const std::string& source) {
+    code_.clear();
+    source_.clear();
+    bank_.clear();
+    col_base_.clear();
+
+    std::istringstream in(source);
+    std::string line;
+    int line_no = 0;
+    int bank = 0;  // EVEN_BANK
+    int col_base = 0;
+    while (std::getline(in, line)) {
+        line_no++;
+        size_t comment = std::min(line.find("//"), line.find('#'));
+        if (comment != std::string::npos)
+            line = line.substr(0, comment);
+        size_t begin = line.find_first_not_of(" \t\r");
+        if (begin == std::string::npos)
+            continue;
+        line = line.substr(begin, line.find_last_not_of(" \t\r") - begin + 1);
+
+        if (line[0] == '.') {
+            std::istringstream iss(line);
+            std::string directive, value;
+            iss >> directive >> value;
+            if (directive == ".bank" && (value == "even" || value == "odd")) {
+                bank = (value == "even") ? 0 : 1;
+            } else if (directive != ".col" || !ParseInt(value, &col_base) ||
+                       col_base < 0) {
+                std::cerr << "ukernel:" << line_no << ": bad directive " << line
+                          << std::endl;
+                return false;
+            }
+            continue;
+        }
+
+        uint32_t code;
+        std::string error;
+        if (!Encode(line, &code, &error)) {
+            std::cerr << "ukernel:" << line_no << ": " << error << std::endl;
+            return false;
+        }
+        // JUMP / LOOP targets are resolved against the CRF slot
+        PIM_OPERATION op = BitToPIM_OP((uint8_t*)&code);
+        if (op == PIM_OPERATION::JUMP || op == PIM_OPERATION::LOOP) {
+            int target = Size() + BitToImm0((uint8_t*)&code);
+            if (target < 0 || target >= Size()) {
+                std::cerr << "ukernel:" << line_no
+                          << ": branch target out of the kernel (" << target
+                          << ")" << std::endl;
+                return false;
+            }
+        }
+        if (Size() == kCrfSlots) {
+            std::cerr << "ukernel:" << line_no << ": more than " << kCrfSlots
+                      << " instructions" << std::endl;
+            return false;
+        }
+        code_.push_back(code);
+        source_.push_back(line);
+        bank_.push_back(bank);
+        col_base_.push_back(col_base);
+    }
+    if (code_.empty() ||
+        BitToPIM_OP((uint8_t*)&code_.back()) != PIM_OPERATION::EXIT) {
+        std::cerr << "ukernel:" << line_no << ": kernel must end with EXIT"
+                  << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool UKernel::AssembleFile(const std::string& path) {
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        std::cerr << "Cannot open ukernel " << path << std::endl;
+        return false;
+    }
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return Assemble(ss.str());
+}
+
+void UKernel::CopyTo(uint32_t* crf, int slots) const {
+    for (int i = 0; i < slots; i++)
+        crf[i] = (i < Size()) ? code_[i] : 0;
+}
+
+std::vector<UKernelTrigger> UKernel::Schedule(std::function<int(int)> loop_count,
+                                              int max_triggers) const {
+    std::vector<UKernelTrigger> triggers;
+    int size = Size();
+    // innermost JUMP / LOOP whose body [target, slot] holds each slot
+    std::vector<int> jump_of(size, -1), loop_of(size, -1);
+    std::vector<int> target(size, 0);
+    for (int s = 0; s < size; s++) {
+        uint8_t* ptr = (uint8_t*)&code_[s];
+        PIM_OPERATION op = BitToPIM_OP(ptr);
+        if (op != PIM_OPERATION::JUMP && op != PIM_OPERATION::LOOP)
+            continue;
+        target[s] = s + BitToImm0(ptr);
+        std::vector<int>& owner =
+            (op == PIM_OPERATION::JUMP) ? jump_of : loop_of;
+        for (int i = target[s]; i < s; i++) {
+            if (owner[i] < 0 || target[owner[i]] < target[s])
+                owner[i] = s;
+        }
+    }
+    std::vector<int> trips(size, 0);
+
+    auto op_at = [&](int ppc) {
+        return (ppc < size) ? BitToPIM_OP((uint8_t*)&code_[ppc])
+                            : PIM_OPERATION::NOP;
+    };
+    int ppc = 0;
+    int lc = 0;
+    while (true) {
+        if ((int)triggers.size() == max_triggers || ppc >= kCrfSlots) {
+            std::cerr << "ukernel: pass does not reach EXIT within "
+                      << max_triggers << " triggers" << std::endl;
+            return std::vector<UKernelTrigger>();
+        }
+        UKernelTrigger t;
+        t.slot = ppc;
+        t.op = op_at(ppc);
+        t.is_write = false;
+        t.bank = 0;
+        t.column = 0;
+        t.loop_iter = 0;
+        if (ppc < size) {
+            uint8_t* ptr = (uint8_t*)&code_[ppc];
+            // PimUnit::AddTransaction writes pmem for MOV to BANK only
+            t.is_write = t.op == PIM_OPERATION::MOV &&
+                         BitToDst(ptr) == PIM_OPERAND::BANK;
+            t.bank = bank_[ppc];
+            t.column = col_base_[ppc] +
+                       (jump_of[ppc] >= 0 ? trips[jump_of[ppc]] : 0);
+            t.loop_iter = loop_of[ppc] >= 0 ? trips[loop_of[ppc]] : 0;
+        }
+        triggers.push_back(t);
+
+        ppc++;
+        PIM_OPERATION op = op_at(ppc);
+        int imm1 = (ppc < size) ? BitToImm1((uint8_t*)&code_[ppc]) : 0;
+        if (op == PIM_OPERATION::NOP) {
+            if (lc == 0) {
+                lc = imm1;
+            } else if (lc > 1) {
+                lc--;
+            } else if (lc == 1) {
+                ppc++;
+                lc = 0;
+            }
+            continue;
+        } else if (op == PIM_OPERATION::JUMP ||
+                   op == PIM_OPERATION::LOOP) {
+            bool taken;
+            if (lc == 0) {
+                if (op == PIM_OPERATION::JUMP)
+                    lc = imm1;
+                else
+                    lc = loop_count ? (loop_count(ppc) & 0xFF) : 0;
+                taken = (op == PIM_OPERATION::JUMP) || lc > 0;
+            } else if (lc > 1) {
+                lc--;
+                taken = true;
+            } else {
+                lc = 0;
+                taken = false;
+            }
+            if (taken) {
+                trips[ppc]++;
+                ppc = target[ppc];
+            } else {
+                trips[ppc] = 0;
+                ppc++;
+            }
+        }
+        if (op_at(ppc) == PIM_OPERATION::EXIT)
+            break;
+    }
+    return triggers;
+}
+
+}  // namespace dramsim3
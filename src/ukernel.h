@@ -0,0 +1,77 @@
+#ifndef __UKERNEL_H
+#define __UKERNEL_H
+
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <vector>
+#include "pim_config.h"
+
+namespace dramsim3 {
+
+// One host transaction of a μkernel pass (see UKernel::Schedule)
+//  slot      : CRF index executed by this trigger
+//  is_write  : the instruction writes the bank (dst == BANK)
+//  bank      : 0 / 1 = EVEN_BANK / ODD_BANK of the trigger (.bank directive)
+//  column    : .col base + trips of the innermost JUMP around the slot,
+//              the AAM column that selects GRF_A/GRF_B[column % 8]
+//  loop_iter : trips of the innermost LOOP around the slot
+struct UKernelTrigger {
+    int slot;
+    PIM_OPERATION op;
+    bool is_write;
+    int bank;
+    int column;
+    int loop_iter;
+};
+
+// μkernel assembler and host schedule builder
+//  Same syntax as UKernelGenerator/ukernel_generator.py, one instruction
+//  per line:
+//    MOV(AAM0) SRF_M BANK          OP[(AAM)][_RELU] dst src0 [src1 [bias]]
+//    MAD_RELU(AAM0) GRF_B GRF_A SRF_M SRF_A[3]
+//    MUL(AAM0) GRF_B[2] BANK SRF_M operand[idx] fixes the register index
+//    JUMP -3 6                     JUMP imm0 imm1, NOP imm1
+//    LOOP -3 GRF_A[2]              trip count from GRF_A[idx] >> 8
+//    EXIT
+//  MUL_DRF is encoded as MUL with a DRF source, like the python script.
+//  Blank lines and "//" / "#" comments are skipped. Directives for Schedule:
+//    .bank even|odd                bank of the following instructions
+//    .col <n>                      base column of the following instructions
+//  Immediates are encoded as pim_utils.cc decodes them. (The python script
+//  ORs the register fix bit into JUMP/LOOP immediates as well)
+class UKernel {
+ public:
+    UKernel() {}
+    // Returns false and prints "ukernel:<line>: <reason>" on the first error
+    bool Assemble(const std::string& source);
+    bool AssembleFile(const std::string& path);
+    static bool Encode(const std::string& line, uint32_t* code,
+                       std::string* error);
+
+    int Size() const { return (int)code_.size(); }
+    const std::vector<uint32_t>& Code() const { return code_; }
+    const std::string& Source(int slot) const { return source_[slot]; }
+    // CRF image of `slots` words (rest NOP), CrfWrites: 32B writes to program it
+    void CopyTo(uint32_t* crf, int slots) const;
+    int CrfWrites() const { return (Size() + 7) / 8; }
+
+    // Host transactions of one pass (PPC 0 .. EXIT), replaying the control
+    // flow of PimUnit::AddTransaction (one LC shared by NOP / JUMP / LOOP).
+    // loop_count(slot) is the LC a LOOP loads from GRF_A when it is entered,
+    // data dependent, 0 if not given (body runs once more per count).
+    // Returns an empty schedule if the pass does not end in max_triggers
+    std::vector<UKernelTrigger> Schedule(
+        std::function<int(int)> loop_count = nullptr,
+        int max_triggers = 1 << 20) const;
+
+ private:
+    std::vector<uint32_t> code_;
+    std::vector<std::string> source_;
+    std::vector<int> bank_;
+    std::vector<int> col_base_;
+};
+
+}  // namespace dramsim3
+
+#endif  // __UKERNEL_H
@@ -0,0 +1,72 @@
+#include <vector>
+#include "catch.hpp"
+#include "cpu_cache.h"
+
+// one set, so every line competes for the same ways
+static dramsim3::CacheLevelConfig OneSet(int ways, int latency) {
+    dramsim3::CacheLevelConfig config = {(uint64_t)64 * ways, ways, latency};
+    return config;
+}
+
+TEST_CASE("SetAssocCache evicts the least recently used way", "[cache]") {
+    dramsim3::SetAssocCache cache(OneSet(2, 4), 64);
+    uint64_t victim = 0;
+    REQUIRE_FALSE(cache.Fill(1, false, false, &victim));
+    REQUIRE_FALSE(cache.Fill(2, true, false, &victim));
+    REQUIRE(cache.Access(1, false, nullptr));  // 2 becomes LRU
+
+    // dirty victim is reported
+    REQUIRE(cache.Fill(3, false, false, &victim));
+    REQUIRE(victim == 2);
+    REQUIRE(cache.Contains(1));
+    REQUIRE_FALSE(cache.Contains(2));
+    REQUIRE(cache.evictions_ == 1);
+
+    // clean victim is not
+    REQUIRE_FALSE(cache.Fill(4, false, false, &victim));
+    REQUIRE_FALSE(cache.Contains(1));
+    REQUIRE(cache.hits_ == 1);
+}
+
+TEST_CASE("SetAssocCache reports the first demand hit of a prefetch", "[cache]") {
+    dramsim3::SetAssocCache cache(OneSet(2, 4), 64);
+    uint64_t victim = 0;
+    cache.Fill(5, false, true, &victim);
+    bool prefetched = false;
+    REQUIRE(cache.Access(5, false, &prefetched));
+    REQUIRE(prefetched);
+    prefetched = false;
+    REQUIRE(cache.Access(5, false, &prefetched));
+    REQUIRE_FALSE(prefetched);
+}
+
+TEST_CASE("CacheHierarchy writes back dirty LLC victims of upper fills", "[cache]") {
+    std::vector<dramsim3::CacheLevelConfig> levels = {OneSet(1, 4), OneSet(2, 14)};
+    dramsim3::CacheHierarchy cache(levels, 64);
+    std::vector<uint64_t> writebacks;
+
+    cache.Fill(1, true, false, &writebacks);   // L1 {1*}  LLC {1}
+    cache.Fill(2, true, false, &writebacks);   // L1 {2*}  LLC {1*, 2}
+    cache.Fill(3, false, true, &writebacks);   // prefetch: LLC {1*, 3}
+    REQUIRE(writebacks.empty());
+
+    // LLC hit: filling L1 pushes 2* down, the LLC evicts 1*
+    REQUIRE(cache.Access(3, false, nullptr, &writebacks) == 1);
+    REQUIRE(writebacks == std::vector<uint64_t>{1});
+    REQUIRE(cache.Level(0).Contains(3));
+    REQUIRE(cache.Level(1).Contains(2));
+    REQUIRE_FALSE(cache.Contains(1));
+
+    // clean victims leave silently
+    writebacks.clear();
+    REQUIRE(cache.Access(2, true, nullptr, &writebacks) == 1);  // L1 {2*}  LLC {2*, 3}
+    cache.Fill(4, false, false, &writebacks);  // L1 {4}  LLC {2*, 4}
+    REQUIRE(writebacks.empty());
+
+    // Flush: every dirty line once
+    cache.Flush(&writebacks);
+    REQUIRE(writebacks == std::vector<uint64_t>{2});
+    writebacks.clear();
+    cache.Flush(&writebacks);
+    REQUIRE(writebacks.empty());
+}
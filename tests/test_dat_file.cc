@@ -0,0 +1,166 @@
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "catch.hpp"
+#include "dat_file.h"
+
+namespace {
+
+struct Record {
+    uint32_t id;
+    uint16_t value[6];
+};
+
+std::vector<std::vector<Record>> MakeParts() {
+    std::vector<std::vector<Record>> parts(4);
+    uint32_t id = 1;
+    for (size_t p = 0; p < parts.size(); p++) {
+        // partition 2 stays empty
+        for (size_t k = 0; p != 2 && k < 3 * p + 1; k++) {
+            Record r;
+            r.id = id++;
+            for (int v = 0; v < 6; v++)
+                r.value[v] = (uint16_t)(r.id * 7 + v);
+            parts[p].push_back(r);
+        }
+    }
+    return parts;
+}
+
+bool SameRecord(const Record& a, const Record& b) {
+    if (a.id != b.id)
+        return false;
+    for (int v = 0; v < 6; v++) {
+        if (a.value[v] != b.value[v])
+            return false;
+    }
+    return true;
+}
+
+// v1 layout: n_part, then count + records per partition
+void WriteV1(const std::string& path, const std::vector<std::vector<Record>>& parts) {
+    FILE* f = fopen(path.c_str(), "wb");
+    REQUIRE(f != nullptr);
+    uint32_t n_part = parts.size();
+    fwrite(&n_part, sizeof(n_part), 1, f);
+    for (const auto& part : parts) {
+        uint32_t count = part.size();
+        fwrite(&count, sizeof(count), 1, f);
+        fwrite(part.data(), sizeof(Record), count, f);
+    }
+    fclose(f);
+}
+
+long FileSize(const std::string& path) {
+    FILE* f = fopen(path.c_str(), "rb");
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fclose(f);
+    return size;
+}
+
+std::string TempPath() {
+    char path[] = "/tmp/dat_testXXXXXX";
+    int fd = mkstemp(path);
+    REQUIRE(fd >= 0);
+    close(fd);
+    return path;
+}
+
+}  // namespace
+
+TEST_CASE("DAT v2 round-trips through save and load", "[dat]") {
+    std::string path = TempPath();
+    std::vector<std::vector<Record>> parts = MakeParts();
+    REQUIRE(saveDatFile(parts, path));
+
+    DatImage image;
+    REQUIRE(openDatFile(path, sizeof(Record), &image));
+    REQUIRE(image.offsets == std::vector<uint64_t>({0, 1, 5, 5, 15}));
+    // records start DAT_ALIGN aligned in the mapping
+    REQUIRE(FileSize(path) == DAT_ALIGN + 15 * (long)sizeof(Record));
+    // another record type is refused
+    DatImage wrong;
+    REQUIRE_FALSE(openDatFile(path, sizeof(Record) + 2, &wrong));
+
+    std::vector<std::vector<Record>> copy = loadDatFile<Record>(path);
+    DatPartitions<Record> mapped = DatPartitions<Record>::Load(path);
+    REQUIRE(copy.size() == parts.size());
+    REQUIRE(mapped.size() == parts.size());
+    for (size_t p = 0; p < parts.size(); p++) {
+        REQUIRE(copy[p].size() == parts[p].size());
+        REQUIRE(mapped[p].size() == parts[p].size());
+        for (size_t k = 0; k < parts[p].size(); k++) {
+            REQUIRE(SameRecord(copy[p][k], parts[p][k]));
+            REQUIRE(SameRecord(mapped[p][k], parts[p][k]));
+        }
+    }
+
+    // the spans keep the mapping alive after the file is gone
+    remove(path.c_str());
+    DatPartitions<Record> kept = mapped;
+    mapped = DatPartitions<Record>();
+    REQUIRE(SameRecord(kept[3][9], parts[3][9]));
+}
+
+TEST_CASE("DAT v1 files load like v2", "[dat]") {
+    std::string path = TempPath();
+    std::vector<std::vector<Record>> parts = MakeParts();
+    WriteV1(path, parts);
+
+    std::vector<std::vector<Record>> copy = loadDatFile<Record>(path);
+    DatPartitions<Record> mapped = DatPartitions<Record>::Load(path);
+    REQUIRE(copy.size() == parts.size());
+    REQUIRE(mapped.size() == parts.size());
+    for (size_t p = 0; p < parts.size(); p++) {
+        REQUIRE(copy[p].size() == parts[p].size());
+        REQUIRE(mapped[p].size() == parts[p].size());
+        for (size_t k = 0; k < parts[p].size(); k++) {
+            REQUIRE(SameRecord(copy[p][k], parts[p][k]));
+            REQUIRE(SameRecord(mapped[p][k], parts[p][k]));
+        }
+    }
+
+    // saving a v1 image writes v2 with the same partitions
+    REQUIRE(saveDatFile(copy, path));
+    DatImage image;
+    REQUIRE(openDatFile(path, sizeof(Record), &image));
+    REQUIRE(image.offsets == std::vector<uint64_t>({0, 1, 5, 5, 15}));
+    remove(path.c_str());
+}
+
+TEST_CASE("DAT truncated files are rejected", "[dat]") {
+    std::string path = TempPath();
+    std::vector<std::vector<Record>> parts = MakeParts();
+    DatImage image;
+
+    SECTION("v2 records cut short") {
+        REQUIRE(saveDatFile(parts, path));
+        REQUIRE(truncate(path.c_str(), FileSize(path) - 1) == 0);
+        REQUIRE_FALSE(openDatFile(path, sizeof(Record), &image));
+    }
+    SECTION("v2 offset table cut short") {
+        REQUIRE(saveDatFile(parts, path));
+        REQUIRE(truncate(path.c_str(), sizeof(DatHeader) + 8) == 0);
+        REQUIRE_FALSE(openDatFile(path, sizeof(Record), &image));
+    }
+    SECTION("v1 records cut short") {
+        WriteV1(path, parts);
+        REQUIRE(truncate(path.c_str(), FileSize(path) - 1) == 0);
+        REQUIRE_FALSE(openDatFile(path, sizeof(Record), &image));
+    }
+    SECTION("v1 count past the end") {
+        WriteV1(path, parts);
+        REQUIRE(truncate(path.c_str(), 6) == 0);
+        REQUIRE_FALSE(openDatFile(path, sizeof(Record), &image));
+    }
+    SECTION("empty file") {
+        REQUIRE(truncate(path.c_str(), 0) == 0);
+        REQUIRE_FALSE(openDatFile(path, sizeof(Record), &image));
+    }
+    REQUIRE(loadDatFile<Record>(path).empty());
+    REQUIRE(DatPartitions<Record>::Load(path).empty());
+    remove(path.c_str());
+}
@@ -1,21 +1,27 @@
 #include "catch.hpp"
 #include "configuration.h"
 #include "dram_system.h"
+#include <vector>
 
 bool call_back_called = false;
 void dummy_call_back(uint64_t addr) {
     call_back_called = true;
     return;
 }
+void dummy_read_call_back(uint64_t addr, uint8_t* data) { dummy_call_back(addr); }
 
 TEST_CASE("Jedec DRAMSystem Testing", "[dramsim3]") {
     dramsim3::Config config("configs/HBM1_4Gb_x128.ini", ".");
 
-    dramsim3::JedecDRAMSystem dramsys(config, ".", dummy_call_back,
+    dramsim3::JedecDRAMSystem dramsys(config, ".", dummy_read_call_back,
                                       dummy_call_back);
+    // PimFuncSim sets up its per-channel state in init
+    std::vector<uint8_t> pmem(1 << 20);
+    dramsys.init(pmem.data(), pmem.size(), 32);
 
     SECTION("TEST interaction with controller") {
-        dramsys.AddTransaction(1, false);
+        uint8_t data[32];
+        dramsys.AddTransaction(1, false, data);
         int clk = 0;
         while (true) {
             dramsys.ClockTick();
@@ -0,0 +1,220 @@
+#include <map>
+#include <random>
+#include <vector>
+#include "catch.hpp"
+#include "global_acc.h"
+#include "pim_func_sim.h"
+
+namespace {
+
+dramsim3::Pair P(uint32_t index, unit_t data) {
+    dramsim3::Pair p;
+    p.index = index;
+    p.data = data;
+    p.eos = false;
+    return p;
+}
+
+dramsim3::Pair Eos() {
+    dramsim3::Pair p = P(0, 0);
+    p.eos = true;
+    return p;
+}
+
+// Ticks until the tree is empty, returns the cycles taken
+int Drain(dramsim3::GlobalAccumulator& gacc, int limit) {
+    int cycles = 0;
+    while (!gacc.IsAllQueueEmpty() && cycles < limit) {
+        gacc.ClockTick();
+        cycles++;
+    }
+    return cycles;
+}
+
+}  // namespace
+
+TEST_CASE("GACC merges two streams one level per cycle", "[gacc]") {
+    dramsim3::Config config("configs/HBM2_4Gb_test.ini", ".");
+    dramsim3::GlobalAccumulator gacc(config, 0, 2, 0);
+    gacc.AddDataToPairQueue1(0, P(1, 10));
+    gacc.AddDataToPairQueue1(0, P(3, 30));
+    gacc.AddDataToPairQueue1(0, Eos());
+    gacc.AddDataToPairQueue1(1, P(1, 5));
+    gacc.AddDataToPairQueue1(1, P(2, 7));
+    gacc.AddDataToPairQueue1(1, Eos());
+
+    // node: 1+1, 2, 3, eos; the root emits each one cycle later
+    REQUIRE(Drain(gacc, 100) == 5);
+    REQUIRE(gacc.last_done_clk == 5);
+    REQUIRE(gacc.num_reductions == 1);
+    REQUIRE(gacc.merge_adds == 1);
+    REQUIRE(gacc.result.size() == 3);
+    REQUIRE(gacc.result[0].index == 1);
+    REQUIRE(gacc.result[0].data == 15);
+    REQUIRE(gacc.result[1].index == 2);
+    REQUIRE(gacc.result[1].data == 7);
+    REQUIRE(gacc.result[2].index == 3);
+    REQUIRE(gacc.result[2].data == 30);
+}
+
+TEST_CASE("GACC waits for the other side until it has data or eos", "[gacc]") {
+    dramsim3::Config config("configs/HBM2_4Gb_test.ini", ".");
+    dramsim3::GlobalAccumulator gacc(config, 0, 2, 0);
+    gacc.AddDataToPairQueue1(0, P(5, 1));
+    for (int c = 0; c < 4; c++)
+        gacc.ClockTick();
+    // a smaller index may still come on the right
+    REQUIRE(gacc.result.empty());
+    REQUIRE(gacc.num_moves == 0);
+
+    gacc.AddDataToPairQueue1(1, P(2, 4));
+    gacc.AddDataToPairQueue1(1, Eos());
+    gacc.AddDataToPairQueue1(0, Eos());
+    Drain(gacc, 100);
+    REQUIRE(gacc.result.size() == 2);
+    REQUIRE(gacc.result[0].index == 2);
+    REQUIRE(gacc.result[1].index == 5);
+    REQUIRE(gacc.num_reductions == 1);
+}
+
+TEST_CASE("GACC queue_depth holds a node back", "[gacc]") {
+    dramsim3::Config config("configs/HBM2_4Gb_test.ini", ".");
+    config.gacc_width = 2;
+
+    SECTION("deep queues") {
+        dramsim3::GlobalAccumulator gacc(config, 0, 2, 0);
+        for (uint32_t i = 1; i <= 3; i++)
+            gacc.AddDataToPairQueue1(0, P(i, 1));
+        gacc.AddDataToPairQueue1(0, Eos());
+        gacc.AddDataToPairQueue1(1, Eos());
+        // two elements per cycle through the node and the root
+        REQUIRE(Drain(gacc, 100) == 3);
+        REQUIRE(gacc.node_stall_cycles == 0);
+    }
+    SECTION("one slot per queue") {
+        config.gacc_queue_depth = 1;
+        dramsim3::GlobalAccumulator gacc(config, 0, 2, 0);
+        for (uint32_t i = 1; i <= 3; i++)
+            gacc.AddDataToPairQueue1(0, P(i, 1));
+        gacc.AddDataToPairQueue1(0, Eos());
+        gacc.AddDataToPairQueue1(1, Eos());
+        // the node's second move of the cycle finds the root queue full
+        REQUIRE(Drain(gacc, 100) == 5);
+        REQUIRE(gacc.node_stall_cycles == 3);
+        REQUIRE(gacc.result.size() == 3);
+    }
+}
+
+TEST_CASE("GACC tree sums the partials of every channel", "[gacc]") {
+    dramsim3::Config config("configs/HBM2_4Gb_test.ini", ".");
+    const int inputs = 5;  // odd levels have a pass-through node
+    dramsim3::GlobalAccumulator gacc(config, 0, inputs, 0);
+    REQUIRE(gacc.pair_queue_.size() == 4);  // 5 -> 3 -> 2 -> 1
+
+    std::mt19937 rng(3);
+    std::map<uint32_t, int> expect;
+    for (int q = 0; q < inputs; q++) {
+        uint32_t index = 0;
+        for (int k = 0; k < 20; k++) {
+            index += 1 + rng() % 4;
+            unit_t data = 1 + rng() % 50;
+            expect[index] += data;
+            gacc.AddDataToPairQueue1(q, P(index, data));
+        }
+        gacc.AddDataToPairQueue1(q, Eos());
+    }
+
+    int cycles = Drain(gacc, 10000);
+    REQUIRE(gacc.IsAllQueueEmpty());
+    REQUIRE(gacc.num_reductions == 1);
+    REQUIRE(gacc.result.size() == expect.size());
+    size_t k = 0;
+    for (const auto& e : expect) {
+        REQUIRE(gacc.result[k].index == e.first);
+        REQUIRE(gacc.result[k].data == e.second);
+        k++;
+    }
+    // one result per cycle at width 1, plus the pipeline fill and the eos
+    REQUIRE(cycles >= (int)expect.size() + 4);
+    REQUIRE(gacc.last_done_clk == (uint64_t)cycles);
+}
+
+TEST_CASE("GACC block mapping gives every accumulator a channel run", "[gacc]") {
+    dramsim3::Config config("configs/HBM2_4Gb_test.ini", ".");
+    config.gacc_count = 3;
+
+    SECTION("block") {
+        dramsim3::PimFuncSim sim(config);
+        // 16 channels over 3: 6 + 5 + 5, contiguous
+        const int acc[16] = {0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2};
+        const int leaf[16] = {0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 0, 1, 2, 3, 4};
+        for (int ch = 0; ch < 16; ch++) {
+            REQUIRE(sim.gacc_of_channel_[ch] == acc[ch]);
+            REQUIRE(sim.gacc_leaf_of_channel_[ch] == leaf[ch]);
+        }
+        REQUIRE(sim.global_acc_.size() == 4);  // + combiner
+        REQUIRE(sim.global_acc_[0]->pair_queue_[0].size() == 6);
+        REQUIRE(sim.global_acc_[2]->pair_queue_[0].size() == 5);
+        REQUIRE(sim.global_acc_[3]->level == 1);
+        REQUIRE(sim.global_acc_[3]->pair_queue_[0].size() == 3);
+    }
+    SECTION("interleave") {
+        config.gacc_mapping = "interleave";
+        dramsim3::PimFuncSim sim(config);
+        for (int ch = 0; ch < 16; ch++) {
+            REQUIRE(sim.gacc_of_channel_[ch] == ch % 3);
+            REQUIRE(sim.gacc_leaf_of_channel_[ch] == ch / 3);
+        }
+    }
+    SECTION("flat") {
+        config.gacc_hierarchical = false;
+        dramsim3::PimFuncSim sim(config);
+        REQUIRE(sim.global_acc_.size() == 3);
+    }
+    SECTION("every count up to the channel count") {
+        for (int count = 1; count <= 16; count++) {
+            config.gacc_count = count;
+            dramsim3::PimFuncSim sim(config);
+            for (int i = 0; i < count; i++)
+                REQUIRE(sim.global_acc_[i]->pair_queue_[0].size() >= 16 / count);
+            for (int ch = 1; ch < 16; ch++)
+                REQUIRE(sim.gacc_of_channel_[ch] >= sim.gacc_of_channel_[ch - 1]);
+        }
+    }
+}
+
+TEST_CASE("GACC combiner adds the outputs of the first level", "[gacc]") {
+    dramsim3::Config config("configs/HBM2_4Gb_test.ini", ".");
+    config.gacc_queue_depth = 2;
+    dramsim3::GlobalAccumulator a(config, 0, 2, 0), b(config, 1, 2, 0);
+    dramsim3::GlobalAccumulator top(config, 2, 2, 1);
+    a.SetParent(&top, 0);
+    b.SetParent(&top, 1);
+
+    // index i appears once in every channel
+    std::vector<dramsim3::GlobalAccumulator*> first = {&a, &b};
+    for (auto g : first) {
+        for (int q = 0; q < 2; q++) {
+            for (uint32_t i = 1; i <= 8; i++)
+                g->AddDataToPairQueue1(q, P(i, (unit_t)i));
+            g->AddDataToPairQueue1(q, Eos());
+        }
+    }
+    int cycles = 0;
+    while ((!a.IsAllQueueEmpty() || !b.IsAllQueueEmpty() ||
+            !top.IsAllQueueEmpty()) && cycles < 1000) {
+        a.ClockTick();
+        b.ClockTick();
+        top.ClockTick();
+        cycles++;
+    }
+    REQUIRE(a.result.empty());
+    REQUIRE(top.result.size() == 8);
+    for (uint32_t i = 1; i <= 8; i++) {
+        REQUIRE(top.result[i - 1].index == i);
+        REQUIRE(top.result[i - 1].data == 4 * i);
+    }
+    REQUIRE(top.num_reductions == 1);
+    REQUIRE(a.num_reductions == 1);
+    REQUIRE(b.num_reductions == 1);
+}
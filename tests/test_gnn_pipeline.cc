@@ -0,0 +1,93 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "catch.hpp"
+#include "dat_file.h"
+#include "gnn_pipeline.h"
+
+namespace {
+
+const char* kConfig = "configs/HBM2_4Gb_test.ini";
+
+// 64 BG partitions of `rows` sparse rows with 4 row descriptors
+sparse_row_partitions SparseRows(int rows) {
+    std::vector<std::vector<sparse_row_format>> parts(64);
+    for (auto& part : parts) {
+        for (int r = 0; r < rows; r++) {
+            sparse_row_format f;
+            memset(&f, 0, sizeof(f));
+            f.n_rd = 4;
+            for (int k = 0; k < MAX_BLOCK_PER_ROW; k++)
+                f.row_count[k] = 1 + k % 2;
+            part.push_back(f);
+        }
+    }
+    char path[] = "/tmp/gnn_testXXXXXX";
+    int fd = mkstemp(path);
+    REQUIRE(fd >= 0);
+    close(fd);
+    REQUIRE(saveDatFile(parts, path));
+    sparse_row_partitions mapped = sparse_row_partitions::Load(path);
+    remove(path);  // the spans keep the mapping
+    return mapped;
+}
+
+}  // namespace
+
+TEST_CASE("ParseGnnDims takes two or more positive widths", "[gnn]") {
+    std::vector<uint32_t> dims;
+    REQUIRE(dramsim3::ParseGnnDims("1433,16,7", &dims));
+    REQUIRE(dims == std::vector<uint32_t>({1433, 16, 7}));
+    REQUIRE_FALSE(dramsim3::ParseGnnDims("16", &dims));
+    REQUIRE_FALSE(dramsim3::ParseGnnDims("16,,7", &dims));
+    REQUIRE_FALSE(dramsim3::ParseGnnDims("16,0", &dims));
+    REQUIRE_FALSE(dramsim3::ParseGnnDims("16,x", &dims));
+}
+
+TEST_CASE("GNN layers aggregate at the smaller width", "[gnn]") {
+    sparse_row_partitions rows = SparseRows(4);
+    char dir[] = "/tmp/gnn_pipelineXXXXXX";
+    REQUIRE(mkdtemp(dir) != nullptr);
+    const uint32_t nodes = 1024;
+    dramsim3::GnnPipeline gnn(kConfig, dir, rows, rows, nodes, {32, 8, 16});
+
+    // layer 0 narrows: A (H W), layer 1 widens: (A H) W
+    const std::vector<dramsim3::GnnPipeline::Stage>& stages = gnn.Stages();
+    REQUIRE(stages.size() == 4);
+    const char* names[4] = {"combine", "aggregate", "aggregate", "combine"};
+    const int layers[4] = {0, 0, 1, 1};
+    const uint32_t in[4] = {32, 8, 8, 8}, out[4] = {8, 8, 8, 16};
+    for (int s = 0; s < 4; s++) {
+        REQUIRE(stages[s].name == names[s]);
+        REQUIRE(stages[s].layer == layers[s]);
+        REQUIRE(stages[s].in == in[s]);
+        REQUIRE(stages[s].out == out[s]);
+    }
+
+    gnn.pim_combination_ = false;
+    gnn.pipeline_ = true;
+    gnn.Run();
+    uint64_t pim = 0, host = 0;
+    for (const dramsim3::GnnPipeline::Stage& s : stages) {
+        REQUIRE(s.cycles > 0);
+        if (s.name == "aggregate") {
+            REQUIRE(s.on_pim);
+            pim += s.cycles;
+            continue;
+        }
+        // host model: max(flops, bytes) at 64 per cycle
+        REQUIRE_FALSE(s.on_pim);
+        double flops = 2.0 * nodes * s.in * s.out;
+        double bytes = 2.0 * ((double)nodes * s.in + s.in * s.out +
+                              (double)nodes * s.out);
+        REQUIRE(s.cycles == (uint64_t)(std::max(flops, bytes) / 64.0));
+        host += s.cycles;
+    }
+    REQUIRE(gnn.Latency() == pim + host);
+    // the stages of the next inference overlap on the other resource
+    REQUIRE(gnn.Interval() == std::max(pim, host));
+    REQUIRE(gnn.Interval() < gnn.Latency());
+}
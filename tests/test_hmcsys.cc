@@ -1,6 +1,7 @@
 #include "catch.hpp"
 #include "configuration.h"
 #include "memory_system.h"
+#include <vector>
 
 bool hmc_called = false;
 
@@ -8,16 +9,20 @@ void hmc_callback(uint64_t addr) {
     hmc_called = true;
     return;
 }
+void hmc_read_callback(uint64_t addr, uint8_t* data) { hmc_callback(addr); }
 
 TEST_CASE("HMC System Testing", "[dramsim3][hmc]") {
     // but THIS doesn't work?
     // dramsim3::Config config("configs/HMC_2GB_4Lx16.ini", ".");
     // dramsim3::HMCMemorySystem hmc(config, ".", hmc_callback, hmc_callback);
-    dramsim3::MemorySystem hmc("configs/HMC_2GB_4Lx16.ini", ".", hmc_callback, hmc_callback);
+    dramsim3::MemorySystem hmc("configs/HMC_2GB_4Lx16.ini", ".", hmc_read_callback, hmc_callback);
+    std::vector<uint8_t> pmem(1 << 20);
+    hmc.init(pmem.data(), pmem.size(), 32);
 
     SECTION("TEST HMC interaction with controller") {
         REQUIRE(hmc.GetBurstLength() == 16);
-        hmc.AddTransaction(1, false);
+        uint8_t data[32];
+        hmc.AddTransaction(1, false, data);
         int clk = 0;
         while (true) {
             hmc.ClockTick();
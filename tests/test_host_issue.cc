@@ -0,0 +1,95 @@
+#include <vector>
+#include "catch.hpp"
+#include "transaction_generator.h"
+
+namespace {
+
+// Bare generator for the host submission API, counts the finished reads
+class HostProbe : public dramsim3::TransactionGenerator {
+ public:
+    HostProbe()
+        : dramsim3::TransactionGenerator("configs/HBM2_4Gb_test.ini", "."), reads(0) {}
+    void Initialize() override {}
+    void SetData() override {}
+    void Execute() override {}
+    void GetResult() override {}
+    void CheckResult() override {}
+    void AdditionalAccumulation() override {}
+    void ChangeVector() override {}
+    void ReadCallBack(uint64_t addr, uint8_t *DataPtr) override { reads++; }
+
+    // Barrier, then ticks until the last read has returned
+    void Finish() {
+        Barrier();
+        for (int c = 0; c < 1000; c++) {
+            memory_system_.ClockTick();
+            clk_++;
+        }
+    }
+
+    // n distinct reads of channel ch
+    std::vector<dramsim3::HostTransaction> Reads(int ch, int n) {
+        std::vector<dramsim3::HostTransaction> txs;
+        for (int k = 0; k < n; k++) {
+            dramsim3::Address addr(ch, 0, 0, 0, k / 32, k % 32);
+            dramsim3::HostTransaction t = {ReverseAddressMapping(addr), false, nullptr};
+            txs.push_back(t);
+        }
+        return txs;
+    }
+    int reads;
+};
+
+}  // namespace
+
+TEST_CASE("AddTransactions fills every channel in the same cycle", "[host_issue]") {
+    HostProbe probe;
+    std::vector<dramsim3::HostTransaction> txs;
+    for (int ch = 0; ch < 16; ch++) {
+        std::vector<dramsim3::HostTransaction> one = probe.Reads(ch, 1);
+        txs.push_back(one[0]);
+    }
+
+    SECTION("batched") {
+        probe.AddTransactions(txs);
+        // one issue cycle, one more to see every channel done
+        REQUIRE(probe.GetClk() == 2);
+    }
+    SECTION("one by one") {
+        probe.interleave_channels_ = false;
+        probe.AddTransactions(txs);
+        REQUIRE(probe.GetClk() == 16);
+    }
+    probe.Finish();
+    REQUIRE(probe.reads == 16);
+}
+
+TEST_CASE("issue_width_ sets the requests per channel and cycle", "[host_issue]") {
+    HostProbe probe;
+    std::vector<dramsim3::HostTransaction> txs = probe.Reads(0, 8);
+
+    SECTION("width 1") {
+        probe.AddTransactions(txs);
+        REQUIRE(probe.GetClk() == 8 + 1);
+    }
+    SECTION("width 4") {
+        probe.issue_width_ = 4;
+        probe.AddTransactions(txs);
+        REQUIRE(probe.GetClk() == 2 + 1);
+    }
+    probe.Finish();
+    REQUIRE(probe.reads == 8);
+}
+
+TEST_CASE("AddTransactions waits for room in a full queue", "[host_issue]") {
+    HostProbe probe;
+    probe.issue_width_ = 1000;
+    // three times the read queue (trans_queue_size = 64) of channel 0
+    std::vector<dramsim3::HostTransaction> txs = probe.Reads(0, 3 * 64);
+    probe.AddTransactions(txs);
+    // the first cycle takes one queue's worth, the rest waits for reads to
+    // leave the queue (at most one command per cycle) instead of being dropped
+    REQUIRE(probe.GetClk() >= 2 * 64);
+    probe.Finish();
+    REQUIRE(probe.reads == 3 * 64);
+}
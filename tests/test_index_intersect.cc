@@ -0,0 +1,108 @@
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "catch.hpp"
+#include "index_intersect.h"
+#include "shared_acc.h"
+
+// Strictly increasing, non-zero (0 marks an empty SACC slot)
+static std::vector<uint32_t> RandomSorted(std::mt19937& rng, int n,
+                                          uint32_t range) {
+    std::vector<uint32_t> v;
+    std::uniform_int_distribution<uint32_t> dist(1, range);
+    while ((int)v.size() < n) {
+        v.push_back(dist(rng));
+        std::sort(v.begin(), v.end());
+        v.erase(std::unique(v.begin(), v.end()), v.end());
+    }
+    return v;
+}
+
+TEST_CASE("IntersectSorted matches a scalar merge", "[sacc]") {
+    std::mt19937 rng(7);
+    for (int trial = 0; trial < 2000; trial++) {
+        int na = rng() % 41;
+        int nb = rng() % 41;
+        uint32_t range = 4 + rng() % 96;
+        if ((uint32_t)na > range) na = range;
+        if ((uint32_t)nb > range) nb = range;
+        auto a = RandomSorted(rng, na, range);
+        auto b = RandomSorted(rng, nb, range);
+
+        std::vector<int> ref_a, ref_b;
+        int i = 0, j = 0;
+        while (i < na && j < nb) {
+            if (a[i] == b[j]) {
+                ref_a.push_back(i++);
+                ref_b.push_back(j++);
+            } else if (a[i] < b[j]) {
+                i++;
+            } else {
+                j++;
+            }
+        }
+
+        std::vector<int> a_pos(std::max(na, 1)), b_pos(std::max(nb, 1));
+        int n = dramsim3::IntersectSorted(a.data(), na, b.data(), nb,
+                                          a_pos.data(), b_pos.data());
+        REQUIRE(n == (int)ref_a.size());
+        for (int k = 0; k < n; k++) {
+            REQUIRE(a_pos[k] == ref_a[k]);
+            REQUIRE(b_pos[k] == ref_b[k]);
+        }
+    }
+}
+
+TEST_CASE("SACC MergeSorted equals step-by-step merge", "[sacc]") {
+    dramsim3::Config config("configs/HBM2_4Gb_test.ini", ".");
+    dramsim3::PimUnit l_fast(config, 0), r_fast(config, 1);
+    dramsim3::PimUnit l_step(config, 0), r_step(config, 1);
+    dramsim3::SharedAccumulator fast(config, 0, l_fast, r_fast);
+    dramsim3::SharedAccumulator step(config, 0, l_step, r_step);
+    const int grf_words = GRF_SIZE / (int)sizeof(unit_t);
+
+    std::mt19937 rng(11);
+    for (int trial = 0; trial < 500; trial++) {
+        for (int k = 0; k < grf_words; k++) {
+            unit_t l = rng() & 0x3ff, r = rng() & 0x3ff;
+            l_fast.GRF_A_[k] = l_step.GRF_A_[k] = l;
+            r_fast.GRF_A_[k] = r_step.GRF_A_[k] = r;
+        }
+        int nl = 1 + rng() % MAX_QUEUE_SIZE;
+        int nr = 1 + rng() % MAX_QUEUE_SIZE;
+        auto lv = RandomSorted(rng, nl, 40);
+        auto rv = RandomSorted(rng, nr, 40);
+        fast.FlushQueue();
+        step.FlushQueue();
+        for (int k = 0; k < nl; k++) {
+            int ord = rng() % grf_words;
+            fast.L_IQ.push(dramsim3::Element(ord, lv[k]));
+            step.L_IQ.push(dramsim3::Element(ord, lv[k]));
+        }
+        for (int k = 0; k < nr; k++) {
+            int ord = rng() % grf_words;
+            fast.R_IQ.push(dramsim3::Element(ord, rv[k]));
+            step.R_IQ.push(dramsim3::Element(ord, rv[k]));
+        }
+        fast.merge_steps = step.merge_steps = 0;
+        fast.L_Q_pop_cnt = fast.R_Q_pop_cnt = 0;
+        step.L_Q_pop_cnt = step.R_Q_pop_cnt = 0;
+
+        REQUIRE(fast.MergeSorted());
+        // runSimulation's fallback loop
+        while (!step.L_IQ.empty() && !step.R_IQ.empty()) {
+            step.simulateStep();
+            step.merge_steps++;
+        }
+
+        REQUIRE(fast.L_IQ.size() == step.L_IQ.size());
+        REQUIRE(fast.R_IQ.size() == step.R_IQ.size());
+        REQUIRE(fast.L_Q_pop_cnt == step.L_Q_pop_cnt);
+        REQUIRE(fast.R_Q_pop_cnt == step.R_Q_pop_cnt);
+        REQUIRE(fast.merge_steps == step.merge_steps);
+        for (int k = 0; k < grf_words; k++) {
+            REQUIRE(l_fast.GRF_A_[k] == l_step.GRF_A_[k]);
+            REQUIRE(r_fast.GRF_A_[k] == r_step.GRF_A_[k]);
+        }
+    }
+}
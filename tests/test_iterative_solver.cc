@@ -0,0 +1,80 @@
+#include <cstring>
+#include <vector>
+#include "catch.hpp"
+#include "iterative_solver.h"
+
+namespace {
+
+const int kN = 16;
+
+// 8 on the diagonal, 1 on both neighbours: diagonally dominant
+COOMatrix Tridiagonal() {
+    COOMatrix m;
+    m.n_rows = m.n_cols = kN;
+    for (uint32_t i = 1; i <= kN; i++) {
+        for (uint32_t j = (i > 1 ? i - 1 : 1); j <= i + 1 && j <= kN; j++) {
+            m.row_indices.push_back(i);
+            m.col_indices.push_back(j);
+            m.values.push_back(i == j ? 8 : 1);
+        }
+    }
+    m.nnz = m.values.size();
+    return m;
+}
+
+// Column c in one DRAF row of partition c - 1; val: the values, or the
+// nonzero flag as generate_DRAF writes it
+std::vector<std::vector<re_aligned_dram_format>> ColumnDraf(const COOMatrix& m,
+                                                            bool values) {
+    std::vector<std::vector<re_aligned_dram_format>> bg(64);
+    for (uint32_t c = 1; c <= m.n_cols; c++) {
+        re_aligned_dram_format f;
+        memset(&f, 0, sizeof(f));
+        f.col_group[0] = c;
+        int slot = 0;
+        for (size_t e = 0; e < m.values.size(); e++) {
+            if (m.col_indices[e] != c)
+                continue;
+            f.row[slot] = m.row_indices[e];
+            f.val[slot] = values ? m.values[e] : 1;
+            slot++;
+        }
+        bg[c - 1].push_back(f);
+    }
+    return bg;
+}
+
+}  // namespace
+
+TEST_CASE("Jacobi converges on the y the PIM reads back", "[solver]") {
+    COOMatrix matrix = Tridiagonal();
+    std::vector<uint16_t> y(kN);
+
+    SECTION("DRAF with the values") {
+        dramsim3::SpmvTransactionGenerator spmv("configs/HBM2_4Gb_test.ini", ".",
+                                                ColumnDraf(matrix, true),
+                                                (uint8_t*)y.data());
+        spmv.output_rows_ = kN;
+        spmv.Initialize();
+        spmv.SetData();
+        dramsim3::IterativeSpmv solver(&spmv, matrix, "jacobi");
+        solver.Run(50, 1e-6);
+        REQUIRE(solver.Converged());
+        REQUIRE(solver.Iterations() < 50);
+        // FP16 x and y only
+        REQUIRE(solver.MaxPimError() < 1e-2);
+    }
+    SECTION("DRAF with the nonzero flag") {
+        dramsim3::SpmvTransactionGenerator spmv("configs/HBM2_4Gb_test.ini", ".",
+                                                ColumnDraf(matrix, false),
+                                                (uint8_t*)y.data());
+        spmv.output_rows_ = kN;
+        spmv.Initialize();
+        spmv.SetData();
+        dramsim3::IterativeSpmv solver(&spmv, matrix, "jacobi");
+        solver.Run(50, 1e-6);
+        // the update uses the host product, the PIM y is the pattern product
+        REQUIRE(solver.Converged());
+        REQUIRE(solver.MaxPimError() > 0.5);
+    }
+}
@@ -0,0 +1,194 @@
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "catch.hpp"
+#include "mtx_reader.h"
+
+namespace {
+
+// .mtx in a fresh directory under /tmp, removed with its cache
+class TempMTX {
+ public:
+    explicit TempMTX(const std::string& text) {
+        char dir[] = "/tmp/mtx_testXXXXXX";
+        REQUIRE(mkdtemp(dir) != nullptr);
+        dir_ = dir;
+        path_ = dir_ + "/m.mtx";
+        Write(text);
+    }
+    ~TempMTX() {
+        remove(mtxCachePath(path_).c_str());
+        remove(path_.c_str());
+        rmdir(dir_.c_str());
+    }
+    void Write(const std::string& text) {
+        std::ofstream(path_.c_str()) << text;
+    }
+    // moves the mtime, a rewrite within the same clock tick keeps it
+    void SetMtime(time_t sec) {
+        struct timespec times[2] = {{sec, 0}, {sec, 0}};
+        REQUIRE(utimensat(AT_FDCWD, path_.c_str(), times, 0) == 0);
+    }
+    const std::string& path() const { return path_; }
+    bool HasCache() const {
+        struct stat st;
+        return stat(mtxCachePath(path_).c_str(), &st) == 0;
+    }
+
+ private:
+    std::string dir_;
+    std::string path_;
+};
+
+}  // namespace
+
+TEST_CASE("MTX pattern symmetric files are expanded", "[mtx]") {
+    TempMTX mtx(
+        "%%MatrixMarket matrix coordinate pattern symmetric\n"
+        "% comment\n"
+        "3 3 3\n"
+        "1 1\n"
+        "2 1\n"
+        "3 2\n");
+    MTXEntries e = parseMTXFile(mtx.path(), 1);
+    REQUIRE(e.header.field == MTX_PATTERN);
+    REQUIRE(e.header.symmetry == MTX_SYMMETRIC);
+    REQUIRE(e.header.entries == 3);
+    // the mirrored entry follows its source, the diagonal is not mirrored
+    REQUIRE(e.rows == std::vector<uint32_t>({1, 2, 1, 3, 2}));
+    REQUIRE(e.cols == std::vector<uint32_t>({1, 1, 2, 2, 3}));
+    REQUIRE(e.values == std::vector<float>(5, 1.0f));
+
+    unsetenv("MTX_NO_CACHE");
+    REQUIRE(readMTXNnz(mtx.path()) == 5);
+    REQUIRE(readMTXHeader(mtx.path()).entries == 3);
+}
+
+TEST_CASE("MTX skew-symmetric mirrors negate the value", "[mtx]") {
+    TempMTX mtx(
+        "%%MatrixMarket matrix coordinate real skew-symmetric\n"
+        "2 2 1\n"
+        "2 1 1.5\n");
+    MTXEntries e = parseMTXFile(mtx.path(), 1);
+    REQUIRE(e.rows == std::vector<uint32_t>({2, 1}));
+    REQUIRE(e.cols == std::vector<uint32_t>({1, 2}));
+    REQUIRE(e.values == std::vector<float>({1.5f, -1.5f}));
+}
+
+TEST_CASE("MTX general files keep the size line count", "[mtx]") {
+    TempMTX mtx(
+        "%%MatrixMarket matrix coordinate integer general\n"
+        "2 3 2\n"
+        "1 3 4\n"
+        "2 1 -2\n");
+    setenv("MTX_NO_CACHE", "1", 1);
+    REQUIRE(readMTXNnz(mtx.path()) == 2);
+    MTXEntries e = readMTXEntries(mtx.path(), 1);
+    REQUIRE(e.values == std::vector<float>({4.0f, -2.0f}));
+    REQUIRE_FALSE(mtx.HasCache());
+    unsetenv("MTX_NO_CACHE");
+}
+
+TEST_CASE("MTX cache is rebuilt when the source changes", "[mtx]") {
+    unsetenv("MTX_NO_CACHE");
+    TempMTX mtx(
+        "%%MatrixMarket matrix coordinate real general\n"
+        "2 2 1\n"
+        "1 2 3.0\n");
+    mtx.SetMtime(1000);
+    REQUIRE(mtxCachePath(mtx.path()) == mtx.path() + ".coo");
+
+    MTXEntries first = readMTXEntries(mtx.path(), 1);
+    REQUIRE(mtx.HasCache());
+    {
+        MappedMTX mapped;
+        REQUIRE(mapped.Open(mtx.path()));
+        REQUIRE(mapped.nnz() == 1);
+        REQUIRE(mapped.values()[0] == 3.0f);
+    }
+
+    // same size, new contents: only the mtime tells them apart
+    mtx.Write(
+        "%%MatrixMarket matrix coordinate real general\n"
+        "2 2 1\n"
+        "2 1 5.0\n");
+    mtx.SetMtime(2000);
+    {
+        MappedMTX mapped;
+        REQUIRE_FALSE(mapped.Open(mtx.path()));
+    }
+    MTXEntries second = readMTXEntries(mtx.path(), 1);
+    REQUIRE(second.rows == std::vector<uint32_t>({2}));
+    REQUIRE(second.values == std::vector<float>({5.0f}));
+    {
+        MappedMTX mapped;
+        REQUIRE(mapped.Open(mtx.path()));
+        REQUIRE(mapped.rows()[0] == 2);
+    }
+
+    // a touch alone invalidates too
+    mtx.SetMtime(3000);
+    MappedMTX mapped;
+    REQUIRE_FALSE(mapped.Open(mtx.path()));
+    REQUIRE(readMTXEntries(mtx.path(), 1).values == second.values);
+    REQUIRE(mapped.Open(mtx.path()));
+}
+
+TEST_CASE("MTX cache header serves readMTXHeader", "[mtx]") {
+    unsetenv("MTX_NO_CACHE");
+    TempMTX mtx(
+        "%%MatrixMarket matrix coordinate real symmetric\n"
+        "4 4 2\n"
+        "1 1 1.0\n"
+        "4 2 2.0\n");
+    MTXHeader text = readMTXHeader(mtx.path());
+    readMTXEntries(mtx.path(), 1);
+    REQUIRE(mtx.HasCache());
+    MTXHeader cached = readMTXHeader(mtx.path());
+    REQUIRE(cached.n_rows == text.n_rows);
+    REQUIRE(cached.n_cols == text.n_cols);
+    REQUIRE(cached.entries == 2);
+    REQUIRE(cached.field == MTX_REAL);
+    REQUIRE(cached.symmetry == MTX_SYMMETRIC);
+    REQUIRE(readMTXNnz(mtx.path()) == 3);
+}
+
+TEST_CASE("MTX corrupt or truncated caches are rebuilt", "[mtx]") {
+    unsetenv("MTX_NO_CACHE");
+    TempMTX mtx(
+        "%%MatrixMarket matrix coordinate real general\n"
+        "3 3 2\n"
+        "1 1 1.0\n"
+        "3 2 2.0\n");
+    MTXEntries ref = readMTXEntries(mtx.path(), 1);
+    std::string cache = mtxCachePath(mtx.path());
+
+    SECTION("overwritten value") {
+        std::fstream f(cache.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(sizeof(MTXCacheHeader) + 4 * 4);  // values[0]
+        uint32_t garbage = 0x12345678;
+        f.write(reinterpret_cast<const char*>(&garbage), 4);
+        f.close();
+        MappedMTX mapped;
+        REQUIRE_FALSE(mapped.Open(mtx.path()));
+        REQUIRE(mapped.Open(mtx.path(), false));  // header and size still valid
+    }
+    SECTION("cut short") {
+        REQUIRE(truncate(cache.c_str(), sizeof(MTXCacheHeader) + 8) == 0);
+        MappedMTX mapped;
+        REQUIRE_FALSE(mapped.Open(mtx.path(), false));
+        REQUIRE(readMTXHeader(mtx.path()).data_offset > 0);  // text header
+    }
+
+    MTXEntries again = readMTXEntries(mtx.path(), 1);
+    REQUIRE(again.rows == ref.rows);
+    REQUIRE(again.cols == ref.cols);
+    REQUIRE(again.values == ref.values);
+    MappedMTX mapped;
+    REQUIRE(mapped.Open(mtx.path()));
+}
@@ -0,0 +1,82 @@
+#include <stdlib.h>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "catch.hpp"
+#include "multi_stack.h"
+
+using half_float::half;
+
+namespace {
+
+const char* kConfig = "configs/HBM2_4Gb_test.ini";
+const int kRows = 64;
+
+uint16_t H(float f) {
+    half h(f);
+    return *reinterpret_cast<uint16_t*>(&h);
+}
+
+// 64 BG partitions of 8 DRAF rows, two nonzeros per DRAF row, small
+// integers so every FP16 sum is exact
+std::vector<std::vector<re_aligned_dram_format>> SmallDraf() {
+    std::mt19937 rng(5);
+    std::vector<std::vector<re_aligned_dram_format>> bg(64);
+    for (auto& part : bg) {
+        for (int j = 0; j < 8; j++) {
+            re_aligned_dram_format f;
+            memset(&f, 0, sizeof(f));
+            int k = rng() % GROUP_SIZE;
+            f.col_group[k] = 1 + rng() % kRows;
+            f.vec[k] = H((float)(1 + rng() % 3));
+            for (int i = 0; i < 2; i++) {
+                f.val[k * PARTITION_SIZE + i] = 1 + rng() % 3;
+                f.row[k * PARTITION_SIZE + i] = 1 + rng() % kRows;
+            }
+            part.push_back(f);
+        }
+    }
+    return bg;
+}
+
+// y of every row, summed on the host
+std::vector<uint16_t> Expected(const std::vector<std::vector<re_aligned_dram_format>>& bg) {
+    std::vector<float> y(kRows, 0.0f);
+    for (const auto& part : bg) {
+        for (const re_aligned_dram_format& f : part) {
+            for (int e = 0; e < GROUP_SIZE * PARTITION_SIZE; e++) {
+                if (f.row[e] == 0)
+                    continue;
+                float x = (float)*reinterpret_cast<const half*>(&f.vec[e / PARTITION_SIZE]);
+                y[f.row[e] - 1] += f.val[e] * x;
+            }
+        }
+    }
+    std::vector<uint16_t> out;
+    for (float v : y)
+        out.push_back(H(v));
+    return out;
+}
+
+std::vector<uint16_t> RunStacks(int stacks, const std::string& policy) {
+    char dir[] = "/tmp/multi_stackXXXXXX";
+    REQUIRE(mkdtemp(dir) != nullptr);
+    dramsim3::StackPolicy p;
+    REQUIRE(dramsim3::GetStackPolicy(policy, &p));
+    dramsim3::MultiStackSpmv multi(kConfig, dir, SmallDraf(), kRows, stacks, p);
+    multi.Run();
+    return multi.Output();
+}
+
+}  // namespace
+
+TEST_CASE("Multi-stack SpMV reduces to the single-stack y", "[multi_stack]") {
+    std::vector<uint16_t> one = RunStacks(1, "block");
+    REQUIRE(one == Expected(SmallDraf()));
+    for (const char* policy : {"block", "interleave"}) {
+        INFO(policy);
+        // both policies split every partition, so rows are shared
+        REQUIRE(RunStacks(2, policy) == one);
+    }
+}
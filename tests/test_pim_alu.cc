@@ -0,0 +1,159 @@
+#include <cstring>
+#include <vector>
+#include "catch.hpp"
+#include "pim_unit.h"
+#include "pim_utils.h"
+#include "ukernel.h"
+
+using half_float::half;
+
+namespace {
+
+// MAD GRF_B[0] GRF_A[0] GRF_A[1] SRF_A[bias], hand-encoded
+uint32_t MadWord(int bias, bool relu) {
+    uint32_t code = (uint32_t)PIM_OPERATION::MAD << 28 |
+                    (uint32_t)PIM_OPERAND::GRF_B << 25 |
+                    (uint32_t)PIM_OPERAND::GRF_A << 22 |
+                    (uint32_t)PIM_OPERAND::GRF_A << 19 | 1u;
+    code |= (uint32_t)bias << 16;
+    if (relu)
+        code |= 1u << 12;
+    return code;
+}
+
+unit_t H(float f) {
+    half h(f);
+    return *reinterpret_cast<unit_t*>(&h);
+}
+
+float F(unit_t u) {
+    return (float)*reinterpret_cast<half*>(&u);
+}
+
+// GRF_A[0] = src0 lanes, GRF_A[1] = src1 lanes, SRF_A[k] = k - 4
+void Fill(dramsim3::PimUnit& unit, const float* src0, const float* src1) {
+    for (int i = 0; i < 16; i++) {
+        unit.GRF_A_[i] = H(src0[i]);
+        unit.GRF_A_[16 + i] = H(src1[i]);
+    }
+    for (int k = 0; k < 8; k++)
+        unit.SRF_A_[k] = H((float)(k - 4));
+}
+
+const float kSrc0[16] = {1.5f, -2.0f, 0.25f, 3.0f, -0.5f, 4.0f, -8.0f, 1.0f,
+                         2.0f, -1.0f, 0.75f, -3.5f, 6.0f, -0.125f, 5.0f, 0.0f};
+const float kSrc1[16] = {2.0f, 1.5f, -4.0f, 0.5f, 3.0f, -0.25f, 0.5f, 7.0f,
+                         -1.0f, 2.0f, 4.0f, 1.0f, -0.5f, 8.0f, 0.5f, 9.0f};
+
+}  // namespace
+
+TEST_CASE("PushCrf decodes the MAD bias index and ReLU bit", "[pim_alu]") {
+    dramsim3::Config config("configs/HBM2_4Gb_test.ini", ".");
+    dramsim3::PimUnit unit(config, 0);
+    for (int bias = 0; bias < 8; bias++) {
+        uint32_t word = MadWord(bias, bias % 2 == 1);
+        REQUIRE(BitToSrc2Idx((uint8_t*)&word) == bias);
+        unit.PushCrf(bias, (uint8_t*)&word);
+        REQUIRE(unit.CRF[bias].PIM_OP == PIM_OPERATION::MAD);
+        REQUIRE(unit.CRF[bias].src2_idx == bias);
+        REQUIRE(unit.CRF[bias].is_relu == (bias % 2 == 1));
+        // src1 index (bits 0-2) is untouched by the bias field
+        REQUIRE(unit.CRF[bias].src1_idx == 1);
+    }
+
+    // the assembler writes the same bias and ReLU bits
+    uint32_t code = 0;
+    std::string error;
+    REQUIRE(dramsim3::UKernel::Encode("MAD_RELU GRF_B[0] GRF_A[0] GRF_A[1] SRF_A[6]",
+                                      &code, &error));
+    REQUIRE((code & 0x71000) == (MadWord(6, true) & 0x71000));
+    REQUIRE(BitToSrc2Idx((uint8_t*)&code) == 6);
+    REQUIRE(CheckReLU((uint8_t*)&code));
+}
+
+TEST_CASE("MAD adds SRF_A[idx] to src0 * src1 in FP16", "[pim_alu]") {
+    dramsim3::Config config("configs/HBM2_4Gb_test.ini", ".");
+    std::vector<uint8_t> pmem(4096, 0);
+    dramsim3::PimUnit unit(config, 0);
+    unit.init(pmem.data(), pmem.size(), 32);
+    uint8_t data[32] = {0};
+    Fill(unit, kSrc0, kSrc1);
+    uint32_t crf[2] = {MadWord(7, false),
+                       (uint32_t)PIM_OPERATION::EXIT << 28};
+    unit.PushCrf(0, (uint8_t*)&crf[0]);
+    unit.PushCrf(1, (uint8_t*)&crf[1]);
+
+    REQUIRE(unit.AddTransaction(0, false, data) == EXIT_END);
+    for (int i = 0; i < 16; i++) {
+        half expect = fma(half(kSrc0[i]), half(kSrc1[i]), half(3.0f));
+        REQUIRE(unit.GRF_B_[i] == *reinterpret_cast<unit_t*>(&expect));
+    }
+    REQUIRE(F(unit.GRF_B_[0]) == 6.0f);   // 1.5 * 2 + 3
+    REQUIRE(F(unit.GRF_B_[6]) == -1.0f);  // -8 * 0.5 + 3, not clamped
+    REQUIRE(unit.num_mad_ops == 1);
+    REQUIRE(unit.num_relu_ops == 0);
+}
+
+TEST_CASE("ReLU bit clears the negative lanes of the ALU result", "[pim_alu]") {
+    dramsim3::Config config("configs/HBM2_4Gb_test.ini", ".");
+    std::vector<uint8_t> pmem(4096, 0);
+    dramsim3::PimUnit unit(config, 0);
+    unit.init(pmem.data(), pmem.size(), 32);
+    uint8_t data[32] = {0};
+    Fill(unit, kSrc0, kSrc1);
+    // bias SRF_A[2] = -2
+    uint32_t crf[2] = {MadWord(2, true), (uint32_t)PIM_OPERATION::EXIT << 28};
+    unit.PushCrf(0, (uint8_t*)&crf[0]);
+    unit.PushCrf(1, (uint8_t*)&crf[1]);
+
+    REQUIRE(unit.AddTransaction(0, false, data) == EXIT_END);
+    int cleared = 0;
+    for (int i = 0; i < 16; i++) {
+        float expect = (float)fma(half(kSrc0[i]), half(kSrc1[i]), half(-2.0f));
+        if (expect < 0.0f) {
+            REQUIRE(unit.GRF_B_[i] == 0);
+            cleared++;
+        } else {
+            REQUIRE(F(unit.GRF_B_[i]) == expect);
+        }
+    }
+    REQUIRE(cleared > 0);
+    REQUIRE(unit.num_mad_ops == 1);
+    REQUIRE(unit.num_relu_ops == 1);
+}
+
+TEST_CASE("Fused ops are counted on the instructions that run", "[pim_alu]") {
+    dramsim3::Config config("configs/HBM2_4Gb_test.ini", ".");
+    std::vector<uint8_t> pmem(4096, 0);
+    dramsim3::PimUnit unit(config, 0);
+    unit.init(pmem.data(), pmem.size(), 32);
+    uint8_t data[32] = {0};
+    Fill(unit, kSrc0, kSrc1);
+
+    dramsim3::UKernel k;
+    REQUIRE(k.Assemble(
+        "MAD GRF_B[0] GRF_A[0] GRF_A[1] SRF_A[4]\n"
+        "JUMP -1 2\n"
+        "NOP 3\n"
+        "ADD_RELU GRF_B[1] GRF_B[0] GRF_A[1]\n"
+        "EXIT\n"));
+    uint32_t crf[32];
+    k.CopyTo(crf, 32);
+    for (int i = 0; i < 32; i++)
+        unit.PushCrf(i, (uint8_t*)&crf[i]);
+
+    // MAD x3 (JUMP), a trigger on the NOP, then ADD_RELU
+    std::vector<uint64_t> mad, relu;
+    int ret = 0;
+    while (ret != EXIT_END && mad.size() < 16) {
+        ret = unit.AddTransaction(0, false, data);
+        mad.push_back(unit.num_mad_ops);
+        relu.push_back(unit.num_relu_ops);
+    }
+    REQUIRE(ret == EXIT_END);
+    REQUIRE(unit.num_mad_ops == 3);
+    REQUIRE(unit.num_relu_ops == 1);
+    REQUIRE(unit.num_alu_ops == 4);
+    REQUIRE(mad == std::vector<uint64_t>({1, 2, 3, 3, 3}));
+    REQUIRE(relu == std::vector<uint64_t>({0, 0, 0, 0, 1}));
+}
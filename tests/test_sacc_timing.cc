@@ -0,0 +1,127 @@
+#include <cstring>
+#include <vector>
+#include "catch.hpp"
+#include "pim_func_sim.h"
+#include "shared_acc.h"
+#include "ukernel.h"
+
+namespace {
+
+// 8 SACC slots, values first .. first + 7 (0 is an empty slot)
+std::vector<uint32_t> Run(uint32_t first) {
+    std::vector<uint32_t> v(8);
+    for (int k = 0; k < 8; k++)
+        v[k] = first + k;
+    return v;
+}
+
+// One SACC load the way PimFuncSim issues it, returns the host stall
+uint64_t Load(dramsim3::SharedAccumulator& sa, uint64_t hex_addr, uint64_t clk,
+              std::vector<uint32_t> L, std::vector<uint32_t> R) {
+    uint64_t stall = sa.ReserveSlots(clk, 8, 8);
+    sa.loadIndices(hex_addr, L.data(), R.data());
+    sa.runSimulation(hex_addr);
+    return stall + sa.TimeMerge(clk + stall);
+}
+
+class SaccFixture {
+ public:
+    SaccFixture()
+        : config_("configs/HBM2_4Gb_test.ini", "."),
+          pmem_(1 << 16, 0),
+          l_(config_, 1),
+          r_(config_, 0),
+          sa_(config_, 0, l_, r_) {
+        l_.init(pmem_.data(), pmem_.size(), 32);
+        r_.init(pmem_.data(), pmem_.size(), 32);
+        sa_.init(pmem_.data(), pmem_.size(), 32);
+        dramsim3::Address addr(0, 0, 0, 0, 0, 8);
+        hex_addr_ = sa_.ReverseAddressMapping(addr);
+    }
+    dramsim3::Config config_;
+    std::vector<uint8_t> pmem_;
+    dramsim3::PimUnit l_, r_;
+    dramsim3::SharedAccumulator sa_;
+    uint64_t hex_addr_;
+};
+
+}  // namespace
+
+TEST_CASE("SACC load waits for the compares still holding its slots", "[sacc]") {
+    SaccFixture f;
+    // every index matches: 8 compares, each pops both queues
+    REQUIRE(Load(f.sa_, f.hex_addr_, 0, Run(1), Run(1)) == 0);
+    REQUIRE(f.sa_.sa_clk == 8);
+    // 8 queued + 8 incoming fit exactly
+    REQUIRE(Load(f.sa_, f.hex_addr_, 0, Run(1), Run(1)) == 0);
+    REQUIRE(f.sa_.sa_clk == 16);
+    // 16 queued: the load enters when the 8th compare retires
+    REQUIRE(Load(f.sa_, f.hex_addr_, 0, Run(1), Run(1)) == 8);
+    REQUIRE(f.sa_.sa_clk == 24);
+    REQUIRE(f.sa_.compare_cycles == 24);
+    REQUIRE(f.sa_.L_IQ.empty());
+    REQUIRE(f.sa_.R_IQ.empty());
+}
+
+TEST_CASE("SACC residue without partner is retired while the host waits", "[sacc]") {
+    SaccFixture f;
+    // L runs out first, R keeps its indices as residue
+    REQUIRE(Load(f.sa_, f.hex_addr_, 0, Run(1), Run(101)) == 0);
+    REQUIRE(f.sa_.R_IQ.size() == 8);
+    // L: 7 entries still in flight + 8, R: 8 residue + 8
+    REQUIRE(Load(f.sa_, f.hex_addr_, 1, Run(9), Run(109)) == 0);
+    REQUIRE(f.sa_.R_IQ.size() == 16);
+    REQUIRE(f.sa_.sa_clk == 16);
+    // R is full until the engine is idle (cycle 16, 14 cycles), then
+    // 8 compares drain the new L and 8 retire R's oldest entries
+    REQUIRE(Load(f.sa_, f.hex_addr_, 2, Run(17), Run(117)) == 14 + 16);
+    REQUIRE(f.sa_.hold_steps == 16);
+    REQUIRE(f.sa_.sa_clk == 32);
+    REQUIRE(f.sa_.L_IQ.empty());
+    REQUIRE(f.sa_.R_IQ.size() == 16);
+    REQUIRE(f.sa_.R_IQ.front().value == 109);
+    REQUIRE(f.sa_.R_IQ.at(15).value == 124);
+}
+
+TEST_CASE("SACC stalls are reported per channel", "[sacc]") {
+    dramsim3::Config config("configs/HBM2_4Gb_test.ini", ".");
+    std::vector<uint8_t> pmem(1 << 20, 0);
+    dramsim3::PimFuncSim sim(config);
+    sim.init(pmem.data(), pmem.size(), 32);
+
+    dramsim3::UKernel k;
+    REQUIRE(k.Assemble("SACC(AAM0) BANK BANK\nJUMP -1 200\nEXIT\n"));
+    uint32_t crf[32];
+    k.CopyTo(crf, 32);
+    for (int u = 0; u < config.pim_units; u++) {
+        for (int i = 0; i < 32; i++)
+            sim.pim_unit_[u]->PushCrf(i, (uint8_t*)&crf[i]);
+    }
+    sim.PIM_OP_MODE[0] = true;
+
+    // same streams as above: odd units (banks 2, 6, ..) feed L_IQ
+    const uint32_t first_L[3] = {1, 9, 17};
+    const uint32_t first_R[3] = {101, 109, 117};
+    uint8_t data[32] = {0};
+    for (int t = 0; t < 3; t++) {
+        for (int bank = 0; bank < config.banks; bank += 2) {
+            dramsim3::Address addr(0, 0, bank / config.banks_per_group,
+                                   bank % config.banks_per_group, 0, 8 + t);
+            uint64_t hex = sim.ReverseAddressMapping(addr);
+            REQUIRE(hex + 32 <= pmem.size());
+            std::vector<uint32_t> v = Run(bank % 4 ? first_L[t] : first_R[t]);
+            memcpy(pmem.data() + hex, v.data(), 32);
+        }
+        dramsim3::Address trigger(0, 0, 0, 0, 0, 8 + t);
+        dramsim3::Transaction trans(sim.ReverseAddressMapping(trigger), false, data);
+        trans.added_cycle = t;
+        sim.AddTransaction(&trans);
+    }
+    // the four accumulators of channel 0 stall together, the slowest counts
+    REQUIRE(sim.sacc_stall_cycles[0] == 30);
+    REQUIRE(sim.sacc_compare_cycles[0] == 4 * 32);
+    REQUIRE(sim.TakeStallCycles(0) == 30);
+    REQUIRE(sim.TakeStallCycles(0) == 0);
+    for (int ch = 1; ch < config.channels; ch++)
+        REQUIRE(sim.sacc_stall_cycles[ch] == 0);
+}
@@ -0,0 +1,265 @@
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include "catch.hpp"
+#include "dat_file.h"
+#include "pim_unit.h"
+#include "transaction_generator.h"
+#include "ukernel.h"
+
+namespace {
+
+const char* kConfig = "configs/HBM2_4Gb_test.ini";
+
+// Exposes the pmem image and fills the banks the μkernel reads
+class SpmmProbe : public dramsim3::SpmmTransactionGenerator {
+ public:
+    using dramsim3::SpmmTransactionGenerator::SpmmTransactionGenerator;
+    const dramsim3::PmemBackend& Pmem() const { return *pmem_; }
+
+    // every bank of rows 0 .. rows-1 with small FP16 integers
+    void FillBanks(int rows) {
+        const uint16_t values[4] = {0x0000, 0x3c00, 0x4000, 0x4200};
+        srand(11);
+        for (int ch = 0; ch < config_->channels; ch++) {
+            for (int bank = 0; bank < config_->banks; bank++) {
+                for (int ro = 0; ro < rows; ro++) {
+                    for (int co = 0; co < 32; co++) {
+                        dramsim3::Address addr(ch, 0, bank / config_->banks_per_group,
+                                               bank % config_->banks_per_group, ro, co);
+                        uint16_t* word = (uint16_t*)(pmemAddr_ + ReverseAddressMapping(addr));
+                        for (int k = 0; k < 16; k++)
+                            word[k] = values[rand() % 4];
+                    }
+                }
+            }
+        }
+    }
+
+    uint64_t execute_cycles;  // set by RunSpmm
+};
+
+// 64 BG partitions of `rows` sparse rows, `n_rd` row descriptors each
+sparse_row_partitions SparseRows(int rows, uint32_t n_rd) {
+    std::vector<std::vector<sparse_row_format>> parts(64);
+    for (auto& part : parts) {
+        for (int r = 0; r < rows; r++) {
+            sparse_row_format f;
+            memset(&f, 0, sizeof(f));
+            f.n_rd = n_rd;
+            for (int k = 0; k < MAX_BLOCK_PER_ROW; k++)
+                f.row_count[k] = 1 + k % 2;
+            part.push_back(f);
+        }
+    }
+    char path[] = "/tmp/spmm_testXXXXXX";
+    int fd = mkstemp(path);
+    REQUIRE(fd >= 0);
+    close(fd);
+    REQUIRE(saveDatFile(parts, path));
+    sparse_row_partitions mapped = sparse_row_partitions::Load(path);
+    remove(path);  // the spans keep the mapping
+    return mapped;
+}
+
+int DiffWords(const dramsim3::PmemBackend& a, const dramsim3::PmemBackend& b) {
+    std::set<uint64_t> pages;
+    for (uint64_t p : a.TouchedPages()) pages.insert(p);
+    for (uint64_t p : b.TouchedPages()) pages.insert(p);
+    REQUIRE(!pages.empty());
+    int diff = 0;
+    for (uint64_t p : pages) {
+        uint64_t off = p * a.PageSize();
+        for (uint64_t w = 0; w < a.PageSize(); w += 32)
+            diff += memcmp(a.Base() + off + w, b.Base() + off + w, 32) != 0;
+    }
+    return diff;
+}
+
+// Records the order in which IssueInterleaved asks the channels for work
+class IssueProbe : public dramsim3::TransactionGenerator {
+ public:
+    IssueProbe() : dramsim3::TransactionGenerator(kConfig, ".") {}
+    void Initialize() override {}
+    void SetData() override {}
+    void Execute() override {}
+    void GetResult() override {}
+    void CheckResult() override {}
+    void AdditionalAccumulation() override {}
+    void ChangeVector() override {}
+
+    // `chunks` chunks of `per_chunk` reads for each of `channels` channels
+    void Run(int channels, int chunks, int per_chunk) {
+        std::vector<int> given(channels, 0);
+        IssueInterleaved(channels, [&](int ch, std::vector<dramsim3::HostTransaction>& out) {
+            if (given[ch] == chunks)
+                return false;
+            for (int k = 0; k < per_chunk; k++) {
+                // distinct addresses, the controller merges repeated reads
+                dramsim3::Address addr(ch, 0, 0, 0, given[ch] * 64 + k / 32, k % 32);
+                dramsim3::HostTransaction t = {ReverseAddressMapping(addr), false, nullptr};
+                out.push_back(t);
+            }
+            given[ch]++;
+            log.push_back(std::make_pair(GetClk(), ch));
+            return true;
+        });
+    }
+    std::vector<std::pair<uint64_t, int>> log;  // (clk, channel) per chunk
+};
+
+// Runs SpMM over `rows` sparse rows with a dense operand of `width` columns
+std::unique_ptr<SpmmProbe> RunSpmm(int rows, uint32_t width,
+                                   const std::vector<uint16_t>& dense,
+                                   std::vector<uint16_t>& out) {
+    std::unique_ptr<SpmmProbe> probe(new SpmmProbe(
+        kConfig, ".", SparseRows(rows, 4), SparseRows(rows, 4), out.data()));
+    probe->dense_width_ = width;
+    probe->dense_matrix_ = dense;
+    probe->FillBanks(rows);
+    probe->Initialize();
+    probe->SetData();
+    uint64_t start = probe->GetClk();
+    probe->Execute();
+    probe->execute_cycles = probe->GetClk() - start;
+    return probe;
+}
+
+// k rows x width columns, a different FP16 value per element
+std::vector<uint16_t> Dense(int k, uint32_t width) {
+    std::vector<uint16_t> d(k * width);
+    for (size_t i = 0; i < d.size(); i++)
+        d[i] = 0x3c00 + i;
+    return d;
+}
+
+}  // namespace
+
+TEST_CASE("IssueInterleaved rotates the first channel every cycle", "[spmm]") {
+    IssueProbe probe;
+    probe.Run(3, 2, 1);
+    // one request per channel per cycle, channel (clk % 3) goes first
+    std::vector<std::pair<uint64_t, int>> expect = {
+        {0, 0}, {0, 1}, {0, 2}, {1, 1}, {1, 2}, {1, 0}};
+    REQUIRE(probe.log == expect);
+    // the third cycle only finds every channel done
+    REQUIRE(probe.GetClk() == 3);
+}
+
+TEST_CASE("IssueInterleaved skips a full channel", "[spmm]") {
+    IssueProbe probe;
+    probe.issue_width_ = 1000;
+    // channel 0 gets more reads than its queue holds
+    probe.Run(2, 1, 200);
+    REQUIRE(probe.log.size() == 2);
+    REQUIRE(probe.log[0] == std::make_pair((uint64_t)0, 0));
+    // channel 1 is not held back by the stalled channel 0
+    REQUIRE(probe.log[1] == std::make_pair((uint64_t)0, 1));
+    REQUIRE(probe.GetClk() > 1);
+}
+
+TEST_CASE("SpMM interleaved issue matches the serial order", "[spmm]") {
+    const int rows = 4;
+    std::vector<uint16_t> out(1 << 16);
+    uint64_t cycles[2];
+    SpmmProbe serial(kConfig, ".", SparseRows(rows, 4), SparseRows(rows, 4), out.data());
+    SpmmProbe interleaved(kConfig, ".", SparseRows(rows, 4), SparseRows(rows, 4), out.data());
+    serial.interleave_channels_ = false;
+    SpmmProbe* runs[2] = {&serial, &interleaved};
+    for (int i = 0; i < 2; i++) {
+        runs[i]->FillBanks(rows);
+        runs[i]->Initialize();
+        runs[i]->SetData();
+        uint64_t start = runs[i]->GetClk();
+        runs[i]->Execute();
+        cycles[i] = runs[i]->GetClk() - start;
+    }
+    // every channel sees the same triggers, only the channel order moves,
+    // so the units leave the same image whatever they compute
+    REQUIRE(DiffWords(serial.Pmem(), interleaved.Pmem()) == 0);
+    // 16 balanced channels overlap
+    INFO("serial " << cycles[0] << " interleaved " << cycles[1]);
+    REQUIRE(cycles[1] * 8 < cycles[0]);
+}
+
+TEST_CASE("SpMM cuts the dense operand into DRF tiles", "[spmm]") {
+    std::vector<uint16_t> out(1 << 16);
+    SpmmProbe probe(kConfig, ".", SparseRows(4, 4), SparseRows(4, 4), out.data());
+
+    SECTION("K = 10, N = 24") {
+        probe.dense_width_ = 24;
+        probe.dense_matrix_ = Dense(10, 24);
+        probe.Initialize();
+        REQUIRE(probe.DenseTiles() == 2);
+        for (int t = 0; t < 2; t++) {
+            const uint16_t* tile = probe.DrfTile(t);
+            for (int r = 0; r < DRF_ROWS; r++) {
+                for (int c = 0; c < DRF_COLS; c++) {
+                    uint32_t col = t * DRF_COLS + c;
+                    // rows past K and columns past N are zero
+                    uint16_t expect = (r < 10 && col < 24)
+                                          ? probe.dense_matrix_[r * 24 + col] : 0;
+                    REQUIRE(tile[r * DRF_COLS + c] == expect);
+                }
+            }
+        }
+    }
+    SECTION("no operand") {
+        probe.dense_width_ = 40;
+        probe.Initialize();
+        REQUIRE(probe.DenseTiles() == 3);
+        for (int i = 0; i < 3 * DRF_ROWS * DRF_COLS; i++)
+            REQUIRE(probe.DrfTile(0)[i] == 0x3c00);  // FP16 1.0
+    }
+}
+
+TEST_CASE("MUL_DRF takes row k of the loaded DRF tile", "[spmm]") {
+    dramsim3::Config config(kConfig, ".");
+    std::vector<uint16_t> out(1 << 16);
+    SpmmProbe probe(kConfig, ".", SparseRows(4, 4), SparseRows(4, 4), out.data());
+    probe.dense_width_ = 32;
+    probe.dense_matrix_ = Dense(16, 32);
+    probe.Initialize();
+
+    std::vector<uint8_t> pmem(1 << 20, 0);
+    dramsim3::PimUnit unit(config, 0);
+    unit.init(pmem.data(), pmem.size(), 32);
+    // the MAP_DRF writes of DrfLoad, one DRF row per column
+    const uint16_t* tile = probe.DrfTile(1);
+    for (int co = 0; co < DRF_ROWS; co++) {
+        dramsim3::Address addr(0, 0, 0, EVEN_BANK, MAP_DRF, co);
+        unit.SetDrf(probe.ReverseAddressMapping(addr), (uint8_t*)(tile + co * DRF_COLS));
+    }
+    dramsim3::UKernel k;
+    REQUIRE(k.Assemble("MUL_DRF(AAM0) GRF_B DRF SRF_M\nEXIT\n"));
+    uint32_t crf[32];
+    k.CopyTo(crf, 32);
+    for (int i = 0; i < 32; i++)
+        unit.PushCrf(i, (uint8_t*)&crf[i]);
+    // the functional MUL multiplies the unit_t words as integers
+    for (int i = 0; i < 8; i++)
+        unit.SRF_M_[i] = 3;
+
+    // GRF_A[0] low byte: column index of the nonzero = dense row
+    const int row = 5;
+    unit.GRF_A_[0] = row;
+    uint8_t data[32] = {0};
+    REQUIRE(unit.AddTransaction(0, false, data) == EXIT_END);
+    for (int c = 0; c < DRF_COLS; c++) {
+        unit_t expect = probe.dense_matrix_[row * 32 + DRF_COLS + c] * 3;
+        REQUIRE(unit.GRF_B_[c] == expect);
+    }
+}
+
+TEST_CASE("SpMM replays the rows once per DRF tile", "[spmm]") {
+    std::vector<uint16_t> out(1 << 16);
+    std::unique_ptr<SpmmProbe> narrow = RunSpmm(4, 16, Dense(16, 16), out);
+    std::unique_ptr<SpmmProbe> wide = RunSpmm(4, 32, Dense(16, 32), out);
+    INFO("16 wide " << narrow->execute_cycles << ", 32 wide " << wide->execute_cycles);
+    REQUIRE(wide->execute_cycles > narrow->execute_cycles * 3 / 2);
+}
@@ -0,0 +1,179 @@
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <set>
+#include <vector>
+#include "catch.hpp"
+#include "transaction_generator.h"
+
+namespace {
+
+// Exposes the pmem image of a finished run
+class SpmvProbe : public dramsim3::SpmvTransactionGenerator {
+ public:
+    using dramsim3::SpmvTransactionGenerator::SpmvTransactionGenerator;
+    const dramsim3::PmemBackend& Pmem() const { return *pmem_; }
+};
+
+// 64 BG partitions of `rows` DRAM rows each with random DRAF contents
+std::vector<std::vector<re_aligned_dram_format>> RandomDraf(int rows) {
+    srand(7);
+    std::vector<std::vector<re_aligned_dram_format>> bg(64);
+    for (int i = 0; i < 64; i++) {
+        for (int r = 0; r < rows * 4; r++) {
+            re_aligned_dram_format f;
+            memset(&f, 0, sizeof(f));
+            for (int k = 0; k < 7; k++) {
+                f.col_group[k] = rand() % 64;
+                f.vec[k] = rand() % 8;
+            }
+            for (int k = 0; k < 7 * 16; k++) {
+                f.val[k] = rand() % 8;
+                f.row[k] = rand() % 64;
+            }
+            bg[i].push_back(f);
+        }
+    }
+    return bg;
+}
+
+// Partition 0 holds `heavy` tiles, the others one; two small-integer
+// nonzeros per DRAF row so the FP16 sums are exact
+std::vector<std::vector<re_aligned_dram_format>> SkewedDraf(int heavy, int n_rows) {
+    std::mt19937 rng(9);
+    std::vector<std::vector<re_aligned_dram_format>> bg(64);
+    for (size_t p = 0; p < bg.size(); p++) {
+        int rows = (p == 0 ? heavy : 1) * 4;
+        for (int r = 0; r < rows; r++) {
+            re_aligned_dram_format f;
+            memset(&f, 0, sizeof(f));
+            int k = rng() % 7;
+            f.col_group[k] = 1 + rng() % n_rows;
+            half_float::half x((float)(1 + rng() % 3));
+            memcpy(&f.vec[k], &x, sizeof(uint16_t));
+            for (int i = 0; i < 2; i++) {
+                f.val[k * 16 + i] = 1 + rng() % 3;
+                f.row[k * 16 + i] = 1 + rng() % n_rows;
+            }
+            bg[p].push_back(f);
+        }
+    }
+    return bg;
+}
+
+// Three column groups of three nonzeros (distinct rows) per DRAF row, vec
+// is x of the column group
+std::vector<std::vector<re_aligned_dram_format>> GroupedDraf(
+    const std::vector<uint16_t>& x, int n_rows) {
+    std::mt19937 rng(13);
+    std::vector<std::vector<re_aligned_dram_format>> bg(64);
+    for (auto& part : bg) {
+        for (int r = 0; r < 4; r++) {
+            re_aligned_dram_format f;
+            memset(&f, 0, sizeof(f));
+            for (int k = 0; k < 3; k++) {
+                f.col_group[k] = 1 + rng() % x.size();
+                f.vec[k] = x[f.col_group[k] - 1];
+                uint32_t row = 1 + rng() % (n_rows - 3);
+                for (int i = 0; i < 3; i++) {
+                    f.val[k * 16 + i] = 1 + rng() % 3;
+                    f.row[k * 16 + i] = row + i;
+                }
+            }
+            part.push_back(f);
+        }
+    }
+    return bg;
+}
+
+}  // namespace
+
+TEST_CASE("Pipelined SpMV leaves the same pmem image", "[spmv]") {
+    const char* config = "configs/HBM2_4Gb_test.ini";
+    std::vector<uint8_t> out(1 << 20);
+    SpmvProbe serial(config, ".", RandomDraf(16), out.data());
+    serial.Initialize();
+    serial.SetData();
+    serial.Execute();
+
+    for (uint32_t tile : {1u, 4u}) {
+        SpmvProbe piped(config, ".", RandomDraf(16), out.data());
+        piped.pipeline_tile_rows_ = tile;
+        piped.Initialize();
+        piped.SetData();
+        piped.Execute();
+
+        const dramsim3::PmemBackend& a = serial.Pmem();
+        const dramsim3::PmemBackend& b = piped.Pmem();
+        std::set<uint64_t> pages;
+        for (uint64_t p : a.TouchedPages()) pages.insert(p);
+        for (uint64_t p : b.TouchedPages()) pages.insert(p);
+        REQUIRE(!pages.empty());
+        int diff_words = 0;
+        for (uint64_t p : pages) {
+            uint64_t off = p * a.PageSize();
+            for (uint64_t w = 0; w < a.PageSize(); w += 32)
+                diff_words += memcmp(a.Base() + off + w, b.Base() + off + w, 32) != 0;
+        }
+        INFO("pipeline_tile_rows_ = " << tile);
+        REQUIRE(diff_words == 0);
+    }
+}
+
+TEST_CASE("Rebalanced SpMV gives the same y", "[spmv]") {
+    const char* config = "configs/HBM2_4Gb_test.ini";
+    const int n_rows = 64;
+    std::vector<uint16_t> y[2];
+    uint64_t cycles[2];
+    for (int i = 0; i < 2; i++) {
+        y[i].assign(n_rows, 0xffff);
+        SpmvProbe spmv(config, ".", SkewedDraf(16, n_rows), (uint8_t*)y[i].data());
+        spmv.output_rows_ = n_rows;
+        spmv.rebalance_ = (i == 1);
+        spmv.Initialize();
+        spmv.SetData();
+        uint64_t start = spmv.GetClk();
+        spmv.Execute();
+        cycles[i] = spmv.GetClk() - start;
+        spmv.GetResult();
+    }
+    // the moved tiles carry their rows and x, only the placement changes
+    REQUIRE(y[0] == y[1]);
+    int nonzero = 0;
+    for (uint16_t v : y[0])
+        nonzero += (v != 0);
+    REQUIRE(nonzero > n_rows / 2);
+    INFO("unbalanced " << cycles[0] << " rebalanced " << cycles[1]);
+    REQUIRE(cycles[1] < cycles[0]);
+}
+
+TEST_CASE("Mixed-format SpMV gives the y of pure DRAF", "[spmv]") {
+    const char* config = "configs/HBM2_4Gb_test.ini";
+    const int n_rows = 64;
+    std::vector<uint16_t> x(n_rows);
+    for (int j = 0; j < n_rows; j++) {
+        half_float::half h((float)(1 + j % 3));
+        memcpy(&x[j], &h, sizeof(uint16_t));
+    }
+    std::vector<uint16_t> y[4];
+    const char* formats[4] = {"draf", "dense", "sparse_row", "auto"};
+    for (int i = 0; i < 4; i++) {
+        y[i].assign(n_rows, 0xffff);
+        SpmvProbe spmv(config, ".", GroupedDraf(x, n_rows), (uint8_t*)y[i].data());
+        spmv.output_rows_ = n_rows;
+        spmv.tile_format_ = formats[i];
+        spmv.x_vector_ = x;
+        spmv.Initialize();
+        spmv.SetData();
+        spmv.Execute();
+        spmv.GetResult();
+    }
+    int nonzero = 0;
+    for (uint16_t v : y[0])
+        nonzero += (v != 0);
+    REQUIRE(nonzero > n_rows / 2);
+    for (int i = 1; i < 4; i++) {
+        INFO(formats[i]);
+        REQUIRE(y[i] == y[0]);
+    }
+}
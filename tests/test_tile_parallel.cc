@@ -0,0 +1,87 @@
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include "catch.hpp"
+#include "tile_parallel.h"
+
+namespace {
+
+// splitMatrixColumnWise of the generators before splitColumnsOnePass:
+// one scan of the nonzeros per tile
+std::vector<COOMatrix> SequentialSplit(const COOMatrix& matrix, int num_tiles) {
+    uint32_t cols_per_tile = matrix.n_cols / num_tiles;
+    uint32_t remainder = matrix.n_cols % num_tiles;
+    std::vector<COOMatrix> tiles(num_tiles);
+    for (int tile = 0; tile < num_tiles; ++tile) {
+        uint32_t start_col = tile * cols_per_tile + std::min(tile, (int)remainder);
+        uint32_t end_col = start_col + cols_per_tile + ((uint32_t)tile < remainder ? 1 : 0);
+        COOMatrix& t = tiles[tile];
+        t.n_rows = matrix.n_rows;
+        t.n_cols = matrix.n_cols;
+        for (size_t i = 0; i < matrix.nnz; ++i) {
+            if (matrix.col_indices[i] >= start_col && matrix.col_indices[i] < end_col) {
+                t.row_indices.push_back(matrix.row_indices[i]);
+                t.col_indices.push_back(matrix.col_indices[i]);
+                t.values.push_back(matrix.values[i]);
+            }
+        }
+        t.nnz = t.row_indices.size();
+    }
+    return tiles;
+}
+
+}  // namespace
+
+TEST_CASE("splitColumnsOnePass equals the per-tile scan", "[tile]") {
+    std::mt19937 rng(5);
+    for (int trial = 0; trial < 200; trial++) {
+        COOMatrix m;
+        m.n_rows = 100;
+        // fewer columns than tiles too (empty tiles)
+        m.n_cols = 1 + rng() % 300;
+        int nnz = rng() % 2000;
+        for (int i = 0; i < nnz; i++) {
+            m.row_indices.push_back(rng() % m.n_rows);
+            // a few columns past n_cols belong to no tile
+            m.col_indices.push_back(rng() % (m.n_cols + 3));
+            m.values.push_back(rng() & 0xffff);
+        }
+        m.nnz = nnz;
+        int num_tiles = (trial % 2) ? 64 : 1 + rng() % 100;
+
+        std::vector<COOMatrix> ref = SequentialSplit(m, num_tiles);
+        std::vector<COOMatrix> out = splitColumnsOnePass(m, num_tiles);
+        REQUIRE(out.size() == ref.size());
+        for (int t = 0; t < num_tiles; t++) {
+            REQUIRE(out[t].n_rows == ref[t].n_rows);
+            REQUIRE(out[t].n_cols == ref[t].n_cols);
+            REQUIRE(out[t].nnz == ref[t].nnz);
+            REQUIRE(out[t].row_indices == ref[t].row_indices);
+            REQUIRE(out[t].col_indices == ref[t].col_indices);
+            REQUIRE(out[t].values == ref[t].values);
+        }
+    }
+}
+
+TEST_CASE("runTilesParallel builds every tile once", "[tile]") {
+    for (int threads : {0, 1, 3, 16}) {
+        std::vector<std::atomic<int>> built(37);
+        for (auto& b : built)
+            b = 0;
+        runTilesParallel(37, threads, [&](int tile) { built[tile]++; });
+        for (auto& b : built)
+            REQUIRE(b == 1);
+    }
+}
+
+TEST_CASE("runTilesParallel rethrows a tile exception", "[tile]") {
+    for (int threads : {1, 4}) {
+        REQUIRE_THROWS_AS(runTilesParallel(20, threads, [](int tile) {
+                              if (tile == 7)
+                                  throw std::runtime_error("tile 7");
+                          }),
+                          std::runtime_error);
+    }
+}
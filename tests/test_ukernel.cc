@@ -0,0 +1,134 @@
+#include <vector>
+#include "catch.hpp"
+#include "pim_unit.h"
+#include "transaction_generator.h"
+#include "ukernel.h"
+
+// CRF tables the generators used before the assembler (hand-encoded)
+static const uint32_t kOldSpmv[15] = {
+    0b01001000000000001000000000000000,  // MOV(AAM0) SRF_M BANK
+    0b10010010001000001000000000000000,  // MUL(AAM0) GRF_A BANK SRF_M
+    0b11000000000000001000000000000000,  // SACC(AAM0) BANK BANK
+    0b11000000000000001000000000000000,  // SACC(AAM0) BANK BANK
+    0b00010000000001000001100000000110,  // JUMP -3 6
+    0b01000000010000001000000000000000,  // MOV(AAM0) BANK GRF_A
+    0b00010000000001000000100000000110,  // JUMP -1 6
+    0b01001000000000001000000000000000,  // MOV(AAM0) SRF_M BANK
+    0b10010010001000001000000000000000,  // MUL(AAM0) GRF_A BANK SRF_M
+    0b11000000000000001000000000000000,  // SACC(AAM0) BANK BANK
+    0b11000000000000001000000000000000,  // SACC(AAM0) BANK BANK
+    0b00010000000001000001100000000110,  // JUMP -3 6
+    0b01000000010000001000000000000000,  // MOV(AAM0) BANK GRF_A
+    0b00010000000001000000100000000110,  // JUMP -1 6
+    0b00100000000000000000000000000000,  // EXIT
+};
+
+static const uint32_t kOldSpmm[10] = {
+    0b01000010000000001000000000000000,  // MOV(AAM0) GRF_A BANK
+    0b01001000010000001000000000000000,  // MOV(AAM0) SRF_M GRF_A
+    0b10010101011000001000000000000000,  // MUL_DRF(AAM0) GRF_B DRF SRF_M
+    0b10000100100100001000000000000000,  // ADD(AAM0) GRF_B GRF_B GRF_B
+    0b11010000010001000101100010100000,  // LOOP -3 GRF_A[2]
+    0b11000100100000001000000000000000,  // SACC(AAM0) GRF_B GRF_B
+    0b00010000000001000111100000011000,  // JUMP -7 16
+    0b01000000100000001000000000000000,  // MOV(AAM0) BANK GRF_B
+    0b00010000000001000100100000001111,  // JUMP -1 7
+    0b00100000000000000000000000000000,  // EXIT
+};
+
+// Triggers until the PimUnit returns EXIT_END (all at pmem offset 0)
+static int RunUntilExit(dramsim3::Config& config, const dramsim3::UKernel& k,
+                        std::vector<uint8_t>& pmem, int limit) {
+    dramsim3::PimUnit unit(config, 0);
+    unit.init(pmem.data(), pmem.size(), 32);
+    uint32_t crf[32];
+    k.CopyTo(crf, 32);
+    for (int i = 0; i < 32; i++)
+        unit.PushCrf(i, (uint8_t*)&crf[i]);
+    uint8_t data[32] = {0};
+    for (int n = 1; n <= limit; n++) {
+        if (unit.AddTransaction(0, false, data) == EXIT_END)
+            return n;
+    }
+    return -1;
+}
+
+TEST_CASE("SpMV CRF image matches the old table", "[ukernel]") {
+    dramsim3::UKernel k;
+    REQUIRE(k.Assemble(dramsim3::kUKernelSpmv));
+    REQUIRE(k.Size() == 15);
+    uint32_t crf[32];
+    k.CopyTo(crf, 32);
+    for (int i = 0; i < 15; i++)
+        REQUIRE(crf[i] == kOldSpmv[i]);
+    for (int i = 15; i < 32; i++)
+        REQUIRE(crf[i] == 0);
+}
+
+TEST_CASE("SpMM CRF image matches the old table", "[ukernel]") {
+    dramsim3::UKernel k;
+    REQUIRE(k.Assemble(dramsim3::kUKernelSpmm));
+    REQUIRE(k.Size() == 10);
+    // LOOP / JUMP immediates are encoded as pim_utils.cc decodes them, the
+    // old table carried the python register fix bit (and JUMP -7)
+    for (int i = 0; i < 10; i++) {
+        if (i == 4 || i == 6 || i == 8)
+            continue;
+        REQUIRE(k.Code()[i] == kOldSpmm[i]);
+    }
+}
+
+TEST_CASE("UKernel reports bad source", "[ukernel]") {
+    dramsim3::UKernel k;
+    CHECK_FALSE(k.Assemble("MUL(AAM0) GRF_A FOO SRF_M\nEXIT\n"));
+    CHECK_FALSE(k.Assemble("JUMP -4 2\nEXIT\n"));
+    uint32_t code;
+    std::string error;
+    REQUIRE(dramsim3::UKernel::Encode("SACC(AAM0) BANK BANK", &code, &error));
+    REQUIRE(code == kOldSpmv[2]);
+}
+
+TEST_CASE("SpMV schedule follows the PimUnit control flow", "[ukernel]") {
+    dramsim3::Config config("configs/HBM2_4Gb_test.ini", ".");
+    dramsim3::UKernel k;
+    REQUIRE(k.Assemble(dramsim3::kUKernelSpmv));
+    std::vector<dramsim3::UKernelTrigger> s = k.Schedule();
+    // per bank: MOV, 7 x (MUL SACC SACC), 7 x MOV (JUMP -3 6 / -1 6)
+    REQUIRE(s.size() == 58);
+    int writes = 0;
+    for (size_t i = 0; i < s.size(); i++) {
+        const dramsim3::UKernelTrigger& t = s[i];
+        REQUIRE(t.bank == (i < 29 ? 0 : 1));
+        if (t.op == PIM_OPERATION::MUL)
+            REQUIRE(t.column == (int)((i % 29) - 1) / 3);
+        if (t.is_write) {
+            REQUIRE(t.op == PIM_OPERATION::MOV);
+            REQUIRE(t.column == (int)(i % 29) - 22);
+            writes++;
+        }
+    }
+    REQUIRE(writes == 14);
+
+    std::vector<uint8_t> pmem(1 << 16, 0);
+    REQUIRE(RunUntilExit(config, k, pmem, 1000) == (int)s.size());
+}
+
+TEST_CASE("LOOP trips come from loop_count", "[ukernel]") {
+    dramsim3::Config config("configs/HBM2_4Gb_test.ini", ".");
+    dramsim3::UKernel k;
+    REQUIRE(k.Assemble(".bank even\n"
+                       "MOV(AAM0) GRF_A BANK\n"
+                       "ADD(AAM0) GRF_B GRF_B GRF_B\n"
+                       "LOOP -1 GRF_A[2]\n"
+                       "EXIT\n"));
+    std::vector<uint8_t> pmem(1 << 16, 0);
+    for (int count = 0; count < 5; count++) {
+        std::vector<dramsim3::UKernelTrigger> s =
+            k.Schedule([count](int) { return count; });
+        REQUIRE(s.size() == (size_t)(2 + count));
+        // MOV loads GRF_A[0..15] from the word at offset 0, lane 2 >> 8 = LC
+        pmem[4] = 0;
+        pmem[5] = count;
+        REQUIRE(RunUntilExit(config, k, pmem, 100) == (int)s.size());
+    }
+}